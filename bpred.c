@@ -51,8 +51,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "host.h"
 #include "misc.h"
@@ -62,6 +68,14 @@
 /* turn this on to enable the SimpleScalar 2.0 RAS bug */
 /* #define RAS_BUG_COMPATIBLE */
 
+/* perceptron history entries kept past the newest H, which bounds the
+   number of branches that may be predicted before an update */
+#define PERC_LAG		1024
+
+/* stat names of the branch types */
+static char *bpred_br_type_name[BrType_NUM] =
+  { "cond", "jump", "call", "ijump", "icall", "ret" };
+
 /* create a branch predictor */
 struct bpred_t *			/* branch predictory instance */
 bpred_create(enum bpred_class class,	/* type of predictor to create */
@@ -108,6 +122,21 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
     pred->dirpred.bimod = 
       bpred_dir_create(class, bimod_size, 0, 0, 0);
 
+    break;
+
+  case BPredPerceptron:
+    pred->dirpred.perc = 
+      bpred_dir_create(class, l1size, 0, shift_width, 0);
+
+    break;
+
+  case BPredTAGE:
+    /* base predictor, bpred_tage_create() adds the tagged components */
+    pred->dirpred.bimod = 
+      bpred_dir_create(BPred2bit, bimod_size, 0, 0, 0);
+
+    break;
+
   case BPredTaken:
   case BPredNotTaken:
     /* no other state */
@@ -120,6 +149,8 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
   /* allocate ret-addr stack */
   switch (class) {
   case BPredComb:
+  case BPredTAGE:
+  case BPredPerceptron:
   case BPred2Level:
   case BPred2bit:
     {
@@ -176,6 +207,218 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
   return pred;
 }
 
+/* TAGE-SC-L predictor, after A. Seznec, "TAGE-SC-L Branch Predictors",
+   4th JILP Championship Branch Prediction, 2014; the statistical corrector
+   and loop predictor are reduced to their essentials */
+
+/* tagged entry counter and useful bit limits */
+#define TAGE_CTR_MAX		3
+#define TAGE_CTR_MIN		(-4)
+#define TAGE_U_MAX		3
+
+/* useful bits are halved every this many updates */
+#define TAGE_U_PERIOD		(1 << 18)
+
+/* use_alt_on_na and with_loop chooser limits */
+#define TAGE_ALT_MAX		7
+#define TAGE_ALT_MIN		(-8)
+#define LOOP_WITH_MAX		63
+#define LOOP_WITH_MIN		(-64)
+
+/* statistical corrector weight limits and threshold adaptation */
+#define SC_W_MAX		31
+#define SC_W_MIN		(-32)
+#define SC_TC_MAX		31
+#define SC_THETA_INIT		12
+
+/* loop entry limits, loops shorter than LOOP_MIN_ITER are left to TAGE */
+#define LOOP_CONF_MAX		3
+#define LOOP_AGE_MAX		7
+#define LOOP_ITER_MAX		0xffff
+#define LOOP_MIN_ITER		3
+
+/* saturating counter updates */
+#define SAT_INC(X, MAX)		do { if ((X) < (MAX)) (X)++; } while (0)
+#define SAT_DEC(X, MIN)		do { if ((X) > (MIN)) (X)--; } while (0)
+#define SAT_UPDATE(X, UP, MIN, MAX)					\
+  do { if (UP) SAT_INC(X, MAX); else SAT_DEC(X, MIN); } while (0)
+
+/* global history lengths of the statistical corrector tables, the first
+   table is a bias table indexed by address and TAGE prediction only */
+static int sc_hist[BPRED_SC_TABLES] = { 0, 4, 10, 20 };
+
+/* initialize folded history F, folding OLEN history bits into CLEN bits */
+static void
+fold_init(struct bpred_fold_t *f, int olen, int clen)
+{
+  f->comp = 0;
+  f->olen = olen;
+  f->clen = clen;
+  f->outpoint = olen % clen;
+}
+
+/* fold the newest global history bit into F */
+static void
+fold_update(struct bpred_fold_t *f, struct bpred_tage_t *t)
+{
+  f->comp = (f->comp << 1) | t->ghist[t->ptr];
+  f->comp ^= t->ghist[(t->ptr + f->olen) & (t->hist_size - 1)] << f->outpoint;
+  f->comp ^= f->comp >> f->clen;
+  f->comp &= (1 << f->clen) - 1;
+}
+
+/* recompute F from the global history, history bit I lands at I % CLEN */
+static void
+fold_rebuild(struct bpred_fold_t *f, struct bpred_tage_t *t)
+{
+  int i;
+
+  f->comp = 0;
+  for (i = 0; i < f->olen; i++)
+    if (t->ghist[(t->ptr + i) & (t->hist_size - 1)])
+      f->comp ^= 1 << (i % f->clen);
+}
+
+/* create a TAGE-SC-L branch predictor, SC_LOG_SIZE is log2 of the number
+   of entries per statistical corrector table and LOOP_SIZE the number of
+   loop predictor entries, either of which may be zero to omit the
+   component */
+struct bpred_t *			/* branch predictory instance */
+bpred_tage_create(unsigned int ntables,	/* number of tagged tables */
+		  unsigned int log_size, /* log2 of entries per table */
+		  unsigned int tag_bits, /* tag width */
+		  unsigned int min_hist, /* shortest history length */
+		  unsigned int max_hist, /* longest history length */
+		  unsigned int log_base, /* log2 of base predictor entries */
+		  unsigned int sc_log_size, /* log2 of SC table entries */
+		  unsigned int loop_size, /* number of loop entries */
+		  unsigned int btb_sets, /* number of sets in BTB */
+		  unsigned int btb_assoc, /* BTB associativity */
+		  unsigned int retstack_size)/* num entries in ret-addr stack */
+{
+  struct bpred_t *pred;
+  struct bpred_tage_t *t;
+  int i;
+
+  if (!ntables || ntables > BPRED_TAGE_MAX)
+    fatal("number of TAGE tables, `%d', must be between 1 and %d",
+	  ntables, BPRED_TAGE_MAX);
+  if (!log_size || log_size > 16)
+    fatal("TAGE table size, `%d', must be between 1 and 16 (log2)", log_size);
+  if (tag_bits < 2 || tag_bits > 16)
+    fatal("TAGE tag width, `%d', must be between 2 and 16", tag_bits);
+  if (!min_hist || max_hist < min_hist || max_hist > 2048)
+    fatal("TAGE history lengths, `%d' to `%d', must be increasing and "
+	  "at most 2048", min_hist, max_hist);
+  if (!log_base || log_base > 24)
+    fatal("TAGE base table size, `%d', must be between 1 and 24 (log2)",
+	  log_base);
+  if (sc_log_size > 20)
+    fatal("SC table size, `%d', must be at most 20 (log2)", sc_log_size);
+  if (loop_size
+      && (loop_size < BPRED_LOOP_ASSOC || (loop_size & (loop_size-1)) != 0))
+    fatal("loop predictor size, `%d', must be zero or a power of two "
+	  ">= %d", loop_size, BPRED_LOOP_ASSOC);
+
+  /* base predictor, BTB and return-address stack */
+  pred = bpred_create(BPredTAGE, 1 << log_base, 0, 0, 0, 0, 0,
+		      btb_sets, btb_assoc, retstack_size);
+
+  if (!(t = calloc(1, sizeof(struct bpred_tage_t))))
+    fatal("out of virtual memory");
+  pred->dirpred.tage = t;
+
+  t->ntables = ntables;
+  t->log_size = log_size;
+  t->tag_bits = tag_bits;
+  t->min_hist = min_hist;
+  t->max_hist = max_hist;
+
+  /* tagged tables with geometric history lengths */
+  for (i = 1; i <= (int)ntables; i++)
+    {
+      if (ntables == 1)
+	t->hist[i] = min_hist;
+      else
+	t->hist[i] = (int)(min_hist * pow((double)max_hist / min_hist,
+					  (double)(i - 1) / (ntables - 1))
+			   + 0.5);
+      if (i > 1 && t->hist[i] <= t->hist[i-1])
+	t->hist[i] = t->hist[i-1] + 1;
+
+      if (!(t->table[i] = calloc(1 << log_size,
+				 sizeof(struct bpred_tage_ent_t))))
+	fatal("cannot allocate TAGE table");
+
+      fold_init(&t->fidx[i], t->hist[i], log_size);
+      fold_init(&t->ftag0[i], t->hist[i], tag_bits);
+      fold_init(&t->ftag1[i], t->hist[i], tag_bits - 1);
+    }
+
+  /* the history must reach back past the oldest in-flight lookup */
+  for (t->hist_size = 1;
+       t->hist_size < t->hist[ntables] + BPRED_TAGE_CKPTS + 1;
+       t->hist_size <<= 1)
+    /* nada */;
+  if (!(t->ghist = calloc(t->hist_size, sizeof(unsigned char))))
+    fatal("cannot allocate TAGE global history");
+  if (!(t->ckpt = calloc(BPRED_TAGE_CKPTS, sizeof(struct bpred_tage_ckpt_t))))
+    fatal("cannot allocate TAGE lookup records");
+  t->seq = 1;
+  t->seed = 0x2545f491;
+
+  /* statistical corrector */
+  t->sc_log_size = sc_log_size;
+  t->sc_theta = SC_THETA_INIT;
+  if (sc_log_size)
+    for (i = 0; i < BPRED_SC_TABLES; i++)
+      if (!(t->sc[i] = calloc(1 << sc_log_size, sizeof(signed char))))
+	fatal("cannot allocate SC table");
+
+  /* loop predictor, start out trusting TAGE */
+  t->loop_size = loop_size;
+  t->with_loop = -1;
+  if (loop_size
+      && !(t->loop = calloc(loop_size, sizeof(struct bpred_loop_ent_t))))
+    fatal("cannot allocate loop predictor");
+
+  return pred;
+}
+
+/* add an indirect target predictor to PRED, a SETS x ASSOC table of
+   targets indexed by branch address and the path of the last PATH_LEN
+   indirect branch targets; it predicts indirect jumps and calls that are
+   not predicted by the return-address stack */
+void
+bpred_indir_create(struct bpred_t *pred, /* branch predictor instance */
+		   unsigned int sets,	/* number of sets */
+		   unsigned int assoc,	/* associativity */
+		   unsigned int path_len) /* targets in path history */
+{
+  int i;
+
+  if (pred->class == BPredTaken || pred->class == BPredNotTaken)
+    fatal("static predictors cannot have an indirect target predictor");
+  if (!sets || (sets & (sets-1)) != 0)
+    fatal("number of indirect target sets must be non-zero and a power of two");
+  if (!assoc || assoc > 255)
+    fatal("indirect target associativity must be between 1 and 255");
+  if (!path_len || path_len > 32)
+    fatal("indirect path history length must be between 1 and 32");
+
+  if (!(pred->indir.data = calloc(sets * assoc,
+				  sizeof(struct bpred_indir_ent_t))))
+    fatal("cannot allocate indirect target predictor");
+
+  /* distinct ages give a total lru order within each set */
+  for (i = 0; i < (int)(sets * assoc); i++)
+    pred->indir.data[i].age = i % assoc;
+
+  pred->indir.sets = sets;
+  pred->indir.assoc = assoc;
+  pred->indir.path_len = path_len;
+}
+
 /* create a branch direction predictor */
 struct bpred_dir_t *		/* branch direction predictor instance */
 bpred_dir_create (
@@ -251,6 +494,34 @@ bpred_dir_create (
 
     break;
 
+  case BPredPerceptron:
+    if (!l1size || (l1size & (l1size-1)) != 0)
+      fatal("perceptron table size, `%d', must be non-zero and a power of two",
+	    l1size);
+    if (!shift_width || shift_width > 1024)
+      fatal("perceptron history length, `%d', must be between 1 and 1024",
+	    shift_width);
+    pred_dir->config.perc.size = l1size;
+    pred_dir->config.perc.hist_len = shift_width;
+
+    /* Jimenez & Lin's best threshold for a given history length */
+    pred_dir->config.perc.theta = (int)(1.93 * shift_width + 14);
+
+    if (!(pred_dir->config.perc.bias = calloc(l1size, sizeof(signed char)))
+	|| !(pred_dir->config.perc.weights =
+	     calloc(l1size * shift_width, sizeof(signed char))))
+      fatal("cannot allocate perceptron weights");
+
+    /* history window, slid back from the front when it fills */
+    pred_dir->config.perc.hist_size = 4 * (shift_width + PERC_LAG);
+    if (!(pred_dir->config.perc.hist =
+	  calloc(pred_dir->config.perc.hist_size, sizeof(unsigned char))))
+      fatal("cannot allocate perceptron history");
+    pred_dir->config.perc.head =
+      pred_dir->config.perc.hist_size - (shift_width + PERC_LAG);
+
+    break;
+
   case BPredTaken:
   case BPredNotTaken:
     /* no other state */
@@ -283,6 +554,13 @@ bpred_dir_config(
       name, pred_dir->config.bimod.size);
     break;
 
+  case BPredPerceptron:
+    fprintf(stream,
+      "pred_dir: %s: perceptron: %d entries, %d history bits, theta %d\n",
+      name, pred_dir->config.perc.size, pred_dir->config.perc.hist_len,
+      pred_dir->config.perc.theta);
+    break;
+
   case BPredTaken:
     fprintf(stream, "pred_dir: %s: predict taken\n", name);
     break;
@@ -311,6 +589,36 @@ bpred_config(struct bpred_t *pred,	/* branch predictor instance */
     fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
     break;
 
+  case BPredTAGE:
+    {
+      struct bpred_tage_t *t = pred->dirpred.tage;
+      int i;
+
+      bpred_dir_config (pred->dirpred.bimod, "base", stream);
+      fprintf(stream, "pred_dir: tage: %d tables x %d entries, %d-bit tags, "
+	      "history lengths", t->ntables, 1 << t->log_size, t->tag_bits);
+      for (i = 1; i <= t->ntables; i++)
+	fprintf(stream, " %d", t->hist[i]);
+      fprintf(stream, "\n");
+      if (t->sc_log_size)
+	fprintf(stream, "pred_dir: sc: %d tables x %d entries\n",
+		BPRED_SC_TABLES, 1 << t->sc_log_size);
+      if (t->loop_size)
+	fprintf(stream, "pred_dir: loop: %d entries, %d-way\n",
+		t->loop_size, BPRED_LOOP_ASSOC);
+      fprintf(stream, "btb: %d sets x %d associativity", 
+	      pred->btb.sets, pred->btb.assoc);
+      fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
+    }
+    break;
+
+  case BPredPerceptron:
+    bpred_dir_config (pred->dirpred.perc, "perc", stream);
+    fprintf(stream, "btb: %d sets x %d associativity", 
+	    pred->btb.sets, pred->btb.assoc);
+    fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
+    break;
+
   case BPred2Level:
     bpred_dir_config (pred->dirpred.twolev, "2lev", stream);
     fprintf(stream, "btb: %d sets x %d associativity", 
@@ -335,6 +643,10 @@ bpred_config(struct bpred_t *pred,	/* branch predictor instance */
   default:
     panic("bogus branch predictor class");
   }
+
+  if (pred->indir.sets)
+    fprintf(stream, "indir: %d sets x %d associativity, %d target path\n",
+	    pred->indir.sets, pred->indir.assoc, pred->indir.path_len);
 }
 
 /* print predictor stats */
@@ -354,6 +666,7 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
 		struct stat_sdb_t *sdb)	/* stats database */
 {
   char buf[512], buf1[512], *name;
+  int i;
 
   /* get a name for this predictor */
   switch (pred->class)
@@ -361,6 +674,12 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
     case BPredComb:
       name = "bpred_comb";
       break;
+    case BPredTAGE:
+      name = "bpred_tage";
+      break;
+    case BPredPerceptron:
+      name = "bpred_perc";
+      break;
     case BPred2Level:
       name = "bpred_2lev";
       break;
@@ -376,6 +695,8 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
     default:
       panic("bogus branch predictor class");
     }
+  if (pred->name)
+    name = pred->name;
 
   sprintf(buf, "%s.lookups", name);
   stat_reg_counter(sdb, buf, "total number of bpred lookups",
@@ -402,8 +723,77 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
 		       "total number of 2-level predictions used", 
 		       &pred->used_2lev, 0, NULL);
     }
+  if (pred->class == BPredTAGE)
+    {
+      struct bpred_tage_t *t = pred->dirpred.tage;
+      int i;
+
+      /* component 0 is the base predictor */
+      for (i = 0; i <= t->ntables; i++)
+	{
+	  sprintf(buf, "%s.prov_T%d", name, i);
+	  sprintf(buf1, "total number of predictions provided by %s%d",
+		  i ? "tagged table " : "base table ", i);
+	  stat_reg_counter(sdb, buf, buf1, &pred->tage_prov[i], 0, NULL);
+	  sprintf(buf, "%s.prov_misses_T%d", name, i);
+	  sprintf(buf1, "total number of provider misses by %s%d",
+		  i ? "tagged table " : "base table ", i);
+	  stat_reg_counter(sdb, buf, buf1,
+			   &pred->tage_prov_misses[i], 0, NULL);
+	  sprintf(buf, "%s.alt_T%d", name, i);
+	  sprintf(buf1, "total number of alt-provider predictions used "
+		  "from %s%d", i ? "tagged table " : "base table ", i);
+	  stat_reg_counter(sdb, buf, buf1, &pred->tage_alt[i], 0, NULL);
+	  sprintf(buf, "%s.alt_misses_T%d", name, i);
+	  sprintf(buf1, "total number of alt-provider misses by %s%d",
+		  i ? "tagged table " : "base table ", i);
+	  stat_reg_counter(sdb, buf, buf1,
+			   &pred->tage_alt_misses[i], 0, NULL);
+	}
+      sprintf(buf, "%s.tage_allocs", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of tagged entries allocated",
+		       &pred->tage_allocs, 0, NULL);
+      sprintf(buf, "%s.hist_repairs", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of speculative history repairs",
+		       &pred->tage_repairs, 0, NULL);
+      if (t->sc_log_size)
+	{
+	  sprintf(buf, "%s.sc_used", name);
+	  stat_reg_counter(sdb, buf,
+			   "total number of TAGE predictions reverted by SC",
+			   &pred->sc_used, 0, NULL);
+	  sprintf(buf, "%s.sc_hits", name);
+	  stat_reg_counter(sdb, buf,
+			   "total number of correct SC reversals",
+			   &pred->sc_hits, 0, NULL);
+	}
+      if (t->loop_size)
+	{
+	  sprintf(buf, "%s.loop_used", name);
+	  stat_reg_counter(sdb, buf,
+			   "total number of loop predictions used",
+			   &pred->loop_used, 0, NULL);
+	  sprintf(buf, "%s.loop_hits", name);
+	  stat_reg_counter(sdb, buf,
+			   "total number of correct loop predictions used",
+			   &pred->loop_hits, 0, NULL);
+	}
+    }
   sprintf(buf, "%s.misses", name);
   stat_reg_counter(sdb, buf, "total number of misses", &pred->misses, 0, NULL);
+  for (i = 0; i < BrType_NUM; i++)
+    {
+      sprintf(buf, "%s.%s_seen", name, bpred_br_type_name[i]);
+      sprintf(buf1, "total number of %s branches seen",
+	      bpred_br_type_name[i]);
+      stat_reg_counter(sdb, buf, buf1, &pred->type_seen[i], 0, NULL);
+      sprintf(buf, "%s.%s_misses", name, bpred_br_type_name[i]);
+      sprintf(buf1, "total number of %s branch address mispredictions",
+	      bpred_br_type_name[i]);
+      stat_reg_counter(sdb, buf, buf1, &pred->type_misses[i], 0, NULL);
+    }
   sprintf(buf, "%s.jr_hits", name);
   stat_reg_counter(sdb, buf,
 		   "total number of address-predicted hits for JR's",
@@ -461,6 +851,23 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
   stat_reg_formula(sdb, buf,
 		   "RAS prediction rate (i.e., RAS hits/used RAS)",
 		   buf1, "%9.4f");
+  if (pred->indir.sets)
+    {
+      sprintf(buf, "%s.used_indir", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of indirect target predictions used",
+		       &pred->indir_used, 0, NULL);
+      sprintf(buf, "%s.indir_hits", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of indirect target hits",
+		       &pred->indir_hits, 0, NULL);
+      sprintf(buf, "%s.indir_rate", name);
+      sprintf(buf1, "%s.indir_hits / %s.used_indir", name, name);
+      stat_reg_formula(sdb, buf,
+		       "indirect target prediction rate "
+		       "(i.e., indir hits/used indir)",
+		       buf1, "%9.4f");
+    }
 }
 
 void
@@ -481,6 +888,20 @@ bpred_after_priming(struct bpred_t *bpred)
   bpred->retstack_pops = 0;
   bpred->retstack_pushes = 0;
   bpred->ras_hits = 0;
+  memset(bpred->tage_prov, 0, sizeof(bpred->tage_prov));
+  memset(bpred->tage_prov_misses, 0, sizeof(bpred->tage_prov_misses));
+  memset(bpred->tage_alt, 0, sizeof(bpred->tage_alt));
+  memset(bpred->tage_alt_misses, 0, sizeof(bpred->tage_alt_misses));
+  bpred->tage_allocs = 0;
+  bpred->tage_repairs = 0;
+  bpred->sc_used = 0;
+  bpred->sc_hits = 0;
+  bpred->loop_used = 0;
+  bpred->loop_hits = 0;
+  bpred->indir_used = 0;
+  bpred->indir_hits = 0;
+  memset(bpred->type_seen, 0, sizeof(bpred->type_seen));
+  memset(bpred->type_misses, 0, sizeof(bpred->type_misses));
 }
 
 #define BIMOD_HASH(PRED, ADDR)						\
@@ -543,6 +964,764 @@ bpred_dir_lookup(struct bpred_dir_t *pred_dir,	/* branch dir predictor inst */
   return (char *)p;
 }
 
+/* tagged table I index for branch address BADDR */
+static unsigned int
+tage_index(struct bpred_tage_t *t, md_addr_t baddr, int i)
+{
+  unsigned int pc = baddr >> MD_BR_SHIFT;
+  unsigned int path = t->path & ((1 << MIN(t->hist[i], 16)) - 1);
+
+  path = (path ^ (path >> t->log_size)) * (2 * i + 1);
+  return ((pc ^ (pc >> ((i % t->log_size) + 1)) ^ t->fidx[i].comp ^ path)
+	  & ((1 << t->log_size) - 1));
+}
+
+/* tagged table I tag for branch address BADDR */
+static unsigned int
+tage_tag(struct bpred_tage_t *t, md_addr_t baddr, int i)
+{
+  unsigned int pc = baddr >> MD_BR_SHIFT;
+
+  return ((pc ^ t->ftag0[i].comp ^ (t->ftag1[i].comp << 1))
+	  & ((1 << t->tag_bits) - 1));
+}
+
+/* statistical corrector table J index, GHR is the global history and
+   TAGE_PRED the TAGE prediction at lookup */
+static unsigned int
+sc_index(struct bpred_tage_t *t, md_addr_t baddr, unsigned int ghr,
+	 int tage_pred, int j)
+{
+  unsigned int pc = baddr >> MD_BR_SHIFT;
+  unsigned int h = ghr & ((1 << sc_hist[j]) - 1);
+
+  return (((((pc ^ (h * (2 * j + 1))) << 1) | tage_pred)
+	   ^ (h >> t->sc_log_size)) & ((1 << t->sc_log_size) - 1));
+}
+
+/* find the loop entry for branch address BADDR, entries with zero age are
+   free; returns the entry index or -1 */
+static int
+loop_lookup(struct bpred_tage_t *t, md_addr_t baddr)
+{
+  unsigned int pc = baddr >> MD_BR_SHIFT;
+  unsigned int nsets = t->loop_size / BPRED_LOOP_ASSOC;
+  unsigned int tag = (pc / nsets) & 0xffff;
+  int i, set = (pc & (nsets - 1)) * BPRED_LOOP_ASSOC;
+
+  for (i = set; i < set + BPRED_LOOP_ASSOC; i++)
+    if (t->loop[i].age && t->loop[i].tag == tag)
+      return i;
+  return -1;
+}
+
+/* advance the speculative iteration count of loop entry L */
+static void
+loop_spec_update(struct bpred_loop_ent_t *l, int taken)
+{
+  if (!!taken == l->dir)
+    SAT_INC(l->spec_iter, LOOP_ITER_MAX);
+  else
+    l->spec_iter = 0;
+}
+
+/* push the direction of the branch at BADDR onto the global history */
+static void
+tage_push(struct bpred_tage_t *t, md_addr_t baddr, int taken)
+{
+  int i;
+
+  t->ptr = (t->ptr - 1) & (t->hist_size - 1);
+  t->ghist[t->ptr] = !!taken;
+  t->ghr = (t->ghr << 1) | !!taken;
+  t->path = ((t->path << 1) | ((baddr >> MD_BR_SHIFT) & 1)) & 0xffff;
+
+  for (i = 1; i <= t->ntables; i++)
+    {
+      fold_update(&t->fidx[i], t);
+      fold_update(&t->ftag0[i], t);
+      fold_update(&t->ftag1[i], t);
+    }
+}
+
+/* predict the branch at BADDR with the TAGE-SC-L predictor, record the
+   lookup for update and recovery, and speculatively update the global
+   history with the prediction (unconditional branches are always taken) */
+static void
+tage_lookup(struct bpred_t *pred,		/* branch predictor instance */
+	    md_addr_t baddr,			/* branch address */
+	    enum md_opcode op,			/* opcode of instruction */
+	    struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  struct bpred_tage_t *t = pred->dirpred.tage;
+  struct bpred_tage_ckpt_t *ck;
+  int i, j, taken;
+
+  ck = &t->ckpt[t->seq & (BPRED_TAGE_CKPTS - 1)];
+  dir_update_ptr->seq = ck->seq = t->seq++;
+  ck->squashed = FALSE;
+  ck->cond = (MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND);
+  ck->baddr = baddr;
+  ck->ptr = t->ptr;
+  ck->path = t->path;
+  ck->ghr = t->ghr;
+  ck->hit = ck->alt = 0;
+  ck->weak = ck->use_alt = FALSE;
+  ck->sc_used = ck->loop_used = ck->loop_valid = FALSE;
+  ck->loop_way = -1;
+
+  if (!ck->cond)
+    taken = TRUE;
+  else
+    {
+      char *base = bpred_dir_lookup(pred->dirpred.bimod, baddr);
+
+      /* the longest matching table provides, the next longest is the
+	 alternate, the base predictor backs both */
+      for (i = t->ntables; i > 0; i--)
+	{
+	  ck->idx[i] = tage_index(t, baddr, i);
+	  ck->tag[i] = tage_tag(t, baddr, i);
+	  if (t->table[i][ck->idx[i]].tag == ck->tag[i])
+	    {
+	      if (!ck->hit)
+		ck->hit = i;
+	      else if (!ck->alt)
+		ck->alt = i;
+	    }
+	}
+      ck->alt_pred = (ck->alt
+		      ? t->table[ck->alt][ck->idx[ck->alt]].ctr >= 0
+		      : *base >= 2);
+
+      if (ck->hit)
+	{
+	  struct bpred_tage_ent_t *e = &t->table[ck->hit][ck->idx[ck->hit]];
+
+	  /* newly allocated entries are unreliable, maybe use the alt */
+	  ck->prov_pred = e->ctr >= 0;
+	  ck->weak = !e->u && (e->ctr == 0 || e->ctr == -1);
+	  ck->use_alt = ck->weak && t->use_alt_on_na >= 0;
+	  ck->tage_pred = ck->use_alt ? ck->alt_pred : ck->prov_pred;
+	}
+      else
+	ck->prov_pred = ck->tage_pred = ck->alt_pred;
+      taken = ck->tage_pred;
+
+      /* statistical corrector reverts confident disagreements */
+      if (t->sc_log_size)
+	{
+	  ck->sc_sum = 0;
+	  for (j = 0; j < BPRED_SC_TABLES; j++)
+	    ck->sc_sum +=
+	      2 * t->sc[j][sc_index(t, baddr, ck->ghr, ck->tage_pred, j)] + 1;
+	  if ((ck->sc_sum >= 0) != taken
+	      && abs(ck->sc_sum) >= t->sc_theta)
+	    {
+	      ck->sc_used = TRUE;
+	      taken = !taken;
+	    }
+	}
+
+      /* loop predictor overrides on a confident trip count */
+      if (t->loop_size && (ck->loop_way = loop_lookup(t, baddr)) >= 0)
+	{
+	  struct bpred_loop_ent_t *l = &t->loop[ck->loop_way];
+
+	  ck->loop_iter = l->spec_iter;
+	  ck->loop_valid = l->conf == LOOP_CONF_MAX && l->past_iter;
+	  ck->loop_pred = (l->spec_iter >= l->past_iter) ? !l->dir : l->dir;
+	  if (ck->loop_valid && t->with_loop >= 0)
+	    {
+	      ck->loop_used = TRUE;
+	      taken = ck->loop_pred;
+	    }
+	  loop_spec_update(l, taken);
+	}
+    }
+
+  ck->pred = taken;
+  dir_update_ptr->dir.tage = taken;
+  tage_push(t, baddr, taken);
+}
+
+/* roll the speculative history back to lookup CK and redo it with the
+   resolved direction TAKEN; younger lookups are squashed */
+static void
+tage_repair(struct bpred_t *pred,		/* branch predictor instance */
+	    struct bpred_tage_ckpt_t *ck,	/* mispredicted lookup */
+	    int taken)				/* resolved direction */
+{
+  struct bpred_tage_t *t = pred->dirpred.tage;
+  struct bpred_tage_ckpt_t *c;
+  unsigned int seq;
+  int i;
+
+  pred->tage_repairs++;
+
+  /* undo loop iteration counts of younger lookups, youngest first */
+  for (seq = t->seq - 1; seq != ck->seq; seq--)
+    {
+      c = &t->ckpt[seq & (BPRED_TAGE_CKPTS - 1)];
+      if (c->seq != seq)
+	break;
+      if (!c->squashed && c->loop_way >= 0)
+	t->loop[c->loop_way].spec_iter = c->loop_iter;
+      c->squashed = TRUE;
+    }
+
+  /* restore the history as of the lookup, then append the outcome */
+  t->ptr = ck->ptr;
+  t->path = ck->path;
+  t->ghr = ck->ghr;
+  for (i = 1; i <= t->ntables; i++)
+    {
+      fold_rebuild(&t->fidx[i], t);
+      fold_rebuild(&t->ftag0[i], t);
+      fold_rebuild(&t->ftag1[i], t);
+    }
+  if (ck->loop_way >= 0)
+    {
+      t->loop[ck->loop_way].spec_iter = ck->loop_iter;
+      loop_spec_update(&t->loop[ck->loop_way], taken);
+    }
+  tage_push(t, ck->baddr, taken);
+}
+
+/* find the lookup record for *DIR_UPDATE_PTR, or NULL if it was recycled */
+static struct bpred_tage_ckpt_t *
+tage_ckpt(struct bpred_tage_t *t, struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_tage_ckpt_t *ck;
+
+  ck = &t->ckpt[dir_update_ptr->seq & (BPRED_TAGE_CKPTS - 1)];
+  return ck->seq == dir_update_ptr->seq ? ck : NULL;
+}
+
+/* allocate a tagged entry with longer history than the provider of CK */
+static void
+tage_alloc(struct bpred_t *pred,		/* branch predictor instance */
+	   struct bpred_tage_ckpt_t *ck,	/* mispredicted lookup */
+	   int taken)				/* resolved direction */
+{
+  struct bpred_tage_t *t = pred->dirpred.tage;
+  struct bpred_tage_ent_t *e;
+  int i, start;
+
+  /* randomly skip the first candidate to spread allocations */
+  t->seed ^= t->seed << 13;
+  t->seed ^= t->seed >> 17;
+  t->seed ^= t->seed << 5;
+  start = ck->hit + 1;
+  if ((t->seed & 1) && start < t->ntables)
+    start++;
+
+  for (i = start; i <= t->ntables; i++)
+    {
+      e = &t->table[i][ck->idx[i]];
+      if (!e->u)
+	{
+	  e->tag = ck->tag[i];
+	  e->ctr = taken ? 0 : -1;
+	  pred->tage_allocs++;
+	  return;
+	}
+    }
+
+  /* no entry available, age the candidates */
+  for (i = start; i <= t->ntables; i++)
+    SAT_DEC(t->table[i][ck->idx[i]].u, 0);
+}
+
+/* train the loop predictor with the committed direction TAKEN of CK */
+static void
+loop_update(struct bpred_t *pred,		/* branch predictor instance */
+	    struct bpred_tage_ckpt_t *ck,	/* lookup record */
+	    int taken)				/* resolved direction */
+{
+  struct bpred_tage_t *t = pred->dirpred.tage;
+  struct bpred_loop_ent_t *l;
+  unsigned int pc, nsets;
+  int i, set, way;
+
+  if ((way = loop_lookup(t, ck->baddr)) >= 0)
+    {
+      l = &t->loop[way];
+
+      if (ck->loop_valid && way == ck->loop_way)
+	{
+	  /* choose between the loop and TAGE predictions */
+	  if (ck->loop_pred != ck->tage_pred)
+	    SAT_UPDATE(t->with_loop, ck->loop_pred == !!taken,
+		       LOOP_WITH_MIN, LOOP_WITH_MAX);
+
+	  /* trip count changed, free the entry */
+	  if (ck->loop_pred != !!taken)
+	    {
+	      l->age = 0;
+	      return;
+	    }
+	}
+
+      if (!!taken == l->dir)
+	{
+	  /* another iteration, give up on runaway loops */
+	  if (++l->cur_iter == LOOP_ITER_MAX)
+	    l->age = 0;
+	}
+      else
+	{
+	  /* loop exit, confirm or learn the trip count */
+	  if (l->cur_iter == l->past_iter)
+	    {
+	      SAT_INC(l->conf, LOOP_CONF_MAX);
+	      SAT_INC(l->age, LOOP_AGE_MAX);
+	    }
+	  else
+	    {
+	      l->past_iter = l->cur_iter;
+	      l->conf = 0;
+	    }
+	  if (l->past_iter < LOOP_MIN_ITER)
+	    l->age = 0;
+	  l->cur_iter = 0;
+	}
+    }
+  else if (ck->pred != !!taken)
+    {
+      /* allocate on a mis-prediction, assuming it was a loop exit */
+      pc = ck->baddr >> MD_BR_SHIFT;
+      nsets = t->loop_size / BPRED_LOOP_ASSOC;
+      set = (pc & (nsets - 1)) * BPRED_LOOP_ASSOC;
+      for (i = set; i < set + BPRED_LOOP_ASSOC; i++)
+	if (!t->loop[i].age)
+	  break;
+      if (i == set + BPRED_LOOP_ASSOC)
+	{
+	  for (i = set; i < set + BPRED_LOOP_ASSOC; i++)
+	    t->loop[i].age--;
+	  return;
+	}
+      l = &t->loop[i];
+      l->tag = (pc / nsets) & 0xffff;
+      l->dir = !taken;
+      l->past_iter = l->cur_iter = l->spec_iter = 0;
+      l->conf = 0;
+      l->age = LOOP_AGE_MAX;
+    }
+}
+
+/* train the TAGE-SC-L predictor with the resolved direction TAKEN of the
+   lookup recorded in *DIR_UPDATE_PTR */
+static void
+tage_update(struct bpred_t *pred,		/* branch predictor instance */
+	    int taken,				/* resolved direction */
+	    struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  struct bpred_tage_t *t = pred->dirpred.tage;
+  struct bpred_tage_ckpt_t *ck;
+  struct bpred_tage_ent_t *e;
+  char *base;
+  int i, j;
+
+  /* too many lookups in flight, the record is gone */
+  if (!(ck = tage_ckpt(t, dir_update_ptr)))
+    return;
+
+  taken = !!taken;
+
+  /* if nothing was predicted since, repair the history here (in-order
+     callers do not call bpred_recover()) */
+  if (ck->pred != taken && ck->seq == t->seq - 1)
+    tage_repair(pred, ck, taken);
+
+  if (!ck->cond)
+    return;
+
+  /* provider stats */
+  if (ck->use_alt)
+    {
+      pred->tage_alt[ck->alt]++;
+      if (ck->alt_pred != taken)
+	pred->tage_alt_misses[ck->alt]++;
+    }
+  else
+    {
+      pred->tage_prov[ck->hit]++;
+      if (ck->prov_pred != taken)
+	pred->tage_prov_misses[ck->hit]++;
+    }
+  if (ck->sc_used)
+    {
+      pred->sc_used++;
+      if (ck->tage_pred != taken)
+	pred->sc_hits++;
+    }
+  if (ck->loop_used)
+    {
+      pred->loop_used++;
+      if (ck->loop_pred == taken)
+	pred->loop_hits++;
+    }
+
+  if (t->loop_size)
+    loop_update(pred, ck, taken);
+
+  /* statistical corrector, trained on mistakes and low-confidence sums */
+  if (t->sc_log_size)
+    {
+      int sc_pred = ck->sc_sum >= 0;
+
+      if (sc_pred != taken || abs(ck->sc_sum) < t->sc_theta)
+	for (j = 0; j < BPRED_SC_TABLES; j++)
+	  SAT_UPDATE(t->sc[j][sc_index(t, ck->baddr, ck->ghr,
+				       ck->tage_pred, j)],
+		     taken, SC_W_MIN, SC_W_MAX);
+
+      /* adapt the override threshold when SC disagreed with TAGE */
+      if (sc_pred != ck->tage_pred)
+	{
+	  if (sc_pred != taken)
+	    SAT_INC(t->sc_tc, SC_TC_MAX);
+	  else
+	    SAT_DEC(t->sc_tc, -SC_TC_MAX);
+	  if (t->sc_tc == SC_TC_MAX)
+	    {
+	      t->sc_theta++;
+	      t->sc_tc = 0;
+	    }
+	  else if (t->sc_tc == -SC_TC_MAX)
+	    {
+	      if (t->sc_theta > 1)
+		t->sc_theta--;
+	      t->sc_tc = 0;
+	    }
+	}
+    }
+
+  /* allocate longer-history entries when TAGE mispredicted, unless only
+     the choice of a new provider's alternate was wrong */
+  if (ck->tage_pred != taken && ck->hit < t->ntables
+      && !(ck->use_alt && ck->prov_pred == taken))
+    tage_alloc(pred, ck, taken);
+
+  /* periodically age the useful bits */
+  if (++t->tick == TAGE_U_PERIOD)
+    {
+      t->tick = 0;
+      for (i = 1; i <= t->ntables; i++)
+	for (j = 0; j < (1 << t->log_size); j++)
+	  t->table[i][j].u >>= 1;
+    }
+
+  /* the provider may have been replaced since the lookup */
+  e = ck->hit ? &t->table[ck->hit][ck->idx[ck->hit]] : NULL;
+  if (e && e->tag == ck->tag[ck->hit])
+    {
+      /* learn whether to trust new entries over their alternate */
+      if (ck->weak && ck->prov_pred != ck->alt_pred)
+	SAT_UPDATE(t->use_alt_on_na, ck->alt_pred == taken,
+		   TAGE_ALT_MIN, TAGE_ALT_MAX);
+
+      /* a provider not yet useful also trains its alternate */
+      if (!e->u)
+	{
+	  if (ck->alt)
+	    SAT_UPDATE(t->table[ck->alt][ck->idx[ck->alt]].ctr, taken,
+		       TAGE_CTR_MIN, TAGE_CTR_MAX);
+	  else
+	    {
+	      base = bpred_dir_lookup(pred->dirpred.bimod, ck->baddr);
+	      SAT_UPDATE(*base, taken, 0, 3);
+	    }
+	}
+
+      SAT_UPDATE(e->ctr, taken, TAGE_CTR_MIN, TAGE_CTR_MAX);
+
+      /* useful when it beat a disagreeing alternate */
+      if (ck->prov_pred != ck->alt_pred)
+	SAT_UPDATE(e->u, ck->prov_pred == taken, 0, TAGE_U_MAX);
+    }
+  else if (!ck->hit)
+    {
+      base = bpred_dir_lookup(pred->dirpred.bimod, ck->baddr);
+      SAT_UPDATE(*base, taken, 0, 3);
+    }
+}
+
+#define PERC_HASH(PRED, ADDR)						\
+  ((((ADDR) >> 19) ^ ((ADDR) >> MD_BR_SHIFT)) & ((PRED)->config.perc.size-1))
+
+/* dot product of the N weights W with the history X, an X entry of 0x00
+   counts +1 and 0xff counts -1; weights are widened to 16 bits before
+   being negated so -128 does not overflow */
+static inline int
+perc_dot(signed char *w,		/* weights */
+	 unsigned char *x,		/* history */
+	 int n)				/* number of weights */
+{
+  int i = 0, sum = 0;
+
+#if defined(__AVX2__)
+  __m256i acc = _mm256_setzero_si256();
+  __m256i ones = _mm256_set1_epi16(1);
+  __m128i s;
+
+  for (; i + 16 <= n; i += 16)
+    {
+      __m256i wv = _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i *)&w[i]));
+      __m256i xv = _mm256_cvtepi8_epi16(_mm_loadu_si128((__m128i *)&x[i]));
+
+      /* (w ^ x) - x is w where x is 0, -w where x is -1 */
+      wv = _mm256_sub_epi16(_mm256_xor_si256(wv, xv), xv);
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(wv, ones));
+    }
+  s = _mm_add_epi32(_mm256_castsi256_si128(acc),
+		    _mm256_extracti128_si256(acc, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1,0,3,2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2,3,0,1)));
+  sum = _mm_cvtsi128_si32(s);
+#elif defined(__SSE2__)
+  __m128i acc = _mm_setzero_si128();
+  __m128i ones = _mm_set1_epi16(1);
+
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i wb = _mm_loadu_si128((__m128i *)&w[i]);
+      __m128i xb = _mm_loadu_si128((__m128i *)&x[i]);
+
+      /* sign-extend both halves to 16 bits */
+      __m128i wlo = _mm_srai_epi16(_mm_unpacklo_epi8(wb, wb), 8);
+      __m128i whi = _mm_srai_epi16(_mm_unpackhi_epi8(wb, wb), 8);
+      __m128i xlo = _mm_srai_epi16(_mm_unpacklo_epi8(xb, xb), 8);
+      __m128i xhi = _mm_srai_epi16(_mm_unpackhi_epi8(xb, xb), 8);
+
+      /* (w ^ x) - x is w where x is 0, -w where x is -1 */
+      wlo = _mm_sub_epi16(_mm_xor_si128(wlo, xlo), xlo);
+      whi = _mm_sub_epi16(_mm_xor_si128(whi, xhi), xhi);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(wlo, ones));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(whi, ones));
+    }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1,0,3,2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2,3,0,1)));
+  sum = _mm_cvtsi128_si32(acc);
+#endif
+
+  /* remaining weights, or all of them without SIMD support */
+  for (; i < n; i++)
+    sum += x[i] ? -w[i] : w[i];
+  return sum;
+}
+
+/* train the N weights W toward outcome TAKEN, each weight moves by +1
+   where history X agrees with the outcome and by -1 where it does not,
+   saturating at the 8-bit limits */
+static inline void
+perc_train(signed char *w,		/* weights */
+	   unsigned char *x,		/* history */
+	   int n,			/* number of weights */
+	   int taken)			/* branch outcome */
+{
+  unsigned char t = taken ? 0x00 : 0xff;
+  int i = 0, d;
+
+#if defined(__AVX2__)
+  __m256i tv = _mm256_set1_epi8(t), one = _mm256_set1_epi8(1);
+
+  for (; i + 32 <= n; i += 32)
+    {
+      __m256i xv = _mm256_loadu_si256((__m256i *)&x[i]);
+      __m256i wv = _mm256_loadu_si256((__m256i *)&w[i]);
+
+      /* (x ^ t) | 1 is +1 on agreement, -1 otherwise */
+      wv = _mm256_adds_epi8(wv, _mm256_or_si256(_mm256_xor_si256(xv, tv), one));
+      _mm256_storeu_si256((__m256i *)&w[i], wv);
+    }
+#elif defined(__SSE2__)
+  __m128i tv = _mm_set1_epi8(t), one = _mm_set1_epi8(1);
+
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i xv = _mm_loadu_si128((__m128i *)&x[i]);
+      __m128i wv = _mm_loadu_si128((__m128i *)&w[i]);
+
+      /* (x ^ t) | 1 is +1 on agreement, -1 otherwise */
+      wv = _mm_adds_epi8(wv, _mm_or_si128(_mm_xor_si128(xv, tv), one));
+      _mm_storeu_si128((__m128i *)&w[i], wv);
+    }
+#endif
+
+  /* remaining weights, or all of them without SIMD support */
+  for (; i < n; i++)
+    {
+      d = w[i] + ((x[i] == t) ? 1 : -1);
+      w[i] = MAX(-128, MIN(127, d));
+    }
+}
+
+/* predict the branch at BADDR with perceptron predictor PRED_DIR, the
+   output and history position are saved in *DIR_UPDATE_PTR for training */
+static void
+perc_lookup(struct bpred_dir_t *pred_dir,	/* perceptron predictor */
+	    md_addr_t baddr,			/* branch address */
+	    struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  int row = PERC_HASH(pred_dir, baddr);
+  int len = pred_dir->config.perc.hist_len;
+
+  dir_update_ptr->out = pred_dir->config.perc.bias[row]
+    + perc_dot(&pred_dir->config.perc.weights[row * len],
+	       &pred_dir->config.perc.hist[pred_dir->config.perc.head], len);
+  dir_update_ptr->dir.perc = dir_update_ptr->out >= 0;
+  dir_update_ptr->seq = pred_dir->config.perc.nbranches;
+}
+
+/* train perceptron predictor PRED_DIR with the outcome TAKEN of the branch
+   at BADDR, using the history it was predicted with, then shift the
+   outcome into the history */
+static void
+perc_update(struct bpred_dir_t *pred_dir,	/* perceptron predictor */
+	    md_addr_t baddr,			/* branch address */
+	    int taken,				/* resolved direction */
+	    struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  int row = PERC_HASH(pred_dir, baddr);
+  int len = pred_dir->config.perc.hist_len;
+  unsigned int lag = pred_dir->config.perc.nbranches - dir_update_ptr->seq;
+  int window = len + PERC_LAG;
+
+  /* train on mispredictions and low-confidence outputs, unless the
+     history the prediction used has been shifted out */
+  if (lag <= PERC_LAG
+      && (dir_update_ptr->dir.perc != !!taken
+	  || abs(dir_update_ptr->out) <= pred_dir->config.perc.theta))
+    {
+      signed char *bias = &pred_dir->config.perc.bias[row];
+
+      if (taken)
+	{
+	  if (*bias < 127)
+	    ++*bias;
+	}
+      else
+	{
+	  if (*bias > -128)
+	    --*bias;
+	}
+      perc_train(&pred_dir->config.perc.weights[row * len],
+		 &pred_dir->config.perc.hist[pred_dir->config.perc.head + lag],
+		 len, taken);
+    }
+
+  /* slide the newest history back to the end of the buffer when full */
+  if (pred_dir->config.perc.head == 0)
+    {
+      pred_dir->config.perc.head = pred_dir->config.perc.hist_size - window;
+      memmove(&pred_dir->config.perc.hist[pred_dir->config.perc.head],
+	      pred_dir->config.perc.hist, window);
+    }
+  pred_dir->config.perc.hist[--pred_dir->config.perc.head] =
+    taken ? 0x00 : 0xff;
+  pred_dir->config.perc.nbranches++;
+}
+
+/* classify the branch with opcode OP for the per-type stats */
+static enum bpred_br_type
+bpred_br_type(enum md_opcode op,		/* opcode of instruction */
+	      struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  unsigned int flags = MD_OP_FLAGS(op);
+
+  if (dir_update_ptr->dir.ret)
+    return BrReturn;
+  else if (MD_IS_CALL(op))
+    return (flags & F_INDIRJMP) ? BrIndCall : BrCall;
+  else if ((flags & (F_UNCOND|F_INDIRJMP)) == (F_UNCOND|F_INDIRJMP))
+    return BrIndJump;
+  else if (flags & F_UNCOND)
+    return BrJump;
+  else
+    return BrCond;
+}
+
+/* predict the target of the indirect branch at BADDR from the path of
+   preceding indirect targets, returns the target or 0 if none */
+static md_addr_t
+indir_lookup(struct bpred_t *pred,		/* branch predictor instance */
+	     md_addr_t baddr,			/* branch address */
+	     struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  unsigned int pc = baddr >> MD_BR_SHIFT;
+  unsigned int hash = pc ^ pred->indir.path ^ (pred->indir.path >> 13);
+  int i, set = (hash & (pred->indir.sets - 1)) * pred->indir.assoc;
+
+  /* remember where to train, the path moves on before the update */
+  dir_update_ptr->ihash = hash;
+
+  for (i = set; i < set + pred->indir.assoc; i++)
+    if (pred->indir.data[i].tag == hash && pred->indir.data[i].target)
+      {
+	dir_update_ptr->dir.indir = TRUE;
+	return pred->indir.data[i].target;
+      }
+  return 0;
+}
+
+/* train the indirect target predictor with the resolved target BTARGET of
+   the branch described by *DIR_UPDATE_PTR, then extend the path history */
+static void
+indir_update(struct bpred_t *pred,		/* branch predictor instance */
+	     md_addr_t btarget,			/* resolved branch target */
+	     struct bpred_update_t *dir_update_ptr) /* pred state pointer */
+{
+  struct bpred_indir_ent_t *ent = NULL, *lru = NULL;
+  unsigned int hash = dir_update_ptr->ihash;
+  int i, set = (hash & (pred->indir.sets - 1)) * pred->indir.assoc;
+
+  for (i = set; i < set + pred->indir.assoc; i++)
+    {
+      if (pred->indir.data[i].tag == hash && pred->indir.data[i].target)
+	ent = &pred->indir.data[i];
+      if (!lru || pred->indir.data[i].age > lru->age)
+	lru = &pred->indir.data[i];
+    }
+
+  if (ent)
+    {
+      /* replace the target only after repeated misses */
+      if (ent->target == btarget)
+	{
+	  if (ent->ctr < 3)
+	    ent->ctr++;
+	}
+      else if (ent->ctr > 0)
+	ent->ctr--;
+      else
+	ent->target = btarget;
+    }
+  else
+    {
+      /* allocate over the LRU entry */
+      ent = lru;
+      ent->tag = hash;
+      ent->target = btarget;
+      ent->ctr = 1;
+    }
+
+  /* ENT becomes MRU */
+  for (i = set; i < set + pred->indir.assoc; i++)
+    if (pred->indir.data[i].age < ent->age)
+      pred->indir.data[i].age++;
+  ent->age = 0;
+
+  /* each target fills 32 / PATH_LEN bits of the path history */
+  if (pred->indir.path_len > 1)
+    pred->indir.path = ((pred->indir.path << (32 / pred->indir.path_len))
+			^ (btarget >> MD_BR_SHIFT));
+  else
+    pred->indir.path = btarget >> MD_BR_SHIFT;
+}
+
 /* probe a predictor for a next fetch address, the predictor is probed
    with branch address BADDR, the branch target is BTARGET (used for
    static predictors), and OP is the instruction opcode (used to simulate
@@ -562,7 +1741,7 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 					 * used on mispredict recovery */
 {
   struct bpred_btb_ent_t *pbtb = NULL;
-  int index, i;
+  int index, i, pred_taken;
 
   if (!dir_update_ptr)
     panic("no bpred update record");
@@ -574,6 +1753,8 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
   pred->lookups++;
 
   dir_update_ptr->dir.ras = FALSE;
+  dir_update_ptr->dir.ret = !!is_return;
+  dir_update_ptr->dir.indir = FALSE;
   dir_update_ptr->pdir1 = NULL;
   dir_update_ptr->pdir2 = NULL;
   dir_update_ptr->pmeta = NULL;
@@ -602,6 +1783,13 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 	    }
 	}
       break;
+    case BPredTAGE:
+      tage_lookup(pred, baddr, op, dir_update_ptr);
+      break;
+    case BPredPerceptron:
+      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
+	perc_lookup(pred->dirpred.perc, baddr, dir_update_ptr);
+      break;
     case BPred2Level:
       if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
 	{
@@ -696,21 +1884,35 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
   /* if this is a jump, ignore predicted direction; we know it's taken. */
   if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) == (F_CTRL|F_UNCOND))
     {
+      md_addr_t target;
+
+      /* indirect jumps prefer the path-based target */
+      if (pred->indir.sets && (MD_OP_FLAGS(op) & F_INDIRJMP)
+	  && (target = indir_lookup(pred, baddr, dir_update_ptr)) != 0)
+	return target;
+
       return (pbtb ? pbtb->target : 1);
     }
 
   /* otherwise we have a conditional branch */
+  if (pred->class == BPredTAGE)
+    pred_taken = dir_update_ptr->dir.tage;
+  else if (pred->class == BPredPerceptron)
+    pred_taken = dir_update_ptr->dir.perc;
+  else
+    pred_taken = (*(dir_update_ptr->pdir1) >= 2);
+
   if (pbtb == NULL)
     {
       /* BTB miss -- just return a predicted direction */
-      return ((*(dir_update_ptr->pdir1) >= 2)
+      return (pred_taken
 	      ? /* taken */ 1
 	      : /* not taken */ 0);
     }
   else
     {
       /* BTB hit, so return target if it's a predicted-taken branch */
-      return ((*(dir_update_ptr->pdir1) >= 2)
+      return (pred_taken
 	      ? /* taken */ pbtb->target
 	      : /* not taken */ 0);
     }
@@ -719,17 +1921,27 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 /* Speculative execution can corrupt the ret-addr stack.  So for each
  * lookup we return the top-of-stack (TOS) at that point; a mispredicted
  * branch, as part of its recovery, restores the TOS using this value --
- * hopefully this uncorrupts the stack. */
+ * hopefully this uncorrupts the stack.  Predictors with speculative global
+ * history also roll it back to the mispredicted branch, found through
+ * *DIR_UPDATE_PTR, and append its resolved direction TAKEN. */
 void
 bpred_recover(struct bpred_t *pred,	/* branch predictor instance */
 	      md_addr_t baddr,		/* branch address */
-	      int stack_recover_idx)	/* Non-speculative top-of-stack;
+	      int stack_recover_idx,	/* Non-speculative top-of-stack;
 					 * used on mispredict recovery */
+	      int taken,		/* non-zero if branch was taken */
+	      struct bpred_update_t *dir_update_ptr) /* pred state pointer */
 {
+  struct bpred_tage_ckpt_t *ck;
+
   if (pred == NULL)
     return;
 
   pred->retstack.tos = stack_recover_idx;
+
+  if (pred->class == BPredTAGE && dir_update_ptr
+      && (ck = tage_ckpt(pred->dirpred.tage, dir_update_ptr)) != NULL)
+    tage_repair(pred, ck, !!taken);
 }
 
 /* update the branch predictor, only useful for stateful predictors; updates
@@ -764,6 +1976,10 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
   if (correct)
     pred->addr_hits++;
 
+  pred->type_seen[bpred_br_type(op, dir_update_ptr)]++;
+  if (!correct)
+    pred->type_misses[bpred_br_type(op, dir_update_ptr)]++;
+
   if (!!pred_taken == !!taken)
     pred->dir_hits++;
   else
@@ -824,6 +2040,22 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
     }
 #endif /* RAS_BUG_COMPATIBLE */
 
+  /* indirect jumps not handled by the RAS train the target predictor,
+     returns predicted by the RAS never looked it up and have no hash */
+  if (pred->indir.sets
+      && (MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND|F_INDIRJMP))
+	  == (F_CTRL|F_UNCOND|F_INDIRJMP)
+      && !dir_update_ptr->dir.ras)
+    {
+      if (dir_update_ptr->dir.indir)
+	{
+	  pred->indir_used++;
+	  if (correct)
+	    pred->indir_hits++;
+	}
+      indir_update(pred, btarget, dir_update_ptr);
+    }
+
   /* update L1 table if appropriate */
   /* L1 table is updated unconditionally for combining predictor too */
   if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND) &&
@@ -840,6 +2072,15 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
 	shift_reg & ((1 << pred->dirpred.twolev->config.two.shift_width) - 1);
     }
 
+  /* perceptron trains on the history it predicted with */
+  if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND) &&
+      pred->class == BPredPerceptron)
+    perc_update(pred->dirpred.perc, baddr, taken, dir_update_ptr);
+
+  /* TAGE trains from the state recorded at lookup */
+  if (pred->class == BPredTAGE)
+    tage_update(pred, taken, dir_update_ptr);
+
   /* find BTB entry if it's a taken branch (don't allocate for non-taken) */
   if (taken)
     {
@@ -91,6 +91,36 @@
  *		are incremented on taken branches and decremented on
  *		no taken branches.  One BTB entry per counter.
  *
+ *	BPredTAGE:  TAGE-SC-L predictor (Seznec)
+ *
+ *		A bimodal base predictor backed by a number of partially
+ *		tagged tables indexed with geometrically increasing global
+ *		history lengths.  The longest matching table provides the
+ *		prediction, the next longest one the alternate prediction.
+ *		Entries carry useful bits that steer allocation on
+ *		mispredictions.  Optionally, a statistical corrector can
+ *		revert low-confidence TAGE predictions and a loop predictor
+ *		can override TAGE on loops with a constant trip count.
+ *		Global history is updated speculatively at lookup and
+ *		repaired by bpred_recover().  Parameters are:
+ *		     N   # tagged tables
+ *		     S   log2 of # entries per tagged table
+ *		     T   tag width in bits
+ *		     L   shortest and longest history lengths
+ *		     B   log2 of # entries in the base predictor
+ *
+ *	BPredPerceptron:  perceptron predictor (Jimenez & Lin)
+ *
+ *		A table of perceptrons indexed by branch address, each with
+ *		a bias weight and one 8-bit weight per global history bit.
+ *		The prediction is the sign of the bias plus the dot product
+ *		of the weights with the history (taken = +1, not taken = -1),
+ *		computed with SSE2/AVX2 integer ops when the host has them.
+ *		Weights are trained on mispredictions and on outputs within
+ *		the training threshold.  Parameters are:
+ *		     N   # perceptrons
+ *		     H   global history length
+ *
  *	BPredTaken:  static predict branch taken
  *
  *	BPredNotTaken:  static predict branch not taken
@@ -100,6 +130,8 @@
 /* branch predictor types */
 enum bpred_class {
   BPredComb,                    /* combined predictor (McFarling) */
+  BPredTAGE,			/* TAGE-SC-L predictor (Seznec) */
+  BPredPerceptron,		/* perceptron predictor (Jimenez & Lin) */
   BPred2Level,			/* 2-level correlating pred w/2-bit counters */
   BPred2bit,			/* 2-bit saturating cntr pred (dir mapped) */
   BPredTaken,			/* static predict taken */
@@ -107,6 +139,17 @@ enum bpred_class {
   BPred_NUM
 };
 
+/* branch types, for misprediction stats */
+enum bpred_br_type {
+  BrCond,			/* conditional branch */
+  BrJump,			/* direct unconditional jump */
+  BrCall,			/* direct function call */
+  BrIndJump,			/* indirect jump */
+  BrIndCall,			/* indirect function call */
+  BrReturn,			/* function return */
+  BrType_NUM
+};
+
 /* an entry in a BTB */
 struct bpred_btb_ent_t {
   md_addr_t addr;		/* address of branch being tracked */
@@ -115,6 +158,14 @@ struct bpred_btb_ent_t {
   struct bpred_btb_ent_t *prev, *next; /* lru chaining pointers */
 };
 
+/* an entry in the indirect target predictor */
+struct bpred_indir_ent_t {
+  unsigned int tag;		/* branch address and path hash */
+  md_addr_t target;		/* predicted target */
+  unsigned char ctr;		/* 2-bit target hysteresis counter */
+  unsigned char age;		/* lru age in set */
+};
+
 /* direction predictor def */
 struct bpred_dir_t {
   enum bpred_class class;	/* type of predictor */
@@ -131,16 +182,137 @@ struct bpred_dir_t {
       int *shiftregs;		/* level-1 history table */
       unsigned char *l2table;	/* level-2 prediction state table */
     } two;
+    struct {
+      unsigned int size;	/* number of perceptrons */
+      int hist_len;		/* global history length (weights per row) */
+      int theta;		/* training threshold */
+      signed char *bias;	/* bias weight of each perceptron */
+      signed char *weights;	/* history weights, a row per perceptron */
+      unsigned char *hist;	/* global history, newest at hist[head],
+				   0x00 for taken, 0xff for not taken */
+      int hist_size;		/* size of hist */
+      int head;			/* newest history entry */
+      unsigned int nbranches;	/* number of history updates */
+    } perc;
   } config;
 };
 
+/* maximum number of TAGE tagged tables */
+#define BPRED_TAGE_MAX		16
+
+/* number of in-flight TAGE lookups tracked for update and recovery */
+#define BPRED_TAGE_CKPTS	1024
+
+/* number of statistical corrector tables */
+#define BPRED_SC_TABLES		4
+
+/* loop predictor associativity */
+#define BPRED_LOOP_ASSOC	4
+
+/* a TAGE tagged table entry */
+struct bpred_tage_ent_t {
+  signed char ctr;		/* 3-bit signed prediction counter */
+  unsigned char u;		/* 2-bit useful counter */
+  unsigned short tag;		/* partial tag */
+};
+
+/* a folded (compressed) global history register */
+struct bpred_fold_t {
+  unsigned int comp;		/* folded history */
+  int clen;			/* folded length in bits */
+  int olen;			/* history length folded */
+  int outpoint;			/* olen % clen */
+};
+
+/* a loop predictor entry */
+struct bpred_loop_ent_t {
+  unsigned short tag;		/* partial tag */
+  unsigned short past_iter;	/* trip count of the last complete loop */
+  unsigned short cur_iter;	/* iterations of current loop (committed) */
+  unsigned short spec_iter;	/* iterations of current loop (speculative) */
+  unsigned char conf;		/* trip count confidence */
+  unsigned char age;		/* replacement age */
+  unsigned char dir;		/* direction of the loop body branch */
+};
+
+/* state saved by a TAGE lookup, used to train the tables on update and to
+   repair the speculative global history on a mis-prediction */
+struct bpred_tage_ckpt_t {
+  unsigned int seq;		/* lookup sequence number */
+  int squashed;			/* rolled back by an older mis-prediction */
+  int cond;			/* conditional branch? */
+  md_addr_t baddr;		/* branch address */
+  int ptr;			/* global history head before this branch */
+  unsigned int path;		/* path history before this branch */
+  unsigned int ghr;		/* recent global history before this branch */
+  int hit;			/* provider component (0 = base) */
+  int alt;			/* alternate provider component (0 = base) */
+  int prov_pred;		/* provider prediction */
+  int weak;			/* provider was a new, weak entry */
+  int alt_pred;			/* alternate prediction */
+  int use_alt;			/* alternate prediction was used */
+  int tage_pred;		/* TAGE prediction */
+  int sc_sum;			/* statistical corrector sum */
+  int sc_used;			/* statistical corrector reverted TAGE */
+  int loop_way;			/* loop predictor entry, or -1 */
+  int loop_iter;		/* loop entry speculative count before this */
+  int loop_valid;		/* loop predictor was confident */
+  int loop_pred;		/* loop prediction */
+  int loop_used;		/* loop prediction was used */
+  int pred;			/* final prediction */
+  unsigned short idx[BPRED_TAGE_MAX+1];	/* tagged table indices */
+  unsigned short tag[BPRED_TAGE_MAX+1];	/* tagged table tags */
+};
+
+/* TAGE-SC-L predictor state */
+struct bpred_tage_t {
+  int ntables;			/* number of tagged tables */
+  int log_size;			/* log2 of entries per tagged table */
+  int tag_bits;			/* tag width */
+  int min_hist, max_hist;	/* shortest and longest history lengths */
+  int hist[BPRED_TAGE_MAX+1];	/* history length of each table */
+  struct bpred_tage_ent_t *table[BPRED_TAGE_MAX+1]; /* tagged tables */
+  struct bpred_fold_t fidx[BPRED_TAGE_MAX+1];	/* folded index histories */
+  struct bpred_fold_t ftag0[BPRED_TAGE_MAX+1];	/* folded tag histories */
+  struct bpred_fold_t ftag1[BPRED_TAGE_MAX+1];
+
+  /* speculative global history */
+  unsigned char *ghist;		/* history bits, newest at ghist[ptr] */
+  int hist_size;		/* size of ghist, a power of two */
+  int ptr;			/* current history head */
+  unsigned int path;		/* path history */
+  unsigned int ghr;		/* most recent 32 history bits */
+
+  int use_alt_on_na;		/* trust alternate over new entries? */
+  int tick;			/* useful bit aging counter */
+  unsigned int seed;		/* allocation pseudo-random seed */
+
+  /* in-flight lookups, indexed by sequence number */
+  unsigned int seq;		/* next lookup sequence number */
+  struct bpred_tage_ckpt_t *ckpt;
+
+  /* statistical corrector (none if sc_log_size == 0) */
+  int sc_log_size;		/* log2 of entries per SC table */
+  signed char *sc[BPRED_SC_TABLES]; /* SC weight tables */
+  int sc_theta;			/* SC override threshold */
+  int sc_tc;			/* SC threshold adaptation counter */
+
+  /* loop predictor (none if loop_size == 0) */
+  int loop_size;		/* number of loop entries */
+  struct bpred_loop_ent_t *loop;
+  int with_loop;		/* trust loop predictor over TAGE? */
+};
+
 /* branch predictor def */
 struct bpred_t {
   enum bpred_class class;	/* type of predictor */
+  char *name;			/* stats name, NULL for bpred_<class> */
   struct {
     struct bpred_dir_t *bimod;	  /* first direction predictor */
     struct bpred_dir_t *twolev;	  /* second direction predictor */
     struct bpred_dir_t *meta;	  /* meta predictor */
+    struct bpred_tage_t *tage;	  /* TAGE tagged components (BPredTAGE) */
+    struct bpred_dir_t *perc;	  /* perceptron table (BPredPerceptron) */
   } dirpred;
 
   struct {
@@ -149,6 +321,14 @@ struct bpred_t {
     struct bpred_btb_ent_t *btb_data; /* BTB addr-prediction table */
   } btb;
 
+  struct {
+    int sets;			/* num indirect target sets, 0 if none */
+    int assoc;			/* indirect target associativity */
+    int path_len;		/* num targets in path history */
+    unsigned int path;		/* path history of indirect targets */
+    struct bpred_indir_ent_t *data; /* indirect target table */
+  } indir;
+
   struct {
     int size;			/* return-address stack size */
     int tos;			/* top-of-stack */
@@ -171,6 +351,22 @@ struct bpred_t {
   counter_t retstack_pops;	/* number of times a value was popped */
   counter_t retstack_pushes;	/* number of times a value was pushed */
   counter_t ras_hits;		/* num correct return-address predictions */
+  counter_t indir_used;		/* num indirect target predictions used */
+  counter_t indir_hits;		/* num correct indirect target predictions */
+  counter_t type_seen[BrType_NUM]; /* num branches, per branch type */
+  counter_t type_misses[BrType_NUM]; /* num incorrect preds, per type */
+
+  /* TAGE stats (BPredTAGE) */
+  counter_t tage_prov[BPRED_TAGE_MAX+1];	/* predictions per provider */
+  counter_t tage_prov_misses[BPRED_TAGE_MAX+1];	/* mispreds per provider */
+  counter_t tage_alt[BPRED_TAGE_MAX+1];	/* alt predictions used, per comp */
+  counter_t tage_alt_misses[BPRED_TAGE_MAX+1];	/* mispreds by alt, per comp */
+  counter_t tage_allocs;	/* num tagged entries allocated */
+  counter_t tage_repairs;	/* num speculative history repairs */
+  counter_t sc_used;		/* num TAGE predictions reverted by SC */
+  counter_t sc_hits;		/* num correct SC reversals */
+  counter_t loop_used;		/* num loop predictions used */
+  counter_t loop_hits;		/* num correct loop predictions used */
 };
 
 /* branch predictor update information */
@@ -183,7 +379,15 @@ struct bpred_update_t {
     unsigned int bimod  : 1;    /* bimodal predictor */
     unsigned int twolev : 1;    /* 2-level predictor */
     unsigned int meta   : 1;    /* meta predictor (0..bimod / 1..2lev) */
+    unsigned int tage   : 1;    /* TAGE-SC-L predictor */
+    unsigned int perc   : 1;    /* perceptron predictor */
+    unsigned int ret    : 1;    /* branch is a function return */
+    unsigned int indir  : 1;    /* indirect target predictor used */
   } dir;
+  unsigned int seq;	/* TAGE lookup sequence number, or perceptron
+			   history position at lookup */
+  int out;		/* perceptron output */
+  unsigned int ihash;	/* indirect target predictor address/path hash */
 };
 
 /* create a branch predictor */
@@ -199,6 +403,33 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
 	     unsigned int btb_assoc,	/* BTB associativity */
 	     unsigned int retstack_size);/* num entries in ret-addr stack */
 
+/* create a TAGE-SC-L branch predictor, SC_LOG_SIZE is log2 of the number
+   of entries per statistical corrector table and LOOP_SIZE the number of
+   loop predictor entries, either of which may be zero to omit the
+   component */
+struct bpred_t *			/* branch predictory instance */
+bpred_tage_create(unsigned int ntables,	/* number of tagged tables */
+		  unsigned int log_size, /* log2 of entries per table */
+		  unsigned int tag_bits, /* tag width */
+		  unsigned int min_hist, /* shortest history length */
+		  unsigned int max_hist, /* longest history length */
+		  unsigned int log_base, /* log2 of base predictor entries */
+		  unsigned int sc_log_size, /* log2 of SC table entries */
+		  unsigned int loop_size, /* number of loop entries */
+		  unsigned int btb_sets, /* number of sets in BTB */
+		  unsigned int btb_assoc, /* BTB associativity */
+		  unsigned int retstack_size);/* num entries in ret-addr stack */
+
+/* add an indirect target predictor to PRED, a SETS x ASSOC table of
+   targets indexed by branch address and the path of the last PATH_LEN
+   indirect branch targets; it predicts indirect jumps and calls that are
+   not predicted by the return-address stack */
+void
+bpred_indir_create(struct bpred_t *pred, /* branch predictor instance */
+		   unsigned int sets,	/* number of sets */
+		   unsigned int assoc,	/* associativity */
+		   unsigned int path_len); /* targets in path history */
+
 /* create a branch direction predictor */
 struct bpred_dir_t *		/* branch direction predictor instance */
 bpred_dir_create (
@@ -247,12 +478,16 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 /* Speculative execution can corrupt the ret-addr stack.  So for each
  * lookup we return the top-of-stack (TOS) at that point; a mispredicted
  * branch, as part of its recovery, restores the TOS using this value --
- * hopefully this uncorrupts the stack. */
+ * hopefully this uncorrupts the stack.  Predictors with speculative global
+ * history also roll it back to the mispredicted branch, found through
+ * *DIR_UPDATE_PTR, and append its resolved direction TAKEN. */
 void
 bpred_recover(struct bpred_t *pred,	/* branch predictor instance */
 	      md_addr_t baddr,		/* branch address */
-	      int stack_recover_idx);	/* Non-speculative top-of-stack;
+	      int stack_recover_idx,	/* Non-speculative top-of-stack;
 					 * used on mispredict recovery */
+	      int taken,		/* non-zero if branch was taken */
+	      struct bpred_update_t *dir_update_ptr); /* pred state pointer */
 
 /* update the branch predictor, only useful for stateful predictors; updates
    entry for instruction type OP at address BADDR.  BTB only gets updated
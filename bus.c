@@ -0,0 +1,330 @@
+/* bus.c - bus and crossbar interconnect timing model routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bus.h"
+
+/* initial size of the reservation table */
+#define BUS_RESV_INIT		16
+
+/* first bus clock edge at or after T */
+#define BUS_ALIGN(BUS, T)						\
+  ((((T) + (BUS)->ratio - 1) / (BUS)->ratio) * (BUS)->ratio)
+
+/* CPU cycles NBYTES hold bus BUS */
+#define BUS_XFER(BUS, NBYTES)						\
+  ((((NBYTES) + (BUS)->width - 1) / (BUS)->width) * (BUS)->ratio)
+
+/* create a bus named NAME of WIDTH bytes at 1/RATIO of the CPU clock, with
+   arbitration MODE and WBUFS write-back buffers */
+struct bus_t *				/* pointer to bus created */
+bus_create(char *name,			/* name of the bus */
+	   int width,			/* bytes per bus cycle */
+	   int ratio,			/* CPU cycles per bus cycle */
+	   enum bus_mode mode,		/* arbitration mode */
+	   int wbufs)			/* number of write-back buffers */
+{
+  struct bus_t *bus;
+
+  /* check all bus parameters */
+  if (width < 1)
+    fatal("bus `%s' width must be at least one byte", name);
+  if (ratio < 1)
+    fatal("bus `%s' clock ratio must be at least one", name);
+  if (wbufs < 0)
+    fatal("bus `%s' write-back buffers must not be negative", name);
+
+  bus = (struct bus_t *)calloc(1, sizeof(struct bus_t));
+  if (!bus)
+    fatal("out of virtual memory");
+
+  bus->name = mystrdup(name);
+  bus->width = width;
+  bus->ratio = ratio;
+  bus->mode = mode;
+  bus->wbufs = wbufs;
+
+  bus->resv_size = BUS_RESV_INIT;
+  bus->resv = (struct bus_resv_t *)
+    calloc(bus->resv_size, sizeof(struct bus_resv_t));
+  if (!bus->resv)
+    fatal("out of virtual memory");
+  bus->nresv = 0;
+
+  if (wbufs)
+    {
+      bus->wbuf_free = (tick_t *)calloc(wbufs, sizeof(tick_t));
+      if (!bus->wbuf_free)
+	fatal("out of virtual memory");
+    }
+
+  return bus;
+}
+
+/* reserve bus BUS for LEN cycles at the first bus clock edge at or after T,
+   in the first gap long enough if FILL, else after all reservations; returns
+   the start of the reservation */
+static tick_t				/* start of reservation */
+bus_reserve(struct bus_t *bus,		/* bus instance */
+	    tick_t t,			/* earliest start */
+	    int len,			/* cycles to reserve */
+	    int fill)			/* may use gaps between reservations? */
+{
+  struct bus_resv_t *resv;
+  tick_t start;
+  int i, drop;
+
+  /* drop the reservations over by T */
+  for (drop=0; drop < bus->nresv && bus->resv[drop].end <= t; drop++)
+    /* nada */;
+  if (drop)
+    {
+      memmove(bus->resv, bus->resv + drop,
+	      (bus->nresv - drop) * sizeof(struct bus_resv_t));
+      bus->nresv -= drop;
+    }
+
+  /* find the first gap of LEN cycles */
+  start = BUS_ALIGN(bus, t);
+  if (!fill && bus->nresv)
+    start = BUS_ALIGN(bus, MAX(start, bus->resv[bus->nresv-1].end));
+  for (i=0; i < bus->nresv; i++)
+    {
+      if (bus->resv[i].end <= start)
+	continue;
+      if (bus->resv[i].start >= start + len)
+	break;
+      start = BUS_ALIGN(bus, bus->resv[i].end);
+    }
+
+  /* insert the reservation before entry I, merging it with its neighbours
+     if they touch */
+  if (i > 0 && bus->resv[i-1].end == start)
+    {
+      bus->resv[i-1].end = start + len;
+      if (i < bus->nresv && bus->resv[i].start == start + len)
+	{
+	  bus->resv[i-1].end = bus->resv[i].end;
+	  memmove(bus->resv + i, bus->resv + i + 1,
+		  (bus->nresv - i - 1) * sizeof(struct bus_resv_t));
+	  bus->nresv--;
+	}
+    }
+  else if (i < bus->nresv && bus->resv[i].start == start + len)
+    bus->resv[i].start = start;
+  else
+    {
+      if (bus->nresv == bus->resv_size)
+	{
+	  resv = (struct bus_resv_t *)
+	    realloc(bus->resv, 2 * bus->resv_size * sizeof(struct bus_resv_t));
+	  if (!resv)
+	    fatal("out of virtual memory");
+	  bus->resv = resv;
+	  bus->resv_size *= 2;
+	}
+      memmove(bus->resv + i + 1, bus->resv + i,
+	      (bus->nresv - i) * sizeof(struct bus_resv_t));
+      bus->resv[i].start = start;
+      bus->resv[i].end = start + len;
+      bus->nresv++;
+    }
+
+  bus->busy += len;
+  bus->queue_delay += start - t;
+  return start;
+}
+
+/* send a read request over bus BUS at NOW, returns the time the request
+   reaches the next level */
+tick_t					/* time request is delivered */
+bus_request(struct bus_t *bus,		/* bus instance */
+	    tick_t now)			/* time of request */
+{
+  bus->transfers++;
+  return bus_reserve(bus, now, bus->ratio,
+		     /* fill */bus->mode == BUS_Pipelined) + bus->ratio;
+}
+
+/* return NBYTES requested over bus BUS at REQ, which the next level has
+   ready at READY, returns the time the data has crossed the bus */
+tick_t					/* time data is delivered */
+bus_response(struct bus_t *bus,		/* bus instance */
+	     int nbytes,		/* bytes returned */
+	     tick_t req,		/* time request was sent */
+	     tick_t ready)		/* time data is ready */
+{
+  int xfer = BUS_XFER(bus, nbytes);
+  tick_t start;
+
+  if (bus->mode == BUS_Atomic)
+    {
+      /* the bus was held since the request, the data follows at once */
+      start = BUS_ALIGN(bus, MAX(req, ready));
+      bus_reserve(bus, req, (int)(start + xfer - req), /* fill */FALSE);
+      return start + xfer;
+    }
+
+  return bus_reserve(bus, ready, xfer, /* fill */TRUE) + xfer;
+}
+
+/* write back NBYTES over bus BUS at NOW, through a write-back buffer;
+   returns the cycles the writer stalls and sets *START to the time the
+   block starts crossing the bus */
+unsigned int				/* cycles writer stalls */
+bus_writeback(struct bus_t *bus,	/* bus instance */
+	      int nbytes,		/* bytes written back */
+	      tick_t now,		/* time of write-back */
+	      tick_t *start)		/* time transfer starts */
+{
+  int i, buf = 0, xfer = BUS_XFER(bus, nbytes);
+  tick_t t = now;
+  unsigned int stall;
+
+  bus->transfers++;
+  bus->writebacks++;
+
+  /* wait for the buffer that frees first */
+  if (bus->wbufs)
+    {
+      for (i=1; i < bus->wbufs; i++)
+	{
+	  if (bus->wbuf_free[i] < bus->wbuf_free[buf])
+	    buf = i;
+	}
+      if (bus->wbuf_free[buf] > now)
+	{
+	  bus->wbuf_full++;
+	  t = bus->wbuf_free[buf];
+	}
+    }
+
+  *start = bus_reserve(bus, t, xfer, /* fill */bus->mode == BUS_Pipelined);
+
+  /* the buffer is freed once the block has crossed the bus, without a
+     buffer the writer waits for that */
+  if (bus->wbufs)
+    {
+      bus->wbuf_free[buf] = *start + xfer;
+      stall = (unsigned int)(t - now);
+    }
+  else
+    stall = (unsigned int)(*start + xfer - now);
+
+  bus->wbuf_stalls += stall;
+  return stall;
+}
+
+/* drop all reservations and empty the write-back buffers */
+void
+bus_flush(struct bus_t *bus)		/* bus instance */
+{
+  int i;
+
+  bus->nresv = 0;
+  for (i=0; i < bus->wbufs; i++)
+    bus->wbuf_free[i] = 0;
+}
+
+/* print bus configuration */
+void
+bus_config(struct bus_t *bus,		/* bus instance */
+	   FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "bus: %s: %d bytes wide, %d cycle(s) per bus cycle, %s, "
+	  "%d write-back buffer(s)\n",
+	  bus->name, bus->width, bus->ratio,
+	  bus->mode == BUS_Pipelined ? "pipelined" : "atomic", bus->wbufs);
+}
+
+/* register bus stats, the bus utilization is its busy cycles over
+   CYCLES_STAT, the name of the stat counting elapsed cycles */
+void
+bus_reg_stats(struct bus_t *bus,	/* bus instance */
+	      struct stat_sdb_t *sdb,	/* stats database */
+	      char *cycles_stat)	/* name of stat of elapsed cycles */
+{
+  char buf[512], buf1[512], *name = bus->name;
+
+  sprintf(buf, "%s.transfers", name);
+  stat_reg_counter(sdb, buf, "total number of transfers (requests and "
+		   "write-backs)", &bus->transfers, 0, NULL);
+  sprintf(buf, "%s.busy", name);
+  stat_reg_counter(sdb, buf, "cycles the bus was reserved",
+		   &bus->busy, 0, NULL);
+  sprintf(buf, "%s.utilization", name);
+  sprintf(buf1, "%s.busy / %s", name, cycles_stat);
+  stat_reg_formula(sdb, buf, "bus utilization (i.e., busy cycles/cycle)",
+		   buf1, NULL);
+  sprintf(buf, "%s.queue_delay", name);
+  stat_reg_counter(sdb, buf, "total cycles transfers waited for the bus",
+		   &bus->queue_delay, 0, NULL);
+  sprintf(buf, "%s.avg_queue_delay", name);
+  sprintf(buf1, "%s.queue_delay / %s.transfers", name, name);
+  stat_reg_formula(sdb, buf, "average cycles a transfer waited for the bus",
+		   buf1, NULL);
+  sprintf(buf, "%s.writebacks", name);
+  stat_reg_counter(sdb, buf, "write-backs sent over the bus",
+		   &bus->writebacks, 0, NULL);
+  sprintf(buf, "%s.wbuf_full", name);
+  stat_reg_counter(sdb, buf, "write-backs finding no free write-back buffer",
+		   &bus->wbuf_full, 0, NULL);
+  sprintf(buf, "%s.wbuf_stalls", name);
+  stat_reg_counter(sdb, buf, "cycles caches stalled writing back",
+		   &bus->wbuf_stalls, 0, NULL);
+}
@@ -0,0 +1,170 @@
+/* bus.h - bus and crossbar interconnect timing model interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+/*
+ * This module models the link from a cache to the next level of the memory
+ * hierarchy.  A bus is WIDTH bytes wide and runs at 1/RATIO of the CPU
+ * clock; transfers start on a bus clock edge, and a block of N bytes holds
+ * the bus for N/WIDTH bus cycles.  A read sends its request in one bus
+ * cycle, then the next level returns the block over the bus.
+ *
+ * A pipelined (split-transaction) bus is released between the request and
+ * the data, so the transfers of other misses may use it in between.  An
+ * atomic bus is held from the request until the data has been returned.
+ *
+ * Write-backs are held in WBUFS write-back buffers, each buffer is freed
+ * once its block has crossed the bus.  A cache writing back a block while
+ * all buffers are in use stalls until one is free.  With no buffers, the
+ * cache waits for the write-back to cross the bus.
+ *
+ * The bus keeps a table of the intervals it is reserved for, so that the
+ * out-of-order times of cache accesses are handled.  Intervals that end
+ * before an access are dropped from the table.  Several caches may share
+ * one bus; a crossbar is modeled by giving each cache its own bus.
+ */
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/* bus arbitration modes */
+enum bus_mode {
+  BUS_Pipelined,			/* released between request and data */
+  BUS_Atomic				/* held from request until data */
+};
+
+/* bus interval reservation */
+struct bus_resv_t
+{
+  tick_t start;				/* first cycle reserved */
+  tick_t end;				/* first cycle after the reservation */
+};
+
+/* bus definition */
+struct bus_t
+{
+  /* parameters */
+  char *name;				/* bus name */
+  int width;				/* bytes per bus cycle */
+  int ratio;				/* CPU cycles per bus cycle */
+  enum bus_mode mode;			/* arbitration mode */
+  int wbufs;				/* number of write-back buffers */
+
+  /* reservations, sorted by start time and not overlapping */
+  struct bus_resv_t *resv;		/* reserved intervals */
+  int nresv;				/* number of reserved intervals */
+  int resv_size;			/* intervals allocated */
+
+  tick_t *wbuf_free;			/* time each write-back buffer frees */
+
+  /* stats */
+  counter_t transfers;			/* total number of transfers */
+  counter_t busy;			/* CPU cycles the bus was reserved */
+  counter_t queue_delay;		/* CPU cycles transfers waited for bus */
+  counter_t writebacks;			/* write-backs sent over the bus */
+  counter_t wbuf_full;			/* write-backs finding no free buffer */
+  counter_t wbuf_stalls;		/* cycles caches stalled for a buffer */
+};
+
+/* create a bus named NAME of WIDTH bytes at 1/RATIO of the CPU clock, with
+   arbitration MODE and WBUFS write-back buffers */
+struct bus_t *				/* pointer to bus created */
+bus_create(char *name,			/* name of the bus */
+	   int width,			/* bytes per bus cycle */
+	   int ratio,			/* CPU cycles per bus cycle */
+	   enum bus_mode mode,		/* arbitration mode */
+	   int wbufs);			/* number of write-back buffers */
+
+/* send a read request over bus BUS at NOW, returns the time the request
+   reaches the next level */
+tick_t					/* time request is delivered */
+bus_request(struct bus_t *bus,		/* bus instance */
+	    tick_t now);		/* time of request */
+
+/* return NBYTES requested over bus BUS at REQ, which the next level has
+   ready at READY, returns the time the data has crossed the bus */
+tick_t					/* time data is delivered */
+bus_response(struct bus_t *bus,		/* bus instance */
+	     int nbytes,		/* bytes returned */
+	     tick_t req,		/* time request was sent */
+	     tick_t ready);		/* time data is ready */
+
+/* write back NBYTES over bus BUS at NOW, through a write-back buffer;
+   returns the cycles the writer stalls and sets *START to the time the
+   block starts crossing the bus */
+unsigned int				/* cycles writer stalls */
+bus_writeback(struct bus_t *bus,	/* bus instance */
+	      int nbytes,		/* bytes written back */
+	      tick_t now,		/* time of write-back */
+	      tick_t *start);		/* time transfer starts */
+
+/* drop all reservations and empty the write-back buffers */
+void
+bus_flush(struct bus_t *bus);		/* bus instance */
+
+/* print bus configuration */
+void
+bus_config(struct bus_t *bus,		/* bus instance */
+	   FILE *stream);		/* output stream */
+
+/* register bus stats, the bus utilization is its busy cycles over
+   CYCLES_STAT, the name of the stat counting elapsed cycles */
+void
+bus_reg_stats(struct bus_t *bus,	/* bus instance */
+	      struct stat_sdb_t *sdb,	/* stats database */
+	      char *cycles_stat);	/* name of stat of elapsed cycles */
+
+#endif /* BUS_H */
@@ -52,17 +52,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "host.h"
 #include "misc.h"
 #include "machine.h"
+#include "options.h"
 #include "cache.h"
+#include "prefetch.h"
 #include "mshr.h"
+#include "bus.h"
 
 struct miss_queue_heap *miss_queue = NULL;
 
-#define parent(i) ((i - 1) / 2)
+/* use the structure-of-arrays tag store for new caches, if possible */
+int cache_soa = TRUE;
 
+/* the miss queue is a MISS_QUEUE_ARITY-ary min-heap on fill time, wider
+   than binary so it is shallower and sifts touch fewer entries */
+#define MISS_QUEUE_ARITY	4
+#define MISS_QUEUE_INIT_SIZE	64
+#define MQ_PARENT(I)		(((I) - 1) / MISS_QUEUE_ARITY)
+#define MQ_CHILD(I)		((I) * MISS_QUEUE_ARITY + 1)
 
 /* cache access macros */
 #define CACHE_TAG(cp, addr)	((addr) >> (cp)->tag_shift)
@@ -145,8 +160,6 @@ struct miss_queue_heap *miss_queue = NULL;
 /* bound sqword_t/dfloat_t to positive int */
 #define BOUND_POS(N)		((int)(MIN(MAX(0, (N)), 2147483647)))
 
-extern struct mshr_t *mshr;
-
 /* unlink BLK from the hash table bucket chain in SET */
 static void
 unlink_htab_ent(struct cache_t *cp,		/* cache to update */
@@ -264,6 +277,623 @@ update_way_list(struct cache_set_t *set,	/* set contained way chain */
     panic("bogus WHERE designator");
 }
 
+/* return the way in SET whose tag is TAG, or -1 if none, the ASSOC tags of
+   a set are contiguous, so several are compared at once if the host has
+   SIMD compares (SSE2, or AVX2 if compiled with -mavx2) */
+static inline int
+soa_tag_match(md_addr_t *tags,		/* tags of the set */
+	      int assoc,		/* number of tags */
+	      md_addr_t tag)		/* tag to find */
+{
+  int way = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+  unsigned int mask;
+#endif
+
+#if defined(__AVX2__)
+  if (sizeof(md_addr_t) == 8)
+    {
+      __m256i key = _mm256_set1_epi64x(tag);
+
+      for (; way + 4 <= assoc; way += 4)
+	{
+	  __m256i t = _mm256_loadu_si256((__m256i *)&tags[way]);
+
+	  mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+				      _mm256_cmpeq_epi64(t, key)));
+	  if (mask)
+	    return way + __builtin_ctz(mask);
+	}
+    }
+  else
+    {
+      __m256i key = _mm256_set1_epi32(tag);
+
+      for (; way + 8 <= assoc; way += 8)
+	{
+	  __m256i t = _mm256_loadu_si256((__m256i *)&tags[way]);
+
+	  mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+				      _mm256_cmpeq_epi32(t, key)));
+	  if (mask)
+	    return way + __builtin_ctz(mask);
+	}
+    }
+#elif defined(__SSE2__)
+  if (sizeof(md_addr_t) == 8)
+    {
+      __m128i key = _mm_set1_epi64x(tag);
+
+      for (; way + 2 <= assoc; way += 2)
+	{
+	  __m128i t = _mm_loadu_si128((__m128i *)&tags[way]);
+	  __m128i eq = _mm_cmpeq_epi32(t, key);
+
+	  /* both 32-bit halves of a 64-bit tag must match */
+	  eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2,3,0,1)));
+	  mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+	  if (mask)
+	    return way + __builtin_ctz(mask);
+	}
+    }
+  else
+    {
+      __m128i key = _mm_set1_epi32(tag);
+
+      for (; way + 4 <= assoc; way += 4)
+	{
+	  __m128i t = _mm_loadu_si128((__m128i *)&tags[way]);
+
+	  mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, key)));
+	  if (mask)
+	    return way + __builtin_ctz(mask);
+	}
+    }
+#endif
+
+  /* remaining tags, or all of them without SIMD support */
+  for (; way < assoc; way++)
+    {
+      if (tags[way] == tag)
+	return way;
+    }
+  return -1;
+}
+
+/* way at replacement order position POS (0 is MRU) of order word ORDER */
+#define SOA_ORDER_WAY(ORDER, POS)	((int)(((ORDER) >> ((POS) << 2)) & 0xf))
+
+/* mask of the low N nibbles of an order word */
+#define SOA_ORDER_MASK(N)						\
+  ((N) >= 16 ? ~ULL(0) : ((ULL(1) << ((N) << 2)) - 1))
+
+/* return the replacement order position of WAY in order word ORDER */
+static inline int
+soa_order_pos(qword_t order,		/* order word */
+	      int way)			/* way to locate */
+{
+#ifdef __GNUC__
+  /* find the lowest zero nibble of ORDER ^ WAY without a loop, a borrow
+     can only mark nibbles above the lowest zero nibble, unused nibbles are
+     zero and lie above the position of any way, including way 0 */
+  qword_t x = order ^ ((qword_t)way * ULL(0x1111111111111111));
+
+  x = (x - ULL(0x1111111111111111)) & ~x & ULL(0x8888888888888888);
+  return __builtin_ctzll(x) >> 2;
+#else /* !__GNUC__ */
+  int pos;
+
+  for (pos=0; SOA_ORDER_WAY(order, pos) != way; pos++)
+    /* nada */;
+  return pos;
+#endif /* __GNUC__ */
+}
+
+/* move WAY to the MRU position of the order word of SET */
+static inline void
+soa_order_mru(struct cache_set_t *set,	/* set to update */
+	      int way)			/* way to move */
+{
+  int pos = soa_order_pos(set->order, way);
+
+  set->order = (set->order & ~SOA_ORDER_MASK(pos+1))
+    | ((set->order & SOA_ORDER_MASK(pos)) << 4) | way;
+}
+
+/* move WAY to the LRU position of the order word of SET, which has ASSOC
+   ways */
+static inline void
+soa_order_lru(struct cache_set_t *set,	/* set to update */
+	      int way,			/* way to move */
+	      int assoc)		/* set associativity */
+{
+  int pos = soa_order_pos(set->order, way);
+
+  set->order = (set->order & SOA_ORDER_MASK(pos))
+    | ((set->order >> 4) & SOA_ORDER_MASK(assoc-1) & ~SOA_ORDER_MASK(pos))
+    | ((qword_t)way << ((assoc-1) << 2));
+}
+
+/* way of block BLK in set SP of cache CP */
+#define CACHE_BWAY(CP, SP, BLK)						\
+  ((int)(((byte_t *)(BLK) - (byte_t *)(SP)->blks)			\
+	 / (sizeof(struct cache_blk_t)					\
+	    + ((CP)->balloc ? (CP)->bsize*sizeof(byte_t) : 0))))
+
+/* tree-PLRU: bit I of the order word is internal node I of a binary tree
+   over the ways (node 1 is the root, the children of node I are 2I and
+   2I+1, the leaves ASSOC..2*ASSOC-1 are the ways), a clear bit points to
+   the left subtree as the pseudo-LRU side, a set bit to the right one */
+static inline int
+plru_victim(qword_t order,		/* tree bits */
+	    int assoc)			/* set associativity */
+{
+  int node = 1;
+
+  while (node < assoc)
+    node = (node << 1) | (int)((order >> node) & 1);
+  return node - assoc;
+}
+
+/* point the tree nodes above WAY away from it (TOUCH), or toward it */
+static inline void
+plru_update(qword_t *order,		/* tree bits */
+	    int way,			/* way accessed */
+	    int assoc,			/* set associativity */
+	    int touch)			/* make WAY MRU? else make it LRU */
+{
+  int node;
+
+  for (node = way + assoc; node > 1; node >>= 1)
+    {
+      /* a right child is made MRU by pointing its parent to the left */
+      if (!(node & 1) == !touch)
+	*order &= ~((qword_t)1 << (node >> 1));
+      else
+	*order |= (qword_t)1 << (node >> 1);
+    }
+}
+
+/* RRIP: 2-bit re-reference prediction value (RRPV) of each way, 0 predicts
+   a near-immediate re-reference, RRIP_DISTANT a distant one */
+#define RRIP_DISTANT		3
+#define RRIP_LONG		2
+#define RRIP_SHIFT(WAY)		((WAY) << 1)
+#define RRIP_SET(ORDER, WAY, V)						\
+  ((ORDER) = ((ORDER) & ~((qword_t)RRIP_DISTANT << RRIP_SHIFT(WAY)))	\
+   | ((qword_t)(V) << RRIP_SHIFT(WAY)))
+
+/* low bit of the RRPV of each of the first N ways */
+#define RRIP_LOW_BITS(N)						\
+  ((N) >= 32 ? ULL(0x5555555555555555)					\
+   : ULL(0x5555555555555555) & ((ULL(1) << ((N) << 1)) - 1))
+
+/* return the first way predicted for a distant re-reference, ageing all
+   ways of the set until one is */
+static inline int
+rrip_victim(qword_t *order,		/* RRPVs of the set */
+	    int assoc)			/* set associativity */
+{
+  qword_t low = RRIP_LOW_BITS(assoc), distant;
+
+  while (!(distant = *order & (*order >> 1) & low))
+    {
+      /* no RRPV is saturated, so no increment carries into the next way */
+      *order += low;
+    }
+#ifdef __GNUC__
+  return __builtin_ctzll(distant) >> 1;
+#else /* !__GNUC__ */
+  {
+    int way;
+
+    for (way=0; !((distant >> RRIP_SHIFT(way)) & 1); way++)
+      /* nada */;
+    return way;
+  }
+#endif /* __GNUC__ */
+}
+
+/* SHiP signature of an access to ADDR, the 16KB memory region it falls in
+   (cache accesses carry no PC, so this is the SHiP-Mem signature) */
+#define SHIP_SIG(ADDR)							\
+  ((unsigned int)(((ADDR) >> 14) ^ ((ADDR) >> (14 + CACHE_SHCT_BITS)))	\
+   & ((1 << CACHE_SHCT_BITS) - 1))
+
+/* DRRIP set dueling: 0 if SET leads SRRIP, 1 if it leads BRRIP, else -1 */
+#define SDM_LEADER(CP, SET)						\
+  ((SET) % (CP)->sdm_period <= 1 ? (int)((SET) % (CP)->sdm_period) : -1)
+
+/* update the replacement state of set SP of cache CP for a fill of WAY at
+   ADDR, replacing block BLK */
+static void
+repl_fill(struct cache_t *cp,		/* cache instance */
+	  struct cache_set_t *sp,	/* set filled */
+	  md_addr_t set,		/* set index */
+	  int way,			/* way filled */
+	  struct cache_blk_t *blk,	/* block filled */
+	  md_addr_t addr)		/* address of the fill */
+{
+  enum cache_policy policy = cp->policy;
+  int leader, rrpv;
+
+  if (policy == PLRU)
+    {
+      plru_update(&sp->order, way, cp->assoc, /* touch */TRUE);
+      return;
+    }
+
+  if (policy == DRRIP)
+    {
+      /* a miss in a leader set votes against its policy */
+      leader = SDM_LEADER(cp, set);
+      if (leader == 0)
+	{
+	  cp->sdm_misses[0]++;
+	  if (cp->psel < CACHE_PSEL_MAX)
+	    cp->psel++;
+	}
+      else if (leader == 1)
+	{
+	  cp->sdm_misses[1]++;
+	  if (cp->psel > 0)
+	    cp->psel--;
+	}
+      else
+	leader = (cp->psel >= (CACHE_PSEL_MAX+1)/2);
+      policy = leader ? BRRIP : SRRIP;
+    }
+
+  switch (policy)
+    {
+    case SRRIP:
+      rrpv = RRIP_LONG;
+      break;
+    case BRRIP:
+      rrpv = (++cp->bip_fills & 31) ? RRIP_DISTANT : RRIP_LONG;
+      break;
+    case SHiP:
+      blk->sig = SHIP_SIG(addr);
+      rrpv = cp->shct[blk->sig] ? RRIP_LONG : RRIP_DISTANT;
+      break;
+    default:
+      panic("bogus replacement policy");
+    }
+  if (rrpv == RRIP_DISTANT)
+    cp->distant_fills++;
+  RRIP_SET(sp->order, way, rrpv);
+}
+
+/* update the replacement state of set SP of cache CP for a hit to block
+   BLK in WAY */
+static inline void
+repl_hit(struct cache_t *cp,		/* cache instance */
+	 struct cache_set_t *sp,	/* set hit */
+	 int way,			/* way hit */
+	 struct cache_blk_t *blk)	/* block hit */
+{
+  if (cp->policy == PLRU)
+    plru_update(&sp->order, way, cp->assoc, /* touch */TRUE);
+  else
+    {
+      /* hit priority: predict a near-immediate re-reference */
+      RRIP_SET(sp->order, way, 0);
+
+      /* train SHiP on the first hit of the block since its fill */
+      if (cp->policy == SHiP && !(blk->status & CACHE_BLK_REUSED))
+	{
+	  blk->status |= CACHE_BLK_REUSED;
+	  if (cp->shct[blk->sig] < CACHE_SHCT_MAX)
+	    cp->shct[blk->sig]++;
+	}
+    }
+}
+
+/* select the block of set SP of cache CP to replace, and re-link it to the
+   appropriate place in the way list, returns the block and, unless the way
+   list is used, its way in *WAYP */
+static struct cache_blk_t *		/* block to replace */
+repl_victim(struct cache_t *cp,		/* cache instance */
+	    struct cache_set_t *sp,	/* set to replace a block of */
+	    int *wayp)			/* for return of the way replaced */
+{
+  struct cache_blk_t *repl;
+  int way = -1;
+
+  if (CACHE_PACKED_POLICY(cp->policy))
+    {
+      /* replacement state is in the order word, in either layout */
+      if (cp->policy == PLRU)
+	way = plru_victim(sp->order, cp->assoc);
+      else
+	way = rrip_victim(&sp->order, cp->assoc);
+      repl = CACHE_BINDEX(cp, sp->blks, way);
+    }
+  else if (sp->tags)
+    {
+      /* same choices, from the packed replacement order */
+      switch (cp->policy) {
+      case LRU:
+      case FIFO:
+	way = SOA_ORDER_WAY(sp->order, cp->assoc - 1);
+	soa_order_mru(sp, way);
+	break;
+      case Random:
+	way = myrand() & (cp->assoc - 1);
+	break;
+      default:
+	panic("bogus replacement policy");
+      }
+      repl = CACHE_BINDEX(cp, sp->blks, way);
+    }
+  else
+    {
+      switch (cp->policy) {
+      case LRU:
+      case FIFO:
+	repl = sp->way_tail;
+	update_way_list(sp, repl, Head);
+	break;
+      case Random:
+	way = myrand() & (cp->assoc - 1);
+	repl = CACHE_BINDEX(cp, sp->blks, way);
+	break;
+      default:
+	panic("bogus replacement policy");
+      }
+    }
+
+  *wayp = way;
+  return repl;
+}
+
+/* account for the eviction of valid block REPL from cache CP */
+static inline void
+repl_evict(struct cache_t *cp,		/* cache instance */
+	   struct cache_blk_t *repl)	/* block evicted */
+{
+  /* a SHiP block evicted without reuse trains its signature down */
+  if (cp->policy == SHiP && !(repl->status & CACHE_BLK_REUSED)
+      && cp->shct[repl->sig] > 0)
+    cp->shct[repl->sig]--;
+
+  if (repl->status & CACHE_BLK_PREFETCH)
+    cp->pf_unused++;
+}
+
+/* pollution filter index of block address BADDR */
+#define PF_FILTER_INDEX(CP, BADDR)					\
+  ((unsigned int)((BADDR) >> (CP)->set_shift)				\
+   & ((1 << CACHE_PF_FILTER_BITS) - 1))
+
+/* record a miss at NOW to ADDR in the MSHRs of cache CP, filled at READY,
+   which is a prefetch if PREFETCH */
+static void
+mshr_miss(struct cache_t *cp,		/* cache instance */
+	  md_addr_t addr,		/* address of miss */
+	  tick_t now,			/* time of miss */
+	  tick_t ready,			/* time the block is filled */
+	  int prefetch)			/* prefetch fill? */
+{
+  struct mshr_t *mshr = cp->mshr;
+  struct mshr_entry_t *entry;
+
+  mshr->accesses++;
+  entry = mshr_insert(mshr, addr, now);
+  if (!entry)
+    {
+      /* untracked, the simulator did not wait for a free entry */
+      mshr->full++;
+      return;
+    }
+  mshr->misses++;
+  entry->completed_time = ready;
+  if (prefetch)
+    entry->status |= MSHR_ENTRY_PREFETCH;
+}
+
+/* merge an access at NOW to ADDR into ENTRY, the outstanding miss to its
+   block in the MSHRs of cache CP, returns the latency of the access */
+static unsigned int			/* latency of access in cycles */
+mshr_merge(struct cache_t *cp,		/* cache instance */
+	   struct mshr_entry_t *entry,	/* outstanding miss */
+	   md_addr_t addr,		/* address of access */
+	   tick_t now)			/* time of access */
+{
+  struct mshr_t *mshr = cp->mshr;
+
+  mshr->accesses++;
+  mshr->hits++;
+  if (mshr_insert(mshr, addr, now))
+    mshr->merges++;
+  else
+    mshr->full++;
+
+  /* a demand access to a prefetch in flight makes it a demand miss */
+  entry->status &= ~MSHR_ENTRY_PREFETCH;
+
+  return (unsigned int)MAX(cp->hit_latency, entry->completed_time - now);
+}
+
+/* write back block BLK of cache CP, at block address BADDR, at NOW,
+   returns the cycles the cache stalls */
+static unsigned int			/* latency of write-back */
+blk_writeback(struct cache_t *cp,	/* cache instance */
+	      md_addr_t baddr,		/* block address written back */
+	      struct cache_blk_t *blk,	/* block written back */
+	      tick_t now)		/* time of write-back */
+{
+  tick_t start;
+  unsigned int lat;
+
+  if (!cp->bus)
+    return cp->blk_access_fn(Write, baddr, cp->bsize, blk, now);
+
+  /* the next level is written when the block crosses the bus, the cache
+     only waits for a write-back buffer */
+  lat = bus_writeback(cp->bus, cp->bsize, now, &start);
+  cp->blk_access_fn(Write, baddr, cp->bsize, blk, start);
+  return lat;
+}
+
+/* read the block at block address BADDR into block BLK of cache CP at
+   NOW, returns the latency of the read */
+static unsigned int			/* latency of read */
+blk_read(struct cache_t *cp,		/* cache instance */
+	 md_addr_t baddr,		/* block address read */
+	 struct cache_blk_t *blk,	/* block filled */
+	 tick_t now)			/* time of read */
+{
+  tick_t req, ready;
+
+  if (!cp->bus)
+    return cp->blk_access_fn(Read, baddr, cp->bsize, blk, now);
+
+  /* request the block over the bus, the next level returns it over it */
+  req = bus_request(cp->bus, now);
+  ready = req + cp->blk_access_fn(Read, baddr, cp->bsize, blk, req);
+  return (unsigned int)(bus_response(cp->bus, cp->bsize, req, ready) - now);
+}
+
+/* copy the contents of block SRC of cache CP into block DST */
+static void
+blk_copy(struct cache_t *cp,		/* cache instance */
+	 struct cache_blk_t *dst,	/* block copied to */
+	 struct cache_blk_t *src)	/* block copied from */
+{
+  dst->tag = src->tag;
+  dst->status = src->status;
+  dst->ready = src->ready;
+  dst->sig = src->sig;
+  if (cp->balloc)
+    memcpy(dst->data, src->data, cp->bsize);
+  if (cp->usize)
+    memcpy(dst->user_data, src->user_data, cp->usize);
+}
+
+/* return the block of victim cache VC holding block address BADDR, NULL
+   if none does */
+static struct cache_blk_t *		/* victim block, or NULL */
+victim_lookup(struct cache_victim_t *vc,/* victim cache */
+	      md_addr_t baddr)		/* block address */
+{
+  int i;
+
+  for (i=0; i<vc->nblks; i++)
+    {
+      if ((vc->blks[i]->status & CACHE_BLK_VALID)
+	  && vc->blks[i]->tag == baddr)
+	return vc->blks[i];
+    }
+  return NULL;
+}
+
+/* retire block BLK at block address BADDR, leaving cache CP at NOW: it
+   spills into the exclusive cache below, if there is one, otherwise a
+   dirty block is written back, returns the cycles the cache stalls */
+static unsigned int			/* latency of write-back */
+blk_retire(struct cache_t *cp,		/* cache instance */
+	   md_addr_t baddr,		/* block address retired */
+	   struct cache_blk_t *blk,	/* block retired */
+	   tick_t now)			/* time of retirement */
+{
+  tick_t start = now;
+  unsigned int lat = 0;
+
+  if (blk->status & CACHE_BLK_DIRTY)
+    cp->writebacks++;
+
+  if (!cp->outer || cp->outer->hier != Exclusive)
+    {
+      /* write back the cache block */
+      if (blk->status & CACHE_BLK_DIRTY)
+	lat = blk_writeback(cp, baddr, blk, now);
+      return lat;
+    }
+
+  /* the block crosses to the cache below like a write-back, keeping its
+     dirty status, outside of the block access function, which need not
+     support writes (e.g., for instruction caches) */
+  if (cp->bus)
+    lat = bus_writeback(cp->bus, cp->bsize, now, &start);
+  cp->outer->spill = CACHE_BLK_VALID | (blk->status & CACHE_BLK_DIRTY);
+  cache_access(cp->outer, Write, baddr, NULL, cp->bsize, start, NULL, NULL);
+  cp->outer->spill = 0;
+  return lat;
+}
+
+/* evict valid block BLK at block address BADDR from cache CP at NOW, into
+   the victim cache if there is one, which retires its LRU block instead,
+   returns the cycles the cache stalls */
+static unsigned int			/* latency of eviction */
+blk_evict(struct cache_t *cp,		/* cache instance */
+	  md_addr_t baddr,		/* block address evicted */
+	  struct cache_blk_t *blk,	/* block evicted */
+	  tick_t now)			/* time of eviction */
+{
+  struct cache_victim_t *vc = cp->victim;
+  struct cache_blk_t *vblk;
+  unsigned int lat = 0;
+  int i;
+
+  if (!vc)
+    return blk_retire(cp, baddr, blk, now);
+
+  /* take the first free block, or the LRU block, and make it MRU */
+  for (i=0; i<vc->nblks-1 && (vc->blks[i]->status & CACHE_BLK_VALID); i++)
+    /* nada */;
+  vblk = vc->blks[i];
+  if (vblk->status & CACHE_BLK_VALID)
+    lat = blk_retire(cp, vblk->tag, vblk, now);
+  memmove(&vc->blks[1], &vc->blks[0], i * sizeof(struct cache_blk_t *));
+  vc->blks[0] = vblk;
+
+  blk_copy(cp, vblk, blk);
+  vblk->tag = baddr;
+  return lat;
+}
+
+/* invalidate the copies of block address BADDR in the caches above the
+   inclusive cache CP at NOW, returns the latency of the invalidations */
+static unsigned int			/* latency of invalidations */
+back_invalidate(struct cache_t *cp,	/* inclusive cache instance */
+		md_addr_t baddr,	/* block address invalidated */
+		tick_t now)		/* time of invalidation */
+{
+  int i, k, nsub;
+  md_addr_t addr;
+  struct cache_t *inner;
+  unsigned int lat = 0;
+
+  /* dirty copies above are written back into CP, which must still hold
+     the block, every smaller block above that lies within it is flushed */
+  for (i=0; i<cp->ninner; i++)
+    {
+      inner = cp->inner[i];
+      nsub = MAX(cp->bsize / inner->bsize, 1);
+      for (k=0; k<nsub; k++)
+	{
+	  addr = baddr + k * inner->bsize;
+	  if (cache_probe(inner, addr))
+	    {
+	      cp->back_invalidations++;
+	      lat = MAX(lat, cache_flush_addr(inner, addr, now));
+	    }
+	}
+    }
+  return lat;
+}
+
+/* register cache module options */
+void
+cache_reg_options(struct opt_odb_t *odb)/* options database */
+{
+  opt_reg_flag(odb, "-cache:soa",
+	       "use contiguous per-set tag arrays (2- to 16-way caches)",
+	       &cache_soa, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+}
+
 /* create and initialize a general cache structure */
 struct cache_t *			/* pointer to cache created */
 cache_create(char *name,		/* name of the cache */
@@ -282,7 +912,8 @@ cache_create(char *name,		/* name of the cache */
 {
   struct cache_t *cp;
   struct cache_blk_t *blk;
-  int i, j, bindex;
+  md_addr_t *tags = NULL;
+  int i, j, bindex, soa;
 
   /* check all cache parameters */
   if (nsets <= 0)
@@ -302,6 +933,12 @@ cache_create(char *name,		/* name of the cache */
     fatal("cache associativity `%d' must be a power of two", assoc);
   if (!blk_access_fn)
     fatal("must specify miss/replacement functions");
+  if (policy == PLRU && assoc > CACHE_PLRU_MAX_ASSOC)
+    fatal("tree-PLRU replacement supports at most %d ways",
+	  CACHE_PLRU_MAX_ASSOC);
+  if (CACHE_RRIP_POLICY(policy) && assoc > CACHE_RRIP_MAX_ASSOC)
+    fatal("RRIP replacement policies support at most %d ways",
+	  CACHE_RRIP_MAX_ASSOC);
 
   /* allocate the cache structure */
   cp = (struct cache_t *)
@@ -322,8 +959,12 @@ cache_create(char *name,		/* name of the cache */
   /* miss/replacement functions */
   cp->blk_access_fn = blk_access_fn;
 
+  /* the structure-of-arrays tag store replaces the way list and the hash
+     tables, direct-mapped caches have nothing to search */
+  soa = cache_soa && assoc > 1 && assoc <= CACHE_SOA_MAX_ASSOC;
+
   /* compute derived parameters */
-  cp->hsize = CACHE_HIGHLY_ASSOC(cp) ? (assoc >> 2) : 0;
+  cp->hsize = (!soa && CACHE_HIGHLY_ASSOC(cp)) ? (assoc >> 2) : 0;
   cp->blk_mask = bsize-1;
   cp->set_shift = log_base2(bsize);
   cp->set_mask = nsets-1;
@@ -332,6 +973,20 @@ cache_create(char *name,		/* name of the cache */
   cp->tagset_mask = ~cp->blk_mask;
   cp->bus_free = 0;
 
+  /* initialize replacement policy state */
+  cp->psel = (CACHE_PSEL_MAX+1)/2;
+  cp->sdm_period = MAX(nsets / CACHE_SDM_LEADERS, CACHE_SDM_MIN_PERIOD);
+  cp->bip_fills = 0;
+  cp->shct = NULL;
+  if (policy == SHiP)
+    {
+      /* start out predicting reuse for every signature */
+      cp->shct = (unsigned char *)malloc(1 << CACHE_SHCT_BITS);
+      if (!cp->shct)
+	fatal("out of virtual memory");
+      memset(cp->shct, 1, 1 << CACHE_SHCT_BITS);
+    }
+
   /* print derived parameters during debug */
   debug("%s: cp->hsize     = %d", cp->name, cp->hsize);
   debug("%s: cp->blk_mask  = 0x%08x", cp->name, cp->blk_mask);
@@ -346,6 +1001,32 @@ cache_create(char *name,		/* name of the cache */
   cp->replacements = 0;
   cp->writebacks = 0;
   cp->invalidations = 0;
+  cp->sdm_misses[0] = cp->sdm_misses[1] = 0;
+  cp->distant_fills = 0;
+  cp->pf_issued = 0;
+  cp->pf_useful = 0;
+  cp->pf_late = 0;
+  cp->pf_unused = 0;
+  cp->pf_polluting = 0;
+  cp->victim_hits = 0;
+  cp->back_invalidations = 0;
+  cp->swaps = 0;
+
+  /* no prefetcher or MSHRs, the simulator attaches them after creating
+     the cache */
+  cp->pf = NULL;
+  cp->access_pc = 0;
+  cp->pf_filter = NULL;
+  cp->mshr = NULL;
+  cp->bus = NULL;
+
+  /* no victim cache, the simulator links the hierarchy and sets its
+     policy */
+  cp->victim = NULL;
+  cp->hier = NINE;
+  cp->ninner = 0;
+  cp->outer = NULL;
+  cp->spill = 0;
 
   /* blow away the last block accessed */
   cp->last_tagset = 0;
@@ -358,6 +1039,14 @@ cache_create(char *name,		/* name of the cache */
   if (!cp->data)
     fatal("out of virtual memory");
 
+  /* allocate the tag store */
+  if (soa)
+    {
+      tags = (md_addr_t *)calloc(nsets * assoc, sizeof(md_addr_t));
+      if (!tags)
+	fatal("out of virtual memory");
+    }
+
   /* slice up the data blocks */
   for (bindex=0,i=0; i<nsets; i++)
     {
@@ -376,7 +1065,22 @@ cache_create(char *name,		/* name of the cache */
 	 otherwise, block accesses through SET->BLKS will fail (used
 	 during random replacement selection) */
       cp->sets[i].blks = CACHE_BINDEX(cp, cp->data, bindex);
-      
+
+      /* invalidate the tag store, in the same replacement order as the way
+	 list below (the last block is MRU) */
+      cp->sets[i].tags = soa ? tags + i*assoc : NULL;
+      cp->sets[i].order = 0;
+      for (j=0; soa && j<assoc; j++)
+	{
+	  cp->sets[i].tags[j] = CACHE_TAG_INVALID;
+	  if (!CACHE_PACKED_POLICY(policy))
+	    cp->sets[i].order |= (qword_t)(assoc-1-j) << (j << 2);
+	}
+
+      /* RRIP policies start with every way predicted distant */
+      if (CACHE_RRIP_POLICY(policy))
+	cp->sets[i].order = RRIP_LOW_BITS(assoc) * RRIP_DISTANT;
+
       /* link the data blocks into ordered way chain and hash table bucket
          chains, if hash table exists */
       for (j=0; j<assoc; j++)
@@ -417,10 +1121,84 @@ cache_char2policy(char c)		/* replacement policy as a char */
   case 'l': return LRU;
   case 'r': return Random;
   case 'f': return FIFO;
+  case 'p': return PLRU;
+  case 's': return SRRIP;
+  case 'b': return BRRIP;
+  case 'd': return DRRIP;
+  case 'h': return SHiP;
   default: fatal("bogus replacement policy, `%c'", c);
   }
 }
 
+/* parse hierarchy policy */
+enum cache_hier				/* hierarchy policy enum */
+cache_str2hier(char *s)			/* {nine|incl|excl} */
+{
+  if (!mystricmp(s, "nine"))
+    return NINE;
+  else if (!mystricmp(s, "incl"))
+    return Inclusive;
+  else if (!mystricmp(s, "excl"))
+    return Exclusive;
+  else
+    fatal("bogus cache hierarchy policy, `%s'", s);
+}
+
+/* attach a fully associative victim cache of NBLKS blocks to cache CP, a
+   block found in it is swapped in after LATENCY extra cycles */
+void
+cache_victim(struct cache_t *cp,	/* cache instance */
+	     int nblks,			/* victim cache size, in blocks */
+	     unsigned int latency)	/* extra cycles to swap a block in */
+{
+  struct cache_victim_t *vc;
+  struct cache_blk_t *blk;
+  int i;
+
+  if (nblks <= 0)
+    fatal("victim cache size (in blocks) `%d' must be positive", nblks);
+
+  vc = (struct cache_victim_t *)calloc(1, sizeof(struct cache_victim_t));
+  if (!vc)
+    fatal("out of virtual memory");
+  vc->nblks = nblks;
+  vc->latency = latency;
+  vc->blks = (struct cache_blk_t **)
+    calloc(nblks, sizeof(struct cache_blk_t *));
+  if (!vc->blks)
+    fatal("out of virtual memory");
+
+  /* the blocks are laid out as in the cache, plus one for swaps */
+  for (i=0; i<=nblks; i++)
+    {
+      blk = (struct cache_blk_t *)
+	calloc(1, sizeof(struct cache_blk_t)
+	       + (cp->balloc ? (cp->bsize*sizeof(byte_t)) : 0));
+      if (!blk)
+	fatal("out of virtual memory");
+      blk->user_data = (cp->usize != 0
+			? (byte_t *)calloc(cp->usize, sizeof(byte_t)) : NULL);
+      if (i < nblks)
+	vc->blks[i] = blk;
+      else
+	vc->tmp = blk;
+    }
+  cp->victim = vc;
+}
+
+/* record that cache INNER misses to cache OUTER, the hierarchy policy of
+   OUTER (i.e., OUTER->HIER) is enforced on INNER */
+void
+cache_link(struct cache_t *inner,	/* cache above */
+	   struct cache_t *outer)	/* cache below */
+{
+  if (outer->ninner == CACHE_MAX_INNER)
+    fatal("cache `%s' has more than %d caches above it",
+	  outer->name, CACHE_MAX_INNER);
+  outer->inner[outer->ninner++] = inner;
+  inner->outer = outer;
+}
+
 /* print cache configuration */
 void
 cache_config(struct cache_t *cp,	/* cache instance */
@@ -435,7 +1213,19 @@ cache_config(struct cache_t *cp,	/* cache instance */
 	  cp->policy == LRU ? "LRU"
 	  : cp->policy == Random ? "Random"
 	  : cp->policy == FIFO ? "FIFO"
+	  : cp->policy == PLRU ? "tree-PLRU"
+	  : cp->policy == SRRIP ? "SRRIP"
+	  : cp->policy == BRRIP ? "BRRIP"
+	  : cp->policy == DRRIP ? "DRRIP"
+	  : cp->policy == SHiP ? "SHiP"
 	  : (abort(), ""));
+  if (cp->victim)
+    fprintf(stream,
+	    "cache: %s: %d block victim cache, %d cycle(s) to swap\n",
+	    cp->name, cp->victim->nblks, cp->victim->latency);
+  if (cp->hier != NINE)
+    fprintf(stream, "cache: %s: %s of the caches above\n", cp->name,
+	    cp->hier == Inclusive ? "inclusive" : "exclusive");
 }
 
 /* register cache stats */
@@ -479,6 +1269,76 @@ cache_reg_stats(struct cache_t *cp,	/* cache instance */
   sprintf(buf, "%s.inv_rate", name);
   sprintf(buf1, "%s.invalidations / %s.accesses", name, name);
   stat_reg_formula(sdb, buf, "invalidation rate (i.e., invs/ref)", buf1, NULL);
+
+  if (cp->policy == DRRIP)
+    {
+      /* set dueling between SRRIP and BRRIP */
+      sprintf(buf, "%s.psel", name);
+      stat_reg_int(sdb, buf, "DRRIP policy selector (BRRIP if >= 512)",
+		   &cp->psel, cp->psel, NULL);
+      sprintf(buf, "%s.sdm_srrip_misses", name);
+      stat_reg_counter(sdb, buf, "misses in SRRIP leader sets",
+		       &cp->sdm_misses[0], 0, NULL);
+      sprintf(buf, "%s.sdm_brrip_misses", name);
+      stat_reg_counter(sdb, buf, "misses in BRRIP leader sets",
+		       &cp->sdm_misses[1], 0, NULL);
+    }
+  if (CACHE_RRIP_POLICY(cp->policy))
+    {
+      sprintf(buf, "%s.distant_fills", name);
+      stat_reg_counter(sdb, buf, "fills predicted for a distant re-reference",
+		       &cp->distant_fills, 0, NULL);
+      sprintf(buf, "%s.distant_fill_rate", name);
+      sprintf(buf1, "%s.distant_fills / %s.misses", name, name);
+      stat_reg_formula(sdb, buf, "fraction of fills predicted distant",
+		       buf1, NULL);
+    }
+  if (cp->pf)
+    {
+      sprintf(buf, "%s.pf_issued", name);
+      stat_reg_counter(sdb, buf, "total number of prefetch fills issued",
+		       &cp->pf_issued, 0, NULL);
+      sprintf(buf, "%s.pf_useful", name);
+      stat_reg_counter(sdb, buf, "prefetched blocks hit before eviction",
+		       &cp->pf_useful, 0, NULL);
+      sprintf(buf, "%s.pf_late", name);
+      stat_reg_counter(sdb, buf, "useful prefetches still filling at first hit",
+		       &cp->pf_late, 0, NULL);
+      sprintf(buf, "%s.pf_unused", name);
+      stat_reg_counter(sdb, buf, "prefetched blocks evicted before any hit",
+		       &cp->pf_unused, 0, NULL);
+      sprintf(buf, "%s.pf_polluting", name);
+      stat_reg_counter(sdb, buf, "misses to blocks evicted by prefetches",
+		       &cp->pf_polluting, 0, NULL);
+      sprintf(buf, "%s.pf_accuracy", name);
+      sprintf(buf1, "%s.pf_useful / %s.pf_issued", name, name);
+      stat_reg_formula(sdb, buf, "prefetch accuracy (i.e., useful/issued)",
+		       buf1, NULL);
+      sprintf(buf, "%s.pf_coverage", name);
+      sprintf(buf1, "%s.pf_useful / (%s.pf_useful + %s.misses)",
+	      name, name, name);
+      stat_reg_formula(sdb, buf, "prefetch coverage (i.e., misses removed)",
+		       buf1, NULL);
+    }
+  if (cp->victim)
+    {
+      sprintf(buf, "%s.victim_hits", name);
+      stat_reg_counter(sdb, buf,
+		       "misses found in the victim cache (counted as hits)",
+		       &cp->victim_hits, 0, NULL);
+    }
+  if (cp->hier == Inclusive)
+    {
+      sprintf(buf, "%s.back_invalidations", name);
+      stat_reg_counter(sdb, buf, "blocks invalidated above to keep inclusion",
+		       &cp->back_invalidations, 0, NULL);
+    }
+  if (cp->hier == Exclusive)
+    {
+      sprintf(buf, "%s.swaps", name);
+      stat_reg_counter(sdb, buf, "blocks handed up to the caches above",
+		       &cp->swaps, 0, NULL);
+    }
 }
 
 /* print cache stats */
@@ -518,8 +1378,10 @@ cache_access(struct cache_t *cp,	/* cache to access */
   md_addr_t tag = CACHE_TAG(cp, addr);
   md_addr_t set = CACHE_SET(cp, addr);
   md_addr_t bofs = CACHE_BLK(cp, addr);
-  struct cache_blk_t *blk, *repl;
-  int lat = 0;
+  struct cache_set_t *sp = &cp->sets[set];
+  struct cache_blk_t *blk, *repl, *vblk = NULL;
+  struct mshr_entry_t *entry = NULL;
+  int way, pf_hit, lat = 0;
 
   /* default replacement address */
   if (repl_addr)
@@ -537,15 +1399,25 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* permissions are checked on cache misses */
 
-  /* check for a fast hit: access to same block */
-  if (CACHE_TAGSET(cp, addr) == cp->last_tagset)
+  /* check for a fast hit: access to same block, an exclusive cache hands
+     up the blocks read, which takes the slow hit handler */
+  if (CACHE_TAGSET(cp, addr) == cp->last_tagset && cp->hier != Exclusive)
     {
       /* hit in the same block */
       blk = cp->last_blk;
       goto cache_fast_hit;
     }
 
-  if (cp->hsize)
+  if (sp->tags)
+    {
+      /* structure-of-arrays tag store, compare all the tags of the set */
+      if ((way = soa_tag_match(sp->tags, cp->assoc, tag)) >= 0)
+	{
+	  blk = CACHE_BINDEX(cp, sp->blks, way);
+	  goto cache_hit;
+	}
+    }
+  else if (cp->hsize)
     {
       /* higly-associativity cache, access through the per-set hash tables */
       int hindex = CACHE_HASH(cp, tag);
@@ -572,26 +1444,59 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* cache block not found */
 
-  /* **MISS** */
-  cp->misses++;
-
-/* select the appropriate block to replace, and re-link this entry to
-     the appropriate place in the way list */
-  switch (cp->policy) {
-  case LRU:
-  case FIFO:
-    repl = cp->sets[set].way_tail;
-    update_way_list(&cp->sets[set], repl, Head);
-    break;
-  case Random:
-    {
-      int bindex = myrand() & (cp->assoc - 1);
-      repl = CACHE_BINDEX(cp, cp->sets[set].blks, bindex);
-    }
-    break;
-  default:
-    panic("bogus replacement policy");
-  }
+  /* blocks with a queued miss are out of the hash table, a miss to one
+     merges into its outstanding miss */
+  if (cp->mshr && (entry = mshr_lookup(cp->mshr, addr)) != NULL)
+    {
+      cp->hits++;
+      return mshr_merge(cp, entry, addr, now);
+    }
+
+  /* an exclusive cache does not allocate the blocks read from above, read
+     misses pass through to the next level */
+  if (cp->hier == Exclusive && cmd == Read)
+    {
+      cp->misses++;
+      lat = blk_read(cp, CACHE_BADDR(cp, addr), NULL, now);
+      if (cp->mshr)
+	mshr_miss(cp, addr, now, now+lat, /* prefetch */FALSE);
+      if (cp->pf)
+	prefetch_access(cp->pf, cp, cp->access_pc, addr, TRUE, FALSE, now);
+      return lat;
+    }
+
+  /* a block found in the victim cache is swapped with the replaced block,
+     its victim cache block is free for the replaced block */
+  if (cp->victim
+      && (vblk = victim_lookup(cp->victim, CACHE_BADDR(cp, addr))) != NULL)
+    {
+      cp->hits++;
+      cp->victim_hits++;
+      blk_copy(cp, cp->victim->tmp, vblk);
+      vblk->status = 0;
+    }
+  else
+    {
+      /* **MISS**, blocks spilled from above are not accesses */
+      if (!cp->spill)
+	cp->misses++;
+
+      /* a miss to a block evicted by a prefetch is prefetcher pollution */
+      if (cp->pf_filter
+	  && cp->pf_filter[PF_FILTER_INDEX(cp, CACHE_BADDR(cp, addr))])
+	{
+	  cp->pf_polluting++;
+	  cp->pf_filter[PF_FILTER_INDEX(cp, CACHE_BADDR(cp, addr))] = 0;
+	}
+    }
+
+  /* select the appropriate block to replace */
+  repl = repl_victim(cp, sp, &way);
+
+  /* an inclusive cache invalidates the copies above of the block replaced,
+     while it still holds the block to take their write-backs */
+  if (cp->hier == Inclusive && (repl->status & CACHE_BLK_VALID))
+    back_invalidate(cp, CACHE_MK_BADDR(cp, repl->tag, set), now);
 
   /* remove this block from the hash bucket chain, if hash exists */
   if (cp->hsize)
@@ -609,47 +1514,85 @@ cache_access(struct cache_t *cp,	/* cache to access */
       if (repl_addr)
 	*repl_addr = CACHE_MK_BADDR(cp, repl->tag, set);
 
+      repl_evict(cp, repl);
+
       /* don't replace the block until outstanding misses are satisfied */
       lat += BOUND_POS(repl->ready - now);
 
-      /* stall until the bus to next level of memory is available */
-      lat += BOUND_POS(cp->bus_free - (now + lat));
-
-      /* track bus resource usage */
-      cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
-
-      if (repl->status & CACHE_BLK_DIRTY)
+      if (!cp->bus && !vblk)
 	{
-	  /* write back the cache block */
-	  cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, repl->tag, set),
-				   cp->bsize, repl, now+lat);
+	  /* stall until the bus to next level of memory is available */
+	  lat += BOUND_POS(cp->bus_free - (now + lat));
+
+	  /* track bus resource usage */
+	  cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
 	}
+
+      /* move the block to the victim cache, or write it back */
+      lat += blk_evict(cp, CACHE_MK_BADDR(cp, repl->tag, set), repl, now+lat);
     }
 
   /* update block tags */
+  if (vblk)
+    {
+      /* the block swapped in keeps its state */
+      blk_copy(cp, repl, cp->victim->tmp);
+      if (repl->status & CACHE_BLK_PREFETCH)
+	{
+	  repl->status &= ~CACHE_BLK_PREFETCH;
+	  cp->pf_useful++;
+	}
+    }
+  else
+    repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
   repl->tag = tag;
-  repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
+  if (sp->tags)
+    sp->tags[way] = tag;
+  if (CACHE_PACKED_POLICY(cp->policy))
+    repl_fill(cp, sp, set, way, repl, addr);
 
-  /* read data block */
-  lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
-			   repl, now+lat);
+  /* link this entry back into the hash table, a block being filled is
+     found by later accesses, as in caches without a hash table */
+  if (cp->hsize)
+    link_htab_ent(cp, &cp->sets[set], repl);
+
+  if (vblk)
+    {
+      /* the swap follows the probe of the cache */
+      lat += cp->hit_latency + cp->victim->latency;
+      lat = MAX(lat, (int)BOUND_POS(repl->ready - now));
+    }
+  else if (cp->hier != Exclusive)
+    {
+      /* read data block */
+      lat += blk_read(cp, CACHE_BADDR(cp, addr), repl, now+lat);
+
+      /* track the miss until the block is filled */
+      if (cp->mshr)
+	mshr_miss(cp, addr, now, now+lat, /* prefetch */FALSE);
 
 // dltb나 itlb 아니면 여기서 queue에 집어넣어야함
-  if(strcmp(cp->name, "dltb") != 0 && strcmp(cp->name, "itlb") != 0)
-  {
-    miss_queue_insert(miss_queue, cp, addr, cmd, p, nbytes, now+lat, repl, udata, repl_addr, tag, set, bofs);
-    return lat;
-  }
+      if(miss_queue && strcmp(cp->name, "dltb") != 0 && strcmp(cp->name, "itlb") != 0)
+      {
+	miss_queue_insert(miss_queue, cp, addr, cmd, p, nbytes, now+lat, repl, udata, repl_addr, tag, set, bofs);
+	if (cp->pf)
+	  prefetch_access(cp->pf, cp, cp->access_pc, addr, TRUE, FALSE, now);
+	return lat;
+      }
+    }
+  /* else, an exclusive cache is written whole blocks from above, which
+     need not be read */
+
   /* copy data out of cache block */
   if (cp->balloc)
     {
       CACHE_BCOPY(cmd, repl, bofs, p, nbytes);
     }
 
-  /* update dirty status */
-  if (cmd == Write)
+  /* update dirty status, blocks spilled from above keep theirs */
+  if (cp->spill)
+    repl->status |= cp->spill & CACHE_BLK_DIRTY;
+  else if (cmd == Write)
     repl->status |= CACHE_BLK_DIRTY;
 
   /* get user block data, if requested and it exists */
@@ -659,9 +1602,9 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* update block status */
   repl->ready = now+lat;
 
-  /* link this entry back into the hash table */
-  if (cp->hsize)
-    link_htab_ent(cp, &cp->sets[set], repl);
+  /* train the prefetcher with the miss */
+  if (cp->pf)
+    prefetch_access(cp->pf, cp, cp->access_pc, addr, TRUE, FALSE, now);
 
   /* return latency of the operation */
   return lat;
@@ -669,19 +1612,43 @@ cache_access(struct cache_t *cp,	/* cache to access */
  cache_hit: /* slow hit handler */
 
   /* **HIT** */
-  cp->hits++;  
+  if (!cp->spill)
+    cp->hits++;
+
+  /* first demand reference to a prefetched block */
+  pf_hit = (blk->status & CACHE_BLK_PREFETCH) != 0;
+  if (pf_hit)
+    {
+      blk->status &= ~CACHE_BLK_PREFETCH;
+      cp->pf_useful++;
+      if (blk->ready > now)
+	cp->pf_late++;
+    }
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
       CACHE_BCOPY(cmd, blk, bofs, p, nbytes);
     }
 
-  /* update dirty status */
-  if (cmd == Write)
+  /* update dirty status, blocks spilled from above keep theirs */
+  if (cp->spill)
+    blk->status |= cp->spill & CACHE_BLK_DIRTY;
+  else if (cmd == Write)
     blk->status |= CACHE_BLK_DIRTY;
 
   /* if LRU replacement and this is not the first element of list, reorder */
-  if (blk->way_prev && cp->policy == LRU)
+  if (CACHE_PACKED_POLICY(cp->policy))
+    {
+      /* update the packed replacement state of the block */
+      repl_hit(cp, sp, sp->tags ? way : CACHE_BWAY(cp, sp, blk), blk);
+    }
+  else if (sp->tags)
+    {
+      /* move this block to the MRU position */
+      if (cp->policy == LRU && SOA_ORDER_WAY(sp->order, 0) != way)
+	soa_order_mru(sp, way);
+    }
+  else if (blk->way_prev && cp->policy == LRU)
     {
       /* move this block to head of the way (MRU) list */
       update_way_list(&cp->sets[set], blk, Head);
@@ -689,16 +1656,36 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* tag is unchanged, so hash links (if they exist) are still valid */
 
-  /* record the last block to hit */
-  cp->last_tagset = CACHE_TAGSET(cp, addr);
-  cp->last_blk = blk;
+  /* a hit to a block with an outstanding miss merges into the miss */
+  if (cp->mshr && (entry = mshr_lookup(cp->mshr, addr)) != NULL)
+    lat = mshr_merge(cp, entry, addr, now);
+  else
+    {
+      /* record the last block to hit */
+      cp->last_tagset = CACHE_TAGSET(cp, addr);
+      cp->last_blk = blk;
+
+      /* first cycle data is available to access */
+      lat = (int) MAX(cp->hit_latency, (blk->ready - now));
+    }
 
   /* get user block data, if requested and it exists */
   if (udata)
     *udata = blk->user_data;
 
-  /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  /* an exclusive cache hands the block up to the cache reading it, which
+     takes a clean copy, so dirty blocks are written back as they leave */
+  if (cp->hier == Exclusive && cmd == Read)
+    {
+      cp->swaps++;
+      cache_flush_addr(cp, addr, now);
+    }
+
+  /* train the prefetcher with the hit, its fills may replace BLK */
+  if (cp->pf)
+    prefetch_access(cp->pf, cp, cp->access_pc, addr, FALSE, pf_hit, now);
+
+  return lat;
 
  cache_fast_hit: /* fast hit handler */
 
@@ -727,8 +1714,14 @@ cache_access(struct cache_t *cp,	/* cache to access */
   cp->last_tagset = CACHE_TAGSET(cp, addr);
   cp->last_blk = blk;
 
-  /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  /* first cycle data is available to access */
+  lat = (int) MAX(cp->hit_latency, (blk->ready - now));
+
+  /* train the prefetcher with the hit, its fills may replace BLK */
+  if (cp->pf)
+    prefetch_access(cp->pf, cp, cp->access_pc, addr, FALSE, FALSE, now);
+
+  return lat;
 }
 /* return non-zero if block containing address ADDR is contained in cache
    CP, this interface is used primarily for debugging and asserting cache
@@ -743,7 +1736,12 @@ cache_probe(struct cache_t *cp,		/* cache instance to probe */
 
   /* permissions are checked on cache misses */
 
-  if (cp->hsize)
+  if (cp->sets[set].tags)
+  {
+    if (soa_tag_match(cp->sets[set].tags, cp->assoc, tag) >= 0)
+      return TRUE;
+  }
+  else if (cp->hsize)
   {
     /* higly-associativity cache, access through the per-set hash tables */
     int hindex = CACHE_HASH(cp, tag);
@@ -768,8 +1766,128 @@ cache_probe(struct cache_t *cp,		/* cache instance to probe */
     }
   }
   
-  /* cache block not found */
-  return FALSE;
+  /* cache block not found, look in the victim cache */
+  return (cp->victim
+	  && victim_lookup(cp->victim, CACHE_BADDR(cp, addr)) != NULL);
+}
+
+/* return non-zero if an access to ADDR would miss in cache CP and its
+   MSHRs could not track the miss, the simulator should retry the access
+   once an outstanding miss completes */
+int					/* non-zero if access must wait */
+cache_mshr_blocked(struct cache_t *cp,	/* cache instance to check */
+		   md_addr_t addr)	/* address of access */
+{
+  if (!cp->mshr || !mshr_blocked(cp->mshr, addr))
+    return FALSE;
+
+  /* a full MSHR only blocks accesses that need a new entry, i.e., misses */
+  return mshr_lookup(cp->mshr, addr) != NULL || !cache_probe(cp, addr);
+}
+
+/* prefetch the block containing ADDR into cache CP at NOW, unless it is
+   already present, returns non-zero if a fill was issued */
+int					/* non-zero if prefetch issued */
+cache_prefetch(struct cache_t *cp,	/* cache instance to fill */
+	       md_addr_t addr,		/* address of block to prefetch */
+	       tick_t now)		/* time of prefetch */
+{
+  md_addr_t tag = CACHE_TAG(cp, addr);
+  md_addr_t set = CACHE_SET(cp, addr);
+  struct cache_set_t *sp = &cp->sets[set];
+  struct cache_blk_t *blk, *repl;
+  int way, lat = 0;
+
+  /* search the way list rather than the hash table, blocks with queued
+     misses are not in the hash table */
+  if (sp->tags)
+    {
+      if (soa_tag_match(sp->tags, cp->assoc, tag) >= 0)
+	return FALSE;
+    }
+  else
+    {
+      for (blk=sp->way_head; blk; blk=blk->way_next)
+	{
+	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
+	    return FALSE;
+	}
+    }
+
+  /* blocks in the victim cache are present too */
+  if (cp->victim && victim_lookup(cp->victim, CACHE_BADDR(cp, addr)))
+    return FALSE;
+
+  /* prefetches are dropped when no MSHR is free */
+  if (cp->mshr && mshr_blocked(cp->mshr, addr))
+    return FALSE;
+
+  /* allocate the pollution filter on the first prefetch */
+  if (!cp->pf_filter)
+    {
+      cp->pf_filter = (unsigned char *)calloc(1 << CACHE_PF_FILTER_BITS, 1);
+      if (!cp->pf_filter)
+	fatal("out of virtual memory");
+    }
+
+  /* select the block to replace, as on a miss */
+  repl = repl_victim(cp, sp, &way);
+  if (cp->hier == Inclusive && (repl->status & CACHE_BLK_VALID))
+    back_invalidate(cp, CACHE_MK_BADDR(cp, repl->tag, set), now);
+
+  /* remove this block from the hash bucket chain, if hash exists */
+  if (cp->hsize)
+    unlink_htab_ent(cp, sp, repl);
+
+  /* blow away the last block to hit */
+  cp->last_tagset = 0;
+  cp->last_blk = NULL;
+
+  /* write back replaced block data */
+  if (repl->status & CACHE_BLK_VALID)
+    {
+      repl_evict(cp, repl);
+
+      /* remember the block, a later miss to it is pollution */
+      cp->pf_filter[PF_FILTER_INDEX(cp, CACHE_MK_BADDR(cp, repl->tag, set))]
+	= 1;
+
+      /* don't replace the block until outstanding misses are satisfied */
+      lat += BOUND_POS(repl->ready - now);
+
+      if (!cp->bus)
+	{
+	  /* stall until the bus to next level of memory is available */
+	  lat += BOUND_POS(cp->bus_free - (now + lat));
+
+	  /* track bus resource usage */
+	  cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
+	}
+
+      /* move the block to the victim cache, or write it back */
+      lat += blk_evict(cp, CACHE_MK_BADDR(cp, repl->tag, set), repl, now+lat);
+    }
+
+  /* update block tags */
+  repl->tag = tag;
+  repl->status = CACHE_BLK_VALID | CACHE_BLK_PREFETCH;
+  if (sp->tags)
+    sp->tags[way] = tag;
+  if (CACHE_PACKED_POLICY(cp->policy))
+    repl_fill(cp, sp, set, way, repl, addr);
+
+  /* read data block, the block is ready when the fill completes */
+  lat += blk_read(cp, CACHE_BADDR(cp, addr), repl, now+lat);
+  repl->ready = now+lat;
+  cp->pf_issued++;
+  if (cp->mshr)
+    mshr_miss(cp, addr, now, now+lat, /* prefetch */TRUE);
+
+  /* link this entry back into the hash table */
+  if (cp->hsize)
+    link_htab_ent(cp, sp, repl);
+
+  return TRUE;
 }
 
 /* flush the entire cache, returns latency of the operation */
@@ -777,8 +1895,17 @@ unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
 	    tick_t now)			/* time of cache flush */
 {
-  int i, lat = cp->hit_latency; /* min latency to probe cache */
-  struct cache_blk_t *blk;
+  int i, pos, way, lat = cp->hit_latency; /* min latency to probe cache */
+  struct cache_set_t *sp;
+  struct cache_blk_t *blk = NULL;
+
+  /* the caches above an inclusive cache are flushed first, their dirty
+     blocks are written back into it */
+  if (cp->hier == Inclusive)
+    {
+      for (i=0; i<cp->ninner; i++)
+	lat += cache_flush(cp->inner[i], now+lat);
+    }
 
   /* blow away the last block to hit */
   cp->last_tagset = 0;
@@ -787,8 +1914,20 @@ cache_flush(struct cache_t *cp,		/* cache instance to flush */
   /* no way list updates required because all blocks are being invalidated */
   for (i=0; i<cp->nsets; i++)
     {
-      for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
+      sp = &cp->sets[i];
+      for (pos=0; pos<cp->assoc; pos++)
 	{
+	  /* visit the blocks of the set in MRU to LRU order */
+	  if (sp->tags)
+	    {
+	      way = CACHE_PACKED_POLICY(cp->policy)
+		? pos : SOA_ORDER_WAY(sp->order, pos);
+	      blk = CACHE_BINDEX(cp, sp->blks, way);
+	      sp->tags[way] = CACHE_TAG_INVALID;
+	    }
+	  else
+	    blk = pos ? blk->way_next : sp->way_head;
+
 	  if (blk->status & CACHE_BLK_VALID)
 	    {
 	      cp->invalidations++;
@@ -798,12 +1937,33 @@ cache_flush(struct cache_t *cp,		/* cache instance to flush */
 		{
 		  /* write back the invalidated block */
           	  cp->writebacks++;
-		  lat += cp->blk_access_fn(Write,
-					   CACHE_MK_BADDR(cp, blk->tag, i),
-					   cp->bsize, blk, now+lat);
+		  lat += blk_writeback(cp, CACHE_MK_BADDR(cp, blk->tag, i),
+				       blk, now+lat);
 		}
 	    }
 	}
+
+      /* invalidated blocks are the first to be replaced under RRIP */
+      if (CACHE_RRIP_POLICY(cp->policy))
+	sp->order = RRIP_LOW_BITS(cp->assoc) * RRIP_DISTANT;
+    }
+
+  /* flush the victim cache */
+  for (i=0; cp->victim && i<cp->victim->nblks; i++)
+    {
+      blk = cp->victim->blks[i];
+      if (blk->status & CACHE_BLK_VALID)
+	{
+	  cp->invalidations++;
+	  blk->status &= ~CACHE_BLK_VALID;
+
+	  if (blk->status & CACHE_BLK_DIRTY)
+	    {
+	      /* write back the invalidated block */
+	      cp->writebacks++;
+	      lat += blk_writeback(cp, blk->tag, blk, now+lat);
+	    }
+	}
     }
 
   /* return latency of the flush operation */
@@ -819,10 +1979,22 @@ cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
 {
   md_addr_t tag = CACHE_TAG(cp, addr);
   md_addr_t set = CACHE_SET(cp, addr);
+  struct cache_set_t *sp = &cp->sets[set];
   struct cache_blk_t *blk;
-  int lat = cp->hit_latency; /* min latency to probe cache */
+  int way = -1, lat = cp->hit_latency; /* min latency to probe cache */
 
-  if (cp->hsize)
+  /* an inclusive cache invalidates the copies above first, while it still
+     holds the block to take their write-backs */
+  if (cp->hier == Inclusive)
+    lat += back_invalidate(cp, CACHE_BADDR(cp, addr), now);
+
+  if (sp->tags)
+    {
+      /* structure-of-arrays tag store, compare all the tags of the set */
+      way = soa_tag_match(sp->tags, cp->assoc, tag);
+      blk = way >= 0 ? CACHE_BINDEX(cp, sp->blks, way) : NULL;
+    }
+  else if (cp->hsize)
     {
       /* higly-associativity cache, access through the per-set hash tables */
       int hindex = CACHE_HASH(cp, tag);
@@ -860,46 +2032,93 @@ cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
 	{
 	  /* write back the invalidated block */
           cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, blk->tag, set),
-				   cp->bsize, blk, now+lat);
+	  lat += blk_writeback(cp, CACHE_MK_BADDR(cp, blk->tag, set),
+			       blk, now+lat);
 	}
       /* move this block to tail of the way (LRU) list */
-      update_way_list(&cp->sets[set], blk, Tail);
+      if (sp->tags)
+	sp->tags[way] = CACHE_TAG_INVALID;
+      if (CACHE_PACKED_POLICY(cp->policy))
+	{
+	  /* make the block the next to be replaced */
+	  if (way < 0)
+	    way = CACHE_BWAY(cp, sp, blk);
+	  if (cp->policy == PLRU)
+	    plru_update(&sp->order, way, cp->assoc, /* touch */FALSE);
+	  else
+	    RRIP_SET(sp->order, way, RRIP_DISTANT);
+	}
+      else if (sp->tags)
+	soa_order_lru(sp, way, cp->assoc);
+      else
+	update_way_list(&cp->sets[set], blk, Tail);
+    }
+  else if (cp->victim
+	   && (blk = victim_lookup(cp->victim, CACHE_BADDR(cp, addr))) != NULL)
+    {
+      /* the block is in the victim cache */
+      cp->invalidations++;
+      blk->status &= ~CACHE_BLK_VALID;
+
+      if (blk->status & CACHE_BLK_DIRTY)
+	{
+	  /* write back the invalidated block */
+          cp->writebacks++;
+	  lat += blk_writeback(cp, blk->tag, blk, now+lat);
+	}
     }
 
   /* return latency of the operation */
   return lat;
 }
 
-void
-miss_queue_swap(struct miss_queue_heap *heap, int i, int j) {
-  struct miss_queue_entry *tmp = &heap->entries[i];
-  heap->entries[i] = heap->entries[j];
-  heap->entries[j] = *tmp;
-}
+/* sift the fill ENTRY down from slot I of miss queue HEAP, moving earlier
+   fills up into the hole */
+static void
+mq_sift_down(struct miss_queue_heap *heap,	/* miss queue */
+	     int i,				/* hole to fill */
+	     struct miss_queue_entry *entry)	/* fill to place */
+{
+  int c, child, last;
 
-void 
-miss_queue_heapify(struct miss_queue_heap *heap, int i) {
-  int left = 2 * i + 1;
-  int right = 2 * i + 2;
-  int smallest = i;
+  for (;;)
+    {
+      /* find the earliest of the children of slot I */
+      child = MQ_CHILD(i);
+      if (child >= heap->size)
+	break;
+      last = MIN(child + MISS_QUEUE_ARITY, heap->size);
+      for (c = child + 1; c < last; c++)
+	{
+	  if (heap->entries[c].ready_time < heap->entries[child].ready_time)
+	    child = c;
+	}
 
-  if (left < heap->size && heap->entries[left].ready_time < heap->entries[smallest].ready_time) {
-    smallest = left;
-  }
+      if (heap->entries[child].ready_time >= entry->ready_time)
+	break;
+      heap->entries[i] = heap->entries[child];
+      i = child;
+    }
+  heap->entries[i] = *entry;
+}
 
-  if (right < heap->size && heap->entries[right].ready_time < heap->entries[smallest].ready_time) {
-    smallest = right;
-  } 
+/* restore the heap order of miss queue HEAP below slot I */
+void
+miss_queue_heapify(struct miss_queue_heap *heap,	/* miss queue */
+		   int i)				/* slot to sift */
+{
+  struct miss_queue_entry entry;
 
-  if (smallest != i) {  
-    miss_queue_swap(heap, i, smallest);
-    miss_queue_heapify(heap, smallest);
-  }
+  if (i < 0 || i >= heap->size)
+    panic("miss queue slot %d out of range", i);
+  entry = heap->entries[i];
+  mq_sift_down(heap, i, &entry);
 }
 
-void miss_queue_insert(
+/* queue the fill of block REPL of cache CP, missed at ADDR, to complete at
+   READY_TIME, the queue grows as needed */
+void
+miss_queue_insert(
   struct miss_queue_heap *heap,
   struct cache_t *cp,
   md_addr_t addr,
@@ -915,83 +2134,115 @@ void miss_queue_insert(
   int bofs
 )
 {
-  struct miss_queue_entry *entry = &heap->entries[heap->size];
-  entry->cp = cp;
-  entry->addr = addr;
-  entry->cmd = cmd;
-  entry->p = p;
-  entry->nbytes = nbytes;
-  entry->ready_time = ready_time;
-  entry->repl = repl;
-  entry->udata = udata;
-  entry->repl_addr = repl_addr;
-  entry->tag = tag;
-  entry->set = set;
-  entry->bofs = bofs;
-  heap->size++;
-
-  int i = heap->size - 1;
-  while (i > 0 && heap->entries[parent(i)].ready_time > heap->entries[i].ready_time) {
-    miss_queue_swap(heap, i, parent(i));
-    i = parent(i);
-  }
-  return;
+  struct miss_queue_entry *entries;
+  int i;
+
+  /* out of room, double the queue */
+  if (heap->size == heap->capacity)
+    {
+      entries = (struct miss_queue_entry *)
+	realloc(heap->entries,
+		2 * heap->capacity * sizeof(struct miss_queue_entry));
+      if (!entries)
+	fatal("out of virtual memory");
+      heap->entries = entries;
+      heap->capacity *= 2;
+    }
+
+  /* sift the hole at the end up past the later fills */
+  i = heap->size++;
+  while (i > 0 && heap->entries[MQ_PARENT(i)].ready_time > ready_time)
+    {
+      heap->entries[i] = heap->entries[MQ_PARENT(i)];
+      i = MQ_PARENT(i);
+    }
+
+  heap->entries[i].cp = cp;
+  heap->entries[i].addr = addr;
+  heap->entries[i].cmd = cmd;
+  heap->entries[i].p = p;
+  heap->entries[i].nbytes = nbytes;
+  heap->entries[i].ready_time = ready_time;
+  heap->entries[i].repl = repl;
+  heap->entries[i].udata = udata;
+  heap->entries[i].repl_addr = repl_addr;
+  heap->entries[i].tag = tag;
+  heap->entries[i].set = set;
+  heap->entries[i].bofs = bofs;
+
+  heap->inserts++;
+  if (heap->size > heap->peak)
+    heap->peak = heap->size;
 }
 
+/* remove the earliest fill from miss queue HEAP and complete it at NOW */
 void
 miss_queue_extract_min(struct miss_queue_heap *heap, tick_t now) {
-  struct miss_queue_entry *top = &heap->entries[0];
-  struct miss_queue_entry *last = &heap->entries[heap->size - 1];
-  heap->entries[0] = *last;
-  heap->size--;
-  miss_queue_heapify(heap, 0);
-
-  struct cache_t *cp = top->cp;
-  md_addr_t addr = top->addr;
-  enum mem_cmd cmd = top->cmd;
-  void *p = top->p;
-  int nbytes = top->nbytes;
-  tick_t ready_time = top->ready_time;
-  struct cache_blk_t *repl = top->repl;
-  byte_t **udata = top->udata;
-  md_addr_t *repl_addr = top->repl_addr;
-  md_addr_t tag = top->tag;
-  md_addr_t set = top->set;
-  int bofs = top->bofs;
+  struct miss_queue_entry top;
 
-  /* update dirty status */
-  if (cmd == Write)
-    repl->status |= CACHE_BLK_DIRTY;
+  if (heap->size <= 0)
+    panic("miss queue underflow");
 
-  /* get user block data, if requested and it exists */
-  if (udata)
-    *udata = repl->user_data;
+  /* take the earliest fill, then sift the last one down from the root */
+  top = heap->entries[0];
+  heap->size--;
+  if (heap->size > 0)
+    mq_sift_down(heap, 0, &heap->entries[heap->size]);
 
-  /* link this entry back into the hash table */
-  if (cp->hsize)
-    link_htab_ent(cp, &cp->sets[set], repl);
+  struct cache_t *cp = top.cp;
+  struct cache_blk_t *repl = top.repl;
+
+  /* the block was replaced again while being filled, the later miss
+     completes it */
+  if (!(repl->status & CACHE_BLK_VALID) || repl->tag != top.tag)
+    return;
 
-    if (cp->balloc)
+  if (cp->balloc)
     {
-      CACHE_BCOPY(cmd, repl, bofs, p, nbytes);
+      CACHE_BCOPY(top.cmd, repl, top.bofs, top.p, top.nbytes);
     }
 
   /* update dirty status */
-  if (cmd == Write)
+  if (top.cmd == Write)
     repl->status |= CACHE_BLK_DIRTY;
 
   /* get user block data, if requested and it exists */
-  if (udata)
-    *udata = repl->user_data;
+  if (top.udata)
+    *top.udata = repl->user_data;
 
   /* update block status */
   repl->ready = now;
 }
 
+/* allocate the global miss queue */
 void
 miss_queue_init() {
-  miss_queue = (struct miss_queue_heap *)malloc(sizeof(struct miss_queue_heap));
+  miss_queue = (struct miss_queue_heap *)
+    calloc(1, sizeof(struct miss_queue_heap));
+  if (!miss_queue)
+    fatal("out of virtual memory");
   miss_queue->size = 0;
-  miss_queue->capacity = 10000;
-  miss_queue->entries = (struct miss_queue_entry *)malloc(miss_queue->capacity* sizeof(struct miss_queue_entry));
+  miss_queue->capacity = MISS_QUEUE_INIT_SIZE;
+  miss_queue->entries = (struct miss_queue_entry *)
+    calloc(miss_queue->capacity, sizeof(struct miss_queue_entry));
+  if (!miss_queue->entries)
+    fatal("out of virtual memory");
+}
+
+/* register the miss queue stats */
+void
+miss_queue_reg_stats(struct miss_queue_heap *heap,	/* miss queue */
+		     struct stat_sdb_t *sdb)		/* stats database */
+{
+  stat_reg_counter(sdb, "miss_queue.fills",
+		   "total number of cache fills queued",
+		   &heap->inserts, heap->inserts, NULL);
+  /* both only grow, copies of the simulator that ran sampled units merge
+     them with the largest value seen */
+  stat_set_merge(stat_reg_int(sdb, "miss_queue.peak",
+			      "peak number of fills outstanding in the queue",
+			      &heap->peak, heap->peak, NULL), sm_max);
+  stat_set_merge(stat_reg_int(sdb, "miss_queue.capacity",
+			      "entries allocated to the queue",
+			      &heap->capacity, heap->capacity, NULL), sm_max);
 }
\ No newline at end of file
@@ -58,6 +58,7 @@
 #include "misc.h"
 #include "machine.h"
 #include "memory.h"
+#include "options.h"
 #include "stats.h"
 
 /*
@@ -78,9 +79,14 @@
  * physical page address information, etc...
  *
  * The caches implemented by this module provide efficient storage management
- * and fast access for all cache geometries.  When sets become highly
- * associative, a hash table (indexed by address) is allocated for each set
- * in the cache.
+ * and fast access for all cache geometries.  By default, the tags of each set
+ * of a set-associative cache are kept in a contiguous array (a
+ * structure-of-arrays tag store) that is searched with SIMD compares where
+ * the host supports them, and the replacement order of each set is packed
+ * into a single word.  Otherwise, and for direct-mapped caches or
+ * associativities the packed order cannot represent, blocks are found
+ * through an ordered way list, and when sets become highly associative, a
+ * hash table (indexed by address) is allocated for each set in the cache.
  *
  * This module also tracks latency of accessing the data cache, each cache has
  * a hit latency defined when instantiated, miss latency is returned by the
@@ -98,16 +104,68 @@
    speed block access, this macro decides if a cache is "highly associative" */
 #define CACHE_HIGHLY_ASSOC(cp)	((cp)->assoc > 4)
 
+/* largest associativity supported by the structure-of-arrays tag store,
+   its packed replacement order holds one 4-bit way index per block */
+#define CACHE_SOA_MAX_ASSOC	16
+
+/* tag store value of an invalid block, never a valid tag because tags are
+   shifted right by at least the block offset */
+#define CACHE_TAG_INVALID	((md_addr_t)-1)
+
 /* cache replacement policy */
 enum cache_policy {
   LRU,		/* replace least recently used block (perfect LRU) */
   Random,	/* replace a random block */
-  FIFO		/* replace the oldest block in the set */
+  FIFO,		/* replace the oldest block in the set */
+  PLRU,		/* tree pseudo-LRU, one bit per internal tree node */
+  SRRIP,	/* static re-reference interval prediction, 2-bit RRPVs */
+  BRRIP,	/* bimodal RRIP, most fills predicted distant */
+  DRRIP,	/* SRRIP or BRRIP, chosen by set dueling */
+  SHiP		/* RRIP with signature-based hit prediction on fills */
+};
+
+/* relation of a cache to the caches above it (closer to the processor),
+   see cache_link() */
+enum cache_hier {
+  NINE,		/* non-inclusive non-exclusive, nothing is enforced */
+  Inclusive,	/* holds every block above, replacing a block invalidates
+		   its copies above */
+  Exclusive	/* holds no block above, read hits hand blocks up and the
+		   caches above spill their replaced blocks down */
 };
 
+/* most caches that can miss to one cache */
+#define CACHE_MAX_INNER		4
+
+/* policies that keep their replacement state in the order word of each set
+   (tree bits for PLRU, 2-bit re-reference prediction values for RRIP),
+   rather than in the way list */
+#define CACHE_PACKED_POLICY(P)	((P) >= PLRU)
+#define CACHE_RRIP_POLICY(P)	((P) >= SRRIP)
+
+/* largest associativities the order word can hold for tree-PLRU (ASSOC-1
+   tree bits) and for the RRIP policies (2 bits per block) */
+#define CACHE_PLRU_MAX_ASSOC	64
+#define CACHE_RRIP_MAX_ASSOC	32
+
+/* SHiP signature history counter table size (log2) and counter maximum */
+#define CACHE_SHCT_BITS		14
+#define CACHE_SHCT_MAX		7
+
+/* DRRIP policy selector range, and number of leader sets per policy, small
+   caches dedicate one set in CACHE_SDM_MIN_PERIOD to each policy instead */
+#define CACHE_PSEL_MAX		1023
+#define CACHE_SDM_LEADERS	32
+#define CACHE_SDM_MIN_PERIOD	16
+
 /* block status values */
 #define CACHE_BLK_VALID		0x00000001	/* block in valid, in use */
 #define CACHE_BLK_DIRTY		0x00000002	/* dirty block */
+#define CACHE_BLK_REUSED	0x00000004	/* block hit since fill (SHiP) */
+#define CACHE_BLK_PREFETCH	0x00000008	/* prefetched, not yet used */
+
+/* prefetch pollution filter size (log2), in blocks */
+#define CACHE_PF_FILTER_BITS	12
 
 /* cache block (or line) definition */
 struct cache_blk_t
@@ -125,6 +183,7 @@ struct cache_blk_t
 				   is set when a miss fetch is initiated */
   byte_t *user_data;		/* pointer to user defined data, e.g.,
 				   pre-decode data or physical page address */
+  unsigned int sig;		/* SHiP signature of the filling access */
   /* DATA should be pointer-aligned due to preceeding field */
   /* NOTE: this is a variable-size tail array, this must be the LAST field
      defined in this structure! */
@@ -142,6 +201,26 @@ struct cache_set_t
   struct cache_blk_t *blks;	/* cache blocks, allocated sequentially, so
 				   this pointer can also be used for random
 				   access to cache blocks */
+  md_addr_t *tags;		/* structure-of-arrays tag store: the tag of
+				   block I is TAGS[I], CACHE_TAG_INVALID if
+				   it is invalid, NULL if the way list and
+				   hash table are used instead */
+  qword_t order;		/* replacement state: tag store replacement
+				   order (4-bit way indices from MRU, low,
+				   to LRU) for LRU/FIFO, or the tree bits
+				   (PLRU) or 2-bit RRPVs of each way (RRIP
+				   policies) in any layout */
+};
+
+/* victim cache, a small fully associative buffer of the blocks last
+   replaced in a cache, searched on misses to the cache */
+struct cache_victim_t
+{
+  int nblks;			/* number of blocks */
+  unsigned int latency;		/* extra cycles to swap a block in */
+  struct cache_blk_t **blks;	/* blocks in MRU to LRU order, the TAG of a
+				   victim block is its block address */
+  struct cache_blk_t *tmp;	/* scratch block for swaps */
 };
 
 /* cache definition */
@@ -191,6 +270,40 @@ struct cache_t
  				   latency of the access to the lower level
  				   may be more than one cycle, as specified
  				   by the miss handler */
+  struct bus_t *bus;		/* link to the next level of memory, see
+				   bus.h, used instead of BUS_FREE if set */
+
+  /* replacement policy state */
+  int psel;			/* DRRIP policy selector, followers use
+				   BRRIP while PSEL >= CACHE_PSEL_MAX/2 */
+  int sdm_period;		/* DRRIP set dueling: set I leads SRRIP if
+				   I % SDM_PERIOD == 0, BRRIP if == 1 */
+  unsigned int bip_fills;	/* BRRIP fill count, every 32nd fill is
+				   inserted with a long re-reference */
+  unsigned char *shct;		/* SHiP signature history counter table */
+
+  /* hardware prefetcher, see prefetch.h */
+  struct prefetch_t *pf;	/* attached prefetcher, NULL if none */
+  md_addr_t access_pc;		/* PC of the instruction making the next
+				   access, set by the simulator before
+				   cache_access(), 0 if unknown */
+  unsigned char *pf_filter;	/* blocks evicted by prefetches, to detect
+				   pollution, indexed by block address */
+
+  /* miss status holding registers, see mshr.h */
+  struct mshr_t *mshr;		/* outstanding misses of a non-blocking
+				   cache, NULL if misses are not tracked */
+
+  /* victim cache, see cache_victim() */
+  struct cache_victim_t *victim;/* victim cache, NULL if none */
+
+  /* multi-level hierarchy, see cache_link() */
+  enum cache_hier hier;		/* policy towards the caches above */
+  struct cache_t *inner[CACHE_MAX_INNER];/* caches missing to this cache */
+  int ninner;			/* number of caches above */
+  struct cache_t *outer;	/* cache this cache misses to, if linked */
+  unsigned int spill;		/* status of a block replaced above while
+				   it spills into this exclusive cache */
 
   /* per-cache stats */
   counter_t hits;		/* total number of hits */
@@ -198,6 +311,18 @@ struct cache_t
   counter_t replacements;	/* total number of replacements at misses */
   counter_t writebacks;		/* total number of writebacks at misses */
   counter_t invalidations;	/* total number of external invalidations */
+  counter_t sdm_misses[2];	/* DRRIP misses in SRRIP and BRRIP leaders */
+  counter_t distant_fills;	/* RRIP fills inserted at the distant RRPV */
+  counter_t pf_issued;		/* prefetch fills issued */
+  counter_t pf_useful;		/* prefetched blocks later hit by demand */
+  counter_t pf_late;		/* useful prefetches not yet filled at hit */
+  counter_t pf_unused;		/* prefetched blocks evicted unused */
+  counter_t pf_polluting;	/* demand misses to blocks evicted by
+				   prefetches */
+  counter_t victim_hits;		/* misses found in the victim cache */
+  counter_t back_invalidations;	/* blocks invalidated above by replacements
+				   of an inclusive cache */
+  counter_t swaps;		/* blocks handed up by exclusive read hits */
 
   /* last block to hit, used to optimize cache hit processing */
   md_addr_t last_tagset;	/* tag of last line accessed */
@@ -211,6 +336,13 @@ struct cache_t
   struct cache_set_t sets[1];	/* each entry is a set */
 };
 
+/* use the structure-of-arrays tag store for new caches, if possible */
+extern int cache_soa;
+
+/* register cache module options */
+void
+cache_reg_options(struct opt_odb_t *odb);/* options database */
+
 /* create and initialize a general cache structure */
 struct cache_t *			/* pointer to cache created */
 cache_create(char *name,		/* name of the cache */
@@ -231,6 +363,23 @@ cache_create(char *name,		/* name of the cache */
 enum cache_policy			/* replacement policy enum */
 cache_char2policy(char c);		/* replacement policy as a char */
 
+/* parse hierarchy policy */
+enum cache_hier				/* hierarchy policy enum */
+cache_str2hier(char *s);		/* {nine|incl|excl} */
+
+/* attach a fully associative victim cache of NBLKS blocks to cache CP, a
+   block found in it is swapped in after LATENCY extra cycles */
+void
+cache_victim(struct cache_t *cp,	/* cache instance */
+	     int nblks,			/* victim cache size, in blocks */
+	     unsigned int latency);	/* extra cycles to swap a block in */
+
+/* record that cache INNER misses to cache OUTER, the hierarchy policy of
+   OUTER (i.e., OUTER->HIER) is enforced on INNER */
+void
+cache_link(struct cache_t *inner,	/* cache above */
+	   struct cache_t *outer);	/* cache below */
+
 /* print cache configuration */
 void
 cache_config(struct cache_t *cp,	/* cache instance */
@@ -286,6 +435,20 @@ int					/* non-zero if access would hit */
 cache_probe(struct cache_t *cp,		/* cache instance to probe */
 	    md_addr_t addr);		/* address of block to probe */
 
+/* return non-zero if an access to ADDR would miss in cache CP and its
+   MSHRs could not track the miss, the simulator should retry the access
+   once an outstanding miss completes */
+int					/* non-zero if access must wait */
+cache_mshr_blocked(struct cache_t *cp,	/* cache instance to check */
+		   md_addr_t addr);	/* address of access */
+
+/* prefetch the block containing ADDR into cache CP at NOW, unless it is
+   already present, returns non-zero if a fill was issued */
+int					/* non-zero if prefetch issued */
+cache_prefetch(struct cache_t *cp,	/* cache instance to fill */
+	       md_addr_t addr,		/* address of block to prefetch */
+	       tick_t now);		/* time of prefetch */
+
 /* flush the entire cache, returns latency of the operation */
 unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
@@ -319,15 +482,16 @@ struct miss_queue_entry {
 /* 캐시 미스 큐 힙 */
 struct miss_queue_heap {
   struct miss_queue_entry *entries;
-  int size;
-  int capacity;
+  int size;                /* fills outstanding */
+  int capacity;            /* entries allocated, doubled when full */
+  int peak;                /* most fills ever outstanding */
+  counter_t inserts;       /* total fills queued */
 };
 
 /* 전역 miss_queue 변수 선언 */
 extern struct miss_queue_heap *miss_queue;
 
 /* miss queue 관련 함수 */
-void miss_queue_swap(struct miss_queue_heap *heap, int i, int j);
 void miss_queue_heapify(struct miss_queue_heap *heap, int i);
 void miss_queue_extract_min(struct miss_queue_heap *heap, tick_t now);
 void miss_queue_init();
@@ -346,6 +510,8 @@ void miss_queue_insert(
   md_addr_t set,
   int bofs    
 );
+void miss_queue_reg_stats(struct miss_queue_heap *heap,
+			  struct stat_sdb_t *sdb);
 
 
 #endif /* CACHE_H */
@@ -0,0 +1,414 @@
+/* dram.c - DRAM controller timing model routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+#include "dram.h"
+
+/* a time later than any simulated */
+#define DRAM_NEVER		(((tick_t)1) << 62)
+
+/* DRAM address decoding, the channel of ADDR, its bank in the channel
+   (RANK*BANKS + BANK) and its row */
+#define DRAM_CHAN(D, ADDR)						\
+  ((int)(((ADDR) >> (D)->col_shift) & ((D)->channels - 1)))
+#define DRAM_BANK(D, ADDR)						\
+  ((int)(((ADDR) >> ((D)->col_shift + (D)->chan_shift))		\
+	 & ((D)->ranks * (D)->banks - 1)))
+#define DRAM_ROW(D, ADDR)						\
+  ((ADDR) >> ((D)->col_shift + (D)->chan_shift				\
+	      + (D)->bank_shift + (D)->rank_shift))
+
+/* allocate the banks and request queue of channel CH */
+static void
+chan_init(struct dram_t *dram,		/* DRAM system */
+	  struct dram_channel_t *ch)	/* channel to initialize */
+{
+  ch->banks = (struct dram_bank_t *)
+    calloc(dram->ranks * dram->banks, sizeof(struct dram_bank_t));
+  ch->queue = (struct dram_req_t *)
+    calloc(dram->queue_size, sizeof(struct dram_req_t));
+  if (!ch->banks || !ch->queue)
+    fatal("out of virtual memory");
+  ch->nqueued = 0;
+  ch->bus_free = 0;
+  ch->next_issue = 0;
+}
+
+/* create a DRAM system of CHANNELS channels of RANKS ranks of BANKS banks,
+   with ROW_SIZE byte rows managed with POLICY, timing T_RCD, T_RP and T_CAS,
+   a BUS_WIDTH byte data bus taking BEAT cycles per transfer and QUEUE_SIZE
+   requests per channel */
+struct dram_t *				/* pointer to DRAM system created */
+dram_create(int channels,		/* number of channels */
+	    int ranks,			/* ranks per channel */
+	    int banks,			/* banks per rank */
+	    int row_size,		/* bytes per row */
+	    enum dram_policy policy,	/* row buffer policy */
+	    int t_rcd,			/* activate to column access */
+	    int t_rp,			/* precharge to activate */
+	    int t_cas,			/* column access to data */
+	    int bus_width,		/* data bus width in bytes */
+	    int beat,			/* data bus cycles per transfer */
+	    int queue_size)		/* requests queued per channel */
+{
+  struct dram_t *dram;
+  int i;
+
+  /* check all DRAM parameters */
+  if (channels <= 0 || (channels & (channels-1)) != 0)
+    fatal("DRAM channels `%d' must be a positive power of two", channels);
+  if (ranks <= 0 || (ranks & (ranks-1)) != 0)
+    fatal("DRAM ranks `%d' must be a positive power of two", ranks);
+  if (banks <= 0 || (banks & (banks-1)) != 0)
+    fatal("DRAM banks `%d' must be a positive power of two", banks);
+  if (row_size < 64 || (row_size & (row_size-1)) != 0)
+    fatal("DRAM row size `%d' must be a power of two, 64 or greater",
+	  row_size);
+  if (t_rcd < 0 || t_rp < 0 || t_cas < 0)
+    fatal("DRAM timing must not be negative");
+  if (bus_width < 1)
+    fatal("DRAM bus width `%d' must be at least one byte", bus_width);
+  if (beat < 1)
+    fatal("DRAM transfers must take at least one cycle");
+  if (queue_size < 1)
+    fatal("DRAM queue size `%d' must be at least one", queue_size);
+
+  dram = (struct dram_t *)calloc(1, sizeof(struct dram_t));
+  if (!dram)
+    fatal("out of virtual memory");
+
+  dram->channels = channels;
+  dram->ranks = ranks;
+  dram->banks = banks;
+  dram->row_size = row_size;
+  dram->policy = policy;
+  dram->t_rcd = t_rcd;
+  dram->t_rp = t_rp;
+  dram->t_cas = t_cas;
+  dram->bus_width = bus_width;
+  dram->beat = beat;
+  dram->queue_size = queue_size;
+
+  dram->col_shift = log_base2(row_size);
+  dram->chan_shift = log_base2(channels);
+  dram->bank_shift = log_base2(banks);
+  dram->rank_shift = log_base2(ranks);
+
+  dram->chans = (struct dram_channel_t *)
+    calloc(channels, sizeof(struct dram_channel_t));
+  if (!dram->chans)
+    fatal("out of virtual memory");
+  for (i=0; i<channels; i++)
+    chan_init(dram, &dram->chans[i]);
+  chan_init(dram, &dram->ahead);
+
+  return dram;
+}
+
+/* parse a DRAM page policy from character C, 'o' or 'c' */
+enum dram_policy			/* DRAM page policy */
+dram_char2policy(char c)		/* policy char */
+{
+  switch (c) {
+  case 'o': return DRAM_OpenPage;
+  case 'c': return DRAM_ClosedPage;
+  default: fatal("bogus DRAM page policy, `%c'", c);
+  }
+}
+
+/* start the next request of channel CH in FR-FCFS order, if it can start
+   by LIMIT, and remove it from the queue; returns its sequence number in
+   *SEQ, its start time in *START and the time its data burst completes in
+   *DONE, and counts its stats if COUNT; returns FALSE if no request starts
+   by LIMIT */
+static int				/* non-zero if a request started */
+dram_issue(struct dram_t *dram,		/* DRAM system */
+	   struct dram_channel_t *ch,	/* channel to schedule */
+	   tick_t limit,		/* latest start time */
+	   int count,			/* count stats? */
+	   counter_t *seq,		/* sequence number of request */
+	   tick_t *start,		/* start time of request */
+	   tick_t *done)		/* completion time of request */
+{
+  int i, pick, hit, empty;
+  tick_t when, cas;
+  struct dram_req_t *req;
+  struct dram_bank_t *bank;
+
+  if (!ch->nqueued)
+    return FALSE;
+
+  /* earliest time a request has arrived and its bank takes a command */
+  when = DRAM_NEVER;
+  for (i=0; i < ch->nqueued; i++)
+    {
+      req = &ch->queue[i];
+      when = MIN(when, MAX(req->arrive, ch->banks[req->bank].ready));
+    }
+  when = MAX(when, ch->next_issue);
+  if (when > limit)
+    return FALSE;
+
+  /* of the ready requests, the oldest open row access, else the oldest */
+  pick = -1;
+  hit = FALSE;
+  for (i=0; i < ch->nqueued; i++)
+    {
+      req = &ch->queue[i];
+      bank = &ch->banks[req->bank];
+      if (req->arrive > when || bank->ready > when)
+	continue;
+      if (bank->row_open && bank->row == req->row)
+	{
+	  pick = i;
+	  hit = TRUE;
+	  break;
+	}
+      if (pick < 0)
+	pick = i;
+    }
+  assert(pick >= 0);
+  req = &ch->queue[pick];
+  bank = &ch->banks[req->bank];
+
+  /* precharge and activate as needed, then access the column */
+  empty = !hit && !bank->row_open;
+  if (hit)
+    cas = when;
+  else if (empty)
+    cas = when + dram->t_rcd;
+  else
+    cas = when + dram->t_rp + dram->t_rcd;
+
+  /* the data burst waits for the bus */
+  *done = MAX(cas + dram->t_cas, ch->bus_free) + req->burst;
+  ch->bus_free = *done;
+
+  if (dram->policy == DRAM_OpenPage)
+    {
+      /* keep the row open for the next column access */
+      bank->row_open = TRUE;
+      bank->row = req->row;
+      bank->ready = cas + req->burst;
+    }
+  else
+    {
+      /* precharge once the data is out */
+      bank->row_open = FALSE;
+      bank->ready = *done + dram->t_rp;
+    }
+
+  /* the controller starts one request per cycle */
+  ch->next_issue = when + 1;
+
+  if (count)
+    {
+      if (req->cmd == Read)
+	dram->reads++;
+      else
+	dram->writes++;
+      if (hit)
+	dram->row_hits++;
+      else if (empty)
+	dram->row_empty++;
+      else
+	dram->row_conflicts++;
+      dram->queue_delay += when - req->arrive;
+    }
+
+  *seq = req->seq;
+  *start = when;
+
+  /* remove the request, keeping the queue in order of arrival */
+  memmove(&ch->queue[pick], &ch->queue[pick+1],
+	  (ch->nqueued - pick - 1) * sizeof(struct dram_req_t));
+  ch->nqueued--;
+
+  return TRUE;
+}
+
+/* access NBYTES at ADDR in DRAM system DRAM with CMD at NOW, returns the
+   latency of the access, the time until its data burst completes; writes
+   are queued and return immediately, as if written to a write buffer */
+unsigned int				/* latency of access in cycles */
+dram_access(struct dram_t *dram,	/* DRAM system to access */
+	    enum mem_cmd cmd,		/* Read or Write */
+	    md_addr_t addr,		/* address of access */
+	    int nbytes,			/* number of bytes to access */
+	    tick_t now)			/* time of access */
+{
+  struct dram_channel_t *ch = &dram->chans[DRAM_CHAN(dram, addr)];
+  struct dram_channel_t *ahead = &dram->ahead;
+  struct dram_req_t *req;
+  counter_t seq, started;
+  tick_t arrive, start, done;
+
+  /* start the requests the controller has scheduled by NOW */
+  while (dram_issue(dram, ch, now, /* count */TRUE, &started, &start, &done))
+    /* nada */;
+
+  /* a full queue holds the request until the next request starts */
+  arrive = now;
+  if (ch->nqueued == dram->queue_size)
+    {
+      dram->queue_full++;
+      dram_issue(dram, ch, DRAM_NEVER, /* count */TRUE,
+		 &started, &start, &done);
+      arrive = MAX(arrive, start);
+      dram->queue_delay += arrive - now;
+    }
+
+  /* queue the request */
+  seq = dram->seq++;
+  req = &ch->queue[ch->nqueued++];
+  req->cmd = cmd;
+  req->bank = DRAM_BANK(dram, addr);
+  req->row = DRAM_ROW(dram, addr);
+  req->burst =
+    ((nbytes + dram->bus_width - 1) / dram->bus_width) * dram->beat;
+  req->arrive = arrive;
+  req->seq = seq;
+
+  /* writes complete in the write buffer */
+  if (cmd == Write)
+    return 0;
+
+  /* schedule a copy of the channel ahead, until the read starts */
+  memcpy(ahead->banks, ch->banks,
+	 dram->ranks * dram->banks * sizeof(struct dram_bank_t));
+  memcpy(ahead->queue, ch->queue, ch->nqueued * sizeof(struct dram_req_t));
+  ahead->nqueued = ch->nqueued;
+  ahead->bus_free = ch->bus_free;
+  ahead->next_issue = ch->next_issue;
+  do {
+    if (!dram_issue(dram, ahead, DRAM_NEVER, /* count */FALSE,
+		    &started, &start, &done))
+      panic("DRAM read never scheduled");
+  } while (started != seq);
+
+  return (unsigned int)(done - now);
+}
+
+/* start all queued requests at once, then make the banks and buses free,
+   as when no timing is modeled; the open rows are kept */
+void
+dram_flush(struct dram_t *dram)		/* DRAM system to flush */
+{
+  int i, j;
+  counter_t seq;
+  tick_t start, done;
+
+  for (i=0; i < dram->channels; i++)
+    {
+      while (dram_issue(dram, &dram->chans[i], DRAM_NEVER, /* count */TRUE,
+			&seq, &start, &done))
+	/* nada */;
+      dram->chans[i].bus_free = 0;
+      dram->chans[i].next_issue = 0;
+      for (j=0; j < dram->ranks * dram->banks; j++)
+	dram->chans[i].banks[j].ready = 0;
+    }
+}
+
+/* print DRAM system configuration */
+void
+dram_config(struct dram_t *dram,	/* DRAM system instance */
+	    FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "dram: %d channel(s), %d rank(s) of %d bank(s) per channel, "
+	  "%d byte rows, %s page\n",
+	  dram->channels, dram->ranks, dram->banks, dram->row_size,
+	  dram->policy == DRAM_OpenPage ? "open" : "closed");
+  fprintf(stream,
+	  "dram: tRCD %d, tRP %d, tCAS %d, %d cycle(s) per %d byte transfer, "
+	  "%d request(s) queued per channel\n",
+	  dram->t_rcd, dram->t_rp, dram->t_cas, dram->beat, dram->bus_width,
+	  dram->queue_size);
+}
+
+/* register DRAM system stats */
+void
+dram_reg_stats(struct dram_t *dram,	/* DRAM system instance */
+	       struct stat_sdb_t *sdb)	/* stats database */
+{
+  stat_reg_counter(sdb, "dram.reads", "total number of DRAM reads",
+		   &dram->reads, 0, NULL);
+  stat_reg_counter(sdb, "dram.writes", "total number of DRAM writes",
+		   &dram->writes, 0, NULL);
+  stat_reg_counter(sdb, "dram.row_hits", "accesses to the open row",
+		   &dram->row_hits, 0, NULL);
+  stat_reg_counter(sdb, "dram.row_empty", "accesses to a precharged bank",
+		   &dram->row_empty, 0, NULL);
+  stat_reg_counter(sdb, "dram.row_conflicts",
+		   "accesses to a bank with another row open (bank conflicts)",
+		   &dram->row_conflicts, 0, NULL);
+  stat_reg_formula(sdb, "dram.row_hit_rate",
+		   "row buffer hit rate (i.e., row hits/access)",
+		   "dram.row_hits / (dram.reads + dram.writes)", NULL);
+  stat_reg_counter(sdb, "dram.queue_delay",
+		   "total cycles requests waited to start",
+		   &dram->queue_delay, 0, NULL);
+  stat_reg_formula(sdb, "dram.avg_queue_delay",
+		   "average cycles a request waited to start",
+		   "dram.queue_delay / (dram.reads + dram.writes)", NULL);
+  stat_reg_counter(sdb, "dram.queue_full",
+		   "requests arriving at a full queue",
+		   &dram->queue_full, 0, NULL);
+}
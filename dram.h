@@ -0,0 +1,205 @@
+/* dram.h - DRAM controller timing model interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+/*
+ * This module models the main memory behind the last cache level as a DRAM
+ * system of CHANNELS independent channels, each with RANKS ranks of BANKS
+ * banks.  A block address is mapped, from the least significant bit up, to
+ * its column in a row of ROW_SIZE bytes, its channel, bank, rank and row.
+ * Every bank has a row buffer, which is left open after an access (open
+ * page policy) or precharged right after it (closed page policy).  An
+ * access to the open row needs only a column access (tCAS), one to a
+ * precharged bank also activates the row (tRCD), and one to another row
+ * first precharges the bank (tRP), a bank conflict.  The data burst of an
+ * access then holds the channel data bus for BEAT cycles per BUS_WIDTH
+ * bytes transferred.
+ *
+ * Each channel controller holds up to QUEUE_SIZE requests and schedules
+ * them first-ready, first-come-first-served (FR-FCFS): of the requests
+ * whose bank can take a command, accesses to open rows go first, oldest
+ * first, then the oldest of the others.  One request is started per cycle.
+ * A request arriving at a full queue waits until the oldest request issues.
+ *
+ * The latency of a read is fixed when it arrives, by scheduling the queue
+ * ahead as if no other requests arrived.  A later row hit scheduled before
+ * it under FR-FCFS delays the banks and bus for the requests after it, but
+ * not the latency already returned.  All times are in CPU cycles.
+ */
+
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+
+/* DRAM page (row buffer) policies */
+enum dram_policy {
+  DRAM_OpenPage,			/* keep the row open after an access */
+  DRAM_ClosedPage			/* precharge the bank after an access */
+};
+
+/* DRAM bank state */
+struct dram_bank_t
+{
+  int row_open;				/* is a row held in the row buffer? */
+  md_addr_t row;			/* the open row, if ROW_OPEN */
+  tick_t ready;				/* time the bank takes a command */
+};
+
+/* DRAM request, waiting in a channel queue */
+struct dram_req_t
+{
+  enum mem_cmd cmd;			/* Read or Write */
+  int bank;				/* bank in channel, RANK*BANKS + BANK */
+  md_addr_t row;			/* row accessed */
+  int burst;				/* data bus cycles of the access */
+  tick_t arrive;			/* time the request entered the queue */
+  counter_t seq;			/* request sequence number */
+};
+
+/* DRAM channel and its controller */
+struct dram_channel_t
+{
+  struct dram_bank_t *banks;		/* RANKS*BANKS banks of the channel */
+  struct dram_req_t *queue;		/* requests, in order of arrival */
+  int nqueued;				/* requests in the queue */
+  tick_t bus_free;			/* time the data bus is free */
+  tick_t next_issue;			/* earliest time of the next start */
+};
+
+/* DRAM system definition */
+struct dram_t
+{
+  /* parameters */
+  int channels;				/* number of channels */
+  int ranks;				/* ranks per channel */
+  int banks;				/* banks per rank */
+  int row_size;				/* bytes per row */
+  enum dram_policy policy;		/* row buffer policy */
+  int t_rcd;				/* activate to column access */
+  int t_rp;				/* precharge to activate */
+  int t_cas;				/* column access to data */
+  int bus_width;			/* data bus width in bytes */
+  int beat;				/* data bus cycles per bus width */
+  int queue_size;			/* requests queued per channel */
+
+  /* derived data, for fast decoding */
+  int col_shift;			/* log2 of ROW_SIZE */
+  int chan_shift;			/* log2 of CHANNELS */
+  int bank_shift;			/* log2 of BANKS */
+  int rank_shift;			/* log2 of RANKS */
+
+  struct dram_channel_t *chans;		/* the channels */
+  struct dram_channel_t ahead;		/* scratch channel, to schedule ahead */
+  counter_t seq;			/* sequence number of the next request */
+
+  /* stats, of the requests started */
+  counter_t reads;			/* read requests */
+  counter_t writes;			/* write requests */
+  counter_t row_hits;			/* accesses to the open row */
+  counter_t row_empty;			/* accesses to a precharged bank */
+  counter_t row_conflicts;		/* accesses to a bank with another row
+					   open, i.e., bank conflicts */
+  counter_t queue_delay;		/* cycles from arrival to start */
+  counter_t queue_full;			/* requests arriving at a full queue */
+};
+
+/* create a DRAM system of CHANNELS channels of RANKS ranks of BANKS banks,
+   with ROW_SIZE byte rows managed with POLICY, timing T_RCD, T_RP and T_CAS,
+   a BUS_WIDTH byte data bus taking BEAT cycles per transfer and QUEUE_SIZE
+   requests per channel */
+struct dram_t *				/* pointer to DRAM system created */
+dram_create(int channels,		/* number of channels */
+	    int ranks,			/* ranks per channel */
+	    int banks,			/* banks per rank */
+	    int row_size,		/* bytes per row */
+	    enum dram_policy policy,	/* row buffer policy */
+	    int t_rcd,			/* activate to column access */
+	    int t_rp,			/* precharge to activate */
+	    int t_cas,			/* column access to data */
+	    int bus_width,		/* data bus width in bytes */
+	    int beat,			/* data bus cycles per transfer */
+	    int queue_size);		/* requests queued per channel */
+
+/* parse a DRAM page policy from character C, 'o' or 'c' */
+enum dram_policy			/* DRAM page policy */
+dram_char2policy(char c);		/* policy char */
+
+/* access NBYTES at ADDR in DRAM system DRAM with CMD at NOW, returns the
+   latency of the access, the time until its data burst completes; writes
+   are queued and return immediately, as if written to a write buffer */
+unsigned int				/* latency of access in cycles */
+dram_access(struct dram_t *dram,	/* DRAM system to access */
+	    enum mem_cmd cmd,		/* Read or Write */
+	    md_addr_t addr,		/* address of access */
+	    int nbytes,			/* number of bytes to access */
+	    tick_t now);		/* time of access */
+
+/* start all queued requests at once, then make the banks and buses free,
+   as when no timing is modeled; the open rows are kept */
+void
+dram_flush(struct dram_t *dram);	/* DRAM system to flush */
+
+/* print DRAM system configuration */
+void
+dram_config(struct dram_t *dram,	/* DRAM system instance */
+	    FILE *stream);		/* output stream */
+
+/* register DRAM system stats */
+void
+dram_reg_stats(struct dram_t *dram,	/* DRAM system instance */
+	       struct stat_sdb_t *sdb);	/* stats database */
+
+#endif /* DRAM_H */
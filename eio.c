@@ -213,6 +213,7 @@ eio_write_chkpt(struct regs_t *regs,		/* regs to dump */
   int i;
   struct exo_term_t *exo;
   struct mem_pte_t *pte;
+  md_addr_t addr;
 
   myfprintf(fd, "/* ** start checkpoint @ %n... */\n\n", eio_trans_icnt);
 
@@ -296,6 +297,17 @@ eio_write_chkpt(struct regs_t *regs,		/* regs to dump */
       fprintf(fd, "\n\n");
       exo_delete(exo);
     }
+  MEM_FLAT_FORALL(mem, addr)
+    {
+      /* dump this page... */
+      exo = exo_new(ec_list,
+		    exo_new(ec_address, (exo_integer_t)addr),
+		    exo_new(ec_blob, MD_PAGE_SIZE, mem->flat + addr),
+		    NULL);
+      exo_print(exo, fd);
+      fprintf(fd, "\n\n");
+      exo_delete(exo);
+    }
 
   myfprintf(fd, "/* ** end checkpoint @ %n... */\n\n", eio_trans_icnt);
 
@@ -1066,6 +1066,227 @@ expr(struct eval_state_t *es)		/* expression evaluator */
   return val;
 }
 
+/* allocate an expression tree node */
+static struct eval_node_t *		/* new node */
+node_new(enum eval_token_t op,		/* node operator */
+	 struct eval_node_t *left,	/* left operand */
+	 struct eval_node_t *right)	/* right operand */
+{
+  struct eval_node_t *node;
+
+  node = calloc(1, sizeof(struct eval_node_t));
+  if (!node)
+    fatal("out of virtual memory");
+
+  node->op = op;
+  node->left = left;
+  node->right = right;
+
+  return node;
+}
+
+/* forward declaration */
+static struct eval_node_t *parse_expr(struct eval_state_t *es);
+
+/* parse an expression factor, returns NULL and sets eval_err on errors */
+static struct eval_node_t *		/* parsed factor */
+parse_factor(struct eval_state_t *es)	/* expression evaluator */
+{
+  enum eval_token_t tok;
+  struct eval_node_t *node;
+
+  tok = peek_next_token(es);
+  switch (tok)
+    {
+    case tok_oparen:
+      (void)get_next_token(es);
+      node = parse_expr(es);
+      if (eval_error)
+	return NULL;
+
+      tok = peek_next_token(es);
+      if (tok != tok_cparen)
+	{
+	  eval_tree_delete(node);
+	  eval_error = ERR_UPAREN;
+	  return NULL;
+	}
+      (void)get_next_token(es);
+      break;
+
+    case tok_minus:
+      /* negation operator */
+      (void)get_next_token(es);
+      node = parse_factor(es);
+      if (eval_error)
+	return NULL;
+      node = node_new(tok_minus, node, NULL);
+      break;
+
+    case tok_ident:
+      (void)get_next_token(es);
+      /* identifiers are evaluated, and bound, by eval_tree() */
+      node = node_new(tok_ident, NULL, NULL);
+      node->ident = mystrdup(es->tok_buf);
+      break;
+
+    case tok_const:
+      (void)get_next_token(es);
+      /* constants are converted once, here */
+      node = node_new(tok_const, NULL, NULL);
+      node->val = constant(es);
+      if (eval_error)
+	{
+	  eval_tree_delete(node);
+	  return NULL;
+	}
+      break;
+
+    default:
+      eval_error = ERR_NOTERM;
+      return NULL;
+    }
+
+  return node;
+}
+
+/* parse an expression term, returns NULL and sets eval_err on errors */
+static struct eval_node_t *		/* parsed term */
+parse_term(struct eval_state_t *es)	/* expression evaluator */
+{
+  enum eval_token_t tok;
+  struct eval_node_t *node, *node1;
+
+  node = parse_factor(es);
+  if (eval_error)
+    return NULL;
+
+  tok = peek_next_token(es);
+  switch (tok)
+    {
+    case tok_mult:
+    case tok_div:
+      (void)get_next_token(es);
+      node1 = parse_term(es);
+      if (eval_error)
+	{
+	  eval_tree_delete(node);
+	  return NULL;
+	}
+      node = node_new(tok, node, node1);
+      break;
+
+    default:;
+    }
+
+  return node;
+}
+
+/* parse an expression, returns NULL and sets eval_err on errors */
+static struct eval_node_t *		/* parsed expression */
+parse_expr(struct eval_state_t *es)	/* expression evaluator */
+{
+  enum eval_token_t tok;
+  struct eval_node_t *node, *node1;
+
+  node = parse_term(es);
+  if (eval_error)
+    return NULL;
+
+  tok = peek_next_token(es);
+  switch (tok)
+    {
+    case tok_plus:
+    case tok_minus:
+      (void)get_next_token(es);
+      node1 = parse_expr(es);
+      if (eval_error)
+	{
+	  eval_tree_delete(node);
+	  return NULL;
+	}
+      node = node_new(tok, node, node1);
+      break;
+
+    default:;
+    }
+
+  return node;
+}
+
+/* evaluate expression tree NODE, eval_err will indicate it any expression
+   evaluation occurs, operands are evaluated in the order expr() does */
+static struct eval_value_t		/* value of the expression */
+tree(struct eval_state_t *es,		/* expression evaluator */
+     struct eval_node_t *node)		/* parsed expression */
+{
+  struct eval_value_t val, val1;
+
+  switch (node->op)
+    {
+    case tok_const:
+      return node->val;
+
+    case tok_ident:
+      /* evaluate the identifier, letting the evaluator bind it */
+      strcpy(es->tok_buf, node->ident);
+      es->ident_bind = &node->bind;
+      val = es->f_eval_ident(es);
+      es->ident_bind = NULL;
+      if (eval_error)
+	return err_value;
+      return val;
+
+    case tok_minus:
+      if (!node->right)
+	{
+	  /* negation operator */
+	  val = tree(es, node->left);
+	  if (eval_error)
+	    return err_value;
+	  return f_neg(val);
+	}
+      break;
+
+    default:;
+    }
+
+  /* binary operators */
+  val = tree(es, node->left);
+  if (eval_error)
+    return err_value;
+
+  switch (node->op)
+    {
+    case tok_plus:
+      val = f_add(val, tree(es, node->right));
+      break;
+    case tok_minus:
+      val = f_sub(val, tree(es, node->right));
+      break;
+    case tok_mult:
+      val = f_mult(val, tree(es, node->right));
+      break;
+    case tok_div:
+      val1 = tree(es, node->right);
+      if (eval_error)
+	return err_value;
+      if (f_eq_zero(val1))
+	{
+	  eval_error = ERR_DIV0;
+	  return err_value;
+	}
+      val = f_div(val, val1);
+      break;
+    default:
+      panic("bogus expression tree operator");
+    }
+  if (eval_error)
+    return err_value;
+
+  return val;
+}
+
 /* create an evaluator */
 struct eval_state_t *			/* expression evaluator */
 eval_new(eval_ident_t f_eval_ident,	/* user ident evaluator */
@@ -1104,6 +1325,7 @@ eval_expr(struct eval_state_t *es,	/* expression evaluator */
   es->p = p;
   *es->tok_buf = '\0';
   es->peek_tok = tok_invalid;
+  es->ident_bind = NULL;
 
   /* evaluate the expression */
   val = expr(es);
@@ -1123,6 +1345,66 @@ eval_expr(struct eval_state_t *es,	/* expression evaluator */
   return val;
 }
 
+/* parse an expression into a tree that can be evaluated repeatedly with
+   eval_tree(), returns NULL and sets eval_error if it cannot be parsed,
+   identifiers are bound on the first evaluation, not when parsed */
+struct eval_node_t *			/* parsed expression */
+eval_parse(struct eval_state_t *es,	/* expression evaluator */
+	   char *p,			/* ptr to expression string */
+	   char **endp)			/* returns ptr to 1st unused char */
+{
+  struct eval_node_t *node;
+
+  /* initialize the evaluator state */
+  eval_error = ERR_NOERR;
+  es->p = p;
+  *es->tok_buf = '\0';
+  es->peek_tok = tok_invalid;
+  es->ident_bind = NULL;
+
+  /* parse the expression */
+  node = parse_expr(es);
+
+  /* return a pointer to the first character not used in the expression */
+  if (endp)
+    {
+      if (es->peek_tok != tok_invalid)
+	{
+	  /* did not consume peek'ed token, so return last p */
+	  *endp = es->lastp;
+	}
+      else
+	*endp = es->p;
+    }
+
+  return node;
+}
+
+/* evaluate a parsed expression, the identifier evaluator may use and set
+   ES->IDENT_BIND to cache the lookup of the identifier in ES->TOK_BUF, if
+   an error occurs the global variable eval_error is set */
+struct eval_value_t			/* value of the expression */
+eval_tree(struct eval_state_t *es,	/* expression evaluator */
+	  struct eval_node_t *node)	/* parsed expression */
+{
+  eval_error = ERR_NOERR;
+  return tree(es, node);
+}
+
+/* delete a parsed expression */
+void
+eval_tree_delete(struct eval_node_t *node)/* parsed expression */
+{
+  if (!node)
+    return;
+
+  eval_tree_delete(node->left);
+  eval_tree_delete(node->right);
+  if (node->ident)
+    free(node->ident);
+  free(node);
+}
+
 /* print an expression value */
 void
 eval_print(FILE *stream,		/* output stream */
@@ -90,6 +90,8 @@ struct eval_state_t {
   void *user_ptr;		/* user-supplied argument pointer */
   char tok_buf[512];		/* text of last token returned */
   enum eval_token_t peek_tok;	/* peek buffer, for one token look-ahead */
+  void **ident_bind;		/* binding slot of the identifier in tok_buf
+				   when evaluating a parsed expression */
 };
 
 /* evaluation errors */
@@ -156,6 +158,18 @@ struct eval_value_t {
   } value;
 };
 
+/* a parsed expression node, the tree mirrors the evaluation order of
+   eval_expr(), so evaluating it returns the same value and error */
+struct eval_node_t {
+  enum eval_token_t op;			/* tok_ident, tok_const, or operator */
+  struct eval_node_t *left;		/* left operand, or negated operand */
+  struct eval_node_t *right;		/* right operand of binary operators */
+  struct eval_value_t val;		/* value of constants (tok_const) */
+  char *ident;				/* identifier name (tok_ident) */
+  void *bind;				/* user binding of the identifier, see
+					   eval_state_t.ident_bind, or NULL */
+};
+
 /*
  * expression value arithmetic conversions
  */
@@ -199,6 +213,25 @@ eval_expr(struct eval_state_t *es,	/* expression evaluator */
 	  char *p,			/* ptr to expression string */
 	  char **endp);			/* returns ptr to 1st unused char */
 
+/* parse an expression into a tree that can be evaluated repeatedly with
+   eval_tree(), returns NULL and sets eval_error if it cannot be parsed,
+   identifiers are bound on the first evaluation, not when parsed */
+struct eval_node_t *			/* parsed expression */
+eval_parse(struct eval_state_t *es,	/* expression evaluator */
+	   char *p,			/* ptr to expression string */
+	   char **endp);		/* returns ptr to 1st unused char */
+
+/* evaluate a parsed expression, the identifier evaluator may use and set
+   ES->IDENT_BIND to cache the lookup of the identifier in ES->TOK_BUF, if
+   an error occurs the global variable eval_error is set */
+struct eval_value_t			/* value of the expression */
+eval_tree(struct eval_state_t *es,	/* expression evaluator */
+	  struct eval_node_t *node);	/* parsed expression */
+
+/* delete a parsed expression */
+void
+eval_tree_delete(struct eval_node_t *node);/* parsed expression */
+
 /* print an expression value */
 void
 eval_print(FILE *stream,		/* output stream */
@@ -72,6 +72,7 @@
 #include "dlite.h"
 #include "options.h"
 #include "stats.h"
+#include "memory.h"
 #include "loader.h"
 #include "sim.h"
 
@@ -112,6 +113,10 @@ int sim_exit_now = FALSE;
 /* longjmp here when simulation is completed */
 jmp_buf sim_exit_buf;
 
+/* if non-NULL, called when the simulation completes, before the final
+   stats are printed */
+void (*sim_exit_hook)(void) = NULL;
+
 /* set to non-zero when simulator should dump statistics */
 int sim_dump_stats = FALSE;
 
@@ -215,6 +220,10 @@ sim_print_stats(FILE *fd)		/* output stream */
 static void
 exit_now(int exit_code)
 {
+  /* let the simulator finish any outstanding work */
+  if (sim_exit_hook)
+    sim_exit_hook();
+
   /* print simulation stats */
   sim_print_stats(stderr);
 
@@ -287,6 +296,9 @@ main(int argc, char **argv, char **envp)
 
   /* FIXME: add stats intervals and max insts... */
 
+  /* register memory system options */
+  mem_reg_options(sim_odb);
+
   /* register all simulator-specific options */
   sim_reg_options(sim_odb);
 
@@ -51,6 +51,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/mman.h>
 
 #include "host.h"
 #include "misc.h"
@@ -60,6 +62,50 @@
 #include "memory.h"
 
 
+/* use a flat address space window for new memory spaces, if possible */
+int mem_flat;
+
+/* register memory system-specific options */
+void
+mem_reg_options(struct opt_odb_t *odb)	/* options database */
+{
+  opt_reg_flag(odb, "-mem:flat",
+	       "map low guest memory to a sparse host region by offset",
+	       &mem_flat, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+}
+
+/* reserve the flat address space window for memory space MEM, leaves
+   MEM->FLAT set to NULL if the host cannot provide the reservation */
+static void
+mem_flat_create(struct mem_t *mem)	/* memory space to reserve for */
+{
+#if defined(HOST_HAS_QWORD) && defined(MAP_ANONYMOUS) && defined(MAP_NORESERVE)
+  void *p;
+
+  /* host pointers must be able to span the window */
+  if (sizeof(void *) < sizeof(qword_t))
+    return;
+
+  /* reserve the window, host pages are only committed when touched and read
+     as zero until written, which matches unallocated page semantics */
+  p = mmap(NULL, (size_t)1 << MEM_LOG_FLAT_SIZE, PROT_READ|PROT_WRITE,
+	   MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED)
+    {
+      warn("could not reserve flat window for `%s', using page table",
+	   mem->name);
+      return;
+    }
+
+  mem->flat_pages = calloc((size_t)1 << (MEM_LOG_FLAT_SIZE-MD_LOG_PAGE_SIZE),
+			   sizeof(byte_t));
+  if (!mem->flat_pages)
+    fatal("out of virtual memory");
+  mem->flat = p;
+#endif
+}
+
 /* create a flat memory space */
 struct mem_t *
 mem_create(char *name)			/* name of the memory space */
@@ -71,6 +117,10 @@ mem_create(char *name)			/* name of the memory space */
     fatal("out of virtual memory");
 
   mem->name = mystrdup(name);
+
+  if (mem_flat)
+    mem_flat_create(mem);
+
   return mem;
 }
 
@@ -114,6 +164,14 @@ mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
   byte_t *page;
   struct mem_pte_t *pte;
 
+  if (MEM_IN_FLAT(mem, addr))
+    {
+      /* host page is already reserved, just mark it allocated */
+      mem->flat_pages[MEM_FLAT_IDX(addr)] = 1;
+      mem->page_count++;
+      return;
+    }
+
   /* see misc.c for details on the getcore() function */
   page = getcore(MD_PAGE_SIZE);
   if (!page)
@@ -234,6 +292,10 @@ mem_reg_stats(struct mem_t *mem,	/* memory space to declare */
   stat_reg_formula(sdb, buf, "total size of memory pages allocated",
 		   buf1, "%11.0fk");
 
+  /* page table stats are only meaningful without a flat window */
+  if (mem->flat)
+    return;
+
   sprintf(buf, "%s.ptab_misses", mem->name);
   stat_reg_counter(sdb, buf, "total first level page table misses",
 		   &mem->ptab_misses, mem->ptab_misses, NULL);
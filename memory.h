@@ -64,6 +64,15 @@
 #define MEM_PTAB_SIZE		(32*1024)
 #define MEM_LOG_PTAB_SIZE	15
 
+/* size of the flat address space window: guest addresses below
+   2^MEM_LOG_FLAT_SIZE are mapped to a sparse host region by a simple offset,
+   rather than through the page table, if the flat window is enabled */
+#if defined(TARGET_ALPHA)
+#define MEM_LOG_FLAT_SIZE	34
+#else
+#define MEM_LOG_FLAT_SIZE	32
+#endif
+
 /* page table entry */
 struct mem_pte_t {
   struct mem_pte_t *next;	/* next translation in this bucket */
@@ -76,6 +85,8 @@ struct mem_t {
   /* memory object state */
   char *name;				/* name of this memory space */
   struct mem_pte_t *ptab[MEM_PTAB_SIZE];/* inverted page table */
+  byte_t *flat;				/* flat window, NULL if not used */
+  byte_t *flat_pages;			/* allocated flag for window pages */
 
   /* memory object stats */
   counter_t page_count;			/* total number of pages allocated */
@@ -83,6 +94,9 @@ struct mem_t {
   counter_t ptab_accesses;		/* total page table accesses */
 };
 
+/* use a flat address space window for new memory spaces, if possible */
+extern int mem_flat;
+
 /* memory access command */
 enum mem_cmd {
   Read,			/* read memory from target (simulated prog) to host */
@@ -102,6 +116,24 @@ typedef enum md_fault_type
  * virtual to host page translation macros
  */
 
+/* is virtual address ADDR within the flat window of memory space MEM? */
+#ifdef HOST_HAS_QWORD
+#define MEM_IN_FLAT(MEM, ADDR)						\
+  ((MEM)->flat && !((qword_t)(ADDR) >> MEM_LOG_FLAT_SIZE))
+#else /* !HOST_HAS_QWORD */
+#define MEM_IN_FLAT(MEM, ADDR)		(0)
+#endif /* HOST_HAS_QWORD */
+
+/* compute flat window page index */
+#define MEM_FLAT_IDX(ADDR)	((ADDR) >> MD_LOG_PAGE_SIZE)
+
+/* locate host page for virtual address ADDR in the flat window, returns NULL
+   if unallocated */
+#define MEM_FLAT_PAGE(MEM, ADDR)					\
+  ((MEM)->flat_pages[MEM_FLAT_IDX(ADDR)]				\
+   ? (MEM)->flat + ((ADDR) & ~((md_addr_t)MD_PAGE_SIZE - 1))		\
+   : NULL)
+
 /* compute page table set */
 #define MEM_PTAB_SET(ADDR)						\
   (((ADDR) >> MD_LOG_PAGE_SIZE) & (MEM_PTAB_SIZE - 1))
@@ -117,7 +149,10 @@ typedef enum md_fault_type
 
 /* locate host page for virtual address ADDR, returns NULL if unallocated */
 #define MEM_PAGE(MEM, ADDR)						\
-  (/* first attempt to hit in first entry, otherwise call xlation fn */	\
+  (MEM_IN_FLAT(MEM, ADDR)						\
+   ? (/* in flat window, no translation needed */			\
+      MEM_FLAT_PAGE(MEM, ADDR))						\
+   : /* first attempt to hit in first entry, otherwise call xlation fn */\
    ((MEM)->ptab[MEM_PTAB_SET(ADDR)]					\
     && (MEM)->ptab[MEM_PTAB_SET(ADDR)]->tag == MEM_PTAB_TAG(ADDR))	\
    ? (/* hit - return the page address on host */			\
@@ -136,20 +171,30 @@ typedef enum md_fault_type
       mem_newpage(MEM, ADDR))						\
    : (/* nada... */ (void)0))
 
-/* memory page iterator */
+/* memory page iterator, page table pages only */
 #define MEM_FORALL(MEM, ITER, PTE)					\
   for ((ITER)=0; (ITER) < MEM_PTAB_SIZE; (ITER)++)			\
     for ((PTE)=(MEM)->ptab[i]; (PTE) != NULL; (PTE)=(PTE)->next)
 
+/* flat window page iterator, visits the address of each allocated page */
+#define MEM_FLAT_FORALL(MEM, ADDR)					\
+  for ((ADDR)=0;							\
+       (MEM)->flat && MEM_IN_FLAT(MEM, ADDR);				\
+       (ADDR) += MD_PAGE_SIZE)						\
+    if ((MEM)->flat_pages[MEM_FLAT_IDX(ADDR)])
+
 
 /*
  * memory accessors macros, fast but difficult to debug...
  */
 
-/* safe version, works only with scalar types */
+/* safe version, works only with scalar types, NOTE: unallocated pages in
+   the flat window read as zero */
 /* FIXME: write a more efficient GNU C expression for this... */
 #define MEM_READ(MEM, ADDR, TYPE)					\
-  (MEM_PAGE(MEM, (md_addr_t)(ADDR))					\
+  (MEM_IN_FLAT(MEM, (md_addr_t)(ADDR))					\
+   ? *((TYPE *)((MEM)->flat + (md_addr_t)(ADDR)))			\
+   : MEM_PAGE(MEM, (md_addr_t)(ADDR))					\
    ? *((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR)))	\
    : /* page not yet allocated, return zero value */ 0)
 
@@ -160,8 +205,14 @@ typedef enum md_fault_type
 /* safe version, works only with scalar types */
 /* FIXME: write a more efficient GNU C expression for this... */
 #define MEM_WRITE(MEM, ADDR, TYPE, VAL)					\
-  (MEM_TICKLE(MEM, (md_addr_t)(ADDR)),					\
-   *((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))) = (VAL))
+  (MEM_IN_FLAT(MEM, (md_addr_t)(ADDR))					\
+   ? ((!(MEM)->flat_pages[MEM_FLAT_IDX((md_addr_t)(ADDR))]		\
+       ? mem_newpage(MEM, (md_addr_t)(ADDR))				\
+       : (void)0),							\
+      *((TYPE *)((MEM)->flat + (md_addr_t)(ADDR))) = (VAL))		\
+   : (MEM_TICKLE(MEM, (md_addr_t)(ADDR)),				\
+      *((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR)))	\
+      = (VAL)))
       
 /* unsafe version, works with any type */
 #define __UNCHK_MEM_WRITE(MEM, ADDR, TYPE, VAL)				\
@@ -204,6 +255,10 @@ typedef enum md_fault_type
 #endif /* HOST_HAS_QWORD */
 
 
+/* register memory system-specific options */
+void
+mem_reg_options(struct opt_odb_t *odb);	/* options database */
+
 /* create a flat memory space */
 struct mem_t *
 mem_create(char *name);			/* name of the memory space */
@@ -6,7 +6,6 @@
 #include "machine.h" /* for enum md_opcode */
 #include "cache.h"
 
-struct mshr_t *mshr = NULL;
 /*
 * MSHR macros
 * simplescalar simulator goals to be faster, so we define some macros to speed up the code
@@ -30,6 +29,9 @@ struct mshr_t *mshr = NULL;
 /* check if the entry is valid */
 #define MSHR_ENTRY_IS_VALID(mshr, entry) \
   ((entry)->status & MSHR_ENTRY_VALID)
+/* get the hash bucket of a block address */
+#define MSHR_HASH(mshr, block_addr) \
+  (((block_addr) >> (mshr)->blk_shift) & ((mshr)->hsize - 1))
 
 
 /* create mshr */
@@ -40,6 +42,8 @@ mshr_create(
   int nblks /* number of blocks for each entry */
 )
 {
+  struct mshr_t *mshr;
+
   mshr = (struct mshr_t *)
     calloc(1, sizeof(struct mshr_t));
   if(!mshr)
@@ -56,8 +60,6 @@ mshr_create(
   // 수정: 블록 마스크와 블록 시프트를 캐시와 동일하게 설정 
   mshr->blk_mask = bsize - 1;
   mshr->blk_shift = log_base2(bsize);
-  // printf("bsize = %d\n", bsize);
-  // printf("mshr->blk_mask: %d, mshr->blk_shift: %d\n", mshr->blk_mask, mshr->blk_shift); 
 
   /* allocate entries */
   mshr->entries = (struct mshr_entry_t *)
@@ -73,20 +75,22 @@ mshr_create(
       fatal("out of virtual memory");
   }
 
-  /* initialize entries */
-  for(int i = 0; i < nentries; i++) {
-    mshr->entries[i].status = 0; 
-    mshr->entries[i].block_addr = 0;
-    mshr->entries[i].nvalid = 0;
-  } 
+  /* at least two buckets per entry, so chains stay short */
+  for(mshr->hsize = 1; mshr->hsize < 2 * nentries; mshr->hsize <<= 1)
+    /* nada */;
+  mshr->hash = (struct mshr_entry_t **)
+    calloc(mshr->hsize, sizeof(struct mshr_entry_t *));
+  if(!mshr->hash)
+    fatal("out of virtual memory");
 
-  /* initialize blocks */
-  for(int i = 0; i < nentries; i++) {
-    for(int j = 0; j < nblks; j++) {
-      mshr->entries[i].blk[j].status = 0;
-      mshr->entries[i].blk[j].offset = 0;
-    }
-  } 
+  /* all entries start out free, allocated in index order */
+  mshr->free_list = NULL;
+  for(int i = nentries - 1; i >= 0; i--) {
+    mshr->entries[i].status = 0;
+    mshr->entries[i].next = mshr->free_list;
+    mshr->free_list = &mshr->entries[i];
+  }
+  mshr->busy_list = NULL;
 
   return mshr;
 }
@@ -94,27 +98,18 @@ mshr_create(
 /* lookup mshr
  * returns valid entry if found, otherwise returns NULL
  */
-/* 시간 체크가 필요함
-   now ? mshr->now + mem_latency
-   여부로 pending인지 ready인지 판단 가능
-*/
 struct mshr_entry_t *
 mshr_lookup(
   struct mshr_t *mshr,
   md_addr_t addr /* address */
 )
 { 
-  /* if mshr is full, return NULL */
-  if(MSHR_IS_FULL(mshr)) {
-    return NULL;
-  }
-  
   md_addr_t block_addr = MSHR_BLK_ADDR(mshr, addr);
   
   struct mshr_entry_t *entry = NULL;
 
-  for(entry = mshr->entries; entry != mshr->entries + mshr->nentries; entry++) {
-    if(entry->status & MSHR_ENTRY_VALID && entry->block_addr == block_addr) {
+  for(entry = mshr->hash[MSHR_HASH(mshr, block_addr)]; entry; entry = entry->hash_next) {
+    if(entry->block_addr == block_addr) {
       return entry;
     }
   }
@@ -138,20 +133,34 @@ mshr_insert(
   if(entry && entry->status & MSHR_ENTRY_FULL) 
     return NULL; // 모든 entry가 유효함(stall 해야 하는 상황)
   if(!entry) {
-    /* 새 entry 할당 */
-    for(entry = mshr->entries; entry != mshr->entries + mshr->nentries; entry++) {
-      if(!(entry->status & MSHR_ENTRY_VALID)) {
-        entry->nvalid = 0;
-        entry->status |= MSHR_ENTRY_VALID;  
-        entry->block_addr = MSHR_BLK_ADDR(mshr, addr);  
-        mshr->nvalid++;
-        break;
-      }
-    }
-  }
-
-  if(entry == NULL) {
-    return NULL; // 모든 entry가 유효함(stall 해야 하는 상황)
+    /* all entries are in use */
+    if(MSHR_IS_FULL(mshr))
+      return NULL;
+
+    /* 새 entry 할당, from the free list */
+    entry = mshr->free_list;
+    mshr->free_list = entry->next;
+
+    entry->nvalid = 0;
+    entry->status = MSHR_ENTRY_VALID;  
+    entry->block_addr = MSHR_BLK_ADDR(mshr, addr);  
+    entry->completed_time = now;
+    mshr->nvalid++;
+
+    /* the caller sets the completion time, rescan at the next update */
+    if(!mshr->next_ready || now < mshr->next_ready)
+      mshr->next_ready = now;
+
+    /* link into the hash bucket of its block and the busy list */
+    unsigned int index = MSHR_HASH(mshr, entry->block_addr);
+    entry->hash_next = mshr->hash[index];
+    mshr->hash[index] = entry;
+
+    entry->prev = NULL;
+    entry->next = mshr->busy_list;
+    if(mshr->busy_list)
+      mshr->busy_list->prev = entry;
+    mshr->busy_list = entry;
   }
 
   /* 블록 추가 */
@@ -180,14 +189,111 @@ mshr_free_entry(
   }
   
   entry->nvalid = 0;
-  entry->status &= ~MSHR_ENTRY_VALID; // clear the valid status
+  entry->status = 0; // clear the valid, full and prefetch status
   mshr->nvalid--;
+
+  /* unlink from the hash bucket chain */
+  struct mshr_entry_t **link = &mshr->hash[MSHR_HASH(mshr, entry->block_addr)];
+  while(*link != entry)
+    link = &(*link)->hash_next;
+  *link = entry->hash_next;
+  entry->hash_next = NULL;
+
+  /* move from the busy list to the free list */
+  if(entry->prev)
+    entry->prev->next = entry->next;
+  else
+    mshr->busy_list = entry->next;
+  if(entry->next)
+    entry->next->prev = entry->prev;
+  entry->prev = NULL;
+  entry->next = mshr->free_list;
+  mshr->free_list = entry;
 }
 
+/* can an access to ADDR not be tracked, because it would need a new entry
+   and all are in use, or it would merge into an entry with no free block? */
+int
+mshr_blocked(
+  struct mshr_t *mshr,
+  md_addr_t addr
+)
+{
+  struct mshr_entry_t *entry = mshr_lookup(mshr, addr);
 
-/* memory request send function */
-/* TODO: latency를 여기서 처리할게 아니라
- * cache_access에서 mshr에 등록할때 병합대상의 남은 시간만큼을 리턴해야할듯? */
+  if(entry)
+    return (entry->status & MSHR_ENTRY_FULL) != 0;
+  return MSHR_IS_FULL(mshr);
+}
+
+/* time the next valid entry completes, returns FALSE if there is none */
+int
+mshr_next_ready(
+  struct mshr_t *mshr,
+  tick_t *when
+)
+{
+  struct mshr_entry_t *entry;
+  int found = FALSE;
+
+  if (MSHR_IS_EMPTY(mshr))
+    return FALSE;
+
+  for (entry = mshr->busy_list; entry; entry = entry->next) {
+    if (!found || entry->completed_time < *when) {
+      *when = entry->completed_time;
+      found = TRUE;
+    }
+  }
+  return found;
+}
+
+/* free all entries, their misses complete immediately */
+void
+mshr_flush(struct mshr_t *mshr)
+{
+  while (mshr->busy_list)
+    mshr_free_entry(mshr, mshr->busy_list);
+}
+
+/* register mshr stats, with names prefixed by NAME */
+void
+mshr_reg_stats(
+  struct mshr_t *mshr,
+  char *name,
+  struct stat_sdb_t *sdb
+)
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.accesses", name);
+  stat_reg_counter(sdb, buf, "total number of misses presented to the MSHR",
+                   &mshr->accesses, 0, NULL);
+  sprintf(buf, "%s.hits", name);
+  stat_reg_counter(sdb, buf, "misses to a block with an outstanding miss",
+                   &mshr->hits, 0, NULL);
+  sprintf(buf, "%s.merges", name);
+  stat_reg_counter(sdb, buf, "secondary misses coalesced into an entry",
+                   &mshr->merges, 0, NULL);
+  sprintf(buf, "%s.misses", name);
+  stat_reg_counter(sdb, buf, "primary misses, entries allocated",
+                   &mshr->misses, 0, NULL);
+  sprintf(buf, "%s.full", name);
+  stat_reg_counter(sdb, buf, "misses not tracked, no entry or block free",
+                   &mshr->full, 0, NULL);
+  sprintf(buf, "%s.full_stalls", name);
+  stat_reg_counter(sdb, buf, "accesses replayed while the MSHR was full",
+                   &mshr->stalls, 0, NULL);
+  sprintf(buf, "%s.miss_rate", name);
+  sprintf(buf1, "%s.misses / %s.accesses", name, name);
+  stat_reg_formula(sdb, buf, "MSHR miss rate (i.e., primary misses/ref)",
+                   buf1, NULL);
+  sprintf(buf, "%s.occupancy", name);
+  mshr->occupancy =
+    stat_reg_dist(sdb, buf, "valid entries, sampled every cycle",
+                  /* initial value */0, /* array size */mshr->nentries + 1,
+                  /* bucket size */1, (PF_COUNT|PF_PDF), NULL, NULL, NULL);
+}
 
 void
 mshr_dump(struct mshr_t *mshr, FILE *stream)
@@ -227,21 +333,30 @@ mshr_dump(struct mshr_t *mshr, FILE *stream)
 }
 
 // 이 함수를 global time이 업데이트 될때마다 호출
+/* free the entries whose misses have completed by NOW, after sampling the
+   occupancy of the cycles since the last update */
 void
 mshr_update(struct mshr_t* mshr, tick_t now) {
-  /* if mshr is empty, return */
-  if (MSHR_IS_EMPTY(mshr)) {
+  if (mshr->occupancy && now > mshr->last_sample) {
+    stat_add_samples(mshr->occupancy, mshr->nvalid,
+                     (int)(now - mshr->last_sample));
+    mshr->last_sample = now;
+  }
+
+  /* if mshr is empty, or nothing completes yet, return */
+  if (MSHR_IS_EMPTY(mshr) || now < mshr->next_ready) {
     return;
   }
 
-  struct mshr_entry_t* entry; // using for loop
+  struct mshr_entry_t *entry, *next; // using for loop
 
-  /* check if the entry is ready */
-  for (entry = mshr->entries; entry != mshr->entries + mshr->nentries; entry++) {
-    /* 각 엔트리, 블럭을 순회하며 now와 requested_time + mem_latancy(mshr_send_request)
-     * 와 비교하여 status 업데이트 */
-    for(int i = 0; i < entry->nvalid; i++) {
-      
-    }
+  /* free the completed entries, find the next to complete */
+  mshr->next_ready = 0;
+  for (entry = mshr->busy_list; entry; entry = next) {
+    next = entry->next;
+    if (entry->completed_time <= now)
+      mshr_free_entry(mshr, entry);
+    else if (!mshr->next_ready || entry->completed_time < mshr->next_ready)
+      mshr->next_ready = entry->completed_time;
   }
-}
\ No newline at end of file
+}
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include "machine.h"
 #include "memory.h"
+#include "stats.h"
 
 /* forward declarations */
 struct RUU_station;
@@ -36,12 +37,16 @@ struct mshr_entry_t {
   unsigned int status; /* mshr entry status(valid, dirty)  */
   md_addr_t block_addr; /* block address */
   int nvalid; /* number of valid blocks */
-  int completed_time;
+  tick_t completed_time; /* time the miss is filled and the entry freed */
   int lat; /* latency */
+  struct mshr_entry_t *hash_next; /* next entry in the hash bucket chain */
+  struct mshr_entry_t *next; /* next entry in the free or busy list */
+  struct mshr_entry_t *prev; /* previous entry in the busy list */
 };
 
 /* MSHR structure */
 struct mshr_t {
+  char *name; /* MSHR file name, prefixes its stats */
   struct mshr_entry_t *entries; /* MSHR entries */
   int nentries; /* number of entries */ 
   int nblks; /* number of blocks for each entry */
@@ -52,6 +57,13 @@ struct mshr_t {
   int blk_mask; /* block mask */
   int blk_shift; /* block shift */
 
+  /* block address lookup, free entries and outstanding misses */
+  struct mshr_entry_t **hash; /* hash table of valid entries, by block */
+  int hsize; /* number of hash buckets, a power of two */
+  struct mshr_entry_t *free_list; /* free entries, singly linked */
+  struct mshr_entry_t *busy_list; /* valid entries, doubly linked */
+  tick_t next_ready; /* earliest completed_time of the valid entries */
+
   /* memory access function */
   struct cache_t *cache;  /* associated cache */
   unsigned int mem_lat;
@@ -61,6 +73,10 @@ struct mshr_t {
   counter_t hits;        /* total number of hits */
   counter_t misses;      /* total number of misses */
   counter_t full;        /* number of times MSHR was full */
+  counter_t merges;      /* secondary misses recorded in an entry */
+  counter_t stalls;      /* accesses stalled because MSHR was full */
+  struct stat_stat_t *occupancy; /* valid entries, sampled every cycle */
+  tick_t last_sample;    /* cycle up to which occupancy is sampled */
 };
 
 /* create mshr*/
@@ -86,27 +102,37 @@ mshr_insert(
   tick_t now
 );
 
-/* memory request send function */
-unsigned int 
-mshr_send_request(
+void 
+mshr_free_entry( 
   struct mshr_t *mshr, 
-  struct mshr_entry_t *entry, 
-  tick_t now
+  struct mshr_entry_t *entry
 );
 
-/* memory request complete function */
-void
-mshr_complete_request(
-  struct mshr_t *mshr, 
-  struct mshr_entry_t *entry, 
-  byte_t *data, 
-  tick_t now
+/* can an access to ADDR not be tracked, because it would need a new entry
+   and all are in use, or it would merge into an entry with no free block? */
+int
+mshr_blocked(
+  struct mshr_t *mshr,
+  md_addr_t addr
 );
 
-void 
-mshr_free_entry( 
-  struct mshr_t *mshr, 
-  struct mshr_entry_t *entry
+/* time the next valid entry completes, returns FALSE if there is none */
+int
+mshr_next_ready(
+  struct mshr_t *mshr,
+  tick_t *when
+);
+
+/* free all entries, their misses complete immediately */
+void
+mshr_flush(struct mshr_t *mshr);
+
+/* register mshr stats, with names prefixed by NAME */
+void
+mshr_reg_stats(
+  struct mshr_t *mshr,
+  char *name,
+  struct stat_sdb_t *sdb
 );
 
 /* mshr dump function */
@@ -117,6 +143,7 @@ mshr_dump(
 );
 
 /* 매 사이클마다 status를 업데이트해줄 함수가 필요함 */
+/* free the entries whose misses have completed by NOW */
 void
 mshr_update(
   struct mshr_t* mshr,
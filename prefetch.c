@@ -0,0 +1,269 @@
+/* stackdist.c - LRU stack distance cache sweep routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "cache.h"
+#include "prefetch.h"
+
+/* create a prefetcher for a cache with BSIZE byte blocks from its
+   configuration string CONFIG, returns NULL if CONFIG is "none" */
+struct prefetch_t *			/* pointer to prefetcher created */
+prefetch_create(char *config,		/* prefetcher configuration */
+		int bsize)		/* block size of its cache */
+{
+  struct prefetch_t *pf;
+  enum prefetch_kind kind;
+  int nentries = 0, degree;
+
+  if (!mystricmp(config, "none"))
+    return NULL;
+
+  /* parse the configuration string */
+  if (sscanf(config, "nextline:%d", &degree) == 1)
+    kind = PF_NextLine;
+  else if (sscanf(config, "stride:%d:%d", &nentries, &degree) == 2)
+    kind = PF_Stride;
+  else if (sscanf(config, "stream:%d:%d", &nentries, &degree) == 2)
+    kind = PF_Stream;
+  else
+    fatal("bad prefetcher config `%s', expected nextline:<degree>, "
+	  "stride:<entries>:<degree> or stream:<buffers>:<depth>", config);
+
+  /* check all prefetcher parameters */
+  if (degree <= 0)
+    fatal("prefetch degree (or depth) `%d' must be positive", degree);
+  if (kind == PF_Stride && (nentries <= 0 || (nentries & (nentries-1)) != 0))
+    fatal("stride table size `%d' must be a positive power of two",
+	  nentries);
+  if (kind == PF_Stream && nentries <= 0)
+    fatal("number of stream buffers `%d' must be positive", nentries);
+
+  pf = (struct prefetch_t *)calloc(1, sizeof(struct prefetch_t));
+  if (!pf)
+    fatal("out of virtual memory");
+
+  /* initialize user parameters */
+  pf->kind = kind;
+  pf->nentries = nentries;
+  pf->degree = degree;
+
+  /* compute derived parameters */
+  pf->blk_shift = log_base2(bsize);
+
+  /* allocate the prefetcher state, all entries unused */
+  if (kind == PF_Stride)
+    {
+      pf->rpt = (struct prefetch_rpt_t *)
+	calloc(nentries, sizeof(struct prefetch_rpt_t));
+      if (!pf->rpt)
+	fatal("out of virtual memory");
+    }
+  else if (kind == PF_Stream)
+    {
+      pf->streams = (struct prefetch_stream_t *)
+	calloc(nentries, sizeof(struct prefetch_stream_t));
+      if (!pf->streams)
+	fatal("out of virtual memory");
+    }
+  pf->stamp = 0;
+
+  return pf;
+}
+
+/* print prefetcher configuration */
+void
+prefetch_config(struct prefetch_t *pf,	/* prefetcher instance */
+		char *name,		/* name of its cache */
+		FILE *stream)		/* output stream */
+{
+  switch (pf->kind)
+    {
+    case PF_NextLine:
+      fprintf(stream, "prefetch: %s: tagged next-line, degree %d\n",
+	      name, pf->degree);
+      break;
+    case PF_Stride:
+      fprintf(stream, "prefetch: %s: per-PC stride, %d entries, degree %d\n",
+	      name, pf->nentries, pf->degree);
+      break;
+    case PF_Stream:
+      fprintf(stream, "prefetch: %s: %d stream buffers, depth %d\n",
+	      name, pf->nentries, pf->degree);
+      break;
+    default:
+      panic("bogus prefetcher kind");
+    }
+}
+
+/* train the per-PC stride table with an access by PC to ADDR */
+static void
+stride_access(struct prefetch_t *pf,	/* prefetcher instance */
+	      struct cache_t *cp,	/* cache accessed */
+	      md_addr_t pc,		/* PC of access */
+	      md_addr_t addr,		/* address of access */
+	      tick_t now)		/* time of access */
+{
+  struct prefetch_rpt_t *ent = &pf->rpt[(pc >> MD_BR_SHIFT)
+					& (pf->nentries - 1)];
+  md_addr_t stride, blk, last_blk;
+  int i;
+
+  if (!ent->valid || ent->pc != pc)
+    {
+      /* a new instruction, no stride yet */
+      ent->valid = TRUE;
+      ent->pc = pc;
+      ent->last_addr = addr;
+      ent->stride = 0;
+      ent->conf = 0;
+      return;
+    }
+
+  stride = addr - ent->last_addr;
+  ent->last_addr = addr;
+  if (stride == ent->stride)
+    {
+      if (ent->conf < 3)
+	ent->conf++;
+    }
+  else if (ent->conf > 0)
+    ent->conf--;
+  else
+    ent->stride = stride;
+
+  /* fetch the blocks of the next DEGREE strides, once confident */
+  if (ent->conf == 0 || ent->stride == 0)
+    return;
+  last_blk = addr >> pf->blk_shift;
+  for (i=1; i <= pf->degree; i++)
+    {
+      blk = (addr + i * ent->stride) >> pf->blk_shift;
+      if (blk != last_blk)
+	cache_prefetch(cp, blk << pf->blk_shift, now);
+      last_blk = blk;
+    }
+}
+
+/* train the stream buffers with an access to block BLK */
+static void
+stream_access(struct prefetch_t *pf,	/* prefetcher instance */
+	      struct cache_t *cp,	/* cache accessed */
+	      md_addr_t blk,		/* block accessed */
+	      int miss,			/* did the access miss? */
+	      tick_t now)		/* time of access */
+{
+  struct prefetch_stream_t *st, *lru = NULL;
+  int i;
+
+  for (i=0; i < pf->nentries; i++)
+    {
+      st = &pf->streams[i];
+      if (st->stamp && blk >= st->head && blk < st->tail)
+	break;
+      if (!lru || st->stamp < lru->stamp)
+	lru = st;
+    }
+
+  if (i == pf->nentries)
+    {
+      /* only misses start new streams */
+      if (!miss)
+	return;
+      st = lru;
+      st->tail = blk + 1;
+    }
+
+  /* keep the DEPTH blocks after BLK in the cache */
+  st->head = blk + 1;
+  st->stamp = ++pf->stamp;
+  for (; st->tail < st->head + pf->degree; st->tail++)
+    cache_prefetch(cp, st->tail << pf->blk_shift, now);
+}
+
+/* train prefetcher PF with a demand access at NOW by the instruction at PC
+   to address ADDR of cache CP, which missed if MISS, or hit a prefetched
+   block for the first time if PF_HIT, prefetches are issued into CP */
+void
+prefetch_access(struct prefetch_t *pf,	/* prefetcher instance */
+		struct cache_t *cp,	/* cache accessed */
+		md_addr_t pc,		/* PC of access, 0 if unknown */
+		md_addr_t addr,		/* address of access */
+		int miss,		/* did the access miss? */
+		int pf_hit,		/* first hit to a prefetched block? */
+		tick_t now)		/* time of access */
+{
+  md_addr_t blk = addr >> pf->blk_shift;
+  int i;
+
+  switch (pf->kind)
+    {
+    case PF_NextLine:
+      if (miss || pf_hit)
+	{
+	  for (i=1; i <= pf->degree; i++)
+	    cache_prefetch(cp, (blk + i) << pf->blk_shift, now);
+	}
+      break;
+    case PF_Stride:
+      stride_access(pf, cp, pc, addr, now);
+      break;
+    case PF_Stream:
+      stream_access(pf, cp, blk, miss, now);
+      break;
+    default:
+      panic("bogus prefetcher kind");
+    }
+}
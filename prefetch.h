@@ -0,0 +1,155 @@
+/* stackdist.h - LRU stack distance cache sweep interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+/*
+ * This module implements hardware prefetchers that attach to the caches of
+ * the cache module.  A prefetcher attached to a cache (CP->PF) observes
+ * every demand access to the cache, with the PC of the instruction making
+ * it if the simulator supplies one, and requests fills of the blocks it
+ * predicts through cache_prefetch(), which brings them into the cache
+ * with the cache's block access function.  The following prefetchers are
+ * implemented:
+ *
+ *   nextline:<degree>		tagged next-line, on a miss or the first hit
+ *				to a prefetched block, fetch the next DEGREE
+ *				blocks
+ *   stride:<entries>:<degree>	per-PC stride, a direct-mapped reference
+ *				prediction table of ENTRIES PCs, fetches
+ *				DEGREE strides ahead once a PC's stride is
+ *				seen twice in a row
+ *   stream:<buffers>:<depth>	stream buffers, each miss outside the
+ *				BUFFERS tracked streams starts a new one (in
+ *				LRU order) that keeps the DEPTH blocks after
+ *				the last block referenced in the cache
+ *
+ * The stream buffers fill the cache itself rather than separate buffers,
+ * so their prefetches are accounted like those of the other prefetchers.
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+
+/* forward declarations */
+struct cache_t;
+
+/* prefetcher kinds */
+enum prefetch_kind {
+  PF_NextLine,		/* tagged next-line */
+  PF_Stride,		/* per-PC stride */
+  PF_Stream		/* stream buffers */
+};
+
+/* per-PC stride reference prediction table entry */
+struct prefetch_rpt_t
+{
+  int valid;			/* entry in use? */
+  md_addr_t pc;			/* PC of the instruction */
+  md_addr_t last_addr;		/* address it accessed last */
+  md_addr_t stride;		/* stride between its last two accesses */
+  int conf;			/* 2-bit stride confidence */
+};
+
+/* stream buffer, tracks blocks HEAD..TAIL-1 of a stream */
+struct prefetch_stream_t
+{
+  md_addr_t head;		/* next block expected */
+  md_addr_t tail;		/* next block to prefetch */
+  unsigned int stamp;		/* time of last use, for LRU allocation, 0
+				   if the buffer is unused */
+};
+
+/* prefetcher definition */
+struct prefetch_t
+{
+  /* parameters */
+  enum prefetch_kind kind;	/* prefetcher kind */
+  int nentries;			/* RPT entries or stream buffers */
+  int degree;			/* blocks fetched ahead per trigger */
+
+  /* derived data */
+  int blk_shift;		/* log2 of the cache block size */
+
+  /* prefetcher state */
+  struct prefetch_rpt_t *rpt;	/* stride reference prediction table */
+  struct prefetch_stream_t *streams;/* stream buffers */
+  unsigned int stamp;		/* stream buffer LRU clock */
+};
+
+/* create a prefetcher for a cache with BSIZE byte blocks from its
+   configuration string CONFIG, returns NULL if CONFIG is "none" */
+struct prefetch_t *			/* pointer to prefetcher created */
+prefetch_create(char *config,		/* prefetcher configuration */
+		int bsize);		/* block size of its cache */
+
+/* print prefetcher configuration */
+void
+prefetch_config(struct prefetch_t *pf,	/* prefetcher instance */
+		char *name,		/* name of its cache */
+		FILE *stream);		/* output stream */
+
+/* train prefetcher PF with a demand access at NOW by the instruction at PC
+   to address ADDR of cache CP, which missed if MISS, or hit a prefetched
+   block for the first time if PF_HIT, prefetches are issued into CP */
+void
+prefetch_access(struct prefetch_t *pf,	/* prefetcher instance */
+		struct cache_t *cp,	/* cache accessed */
+		md_addr_t pc,		/* PC of access, 0 if unknown */
+		md_addr_t addr,		/* address of access */
+		int miss,		/* did the access miss? */
+		int pf_hit,		/* first hit to a prefetched block? */
+		tick_t now);		/* time of access */
+
+#endif /* PREFETCH_H */
@@ -66,6 +66,11 @@
 #include "bpred.h"
 #include "sim.h"
 
+#ifndef _MSC_VER
+#include <pthread.h>
+#define PRED_THREADS
+#endif /* !_MSC_VER */
+
 /*
  * This file implements a branch predictor analyzer.
  */
@@ -79,7 +84,7 @@ static struct mem_t *mem = NULL;
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
 
-/* branch predictor type {nottaken|taken|perfect|bimod|2lev} */
+/* branch predictor type {nottaken|taken|perfect|bimod|2lev|tage|perc} */
 static char *pred_type;
 
 /* bimodal predictor config (<table_size>) */
@@ -97,6 +102,30 @@ static int comb_nelt = 1;
 static int comb_config[1] =
   { /* meta_table_size */1024 };
 
+/* TAGE predictor config
+   (<tables> <log_size> <tag_bits> <min_hist> <max_hist> <log_base>) */
+static int tage_nelt = 6;
+static int tage_config[6] =
+  { /* tables */8, /* log_size */10, /* tag_bits */11,
+    /* min_hist */4, /* max_hist */256, /* log_base */13 };
+
+/* TAGE statistical corrector table size (log2, 0 for no corrector) */
+static int tage_sc_size = 10;
+
+/* TAGE loop predictor size (0 for no loop predictor) */
+static int tage_loop_size = 64;
+
+/* perceptron predictor config (<num_perceptrons> <hist_len>) */
+static int perc_nelt = 2;
+static int perc_config[2] =
+  { /* num_perceptrons */1024, /* hist_len */32 };
+
+/* indirect target predictor config
+   (<num_sets> <associativity> <path_len>), no predictor if 0 sets */
+static int indir_nelt = 3;
+static int indir_config[3] =
+  { /* num_sets */0, /* assoc */4, /* path_len */4 };
+
 /* return address stack (RAS) size */
 static int ras_size = 8;
 
@@ -105,8 +134,20 @@ static int btb_nelt = 2;
 static int btb_config[2] =
   { /* nsets */512, /* assoc */4 };
 
-/* branch predictor */
-static struct bpred_t *pred;
+/* maximum number of predictors evaluated in one run */
+#define MAX_PREDS		16
+
+/* predictor configs evaluated in one pass, `<type>[:<arg>...]' each, or
+   none to evaluate just the -bpred predictor */
+static int multi_nelt = 0;
+static char *multi_config[MAX_PREDS];
+
+/* number of worker threads running the predictors, 0 to run them inline */
+static int pred_threads = 0;
+
+/* branch predictors */
+static struct bpred_t *preds[MAX_PREDS];
+static int npreds = 0;
 
 /* track number of insn and refs */
 static counter_t sim_num_refs = 0;
@@ -138,6 +179,12 @@ sim_reg_options(struct opt_odb_t *odb)
 "      PAp     : N, W, M (M == 2^(N+W)), 0\n"
 "      gshare  : 1, W, 2^W, 1\n"
 "  Predictor `comb' combines a bimodal and a 2-level predictor.\n"
+"  Predictor `tage' is a TAGE-SC-L predictor with N tagged tables of 2^S\n"
+"    entries, T-bit tags and geometric history lengths from Lmin to Lmax\n"
+"    over a 2^B entry bimodal base, optionally refined by a statistical\n"
+"    corrector and a loop predictor.\n"
+"  Predictor `perc' is a perceptron predictor with N perceptrons over H\n"
+"    bits of global history.\n"
                );
 
   /* instruction limit */
@@ -146,7 +193,7 @@ sim_reg_options(struct opt_odb_t *odb)
 	       /* print */TRUE, /* format */NULL);
 
   opt_reg_string(odb, "-bpred",
-		 "branch predictor type {nottaken|taken|bimod|2lev|comb}",
+		 "branch predictor type {nottaken|taken|bimod|2lev|comb|tage|perc}",
                  &pred_type, /* default */"bimod",
                  /* print */TRUE, /* format */NULL);
 
@@ -169,6 +216,36 @@ sim_reg_options(struct opt_odb_t *odb)
 		   /* default */comb_config,
 		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
 
+  opt_reg_int_list(odb, "-bpred:tage",
+		   "TAGE predictor config (<tables> <log_size> <tag_bits> "
+		   "<min_hist> <max_hist> <log_base>)",
+		   tage_config, tage_nelt, &tage_nelt,
+		   /* default */tage_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-bpred:tage_sc",
+	      "TAGE statistical corrector table size (log2, 0 for none)",
+	      &tage_sc_size, /* default */tage_sc_size,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-bpred:tage_loop",
+	      "TAGE loop predictor entries (0 for none)",
+	      &tage_loop_size, /* default */tage_loop_size,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int_list(odb, "-bpred:perc",
+		   "perceptron predictor config (<num_perceptrons> <hist_len>)",
+		   perc_config, perc_nelt, &perc_nelt,
+		   /* default */perc_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:indir",
+		   "indirect target predictor config "
+		   "(<num_sets> <associativity> <path_len>, 0 sets for none)",
+		   indir_config, indir_nelt, &indir_nelt,
+		   /* default */indir_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
   opt_reg_int(odb, "-bpred:ras",
               "return address stack size (0 for no return stack)",
               &ras_size, /* default */ras_size,
@@ -179,23 +256,47 @@ sim_reg_options(struct opt_odb_t *odb)
 		   btb_config, btb_nelt, &btb_nelt,
 		   /* default */btb_config,
 		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_string_list(odb, "-bpred:multi",
+		      "predictor config to evaluate in the same pass "
+		      "(<type>[:<arg>...], replaces -bpred, mult uses ok)",
+		      multi_config, MAX_PREDS, &multi_nelt, NULL,
+		      /* print */TRUE, /* format */NULL, /* accrue */TRUE);
+
+  opt_reg_int(odb, "-bpred:threads",
+	      "worker threads running the predictors (0 to run inline)",
+	      &pred_threads, /* default */pred_threads,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  Option -bpred:multi feeds every branch to each given predictor, e.g.,\n"
+"    `-bpred:multi bimod -bpred:multi 2lev:1:4096:12:1'.  The args of a\n"
+"    config replace those of the matching -bpred:<type> option; the BTB,\n"
+"    RAS, TAGE SC/loop and indirect target options are shared by all\n"
+"    configs.  Stats of the i'th config are named bpred<i>_<type>.  With\n"
+"    -bpred:threads, branches are buffered and the predictors are split\n"
+"    across worker threads, each predictor still sees every branch in\n"
+"    program order, so stats do not depend on the thread count.\n"
+		);
 }
 
-/* check simulator-specific option values */
-void
-sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
+/* create a predictor of type TYPE, configured by the -bpred:* options */
+static struct bpred_t *
+pred_create(char *type)			/* predictor type */
 {
-  if (!mystricmp(pred_type, "taken"))
+  struct bpred_t *pred = NULL;
+
+  if (!mystricmp(type, "taken"))
     {
       /* static predictor, not taken */
       pred = bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     }
-  else if (!mystricmp(pred_type, "nottaken"))
+  else if (!mystricmp(type, "nottaken"))
     {
       /* static predictor, taken */
       pred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     }
-  else if (!mystricmp(pred_type, "bimod"))
+  else if (!mystricmp(type, "bimod"))
     {
       if (bimod_nelt != 1)
 	fatal("bad bimod predictor config (<table_size>)");
@@ -214,7 +315,7 @@ sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 			  /* btb assoc */btb_config[1],
 			  /* ret-addr stack size */ras_size);
     }
-  else if (!mystricmp(pred_type, "2lev"))
+  else if (!mystricmp(type, "2lev"))
     {
       /* 2-level adaptive predictor, bpred_create() checks args */
       if (twolev_nelt != 4)
@@ -233,7 +334,7 @@ sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 			  /* btb assoc */btb_config[1],
 			  /* ret-addr stack size */ras_size);
     }
-  else if (!mystricmp(pred_type, "comb"))
+  else if (!mystricmp(type, "comb"))
     {
       /* combining predictor, bpred_create() checks args */
       if (twolev_nelt != 4)
@@ -256,14 +357,162 @@ sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 			  /* btb assoc */btb_config[1],
 			  /* ret-addr stack size */ras_size);
     }
+  else if (!mystricmp(type, "tage"))
+    {
+      /* TAGE-SC-L predictor, bpred_tage_create() checks args */
+      if (tage_nelt != 6)
+	fatal("bad TAGE pred config (<tables> <log_size> <tag_bits> "
+	      "<min_hist> <max_hist> <log_base>)");
+      if (tage_sc_size < 0 || tage_loop_size < 0)
+	fatal("TAGE SC and loop predictor sizes must be non-negative");
+      if (btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      pred = bpred_tage_create(/* tagged tables */tage_config[0],
+			       /* log2 table size */tage_config[1],
+			       /* tag width */tage_config[2],
+			       /* shortest history */tage_config[3],
+			       /* longest history */tage_config[4],
+			       /* log2 base table size */tage_config[5],
+			       /* log2 SC table size */tage_sc_size,
+			       /* loop predictor size */tage_loop_size,
+			       /* btb sets */btb_config[0],
+			       /* btb assoc */btb_config[1],
+			       /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(type, "perc"))
+    {
+      /* perceptron predictor, bpred_create() checks args */
+      if (perc_nelt != 2)
+	fatal("bad perceptron pred config (<num_perceptrons> <hist_len>)");
+      if (btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      pred = bpred_create(BPredPerceptron,
+			  /* bimod table size */0,
+			  /* number of perceptrons */perc_config[0],
+			  /* 2lev l2 size */0,
+			  /* meta table size */0,
+			  /* history length */perc_config[1],
+			  /* history xor address */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* ret-addr stack size */ras_size);
+    }
   else
-    fatal("cannot parse predictor type `%s'", pred_type);
+    fatal("cannot parse predictor type `%s'", type);
+
+  return pred;
+
+}
+
+/* create the predictor described by SPEC, `<type>[:<arg>...]', where the
+   args, if any, replace the config of the -bpred:<type> option, its stats
+   are named bpred<IDX>_<type> as specs may repeat a type */
+static struct bpred_t *
+pred_create_spec(char *spec,		/* predictor config spec */
+		 int idx)		/* position of spec in -bpred:multi */
+{
+  char type[128], buf[160], *p, *end;
+  int *config = NULL, *nelt = NULL, max = 0, n = 0;
+  int save_config[6], save_nelt = 0;
+  struct bpred_t *pred;
+
+  if (!(p = strchr(spec, ':')))
+    p = spec + strlen(spec);
+  if (p - spec >= (int)sizeof(type))
+    fatal("bad predictor config `%s'", spec);
+  strncpy(type, spec, p - spec);
+  type[p - spec] = '\0';
+
+  /* find the config the args replace */
+  if (!mystricmp(type, "bimod"))
+    config = bimod_config, nelt = &bimod_nelt, max = 1;
+  else if (!mystricmp(type, "2lev"))
+    config = twolev_config, nelt = &twolev_nelt, max = 4;
+  else if (!mystricmp(type, "comb"))
+    config = comb_config, nelt = &comb_nelt, max = 1;
+  else if (!mystricmp(type, "tage"))
+    config = tage_config, nelt = &tage_nelt, max = 6;
+  else if (!mystricmp(type, "perc"))
+    config = perc_config, nelt = &perc_nelt, max = 2;
+
+  if (*p && !config)
+    fatal("predictor type `%s' takes no config args", type);
+  if (config)
+    {
+      memcpy(save_config, config, max * sizeof(int));
+      save_nelt = *nelt;
+    }
+
+  /* parse the args, the type's config checks catch too few */
+  while (*p)
+    {
+      if (n == max)
+	fatal("too many args in predictor config `%s'", spec);
+      config[n++] = strtol(p + 1, &end, 0);
+      if (end == p + 1 || (*end && *end != ':'))
+	fatal("bad arg in predictor config `%s'", spec);
+      p = end;
+    }
+  if (n)
+    *nelt = n;
+
+  pred = pred_create(type);
+
+  /* restore the -bpred:<type> config for later specs */
+  if (config)
+    {
+      memcpy(config, save_config, max * sizeof(int));
+      *nelt = save_nelt;
+    }
+
+  sprintf(buf, "bpred%d_%s", idx, type);
+  pred->name = mystrdup(buf);
+
+  return pred;
+}
+
+/* check simulator-specific option values */
+void
+sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
+{
+  int i;
+
+  if (multi_nelt == 0)
+    {
+      /* just the -bpred predictor, its stats named by its class */
+      preds[0] = pred_create(pred_type);
+      npreds = 1;
+    }
+  else
+    {
+      for (npreds=0; npreds < multi_nelt; npreds++)
+	preds[npreds] = pred_create_spec(multi_config[npreds], npreds);
+    }
+
+  /* path-based indirect target predictor, bpred_indir_create() checks args */
+  if (indir_nelt != 3)
+    fatal("bad indirect target pred config "
+	  "(<num_sets> <associativity> <path_len>)");
+  for (i=0; indir_config[0] && i < npreds; i++)
+    bpred_indir_create(preds[i],
+		       /* sets */indir_config[0],
+		       /* assoc */indir_config[1],
+		       /* path history length */indir_config[2]);
+
+  if (pred_threads < 0)
+    fatal("number of predictor threads must be non-negative");
+  if (pred_threads > npreds)
+    pred_threads = npreds;
 }
 
 /* register simulator-specific statistics */
 void
 sim_reg_stats(struct stat_sdb_t *sdb)
 {
+  int i;
+
   stat_reg_counter(sdb, "sim_num_insn",
 		   "total number of instructions executed",
 		   &sim_num_insn, sim_num_insn, NULL);
@@ -285,10 +534,190 @@ sim_reg_stats(struct stat_sdb_t *sdb)
                    "sim_num_insn / sim_num_branches", /* format */NULL);
 
   /* register predictor stats */
-  if (pred)
-    bpred_reg_stats(pred, sdb);
+  for (i=0; i < npreds; i++)
+    bpred_reg_stats(preds[i], sdb);
+}
+
+/* a resolved branch, as fed to each predictor */
+struct br_rec_t {
+  md_addr_t PC;				/* branch address */
+  md_addr_t target_PC;			/* decoded branch target */
+  md_addr_t NPC;			/* resolved next PC */
+  enum md_opcode op;			/* branch opcode */
+  int is_call;				/* call? */
+  int is_return;			/* return? */
+};
+
+/* predict branch REC with PRED, then update PRED with its outcome */
+static void
+pred_branch(struct bpred_t *pred,	/* branch predictor instance */
+	    struct br_rec_t *rec)	/* resolved branch */
+{
+  md_addr_t pred_PC;
+  struct bpred_update_t update_rec;
+  int stack_idx;
+
+  /* get the next predicted fetch address */
+  pred_PC = bpred_lookup(pred,
+			 /* branch addr */rec->PC,
+			 /* target */rec->target_PC,
+			 /* inst opcode */rec->op,
+			 /* call? */rec->is_call,
+			 /* return? */rec->is_return,
+			 /* stash an update ptr */&update_rec,
+			 /* stash return stack ptr */&stack_idx);
+
+  /* valid address returned from branch predictor? */
+  if (!pred_PC)
+    {
+      /* no predicted taken target, attempt not taken target */
+      pred_PC = rec->PC + sizeof(md_inst_t);
+    }
+
+  bpred_update(pred,
+	       /* branch addr */rec->PC,
+	       /* resolved branch target */rec->NPC,
+	       /* taken? */rec->NPC != (rec->PC + sizeof(md_inst_t)),
+	       /* pred taken? */pred_PC != (rec->PC + sizeof(md_inst_t)),
+	       /* correct pred? */pred_PC == rec->NPC,
+	       /* opcode */rec->op,
+	       /* predictor update pointer */&update_rec);
 }
 
+#ifdef PRED_THREADS
+
+/*
+ * threaded predictor evaluation: the simulator appends branches to one of
+ * two record buffers, a full buffer is handed to the worker threads while
+ * the other one fills, worker W runs predictors W, W+N, W+2N, ... over
+ * every record of the buffer, so each predictor sees the branches in order
+ */
+
+/* branch records per buffer */
+#define BR_BUF_SIZE		65536
+
+/* double-buffered branch record stream */
+static struct br_rec_t *br_buf[2];
+static int br_cur = 0;			/* buffer being filled */
+static int br_fill = 0;			/* records in the buffer being filled */
+
+/* worker synchronization, protected by br_lock */
+static pthread_mutex_t br_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t br_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t br_idle = PTHREAD_COND_INITIALIZER;
+static unsigned int br_gen = 0;		/* number of buffers handed out */
+static int br_pub = 0;			/* buffer handed to the workers */
+static int br_pub_n = 0;		/* records in the handed out buffer */
+static int br_done = 0;			/* workers done with the buffer */
+static int br_quit = FALSE;		/* workers should exit */
+static pthread_t *br_workers = NULL;
+
+/* worker thread, runs its share of the predictors over each buffer */
+static void *
+pred_worker(void *arg)			/* worker number */
+{
+  int w = (int)(long)arg, i, j, n;
+  unsigned int gen = 0;
+  struct br_rec_t *buf;
+
+  pthread_mutex_lock(&br_lock);
+  for (;;)
+    {
+      while (br_gen == gen && !br_quit)
+	pthread_cond_wait(&br_go, &br_lock);
+      if (br_gen == gen)
+	break;
+      gen = br_gen;
+      buf = br_buf[br_pub];
+      n = br_pub_n;
+      pthread_mutex_unlock(&br_lock);
+
+      for (i=w; i < npreds; i += pred_threads)
+	for (j=0; j < n; j++)
+	  pred_branch(preds[i], &buf[j]);
+
+      pthread_mutex_lock(&br_lock);
+      if (++br_done == pred_threads)
+	pthread_cond_signal(&br_idle);
+    }
+  pthread_mutex_unlock(&br_lock);
+
+  return NULL;
+}
+
+/* wait until the workers are done with the handed out buffer */
+static void
+br_wait(void)
+{
+  pthread_mutex_lock(&br_lock);
+  while (br_done < pred_threads)
+    pthread_cond_wait(&br_idle, &br_lock);
+  pthread_mutex_unlock(&br_lock);
+}
+
+/* hand the buffer being filled to the workers, and switch buffers */
+static void
+br_flush(void)
+{
+  br_wait();
+
+  pthread_mutex_lock(&br_lock);
+  br_pub = br_cur;
+  br_pub_n = br_fill;
+  br_done = 0;
+  br_gen++;
+  pthread_cond_broadcast(&br_go);
+  pthread_mutex_unlock(&br_lock);
+
+  br_cur ^= 1;
+  br_fill = 0;
+}
+
+/* run the predictors over the buffered branches and stop the workers
+   before the final stats are printed, called at simulator exit */
+static void
+br_exit(void)
+{
+  int i;
+
+  if (br_fill)
+    br_flush();
+  br_wait();
+
+  pthread_mutex_lock(&br_lock);
+  br_quit = TRUE;
+  pthread_cond_broadcast(&br_go);
+  pthread_mutex_unlock(&br_lock);
+
+  for (i=0; i < pred_threads; i++)
+    pthread_join(br_workers[i], NULL);
+  pred_threads = 0;
+}
+
+/* allocate the branch record buffers and start the worker threads */
+static void
+br_init(void)
+{
+  int i;
+
+  br_buf[0] = calloc(BR_BUF_SIZE, sizeof(struct br_rec_t));
+  br_buf[1] = calloc(BR_BUF_SIZE, sizeof(struct br_rec_t));
+  br_workers = calloc(pred_threads, sizeof(pthread_t));
+  if (!br_buf[0] || !br_buf[1] || !br_workers)
+    fatal("out of virtual memory");
+
+  /* no buffer handed out yet */
+  br_done = pred_threads;
+
+  for (i=0; i < pred_threads; i++)
+    if (pthread_create(&br_workers[i], NULL, pred_worker, (void *)(long)i))
+      fatal("cannot create predictor worker thread");
+
+  sim_exit_hook = br_exit;
+}
+
+#endif /* PRED_THREADS */
+
 /* initialize the simulator */
 void
 sim_init(void)
@@ -301,6 +730,16 @@ sim_init(void)
   /* allocate and initialize memory space */
   mem = mem_create("mem");
   mem_init(mem);
+
+  /* start the predictor worker threads */
+  if (pred_threads)
+    {
+#ifdef PRED_THREADS
+      br_init();
+#else /* !PRED_THREADS */
+      fatal("predictor threads are not supported on this host");
+#endif /* PRED_THREADS */
+    }
 }
 
 /* local machine state accessor */
@@ -444,7 +883,6 @@ sim_main(void)
   register md_addr_t addr, target_PC = 0;
   enum md_opcode op;
   register int is_write;
-  int stack_idx;
   enum md_fault_type fault;
 
   fprintf(stderr, "sim: ** starting functional simulation w/ predictors **\n");
@@ -510,40 +948,31 @@ sim_main(void)
 
       if (MD_OP_FLAGS(op) & F_CTRL)
 	{
-	  md_addr_t pred_PC;
-	  struct bpred_update_t update_rec;
+	  struct br_rec_t rec;
+	  int i;
 
 	  sim_num_branches++;
 
-	  if (pred)
+	  rec.PC = regs.regs_PC;
+	  rec.target_PC = target_PC;
+	  rec.NPC = regs.regs_NPC;
+	  rec.op = op;
+	  rec.is_call = MD_IS_CALL(op);
+	  rec.is_return = MD_IS_RETURN(op);
+
+#ifdef PRED_THREADS
+	  if (pred_threads)
+	    {
+	      /* buffer the branch for the worker threads */
+	      br_buf[br_cur][br_fill++] = rec;
+	      if (br_fill == BR_BUF_SIZE)
+		br_flush();
+	    }
+	  else
+#endif /* PRED_THREADS */
 	    {
-	      /* get the next predicted fetch address */
-	      pred_PC = bpred_lookup(pred,
-				     /* branch addr */regs.regs_PC,
-				     /* target */target_PC,
-				     /* inst opcode */op,
-				     /* call? */MD_IS_CALL(op),
-				     /* return? */MD_IS_RETURN(op),
-				     /* stash an update ptr */&update_rec,
-				     /* stash return stack ptr */&stack_idx);
-
-	      /* valid address returned from branch predictor? */
-	      if (!pred_PC)
-		{
-		  /* no predicted taken target, attempt not taken target */
-		  pred_PC = regs.regs_PC + sizeof(md_inst_t);
-		}
-
-	      bpred_update(pred,
-			   /* branch addr */regs.regs_PC,
-			   /* resolved branch target */regs.regs_NPC,
-			   /* taken? */regs.regs_NPC != (regs.regs_PC +
-							 sizeof(md_inst_t)),
-			   /* pred taken? */pred_PC != (regs.regs_PC +
-							sizeof(md_inst_t)),
-			   /* correct pred? */pred_PC == regs.regs_NPC,
-			   /* opcode */op,
-			   /* predictor update pointer */&update_rec);
+	      for (i=0; i < npreds; i++)
+		pred_branch(preds[i], &rec);
 	    }
 	}
 
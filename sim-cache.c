@@ -61,6 +61,8 @@
 #include "regs.h"
 #include "memory.h"
 #include "cache.h"
+#include "prefetch.h"
+#include "stackdist.h"
 #include "loader.h"
 #include "syscall.h"
 #include "dlite.h"
@@ -104,6 +106,11 @@ static struct cache_t *itlb = NULL;
 /* data TLB */
 static struct cache_t *dtlb = NULL;
 
+/* single-pass sweeps of LRU level 1 and level 2 data caches, fed the same
+   references as CACHE_DL1 and CACHE_DL2 */
+static struct stackdist_t *sweep_dl1 = NULL;
+static struct stackdist_t *sweep_dl2 = NULL;
+
 /* text-based stat profiles */
 #define MAX_PCSTAT_VARS 8
 static struct stat_stat_t *pcstat_stats[MAX_PCSTAT_VARS];
@@ -128,9 +135,13 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
 	      tick_t now)		/* time of access */
 {
+  if (sweep_dl2)
+    stackdist_access(sweep_dl2, baddr);
+
   if (cache_dl2)
     {
       /* access next level of data cache hierarchy */
+      cache_dl2->access_pc = cache_dl1->access_pc;
       return cache_access(cache_dl2, cmd, baddr, NULL, bsize,
 			  /* now */now, /* pudata */NULL, /* repl addr */NULL);
     }
@@ -162,9 +173,13 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
 	      tick_t now)		/* time of access */
 {
+  if (sweep_dl2 && cache_il2 == cache_dl2)
+    stackdist_access(sweep_dl2, baddr);
+
   if (cache_il2)
     {
       /* access next level of inst cache hierarchy */
+      cache_il2->access_pc = cache_il1->access_pc;
       return cache_access(cache_il2, cmd, baddr, NULL, bsize,
 			  /* now */now, /* pudata */NULL, /* repl addr */NULL);
     }
@@ -226,6 +241,77 @@ dtlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
   return /* access latency, ignored */1;
 }
 
+/* attach the prefetcher configured by OPT to cache CP, named WHAT, which is
+   UNIFIED with a data cache */
+static void
+pf_attach(struct cache_t *cp,		/* cache to attach prefetcher to */
+	  char *opt,			/* prefetcher configuration */
+	  char *what,			/* name of the cache level */
+	  int unified)			/* is CP also a data cache? */
+{
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!cp)
+    fatal("a %s prefetcher requires the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache prefetcher", what);
+  cp->pf = prefetch_create(opt, cp->bsize);
+}
+
+/* attach the victim cache configured by OPT to cache CP, named WHAT, which
+   is UNIFIED with a data cache */
+static void
+vc_attach(struct cache_t *cp,		/* cache to attach victim cache to */
+	  char *opt,			/* victim cache configuration */
+	  char *what,			/* name of the cache level */
+	  int unified)			/* is CP also a data cache? */
+{
+  int nblks, lat;
+
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!cp)
+    fatal("a %s victim cache requires the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache victim cache", what);
+  if (cp->hier == Exclusive)
+    fatal("the %s is exclusive, it cannot have a victim cache", what);
+  if (sscanf(opt, "%d:%d", &nblks, &lat) != 2)
+    fatal("bad %s victim cache parms: <nblks>:<lat>", what);
+  if (lat < 0)
+    fatal("victim cache latency must be non-negative");
+  cache_victim(cp, nblks, lat);
+}
+
+/* set the hierarchy policy of l2 cache CP, named WHAT, which is UNIFIED
+   with the l2 data cache, to the one configured by OPT */
+static void
+hier_attach(struct cache_t *cp,		/* l2 cache */
+	    char *opt,			/* hierarchy policy */
+	    char *what,			/* name of the cache level */
+	    int unified)		/* is CP also the l2 data cache? */
+{
+  enum cache_hier hier = cache_str2hier(opt);
+  int i;
+
+  if (hier == NINE)
+    return;
+  if (!cp)
+    fatal("a %s policy requires the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache policy", what);
+  if (!cp->ninner)
+    fatal("the %s has no l1 caches to enforce its policy on", what);
+
+  /* blocks move whole between exclusive levels */
+  for (i=0; hier == Exclusive && i<cp->ninner; i++)
+    {
+      if (cp->inner[i]->bsize != cp->bsize)
+	fatal("the exclusive %s needs the block size of its l1 caches", what);
+    }
+  cp->hier = hier;
+}
+
 /* cache/TLB options */
 static char *cache_dl1_opt /* = "none" */;
 static char *cache_dl2_opt /* = "none" */;
@@ -233,6 +319,18 @@ static char *cache_il1_opt /* = "none" */;
 static char *cache_il2_opt /* = "none" */;
 static char *itlb_opt /* = "none" */;
 static char *dtlb_opt /* = "none" */;
+static char *sweep_dl1_opt /* = "none" */;
+static char *sweep_dl2_opt /* = "none" */;
+static char *pf_dl1_opt /* = "none" */;
+static char *pf_dl2_opt /* = "none" */;
+static char *pf_il1_opt /* = "none" */;
+static char *pf_il2_opt /* = "none" */;
+static char *vc_dl1_opt /* = "none" */;
+static char *vc_dl2_opt /* = "none" */;
+static char *vc_il1_opt /* = "none" */;
+static char *vc_il2_opt /* = "none" */;
+static char *hier_dl2_opt /* = "nine" */;
+static char *hier_il2_opt /* = "nine" */;
 static int flush_on_syscalls /* = FALSE */;
 static int compress_icache_addrs /* = FALSE */;
 
@@ -280,7 +378,9 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
 "    <nsets>  - number of sets in the cache\n"
 "    <bsize>  - block size of the cache\n"
 "    <assoc>  - associativity of the cache\n"
-"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random\n"
+"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random,\n"
+"               'p'-tree-PLRU, 's'-SRRIP, 'b'-BRRIP, 'd'-DRRIP (set dueling),\n"
+"               'h'-SHiP (RRIP with memory-region reuse prediction)\n"
 "\n"
 "    Examples:   -cache:dl1 dl1:4096:32:1:l\n"
 "                -dtlb dtlb:128:4096:32:r\n"
@@ -307,6 +407,96 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
   opt_reg_string(odb, "-cache:il2",
 		 "l2 instruction cache config, i.e., {<config>|dl2|none}",
 		 &cache_il2_opt, "dl2", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl1sweep",
+		 "single-pass sweep of l1 data caches, i.e., {<config>|none}",
+		 &sweep_dl1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl2sweep",
+		 "single-pass sweep of l2 data caches, i.e., {<config>|none}",
+		 &sweep_dl2_opt, "none", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The cache sweep parameter <config> has the following format:\n"
+"\n"
+"    <name>:<bsize>:<min_sets>:<max_sets>:<max_assoc>\n"
+"\n"
+"    <name>      - name of the sweep, used in its statistics\n"
+"    <bsize>     - block size of the caches swept\n"
+"    <min_sets>  - smallest number of sets swept\n"
+"    <max_sets>  - largest number of sets swept\n"
+"    <max_assoc> - largest associativity swept\n"
+"\n"
+"  A sweep computes the misses of every LRU cache with a power-of-two number\n"
+"  of sets from <min_sets> to <max_sets> and a power-of-two associativity up\n"
+"  to <max_assoc> in one pass, using LRU stack distances.  The dl1 sweep sees\n"
+"  the references made to the l1 data cache, the dl2 sweep sees those made to\n"
+"  the l2 data cache, so it requires an l1 data cache, e.g.,\n"
+"\n"
+"    -cache:dl1sweep sdl1:32:16:1024:8 -cache:dl2sweep sdl2:64:256:8192:16\n"
+	       );
+  opt_reg_string(odb, "-cache:dl1pf",
+		 "l1 data cache prefetcher, i.e., {<config>|none}",
+		 &pf_dl1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl2pf",
+		 "l2 data cache prefetcher, i.e., {<config>|none}",
+		 &pf_dl2_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:il1pf",
+		 "l1 inst cache prefetcher, i.e., {<config>|none}",
+		 &pf_il1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:il2pf",
+		 "l2 inst cache prefetcher, i.e., {<config>|none}",
+		 &pf_il2_opt, "none", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The cache prefetcher parameter <config> has one of the following formats:\n"
+"\n"
+"    nextline:<degree>          - tagged next-line, fetch the <degree> blocks\n"
+"                                 after a miss or a first prefetched hit\n"
+"    stride:<entries>:<degree>  - per-PC stride table with <entries> entries,\n"
+"                                 fetch <degree> strides ahead\n"
+"    stream:<buffers>:<depth>   - <buffers> stream buffers, each keeps the\n"
+"                                 <depth> blocks after its last reference\n"
+"\n"
+"  Prefetches fill the cache they are attached to.  An instruction cache\n"
+"  unified with a data cache uses the data cache prefetcher, e.g.,\n"
+"\n"
+"    -cache:dl1pf stride:256:2 -cache:dl2pf stream:8:4\n"
+	       );
+  opt_reg_string(odb, "-cache:dl1vc",
+		 "l1 data cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_dl1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl2vc",
+		 "l2 data cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_dl2_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:il1vc",
+		 "l1 inst cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_il1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:il2vc",
+		 "l2 inst cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_il2_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl2hier",
+		 "l2 data cache policy to l1 caches, i.e., {nine|incl|excl}",
+		 &hier_dl2_opt, "nine", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:il2hier",
+		 "l2 inst cache policy to l1 caches, i.e., {nine|incl|excl}",
+		 &hier_il2_opt, "nine", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  A victim cache holds the <nblks> blocks last replaced in its cache, fully\n"
+"  associative, a miss found in it swaps the block back in (<lat> matters\n"
+"  only to the timing simulators).\n"
+"\n"
+"  The l2 cache hierarchy policies are:\n"
+"\n"
+"    nine - non-inclusive non-exclusive, the l2 cache allocates every block\n"
+"           it misses, no relation to the l1 caches is enforced\n"
+"    incl - inclusive, replacing an l2 block invalidates it in the l1\n"
+"           caches (back-invalidation)\n"
+"    excl - exclusive, an l2 block read by an l1 cache moves up (a swap),\n"
+"           l2 read misses are not allocated, and the l1 caches write\n"
+"           their replaced blocks, clean or dirty, into the l2 cache\n"
+"\n"
+"  An exclusive cache cannot have a victim cache, it is one for the caches\n"
+"  above, e.g.,\n"
+"\n"
+"    -cache:dl1vc 8:1 -cache:dl2hier incl\n"
+	       );
   opt_reg_string(odb, "-tlb:itlb",
 		 "instruction TLB config, i.e., {<config>|none}",
 		 &itlb_opt, "itlb:16:4096:4:l", /* print */TRUE, NULL);
@@ -319,6 +509,7 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
 	       "convert 64-bit inst addresses to 32-bit inst equivalents",
 	       &compress_icache_addrs, /* default */FALSE,
 	       /* print */TRUE, NULL);
+  cache_reg_options(odb);
 
   opt_reg_string_list(odb, "-pcstat",
 		      "profile stat(s) against text addr's (mult uses ok)",
@@ -431,6 +622,57 @@ sim_check_options(struct opt_odb_t *odb,	/* options database */
 	}
     }
 
+  /* sweep l1 data caches? */
+  if (mystricmp(sweep_dl1_opt, "none"))
+    {
+      int min_sets, max_sets;
+
+      if (sscanf(sweep_dl1_opt, "%[^:]:%d:%d:%d:%d",
+		 name, &bsize, &min_sets, &max_sets, &assoc) != 5)
+	fatal("bad l1 D-cache sweep parms: "
+	      "<name>:<bsize>:<min_sets>:<max_sets>:<max_assoc>");
+      sweep_dl1 = stackdist_create(name, bsize, min_sets, max_sets, assoc);
+    }
+
+  /* sweep l2 data caches? */
+  if (mystricmp(sweep_dl2_opt, "none"))
+    {
+      int min_sets, max_sets;
+
+      if (!cache_dl1)
+	fatal("the l1 data cache must be defined for an l2 cache sweep");
+      if (sscanf(sweep_dl2_opt, "%[^:]:%d:%d:%d:%d",
+		 name, &bsize, &min_sets, &max_sets, &assoc) != 5)
+	fatal("bad l2 D-cache sweep parms: "
+	      "<name>:<bsize>:<min_sets>:<max_sets>:<max_assoc>");
+      sweep_dl2 = stackdist_create(name, bsize, min_sets, max_sets, assoc);
+    }
+
+  /* attach the cache prefetchers */
+  pf_attach(cache_dl1, pf_dl1_opt, "l1 data cache", FALSE);
+  pf_attach(cache_dl2, pf_dl2_opt, "l2 data cache", FALSE);
+  pf_attach(cache_il1, pf_il1_opt, "l1 inst cache",
+	    cache_il1 == cache_dl1 || cache_il1 == cache_dl2);
+  pf_attach(cache_il2, pf_il2_opt, "l2 inst cache", cache_il2 == cache_dl2);
+
+  /* link the l1 caches to the l2 caches they miss to, and set the l2
+     hierarchy policies before attaching victim caches */
+  if (cache_dl1 && cache_dl2)
+    cache_link(cache_dl1, cache_dl2);
+  if (cache_il1 && cache_il2
+      && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_link(cache_il1, cache_il2);
+  hier_attach(cache_dl2, hier_dl2_opt, "l2 data cache", FALSE);
+  hier_attach(cache_il2, hier_il2_opt, "l2 inst cache",
+	      cache_il2 == cache_dl2);
+
+  /* attach the victim caches */
+  vc_attach(cache_dl1, vc_dl1_opt, "l1 data cache", FALSE);
+  vc_attach(cache_dl2, vc_dl2_opt, "l2 data cache", FALSE);
+  vc_attach(cache_il1, vc_il1_opt, "l1 inst cache",
+	    cache_il1 == cache_dl1 || cache_il1 == cache_dl2);
+  vc_attach(cache_il2, vc_il2_opt, "l2 inst cache", cache_il2 == cache_dl2);
+
   /* use an I-TLB? */
   if (!mystricmp(itlb_opt, "none"))
     itlb = NULL;
@@ -505,7 +747,19 @@ sim_load_prog(char *fname,		/* program to load */
 void
 sim_aux_config(FILE *stream)		/* output stream */
 {
-  /* nada */
+  if (sweep_dl1)
+    stackdist_config(sweep_dl1, stream);
+  if (sweep_dl2)
+    stackdist_config(sweep_dl2, stream);
+  if (cache_dl1 && cache_dl1->pf)
+    prefetch_config(cache_dl1->pf, cache_dl1->name, stream);
+  if (cache_dl2 && cache_dl2->pf)
+    prefetch_config(cache_dl2->pf, cache_dl2->name, stream);
+  if (cache_il1 && cache_il1->pf
+      && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    prefetch_config(cache_il1->pf, cache_il1->name, stream);
+  if (cache_il2 && cache_il2->pf && cache_il2 != cache_dl2)
+    prefetch_config(cache_il2->pf, cache_il2->name, stream);
 }
 
 /* register simulator-specific statistics */
@@ -543,6 +797,10 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
     cache_reg_stats(itlb, sdb);
   if (dtlb)
     cache_reg_stats(dtlb, sdb);
+  if (sweep_dl1)
+    stackdist_reg_stats(sweep_dl1, sdb);
+  if (sweep_dl2)
+    stackdist_reg_stats(sweep_dl2, sdb);
 
   for (i=0; i<pcstat_nelt; i++)
     {
@@ -652,6 +910,7 @@ sim_uninit(void)
     ? cache_access(dtlb, Read, (addr), NULL,				\
 		   sizeof(SRC_T), 0, NULL, NULL)			\
     : 0),								\
+   (sweep_dl1 ? (stackdist_access(sweep_dl1, (addr)), 0) : 0),		\
    (cache_dl1								\
     ? cache_access(cache_dl1, Read, (addr), NULL,			\
 		   sizeof(SRC_T), 0, NULL, NULL)			\
@@ -677,6 +936,7 @@ sim_uninit(void)
     ? cache_access(dtlb, Write, (addr), NULL,				\
 		   sizeof(DST_T), 0, NULL, NULL)			\
     : 0),								\
+   (sweep_dl1 ? (stackdist_access(sweep_dl1, (addr)), 0) : 0),		\
    (cache_dl1								\
     ? cache_access(cache_dl1, Write, (addr), NULL,			\
 		   sizeof(DST_T), 0, NULL, NULL)			\
@@ -707,6 +967,8 @@ dcache_access_fn(struct mem_t *mem,	/* memory space to access */
 {
   if (dtlb)
     cache_access(dtlb, cmd, addr, NULL, nbytes, 0, NULL, NULL);
+  if (sweep_dl1)
+    stackdist_access(sweep_dl1, addr);
   if (cache_dl1)
     cache_access(cache_dl1, cmd, addr, NULL, nbytes, 0, NULL, NULL);
   return mem_access(mem, cmd, addr, p, nbytes);
@@ -718,6 +980,8 @@ dcache_access_fn(struct mem_t *mem,	/* memory space to access */
    ? ((dtlb ? cache_flush(dtlb, 0) : 0),				\
       (cache_dl1 ? cache_flush(cache_dl1, 0) : 0),			\
       (cache_dl2 ? cache_flush(cache_dl2, 0) : 0),			\
+      (sweep_dl1 ? (stackdist_flush(sweep_dl1), 0) : 0),		\
+      (sweep_dl2 ? (stackdist_flush(sweep_dl2), 0) : 0),		\
       sys_syscall(&regs, mem_access, mem, INST, TRUE))			\
    : sys_syscall(&regs, dcache_access_fn, mem, INST, TRUE))
 
@@ -750,10 +1014,18 @@ sim_main(void)
       regs.regs_F.d[MD_REG_ZERO] = 0.0;
 #endif /* TARGET_ALPHA */
 
+      /* tell the prefetchers which instruction makes the accesses */
+      if (cache_il1)
+	cache_il1->access_pc = regs.regs_PC;
+      if (cache_dl1)
+	cache_dl1->access_pc = regs.regs_PC;
+
       /* get the next instruction to execute */
       if (itlb)
 	cache_access(itlb, Read, IACOMPRESS(regs.regs_PC),
 		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
+      if (sweep_dl1 && cache_il1 && cache_il1 == cache_dl1)
+	stackdist_access(sweep_dl1, IACOMPRESS(regs.regs_PC));
       if (cache_il1)
 	cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
 		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
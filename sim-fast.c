@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 /*
@@ -74,6 +75,13 @@
    versions of GNU GCC core dump when optimizing the jump table code with
    optimization levels higher than -O1 */
 /* #define USE_JUMP_TABLE */
+
+/* basic-block translation cache, each basic block is decoded once into a
+   vector of pointers to instruction implementation code, which is then
+   executed with threaded dispatch until the next control transfer or trap,
+   translated blocks are chained directly to their successors, requires GNU
+   GCC C extensions, overrides USE_JUMP_TABLE */
+#define USE_BLOCK_CACHE
 #endif /* __GNUC__ */
 
 #include "host.h"
@@ -92,11 +100,92 @@ static struct regs_t regs;
 /* simulated memory */
 static struct mem_t *mem = NULL;
 
-#ifdef TARGET_ALPHA
-/* predecoded text memory */
+#if defined(TARGET_ALPHA)
+/* predecoded text memory, used when the block cache is off */
 static struct mem_t *dec = NULL;
 #endif
 
+#ifdef USE_BLOCK_CACHE
+/* maximum number of instructions in a translated block */
+#define BCACHE_MAX_INSN		32
+
+/* number of block chain slots following each block exit, NOTE: sim_main()
+   follows exactly two chain slots */
+#define BCACHE_NUM_CHAIN	2
+
+/* number of block map entries, must be a power of two */
+#define BCACHE_MAP_SIZE		16384
+
+/* block map entry index for block starting at PC */
+#define BCACHE_MAP_INDEX(PC)						\
+  (((PC) / sizeof(md_inst_t)) & (BCACHE_MAP_SIZE-1))
+
+/* code cache entry, translated blocks are laid out contiguously in the code
+   cache as one entry per instruction, followed by the block exit entry and
+   BCACHE_NUM_CHAIN chain slots; instruction and exit entries point to their
+   implementation code, chain slots point to the first entry of the chained
+   block, or NULL if the slot is unused */
+struct bcache_inst_t {
+  void *impl;				/* implementation, or chained block */
+  union {
+    md_inst_t inst;			/* instruction bits, for insts */
+    int ninsn;				/* block inst count, for exits */
+    md_addr_t PC;			/* chained block PC, for chain slots */
+  } u;
+};
+
+/* block map entry, maps a block starting address to its translation */
+struct bcache_map_t {
+  md_addr_t PC;				/* address of first instruction */
+  struct bcache_inst_t *code;		/* translation, NULL if none */
+};
+
+/* code cache size, in entries, 0 to run the plain interpreter */
+static int bcache_size;
+
+/* code cache entries holding translations */
+static counter_t bcache_occupancy = 0;
+
+/* chain translated blocks directly to their successors */
+static int bcache_chain;
+
+/* code cache, and its first free entry */
+static struct bcache_inst_t *bcache = NULL;
+static struct bcache_inst_t *bcache_free = NULL;
+
+/* block map, direct mapped on the starting PC of the block */
+static struct bcache_map_t *bcache_map = NULL;
+
+/* block exit implementation code */
+static void *bcache_exit_impl = NULL;
+
+/* block exit used to leave a block early, after a store to the text */
+static struct bcache_inst_t bcache_stop[2];
+
+/* non-zero if a system call wrote into the text segment since the last
+   code cache flush */
+static int bcache_text_dirty = FALSE;
+
+/* total number of blocks translated */
+static counter_t bcache_xlates = 0;
+
+/* total number of code cache flushes */
+static counter_t bcache_flushes = 0;
+
+/* total number of block exits resolved through the block map */
+static counter_t bcache_lookups = 0;
+
+/* total number of block chains created */
+static counter_t bcache_chains = 0;
+#endif /* USE_BLOCK_CACHE */
+
+/* non-zero if the block cache executes the program */
+#ifdef USE_BLOCK_CACHE
+#define BCACHE_ON		(bcache_size != 0)
+#else /* !USE_BLOCK_CACHE */
+#define BCACHE_ON		FALSE
+#endif /* USE_BLOCK_CACHE */
+
 /* register simulator-specific options */
 void
 sim_reg_options(struct opt_odb_t *odb)
@@ -110,6 +199,19 @@ sim_reg_options(struct opt_odb_t *odb)
 "causing sim-fast to execute incorrectly or dump core.  Such is the\n"
 "price we pay for speed!!!!\n"
 		 );
+
+#ifdef USE_BLOCK_CACHE
+  opt_reg_int(odb, "-bcache:size",
+	      "translated code cache size (in instruction entries, "
+	      "0 for no code cache)",
+	      &bcache_size, /* default */262144,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-bcache:chain",
+	       "chain translated blocks directly to their successors",
+	       &bcache_chain, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+#endif /* USE_BLOCK_CACHE */
 }
 
 /* check simulator-specific option values */
@@ -118,6 +220,14 @@ sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
   if (dlite_active)
     fatal("sim-fast does not support DLite debugging");
+
+#ifdef USE_BLOCK_CACHE
+  if (bcache_size < 0
+      || (bcache_size && bcache_size < 4 * (BCACHE_MAX_INSN + 1
+					     + BCACHE_NUM_CHAIN)))
+    fatal("translated code cache size must be 0 or at least %d entries",
+	  4 * (BCACHE_MAX_INSN + 1 + BCACHE_NUM_CHAIN));
+#endif /* USE_BLOCK_CACHE */
 }
 
 /* register simulator-specific statistics */
@@ -137,10 +247,42 @@ sim_reg_stats(struct stat_sdb_t *sdb)
 		   "simulation speed (in insts/sec)",
 		   "sim_num_insn / sim_elapsed_time", NULL);
 #endif /* !NO_INSN_COUNT */
+#ifdef USE_BLOCK_CACHE
+  if (bcache_size)
+    {
+      stat_reg_int(sdb, "bcache.size",
+		   "translated code cache size (in instruction entries)",
+		   &bcache_size, bcache_size, NULL);
+      stat_reg_counter(sdb, "bcache.occupancy",
+		       "code cache entries holding translations",
+		       &bcache_occupancy, bcache_occupancy, NULL);
+      stat_reg_formula(sdb, "bcache.occupancy_rate",
+		       "fraction of the code cache holding translations",
+		       "bcache.occupancy / bcache.size", NULL);
+      stat_reg_counter(sdb, "bcache.xlates",
+		       "total number of basic blocks translated",
+		       &bcache_xlates, bcache_xlates, NULL);
+      stat_reg_counter(sdb, "bcache.flushes",
+		       "total number of code cache flushes",
+		       &bcache_flushes, bcache_flushes, NULL);
+      stat_reg_counter(sdb, "bcache.lookups",
+		       "total number of block exits resolved through block map",
+		       &bcache_lookups, bcache_lookups, NULL);
+      stat_reg_counter(sdb, "bcache.chains",
+		       "total number of block chains created",
+		       &bcache_chains, bcache_chains, NULL);
+#ifndef NO_INSN_COUNT
+      stat_reg_formula(sdb, "bcache.insn_per_xlate",
+		       "instructions executed per block translated",
+		       "sim_num_insn / bcache.xlates", NULL);
+#endif /* !NO_INSN_COUNT */
+    }
+#endif /* USE_BLOCK_CACHE */
   ld_reg_stats(sdb);
   mem_reg_stats(mem, sdb);
-#ifdef TARGET_ALPHA
-  mem_reg_stats(dec, sdb);
+#if defined(TARGET_ALPHA)
+  if (dec)
+    mem_reg_stats(dec, sdb);
 #endif
 }
 
@@ -154,6 +296,18 @@ sim_init(void)
   /* allocate and initialize memory space */
   mem = mem_create("mem");
   mem_init(mem);
+
+#ifdef USE_BLOCK_CACHE
+  /* allocate the code cache and block map, all start out empty */
+  if (bcache_size)
+    {
+      bcache = calloc(bcache_size, sizeof(struct bcache_inst_t));
+      bcache_map = calloc(BCACHE_MAP_SIZE, sizeof(struct bcache_map_t));
+      if (!bcache || !bcache_map)
+	fatal("out of virtual memory");
+      bcache_free = bcache;
+    }
+#endif /* USE_BLOCK_CACHE */
 }
 
 /* load program into simulated state */
@@ -165,37 +319,38 @@ sim_load_prog(char *fname,		/* program to load */
   /* load program text and data, set up environment, memory, and regs */
   ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
 
-#ifdef TARGET_ALPHA
-  /* pre-decode text segment */
-  {
-    unsigned i, num_insn = (ld_text_size + 3) / 4;
+#if defined(TARGET_ALPHA)
+  /* pre-decode text segment, for the plain interpreter */
+  if (!BCACHE_ON)
+    {
+      unsigned i, num_insn = (ld_text_size + 3) / 4;
 
-    fprintf(stderr, "** pre-decoding %u insts...", num_insn);
+      fprintf(stderr, "** pre-decoding %u insts...", num_insn);
 
-    /* allocate decoded text space */
-    dec = mem_create("dec");
+      /* allocate decoded text space */
+      dec = mem_create("dec");
 
-    for (i=0; i < num_insn; i++)
-      {
-	enum md_opcode op;
-	md_inst_t inst;
-	md_addr_t PC;
+      for (i=0; i < num_insn; i++)
+	{
+	  enum md_opcode op;
+	  md_inst_t inst;
+	  md_addr_t PC;
 
-	/* compute PC */
-	PC = ld_text_base + i * sizeof(md_inst_t);
+	  /* compute PC */
+	  PC = ld_text_base + i * sizeof(md_inst_t);
 
-	/* get instruction from memory */
-	MD_FETCH_INST(inst, mem, PC);
+	  /* get instruction from memory */
+	  MD_FETCH_INST(inst, mem, PC);
 
-	/* decode the instruction */
-	MD_SET_OPCODE(op, inst);
+	  /* decode the instruction */
+	  MD_SET_OPCODE(op, inst);
 
-	/* insert into decoded opcode space */
-	MEM_WRITE_WORD(dec, PC << 1, (word_t)op);
-	MEM_WRITE_WORD(dec, (PC << 1)+sizeof(word_t), inst);
-      }
-    fprintf(stderr, "done\n");
-  }
+	  /* insert into decoded opcode space */
+	  MEM_WRITE_WORD(dec, PC << 1, (word_t)op);
+	  MEM_WRITE_WORD(dec, (PC << 1)+sizeof(word_t), inst);
+	}
+      fprintf(stderr, "done\n");
+    }
 #endif /* TARGET_ALPHA */
 }
 
@@ -282,19 +437,55 @@ sim_uninit(void)
   ((FAULT) = md_fault_none, MEM_READ_QWORD(mem, (SRC)))
 #endif /* HOST_HAS_QWORD */
 
+#ifdef USE_BLOCK_CACHE
+/* stores into the text segment flush the code cache and end the executing
+   block after the store, updates the block state local to sim_main() */
+#define TEXT_WRITE(DST)							\
+  ((md_addr_t)((DST) - ld_text_base) < ld_text_size			\
+   ? (void)(bcp = bcache_text_write(bcp))				\
+   : (void)0)
+#else /* !USE_BLOCK_CACHE */
+#define TEXT_WRITE(DST)		((void)0)
+#endif /* USE_BLOCK_CACHE */
+
 #define WRITE_BYTE(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, MEM_WRITE_BYTE(mem, (DST), (SRC)))
+  ((FAULT) = md_fault_none, TEXT_WRITE(DST),				\
+   MEM_WRITE_BYTE(mem, (DST), (SRC)))
 #define WRITE_HALF(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, MEM_WRITE_HALF(mem, (DST), (SRC)))
+  ((FAULT) = md_fault_none, TEXT_WRITE(DST),				\
+   MEM_WRITE_HALF(mem, (DST), (SRC)))
 #define WRITE_WORD(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, MEM_WRITE_WORD(mem, (DST), (SRC)))
+  ((FAULT) = md_fault_none, TEXT_WRITE(DST),				\
+   MEM_WRITE_WORD(mem, (DST), (SRC)))
 #ifdef HOST_HAS_QWORD
 #define WRITE_QWORD(SRC, DST, FAULT)					\
-  ((FAULT) = md_fault_none, MEM_WRITE_QWORD(mem, (DST), (SRC)))
+  ((FAULT) = md_fault_none, TEXT_WRITE(DST),				\
+   MEM_WRITE_QWORD(mem, (DST), (SRC)))
 #endif /* HOST_HAS_QWORD */
 
 /* system call handler macro */
+#ifdef USE_BLOCK_CACHE
+/* system calls that write into the text segment (e.g., a read() into the
+   text) flush the code cache and end the block after the trap, just like
+   stores do */
+#define SYSCALL_TEXT_WRITE()						\
+  (bcache_text_dirty ? (void)(bcp = bcache_text_write(bcp)) : (void)0)
+#ifndef NO_INSN_COUNT
+/* block instruction counts are kept at the block exit, which always follows
+   the trap, so count the block early in case the program exits */
+#define SYSCALL(INST)							\
+  (sim_num_insn += bcp[1].u.ninsn,					\
+   sys_syscall(&regs, bcache_mem_access, mem, INST, TRUE),		\
+   sim_num_insn -= bcp[1].u.ninsn,					\
+   SYSCALL_TEXT_WRITE())
+#else /* NO_INSN_COUNT */
+#define SYSCALL(INST)							\
+  (sys_syscall(&regs, bcache_mem_access, mem, INST, TRUE),		\
+   SYSCALL_TEXT_WRITE())
+#endif /* !NO_INSN_COUNT */
+#else /* !USE_BLOCK_CACHE */
 #define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
+#endif /* USE_BLOCK_CACHE */
 
 #ifndef NO_INSN_COUNT
 #define INC_INSN_CTR()	sim_num_insn++
@@ -308,11 +499,150 @@ sim_uninit(void)
 #define ZERO_FP_REG()	/* nada... */
 #endif
 
+#ifdef USE_BLOCK_CACHE
+/* discard all translations in the code cache */
+static void
+bcache_flush(void)
+{
+  int i;
+
+  for (i=0; i < BCACHE_MAP_SIZE; i++)
+    bcache_map[i].code = NULL;
+  bcache_free = bcache;
+  bcache_occupancy = 0;
+  bcache_text_dirty = FALSE;
+  bcache_flushes++;
+}
+
+/* memory accessor for system calls, notes writes into the text segment so
+   the translations of the text can be discarded after the call */
+static enum md_fault_type
+bcache_mem_access(struct mem_t *mem,	/* memory space to access */
+		  enum mem_cmd cmd,	/* Read or Write */
+		  md_addr_t addr,	/* target memory address to access */
+		  void *p,		/* where to copy to/from */
+		  int nbytes)		/* transfer length in bytes */
+{
+  if (cmd == Write
+      && addr < ld_text_base + ld_text_size
+      && addr + nbytes > ld_text_base)
+    bcache_text_dirty = TRUE;
+
+  return mem_access(mem, cmd, addr, p, nbytes);
+}
+
+/* translate the basic block starting at PC into the code cache, OP_JUMP maps
+   opcodes to their implementation code, returns the translation */
+static struct bcache_inst_t *
+bcache_xlate(md_addr_t PC,		/* address of first instruction */
+	     void **op_jump)		/* opcode implementations */
+{
+  int n;
+  md_inst_t inst;
+  enum md_opcode op;
+  struct bcache_inst_t *code;
+
+  /* make room for the largest possible block, one full code cache at a time */
+  if (bcache_free + BCACHE_MAX_INSN + 1 + BCACHE_NUM_CHAIN
+      > bcache + bcache_size)
+    bcache_flush();
+  code = bcache_free;
+
+  for (n=0; n < BCACHE_MAX_INSN; n++, PC += sizeof(md_inst_t))
+    {
+      /* get the instruction from memory, and decode it */
+      MD_FETCH_INST(inst, mem, PC);
+      MD_SET_OPCODE(op, inst);
+      if ((unsigned)op >= OP_MAX)
+	op = OP_NA;
+
+      code[n].impl = op_jump[op];
+      code[n].u.inst = inst;
+
+      /* control transfers and traps end the block */
+      if (MD_OP_FLAGS(op) & (F_CTRL|F_TRAP))
+	{
+	  n++;
+	  break;
+	}
+    }
+
+  /* terminate the block with its exit, followed by empty chain slots */
+  code[n].impl = bcache_exit_impl;
+  code[n].u.ninsn = n;
+  memset(&code[n+1], 0, BCACHE_NUM_CHAIN * sizeof(struct bcache_inst_t));
+
+  bcache_free = &code[n + 1 + BCACHE_NUM_CHAIN];
+  bcache_occupancy = bcache_free - bcache;
+  bcache_xlates++;
+
+  return code;
+}
+
+/* locate the translation of the block starting at PC, translating it on a
+   miss, if EXIT is non-NULL, the translation is chained to that block exit,
+   returns the translation */
+static struct bcache_inst_t *
+bcache_lookup(md_addr_t PC,		/* address of first instruction */
+	      void **op_jump,		/* opcode implementations */
+	      struct bcache_inst_t *exit)/* block exit to chain, or NULL */
+{
+  int i;
+  counter_t flushes = bcache_flushes;
+  struct bcache_map_t *map = &bcache_map[BCACHE_MAP_INDEX(PC)];
+
+  bcache_lookups++;
+  if (!map->code || map->PC != PC)
+    {
+      map->code = bcache_xlate(PC, op_jump);
+      map->PC = PC;
+    }
+
+  /* chain the exit to the block, unless its translation was discarded */
+  if (bcache_chain && exit && flushes == bcache_flushes)
+    {
+      for (i=1; i <= BCACHE_NUM_CHAIN; i++)
+	{
+	  if (!exit[i].impl)
+	    {
+	      exit[i].impl = map->code;
+	      exit[i].u.PC = PC;
+	      bcache_chains++;
+	      break;
+	    }
+	}
+    }
+
+  return map->code;
+}
+
+/* handle a store or system call write into the text segment by the
+   instruction at BCP, the instruction will be the last executed from its
+   block, returns the entry preceding the early block exit */
+static struct bcache_inst_t *
+bcache_text_write(struct bcache_inst_t *bcp)/* storing instruction */
+{
+  struct bcache_inst_t *exit;
+
+  /* find the block exit, and count the instructions executed so far */
+  for (exit=bcp; exit->impl != bcache_exit_impl; exit++)
+    /* nada */;
+#ifndef NO_INSN_COUNT
+  sim_num_insn += exit->u.ninsn - (exit - bcp - 1);
+#endif /* !NO_INSN_COUNT */
+
+  /* the text may no longer match any translation */
+  bcache_flush();
+
+  return &bcache_stop[0];
+}
+#endif /* USE_BLOCK_CACHE */
+
 /* start simulation, program loaded, processor precise state initialized */
 void
 sim_main(void)
 {
-#ifdef USE_JUMP_TABLE
+#if defined(USE_JUMP_TABLE) || defined(USE_BLOCK_CACHE)
   /* the jump table employs GNU GCC label extensions to construct an array
      of pointers to instruction implementation code, the simulator then uses
      the table to lookup the location of instruction's implementing code, a
@@ -331,7 +661,12 @@ sim_main(void)
 #define CONNECT(OP)
 #include "machine.def"
   };
-#endif /* USE_JUMP_TABLE */
+#endif /* USE_JUMP_TABLE || USE_BLOCK_CACHE */
+
+#ifdef USE_BLOCK_CACHE
+  /* executing code cache entry */
+  register struct bcache_inst_t *bcp;
+#endif /* USE_BLOCK_CACHE */
 
   /* register allocate instruction buffer */
   register md_inst_t inst;
@@ -345,7 +680,88 @@ sim_main(void)
   if (sim_swap_bytes || sim_swap_words)
     fatal("sim: *fast* functional simulation cannot swap bytes or words");
 
-#ifdef USE_JUMP_TABLE
+#if defined(USE_BLOCK_CACHE)
+
+  /* set up initial default next PC */
+  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+
+  /* without a code cache, run the plain interpreter below */
+  if (!bcache_size)
+    goto interp;
+
+  /* block exits jump to bcache_exit, early exits to bcache_enter */
+  bcache_exit_impl = &&bcache_exit;
+  bcache_stop[1].impl = &&bcache_enter;
+
+ bcache_enter:
+  /* enter the block at the next PC, without chaining */
+  bcp = bcache_lookup(regs.regs_PC, op_jump, NULL);
+  goto *bcp->impl;
+
+ bcache_exit:
+  /* keep an instruction count */
+#ifndef NO_INSN_COUNT
+  sim_num_insn += bcp->u.ninsn;
+#endif /* !NO_INSN_COUNT */
+
+  /* follow the chain to the next block, if the block exit has one */
+  if (bcp[1].u.PC == regs.regs_PC && bcp[1].impl)
+    {
+      bcp = bcp[1].impl;
+      goto *bcp->impl;
+    }
+  if (bcp[2].u.PC == regs.regs_PC && bcp[2].impl)
+    {
+      bcp = bcp[2].impl;
+      goto *bcp->impl;
+    }
+
+  /* otherwise, locate the next block and chain the block exit to it */
+  bcp = bcache_lookup(regs.regs_PC, op_jump, bcp);
+  goto *bcp->impl;
+
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
+  opcode_##OP:								\
+    /* maintain $r0 semantics */					\
+    regs.regs_R[MD_REG_ZERO] = 0;					\
+    ZERO_FP_REG();							\
+									\
+    /* get the instruction bits */					\
+    inst = bcp->u.inst;							\
+									\
+    /* execute the instruction */					\
+    do { SYMCAT(OP,_IMPL); } while (0);					\
+									\
+    /* execute next instruction */					\
+    regs.regs_PC = regs.regs_NPC;					\
+    regs.regs_NPC += sizeof(md_inst_t);					\
+									\
+    /* jump to next instruction implementation, or the block exit */	\
+    goto *(++bcp)->impl;
+
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+  opcode_##OP:								\
+    panic("attempted to execute a linking opcode");
+#define CONNECT(OP)
+#define DECLARE_FAULT(FAULT)						\
+	  { /* uncaught... */break; }
+#include "machine.def"
+
+  opcode_NA:
+    panic("attempted to execute a bogus opcode");
+
+  /* should not get here... */
+  panic("exited sim-fast main loop");
+
+  /* the plain interpreter does not track blocks */
+#undef TEXT_WRITE
+#define TEXT_WRITE(DST)		((void)0)
+#undef SYSCALL
+#define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
+
+ interp:
+
+#elif defined(USE_JUMP_TABLE)
 
   regs.regs_NPC = regs.regs_PC;
 
@@ -395,10 +811,14 @@ sim_main(void)
   /* should not get here... */
   panic("exited sim-fast main loop");
 
-#else /* !USE_JUMP_TABLE */
+#endif /* USE_BLOCK_CACHE || USE_JUMP_TABLE */
+
+#if defined(USE_BLOCK_CACHE) || !defined(USE_JUMP_TABLE)
 
+#ifndef USE_BLOCK_CACHE
   /* set up initial default next PC */
   regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+#endif /* !USE_BLOCK_CACHE */
 
   while (TRUE)
     {
@@ -449,5 +869,5 @@ sim_main(void)
       regs.regs_NPC += sizeof(md_inst_t);
     }
 
-#endif /* USE_JUMP_TABLE */
+#endif /* USE_BLOCK_CACHE || !USE_JUMP_TABLE */
 }
@@ -54,6 +54,9 @@
 #include <math.h>
 #include <assert.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "host.h"
 #include "misc.h"
@@ -61,6 +64,7 @@
 #include "regs.h"
 #include "memory.h"
 #include "cache.h"
+#include "prefetch.h"
 #include "loader.h"
 #include "syscall.h"
 #include "bpred.h"
@@ -73,6 +77,8 @@
 #include "dlite.h"
 #include "sim.h"
 #include "mshr.h"
+#include "dram.h"
+#include "bus.h"
 
 /*
  * This file implements a very detailed out-of-order issue superscalar
@@ -98,6 +104,25 @@ static unsigned int max_insts;
 /* number of insts skipped before timing starts */
 static int fastfwd_count;
 
+/* sampled simulation period, measured unit size and detailed warm-up size
+   (in insts), a zero period disables sampling */
+static unsigned int sample_period;
+static unsigned int sample_unit;
+static unsigned int sample_warmup;
+
+/* warm caches and branch predictors between sampled units */
+static int sample_fwarm;
+
+/* explicit sampling windows, as the inst offsets (after any fast forward)
+   at which the detailed warm-up of each measured unit starts */
+#define MAX_SAMPLE_WINDOWS 1024
+static int sample_nwindows = 0;
+static unsigned int sample_windows[MAX_SAMPLE_WINDOWS];
+
+/* number of host processes simulating sampled units in parallel, zero
+   simulates all units in this process */
+static int sample_jobs;
+
 /* pipeline trace range and output filename */
 static int ptrace_nelt = 0;
 static char *ptrace_opts[2];
@@ -129,6 +154,30 @@ static int comb_nelt = 1;
 static int comb_config[1] =
   { /* meta_table_size */1024 };
 
+/* TAGE predictor config
+   (<tables> <log_size> <tag_bits> <min_hist> <max_hist> <log_base>) */
+static int tage_nelt = 6;
+static int tage_config[6] =
+  { /* tables */8, /* log_size */10, /* tag_bits */11,
+    /* min_hist */4, /* max_hist */256, /* log_base */13 };
+
+/* TAGE statistical corrector table size (log2, 0 for no corrector) */
+static int tage_sc_size = 10;
+
+/* TAGE loop predictor size (0 for no loop predictor) */
+static int tage_loop_size = 64;
+
+/* perceptron predictor config (<num_perceptrons> <hist_len>) */
+static int perc_nelt = 2;
+static int perc_config[2] =
+  { /* num_perceptrons */1024, /* hist_len */32 };
+
+/* indirect target predictor config
+   (<num_sets> <associativity> <path_len>), no predictor if 0 sets */
+static int indir_nelt = 3;
+static int indir_config[3] =
+  { /* num_sets */0, /* assoc */4, /* path_len */4 };
+
 /* return address stack (RAS) size */
 static int ras_size = 8;
 
@@ -158,11 +207,32 @@ static int RUU_size = 8;
 /* load/store queue (LSQ) size */
 static int LSQ_size = 4;
 
+/* event queue timing wheel size (in cycles), 0 uses a sorted list */
+static int eventq_wheel_size;
+
+/* keep the ready queue as per-slot bitmaps rather than a sorted list */
+static int readyq_bitmap;
+
+/* skip over cycles in which no pipeline stage can make progress */
+static int skip_idle;
+
+/* pre-decoded instruction cache size (in instructions), 0 disables it */
+static int decode_cache_size;
+
 /* l1 data cache config, i.e., {<config>|none} */
 static char *cache_dl1_opt;
 
-/* mshr config, i.e., {<config>|none} */
-static char *mshr_opt;
+/* l1 data cache MSHR config, i.e., {<config>|none} */
+static char *mshr_dl1_opt;
+
+/* l2 data cache MSHR config, i.e., {<config>|none} */
+static char *mshr_dl2_opt;
+
+/* l1 inst cache MSHR config, i.e., {<config>|none} */
+static char *mshr_il1_opt;
+
+/* l2 inst cache MSHR config, i.e., {<config>|none} */
+static char *mshr_il2_opt;
 
 /* mshr hit latency (in cycles) */
 static int mshr_lat;  
@@ -188,6 +258,22 @@ static char *cache_il2_opt;
 /* l2 instruction cache hit latency (in cycles) */
 static int cache_il2_lat;
 
+/* cache prefetcher configs, i.e., {<config>|none} */
+static char *pf_dl1_opt;
+static char *pf_dl2_opt;
+static char *pf_il1_opt;
+static char *pf_il2_opt;
+
+/* victim cache configs, i.e., {<nblks>:<lat>|none} */
+static char *vc_dl1_opt;
+static char *vc_dl2_opt;
+static char *vc_il1_opt;
+static char *vc_il2_opt;
+
+/* l2 cache hierarchy policies, i.e., {nine|incl|excl} */
+static char *hier_dl2_opt;
+static char *hier_il2_opt;
+
 
 /* flush caches on system calls */
 static int flush_on_syscalls;
@@ -203,6 +289,31 @@ static int mem_lat[2] =
 /* memory access bus width (in bytes) */
 static int mem_bus_width;
 
+/* DRAM system config, i.e., {<config>|none} */
+static char *dram_opt;
+
+/* DRAM timing (<tRCD> <tRP> <tCAS>) */
+static int dram_nelt = 3;
+static int dram_lat[3] =
+  { /* activate to column */12, /* precharge */12, /* column to data */12 };
+
+/* DRAM requests queued per channel */
+static int dram_queue;
+
+/* DRAM system, main memory timing when not NULL */
+static struct dram_t *dram = NULL;
+
+/* l1 caches to l2 caches interconnect config, i.e., {<config>|none} */
+static char *bus_l2_opt;
+
+/* lowest level caches to main memory interconnect config, i.e.,
+   {<config>|none} */
+static char *bus_mem_opt;
+
+/* interconnects of the cache levels */
+static struct bus_t *buses[4];
+static int nbuses = 0;
+
 /* instruction TLB config, i.e., {<config>|none} */
 static char *itlb_opt;
 
@@ -349,6 +460,37 @@ static counter_t LSQ_fcount;		/* cumulative LSQ full count */
 /* total non-speculative bogus addresses seen (debug var) */
 static counter_t sim_invalid_addrs;
 
+/* total idle cycles skipped over by the main loop */
+static counter_t sim_idle_skipped;
+
+/* pre-decoded instruction cache lookups and hits */
+static counter_t decode_lookups;
+static counter_t decode_hits;
+
+/* total number of sampled units measured */
+static counter_t sample_units;
+
+/* total number of parallel sampled units that could not be simulated */
+static counter_t sample_dropped;
+
+/* total number of insts executed functionally between sampled units */
+static counter_t sample_fwd_insn;
+
+/* sum and sum of squares of sampled unit CPIs */
+static double sample_cpi_sum;
+static double sample_cpi_sum2;
+
+/* sampled CPI mean, standard deviation and confidence interval */
+static double sample_cpi;
+static double sample_cpi_stddev;
+static double sample_cpi_ci;
+
+/* set when any pipeline stage makes progress in the current cycle (an inst
+   is committed, completes, becomes ready, issues, is dispatched or fetched,
+   fetch blocks on a miss, or a functional unit is released), used to detect
+   idle cycles */
+static int pipe_active;
+
 /*
  * simulator state variables
  */
@@ -368,6 +510,12 @@ static int spec_mode = FALSE;
 /* cycles until fetch issue resumes */
 static unsigned ruu_fetch_issue_delay = 0;
 
+/* fetch is waiting for a free I-cache MSHR this cycle */
+static int ruu_fetch_mshr_blocked = FALSE;
+
+/* loads that waited for a free D-cache MSHR this cycle */
+static int ruu_issue_mshr_blocked = 0;
+
 /* perfect prediction enabled */
 static int pred_perfect = FALSE;
 
@@ -387,8 +535,9 @@ struct cache_t *cache_dl1 = NULL;  // static 제거, 전역 변수로 선언
 /* level 2 data cache */
 static struct cache_t *cache_dl2;
 
-/* added: mshr */
-extern struct mshr_t *mshr;
+/* MSHR files of the cache levels, updated every cycle */
+static struct mshr_t *mshr_files[4];
+static int mshr_nfiles = 0;
 
 extern struct miss_queue_heap *miss_queue;  
 
@@ -432,6 +581,27 @@ mem_access_latency(int blk_sz)		/* block size accessed */
 	  (/* remainder chunk latency */mem_lat[1] * (chunks - 1)));
 }
 
+/* access main memory with CMD at block address BADDR at NOW, returns the
+   latency of the access */
+static unsigned int			/* total latency of access */
+main_mem_access(enum mem_cmd cmd,	/* access cmd, Read or Write */
+		md_addr_t baddr,	/* block address to access */
+		int bsize,		/* size of block to access */
+		tick_t now)		/* time of access */
+{
+  /* the DRAM model queues writes in its controllers */
+  if (dram)
+    return dram_access(dram, cmd, baddr, bsize, now);
+
+  if (cmd == Read)
+    return mem_access_latency(bsize);
+  else
+    {
+      /* FIXME: unlimited write buffers */
+      return 0;
+    }
+}
+
 /*
  * cache miss handlers
  */
@@ -449,6 +619,7 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
   if (cache_dl2)
     {
       /* access next level of data cache hierarchy */
+      cache_dl2->access_pc = cache_dl1->access_pc;
       lat = cache_access(cache_dl2, cmd, baddr, NULL, bsize,
 			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
       if (cmd == Read)
@@ -462,13 +633,7 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
   else
     {
       /* access main memory */
-      if (cmd == Read)
-	return mem_access_latency(bsize);
-      else
-	{
-	  /* FIXME: unlimited write buffers */
-	  return 0;
-	}
+      return main_mem_access(cmd, baddr, bsize, now);
     }
 }
 
@@ -481,13 +646,7 @@ dl2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      tick_t now)		/* time of access */
 {
   /* this is a miss to the lowest level, so access main memory */
-  if (cmd == Read)
-    return mem_access_latency(bsize);
-  else
-    {
-      /* FIXME: unlimited write buffers */
-      return 0;
-    }
+  return main_mem_access(cmd, baddr, bsize, now);
 }
 
 /* l1 inst cache l1 block miss handler function */
@@ -503,6 +662,7 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 if (cache_il2)
     {
       /* access next level of inst cache hierarchy */
+      cache_il2->access_pc = cache_il1->access_pc;
       lat = cache_access(cache_il2, cmd, baddr, NULL, bsize,
 			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
       if (cmd == Read)
@@ -514,7 +674,7 @@ if (cache_il2)
     {
       /* access main memory */
       if (cmd == Read)
-	return mem_access_latency(bsize);
+	return main_mem_access(cmd, baddr, bsize, now);
       else
 	panic("writes to instruction memory not supported");
     }
@@ -530,7 +690,7 @@ il2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 {
   /* this is a miss to the lowest level, so access main memory */
   if (cmd == Read)
-    return mem_access_latency(bsize);
+    return main_mem_access(cmd, baddr, bsize, now);
   else
     panic("writes to instruction memory not supported");
 }
@@ -628,6 +788,57 @@ sim_reg_options(struct opt_odb_t *odb)
 "                -ptrace FOOBAR.trc @main:+278\n"
 	       );
 
+  /* sampling options */
+
+  opt_reg_uint(odb, "-sample:period",
+	       "sampling period (in insts, 0 = no sampling)",
+	       &sample_period, /* default */0,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_uint(odb, "-sample:unit",
+	       "measured detailed insts per sampling period",
+	       &sample_unit, /* default */1000,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_uint(odb, "-sample:warmup",
+	       "detailed warm-up insts before each measured unit",
+	       &sample_warmup, /* default */2000,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_flag(odb, "-sample:fwarm",
+	       "warm caches and bpred during functional simulation",
+	       &sample_fwarm, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_uint_list(odb, "-sample:windows",
+		    "inst offsets of sampling windows (detailed warm-up start)",
+		    sample_windows, MAX_SAMPLE_WINDOWS, &sample_nwindows,
+		    /* default */NULL, /* !print */FALSE, /* format */NULL,
+		    /* !accrue */FALSE);
+  opt_reg_int(odb, "-sample:jobs",
+	      "host processes simulating sampled units in parallel",
+	      &sample_jobs, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  Sampled simulation repeats the following for every -sample:period insts\n"
+"  (after any -fastfwd insts): functional simulation, with caches and\n"
+"  branch predictors warmed if -sample:fwarm is set, then -sample:warmup\n"
+"  insts of detailed simulation, then -sample:unit insts of detailed\n"
+"  simulation that are measured, after which the pipeline is drained.  The\n"
+"  sample.* statistics give the mean CPI of the measured units and its\n"
+"  99.7% confidence interval.  When sampling, -max:inst limits the total\n"
+"  number of insts executed, functionally or in detail.\n"
+"\n"
+"  With -sample:jobs N > 0, the program is run functionally once, and at the\n"
+"  start of each unit a copy of the simulator is forked that simulates the\n"
+"  unit in detail, at most N at a time, the statistics of all units are\n"
+"  merged into those of the main process.  -sample:windows lists explicit\n"
+"  unit start offsets instead of a sampling period, e.g.,\n"
+"\n"
+"                -sample:jobs 64 -sample:windows 1000000 5000000 9000000\n"
+"\n"
+"  The copies replay the system calls executed by the main process, a unit\n"
+"  that needs a call the main process did not send it is dropped and\n"
+"  counted in sample.dropped_units.\n"
+	       );
+
   /* ifetch options */
 
   opt_reg_int(odb, "-fetch:ifqsize", "instruction fetch queue size (in insts)",
@@ -659,10 +870,16 @@ sim_reg_options(struct opt_odb_t *odb)
 "      PAp     : N, W, M (M == 2^(N+W)), 0\n"
 "      gshare  : 1, W, 2^W, 1\n"
 "  Predictor `comb' combines a bimodal and a 2-level predictor.\n"
+"  Predictor `tage' is a TAGE-SC-L predictor with N tagged tables of 2^S\n"
+"    entries, T-bit tags and geometric history lengths from Lmin to Lmax\n"
+"    over a 2^B entry bimodal base, optionally refined by a statistical\n"
+"    corrector and a loop predictor.\n"
+"  Predictor `perc' is a perceptron predictor with N perceptrons over H\n"
+"    bits of global history.\n"
                );
 
   opt_reg_string(odb, "-bpred",
-		 "branch predictor type {nottaken|taken|perfect|bimod|2lev|comb}",
+		 "branch predictor type {nottaken|taken|perfect|bimod|2lev|comb|tage|perc}",
                  &pred_type, /* default */"bimod",
                  /* print */TRUE, /* format */NULL);
 
@@ -685,6 +902,36 @@ sim_reg_options(struct opt_odb_t *odb)
 		   /* default */comb_config,
 		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
 
+  opt_reg_int_list(odb, "-bpred:tage",
+		   "TAGE predictor config (<tables> <log_size> <tag_bits> "
+		   "<min_hist> <max_hist> <log_base>)",
+		   tage_config, tage_nelt, &tage_nelt,
+		   /* default */tage_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-bpred:tage_sc",
+	      "TAGE statistical corrector table size (log2, 0 for none)",
+	      &tage_sc_size, /* default */tage_sc_size,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-bpred:tage_loop",
+	      "TAGE loop predictor entries (0 for none)",
+	      &tage_loop_size, /* default */tage_loop_size,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int_list(odb, "-bpred:perc",
+		   "perceptron predictor config (<num_perceptrons> <hist_len>)",
+		   perc_config, perc_nelt, &perc_nelt,
+		   /* default */perc_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:indir",
+		   "indirect target predictor config "
+		   "(<num_sets> <associativity> <path_len>, 0 sets for none)",
+		   indir_config, indir_nelt, &indir_nelt,
+		   /* default */indir_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
   opt_reg_int(odb, "-bpred:ras",
               "return address stack size (0 for no return stack)",
               &ras_size, /* default */ras_size,
@@ -708,6 +955,11 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &ruu_decode_width, /* default */4,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-decode:cache",
+	      "pre-decoded instruction cache size (in insts, 0 = none)",
+	      &decode_cache_size, /* default */4096,
+	      /* print */TRUE, /* format */NULL);
+
   /* issue options */
 
   opt_reg_int(odb, "-issue:width",
@@ -745,6 +997,21 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &LSQ_size, /* default */8,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-eventq:wheel",
+	      "event queue timing wheel size (in cycles, 0 = sorted list)",
+	      &eventq_wheel_size, /* default */1024,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-readyq:bitmap",
+	       "keep the ready queue as bitmaps indexed by RUU/LSQ slot",
+	       &readyq_bitmap, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-skip:idle",
+	       "skip idle cycles (no stage can make progress) in one step",
+	       &skip_idle, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+
   /* cache options */
 
   opt_reg_string(odb, "-cache:dl1",
@@ -761,7 +1028,9 @@ sim_reg_options(struct opt_odb_t *odb)
 "    <nsets>  - number of sets in the cache\n"
 "    <bsize>  - block size of the cache\n"
 "    <assoc>  - associativity of the cache\n"
-"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random\n"
+"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random,\n"
+"               'p'-tree-PLRU, 's'-SRRIP, 'b'-BRRIP, 'd'-DRRIP (set dueling),\n"
+"               'h'-SHiP (RRIP with memory-region reuse prediction)\n"
 "\n"
 "    Examples:   -cache:dl1 dl1:4096:32:1:l\n"
 "                -dtlb dtlb:128:4096:32:r\n"
@@ -816,6 +1085,112 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_il2_lat, /* default */6,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-cache:dl1pf",
+		 "l1 data cache prefetcher, i.e., {<config>|none}",
+		 &pf_dl1_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:dl2pf",
+		 "l2 data cache prefetcher, i.e., {<config>|none}",
+		 &pf_dl2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:il1pf",
+		 "l1 inst cache prefetcher, i.e., {<config>|none}",
+		 &pf_il1_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:il2pf",
+		 "l2 inst cache prefetcher, i.e., {<config>|none}",
+		 &pf_il2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  The cache prefetcher parameter <config> has one of the following formats:\n"
+"\n"
+"    nextline:<degree>          - tagged next-line, fetch the <degree> blocks\n"
+"                                 after a miss or a first prefetched hit\n"
+"    stride:<entries>:<degree>  - per-PC stride table with <entries> entries,\n"
+"                                 fetch <degree> strides ahead\n"
+"    stream:<buffers>:<depth>   - <buffers> stream buffers, each keeps the\n"
+"                                 <depth> blocks after its last reference\n"
+"\n"
+"  Prefetches fill the cache they are attached to, through its miss handler.\n"
+"  An instruction cache unified with a data cache uses the data cache\n"
+"  prefetcher, e.g.,\n"
+"\n"
+"    -cache:dl1pf stride:256:2 -cache:dl2pf stream:8:4\n"
+		);
+
+  opt_reg_string(odb, "-cache:dl1vc",
+		 "l1 data cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_dl1_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:dl2vc",
+		 "l2 data cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_dl2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:il1vc",
+		 "l1 inst cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_il1_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:il2vc",
+		 "l2 inst cache victim cache, i.e., {<nblks>:<lat>|none}",
+		 &vc_il2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:dl2hier",
+		 "l2 data cache policy to l1 caches, i.e., {nine|incl|excl}",
+		 &hier_dl2_opt, "nine", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-cache:il2hier",
+		 "l2 inst cache policy to l1 caches, i.e., {nine|incl|excl}",
+		 &hier_il2_opt, "nine", /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  A victim cache holds the <nblks> blocks last replaced in its cache, fully\n"
+"  associative, a miss found in it swaps the block back in <lat> cycles\n"
+"  after the cache hit latency.\n"
+"\n"
+"  The l2 cache hierarchy policies are:\n"
+"\n"
+"    nine - non-inclusive non-exclusive, the l2 cache allocates every block\n"
+"           it misses, no relation to the l1 caches is enforced\n"
+"    incl - inclusive, replacing an l2 block invalidates it in the l1\n"
+"           caches (back-invalidation)\n"
+"    excl - exclusive, an l2 block read by an l1 cache moves up (a swap),\n"
+"           l2 read misses are not allocated, and the l1 caches write\n"
+"           their replaced blocks, clean or dirty, into the l2 cache\n"
+"\n"
+"  An exclusive cache cannot have a victim cache, it is one for the caches\n"
+"  above, e.g.,\n"
+"\n"
+"    -cache:dl1vc 8:1 -cache:dl2hier incl\n"
+		);
+
+  opt_reg_string(odb, "-bus:l2",
+		 "l1 to l2 caches interconnect config, i.e., {<config>|none}",
+		 &bus_l2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-bus:mem",
+		 "caches to memory interconnect config, i.e., {<config>|none}",
+		 &bus_mem_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  The interconnect config parameter <config> has the following format:\n"
+"\n"
+"    <name>:<width>:<ratio>:<mode>:<wbufs>\n"
+"\n"
+"    <name>  - name of the bus, prefixes its statistics\n"
+"    <width> - bytes transferred per bus cycle\n"
+"    <ratio> - CPU cycles per bus cycle\n"
+"    <mode>  - {p|a|x} = pipelined (split-transaction) bus, atomic bus,\n"
+"              or crossbar, a pipelined bus of its own for every cache\n"
+"    <wbufs> - write-back buffers, 0 = caches wait for their write-backs\n"
+"\n"
+"  -bus:l2 connects the l1 caches to the l2 caches, -bus:mem connects the\n"
+"  lowest level caches to main memory.  Without an interconnect, a cache\n"
+"  has a fully-pipelined port to the next level, busy one cycle per block\n"
+"  replaced, and unlimited write buffers, e.g.,\n"
+"\n"
+"    -bus:l2 l2bus:32:1:x:8 -bus:mem membus:8:4:p:4\n"
+		);
+
   opt_reg_flag(odb, "-cache:flush", "flush caches on system calls",
 	       &flush_on_syscalls, /* default */FALSE, /* print */TRUE, NULL);
 
@@ -823,6 +1198,7 @@ sim_reg_options(struct opt_odb_t *odb)
 	       "convert 64-bit inst addresses to 32-bit inst equivalents",
 	       &compress_icache_addrs, /* default */FALSE,
 	       /* print */TRUE, NULL);
+  cache_reg_options(odb);
 
   /* mem options */
   opt_reg_int_list(odb, "-mem:lat",
@@ -834,6 +1210,39 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &mem_bus_width, /* default */8,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-mem:dram",
+		 "DRAM system config, i.e., {<config>|none}",
+		 &dram_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_int_list(odb, "-mem:dramlat",
+		   "DRAM timing (<tRCD> <tRP> <tCAS>)",
+		   dram_lat, dram_nelt, &dram_nelt, dram_lat,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-mem:dramq", "DRAM requests queued per channel",
+	      &dram_queue, /* default */32,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  The DRAM config parameter <config> has the following format:\n"
+"\n"
+"    <channels>:<ranks>:<banks>:<rowsize>:<page>\n"
+"\n"
+"    <channels> - number of independent channels (a power of two)\n"
+"    <ranks>    - ranks per channel (a power of two)\n"
+"    <banks>    - banks per rank (a power of two)\n"
+"    <rowsize>  - row buffer size in bytes (a power of two)\n"
+"    <page>     - row buffer policy, {o|c} = open page or closed page\n"
+"\n"
+"  With a DRAM system, main memory accesses are scheduled FR-FCFS by the\n"
+"  controller of their channel, and take -mem:dramlat cycles to precharge,\n"
+"  activate and access a row, then -mem:lat's inter-chunk latency per\n"
+"  -mem:width bytes on the data bus; -mem:lat's first chunk latency is not\n"
+"  used.  Writes are queued, but do not stall the cache writing back, e.g.,\n"
+"\n"
+"    -mem:dram 2:1:8:2048:o -mem:dramlat 14 14 14\n"
+		);
+
   /* TLB options */
 
   opt_reg_string(odb, "-tlb:itlb",
@@ -886,10 +1295,37 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &bugcompat_mode, /* default */FALSE, /* print */TRUE, NULL);
 
   /* mshr options */
-  opt_reg_string(odb, "-mshr",
-                 "mshr config, i.e., {<config>|none}",
-                 &mshr_opt, "mshr:8:32:4:l",  /* default: 8 entries, 32 blocks/entry, 4B block size */
-                 /* print */TRUE, NULL);
+  opt_reg_string(odb, "-mshr:dl1",
+		 "l1 data cache MSHR config, i.e., {<config>|none}",
+		 &mshr_dl1_opt, "mshr_dl1:8:4", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-mshr:dl2",
+		 "l2 data cache MSHR config, i.e., {<config>|none}",
+		 &mshr_dl2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-mshr:il1",
+		 "l1 inst cache MSHR config, i.e., {<config>|none}",
+		 &mshr_il1_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_string(odb, "-mshr:il2",
+		 "l2 inst cache MSHR config, i.e., {<config>|none}",
+		 &mshr_il2_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  The MSHR config parameter <config> has the following format:\n"
+"\n"
+"    <name>:<entries>:<targets>\n"
+"\n"
+"    <name>    - name of the MSHR file, prefixes its statistics\n"
+"    <entries> - outstanding misses (primary misses) of the cache\n"
+"    <targets> - accesses merged into each outstanding miss\n"
+"\n"
+"  Loads that would miss in the l1 data cache stall at issue, and fetch\n"
+"  stalls on l1 inst cache misses, while no entry (or target of the\n"
+"  outstanding miss to their block) is free; the l2 MSHRs count the misses\n"
+"  they cannot track.  An inst cache unified with a data cache uses the\n"
+"  data cache MSHRs, `none' tracks no misses.\n"
+		);
 
   opt_reg_int(odb, "-mshr:lat",
               "mshr hit latency (in cycles)",
@@ -897,17 +1333,182 @@ sim_reg_options(struct opt_odb_t *odb)
               /* print */TRUE, /* format */NULL);
 }
 
+/* attach the prefetcher configured by OPT to cache CP, named WHAT, which is
+   UNIFIED with a data cache */
+static void
+pf_attach(struct cache_t *cp,		/* cache to attach prefetcher to */
+	  char *opt,			/* prefetcher configuration */
+	  char *what,			/* name of the cache level */
+	  int unified)			/* is CP also a data cache? */
+{
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!cp)
+    fatal("a %s prefetcher requires the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache prefetcher", what);
+  cp->pf = prefetch_create(opt, cp->bsize);
+}
+
+/* attach the victim cache configured by OPT to cache CP, named WHAT, which
+   is UNIFIED with a data cache */
+static void
+vc_attach(struct cache_t *cp,		/* cache to attach victim cache to */
+	  char *opt,			/* victim cache configuration */
+	  char *what,			/* name of the cache level */
+	  int unified)			/* is CP also a data cache? */
+{
+  int nblks, lat;
+
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!cp)
+    fatal("a %s victim cache requires the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache victim cache", what);
+  if (cp->hier == Exclusive)
+    fatal("the %s is exclusive, it cannot have a victim cache", what);
+  if (sscanf(opt, "%d:%d", &nblks, &lat) != 2)
+    fatal("bad %s victim cache parms: <nblks>:<lat>", what);
+  if (lat < 0)
+    fatal("victim cache latency must be non-negative");
+  cache_victim(cp, nblks, lat);
+}
+
+/* set the hierarchy policy of l2 cache CP, named WHAT, which is UNIFIED
+   with the l2 data cache, to the one configured by OPT */
+static void
+hier_attach(struct cache_t *cp,		/* l2 cache */
+	    char *opt,			/* hierarchy policy */
+	    char *what,			/* name of the cache level */
+	    int unified)		/* is CP also the l2 data cache? */
+{
+  enum cache_hier hier = cache_str2hier(opt);
+  int i;
+
+  if (hier == NINE)
+    return;
+  if (!cp)
+    fatal("a %s policy requires the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache policy", what);
+  if (!cp->ninner)
+    fatal("the %s has no l1 caches to enforce its policy on", what);
+
+  /* blocks move whole between exclusive levels */
+  for (i=0; hier == Exclusive && i<cp->ninner; i++)
+    {
+      if (cp->inner[i]->bsize != cp->bsize)
+	fatal("the exclusive %s needs the block size of its l1 caches", what);
+    }
+  cp->hier = hier;
+}
+
+/* attach the MSHR file configured by OPT to cache CP, named WHAT, which
+   is UNIFIED with a data cache */
+static void
+mshr_attach(struct cache_t *cp,		/* cache to attach MSHRs to */
+	    char *opt,			/* MSHR configuration */
+	    char *what,			/* name of the cache level */
+	    int unified)		/* is CP also a data cache? */
+{
+  char name[128];
+  int nentries, ntargets;
+
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!cp)
+    fatal("%s MSHRs require the %s to be defined", what, what);
+  if (unified)
+    fatal("the %s is unified, use its data cache MSHRs", what);
+  if (sscanf(opt, "%[^:]:%d:%d", name, &nentries, &ntargets) != 3)
+    fatal("bad %s MSHR parms: <name>:<entries>:<targets>", what);
+  if (nentries <= 0 || ntargets <= 0)
+    fatal("MSHR entries and targets per entry must be positive");
+
+  cp->mshr = mshr_create(cp->bsize, nentries, ntargets);
+  cp->mshr->name = mystrdup(name);
+  cp->mshr->cache = cp;
+  mshr_files[mshr_nfiles++] = cp->mshr;
+}
+
+/* connect the N caches CPS to the next level of memory with the
+   interconnect configured by OPT, named WHAT */
+static void
+bus_attach(char *opt,			/* interconnect configuration */
+	   char *what,			/* name of the interconnect */
+	   struct cache_t **cps,	/* caches connected */
+	   int n)			/* number of caches connected */
+{
+  char name[128], portname[256], mode;
+  int i, width, ratio, wbufs;
+  struct bus_t *bus = NULL;
+
+  if (!mystricmp(opt, "none"))
+    return;
+  if (!n)
+    fatal("the %s interconnect has no caches to connect", what);
+  if (sscanf(opt, "%[^:]:%d:%d:%c:%d",
+	     name, &width, &ratio, &mode, &wbufs) != 5)
+    fatal("bad %s interconnect parms: "
+	  "<name>:<width>:<ratio>:<mode>:<wbufs>", what);
+  if (mode != 'p' && mode != 'a' && mode != 'x')
+    fatal("bogus %s interconnect mode, `%c'", what, mode);
+
+  for (i=0; i<n; i++)
+    {
+      if (mode == 'x')
+	{
+	  /* a crossbar gives every cache its own link */
+	  sprintf(portname, "%s_%s", name, cps[i]->name);
+	  bus = bus_create(portname, width, ratio, BUS_Pipelined, wbufs);
+	  buses[nbuses++] = bus;
+	}
+      else if (!bus)
+	{
+	  bus = bus_create(name, width, ratio,
+			   mode == 'a' ? BUS_Atomic : BUS_Pipelined, wbufs);
+	  buses[nbuses++] = bus;
+	}
+      cps[i]->bus = bus;
+    }
+}
+
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb,        /* options database */
 		  int argc, char **argv)        /* command line arguments */
 {
   char name[128], c;
-  int nsets, bsize, assoc;
+  int nsets, bsize, assoc, n;
+  struct cache_t *cps[2];
 
   if (fastfwd_count < 0 || fastfwd_count >= 2147483647)
     fatal("bad fast forward count: %d", fastfwd_count);
 
+  if (sample_period && sample_nwindows)
+    fatal("-sample:period and -sample:windows are mutually exclusive");
+  if (sample_period || sample_nwindows)
+    {
+      if (sample_unit < 1)
+	fatal("sampled unit size must be at least one inst");
+      if (sample_period && sample_period <= sample_unit + sample_warmup)
+	fatal("sampling period must be larger than unit plus warm-up size");
+    }
+  if (sample_jobs < 0)
+    fatal("number of sampling jobs must be non-negative");
+  if (sample_nwindows)
+    {
+      int i;
+
+      if (!sample_jobs)
+	fatal("-sample:windows requires -sample:jobs");
+      for (i=1; i < sample_nwindows; i++)
+	if (sample_windows[i] < sample_windows[i-1] + sample_warmup
+	                        + sample_unit)
+	  fatal("sampling windows must be ascending and may not overlap");
+    }
+
   if (ruu_ifq_size < 1 || (ruu_ifq_size & (ruu_ifq_size - 1)) != 0)
     fatal("inst fetch queue size must be positive > 0 and a power of two");
 
@@ -995,9 +1596,61 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 			  /* btb assoc */btb_config[1],
 			  /* ret-addr stack size */ras_size);
     }
+  else if (!mystricmp(pred_type, "tage"))
+    {
+      /* TAGE-SC-L predictor, bpred_tage_create() checks args */
+      if (tage_nelt != 6)
+	fatal("bad TAGE pred config (<tables> <log_size> <tag_bits> "
+	      "<min_hist> <max_hist> <log_base>)");
+      if (tage_sc_size < 0 || tage_loop_size < 0)
+	fatal("TAGE SC and loop predictor sizes must be non-negative");
+      if (btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      pred = bpred_tage_create(/* tagged tables */tage_config[0],
+			       /* log2 table size */tage_config[1],
+			       /* tag width */tage_config[2],
+			       /* shortest history */tage_config[3],
+			       /* longest history */tage_config[4],
+			       /* log2 base table size */tage_config[5],
+			       /* log2 SC table size */tage_sc_size,
+			       /* loop predictor size */tage_loop_size,
+			       /* btb sets */btb_config[0],
+			       /* btb assoc */btb_config[1],
+			       /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(pred_type, "perc"))
+    {
+      /* perceptron predictor, bpred_create() checks args */
+      if (perc_nelt != 2)
+	fatal("bad perceptron pred config (<num_perceptrons> <hist_len>)");
+      if (btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      pred = bpred_create(BPredPerceptron,
+			  /* bimod table size */0,
+			  /* number of perceptrons */perc_config[0],
+			  /* 2lev l2 size */0,
+			  /* meta table size */0,
+			  /* history length */perc_config[1],
+			  /* history xor address */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* ret-addr stack size */ras_size);
+    }
   else
     fatal("cannot parse predictor type `%s'", pred_type);
 
+  /* path-based indirect target predictor, bpred_indir_create() checks args */
+  if (indir_nelt != 3)
+    fatal("bad indirect target pred config "
+	  "(<num_sets> <associativity> <path_len>)");
+  if (pred && indir_config[0])
+    bpred_indir_create(pred,
+		       /* sets */indir_config[0],
+		       /* assoc */indir_config[1],
+		       /* path history length */indir_config[2]);
+
   if (!bpred_spec_opt)
     bpred_spec_update = spec_CT;
   else if (!mystricmp(bpred_spec_opt, "ID"))
@@ -1022,6 +1675,14 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (LSQ_size < 2 || (LSQ_size & (LSQ_size-1)) != 0)
     fatal("LSQ size must be a positive number > 1 and a power of two");
 
+  if (decode_cache_size < 0
+      || (decode_cache_size & (decode_cache_size-1)) != 0)
+    fatal("decode cache size must be zero or a power of two");
+
+  if (eventq_wheel_size < 0
+      || (eventq_wheel_size & (eventq_wheel_size-1)) != 0)
+    fatal("event queue wheel size must be zero or a power of two");
+
   /* use a level 1 D-cache? */
   if (!mystricmp(cache_dl1_opt, "none"))
     {
@@ -1041,11 +1702,6 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 			       /* usize */0, assoc, cache_char2policy(c),
 			       dl1_access_fn, /* hit lat */cache_dl1_lat);
     
-    //mshr_create 추가
-      if (sscanf(mshr_opt, "%[^:]:%d:%d:%d:%c",
-		 name, &nsets, &bsize, &assoc, &c) != 5)
-	fatal("bad mshr parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
-      mshr = mshr_create(bsize, nsets, assoc);
       if (sscanf(cache_dl2_opt, "%[^:]:%d:%d:%d:%c",
 		 name, &nsets, &bsize, &assoc, &c) != 5)
 	cache_dl2 = NULL;
@@ -1123,6 +1779,58 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	}
     }
 
+  /* attach the cache prefetchers */
+  pf_attach(cache_dl1, pf_dl1_opt, "l1 data cache", FALSE);
+  pf_attach(cache_dl2, pf_dl2_opt, "l2 data cache", FALSE);
+  pf_attach(cache_il1, pf_il1_opt, "l1 inst cache",
+	    cache_il1 == cache_dl1 || cache_il1 == cache_dl2);
+  pf_attach(cache_il2, pf_il2_opt, "l2 inst cache", cache_il2 == cache_dl2);
+
+  /* link the l1 caches to the l2 caches they miss to, and set the l2
+     hierarchy policies before attaching victim caches */
+  if (cache_dl1 && cache_dl2)
+    cache_link(cache_dl1, cache_dl2);
+  if (cache_il1 && cache_il2
+      && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_link(cache_il1, cache_il2);
+  hier_attach(cache_dl2, hier_dl2_opt, "l2 data cache", FALSE);
+  hier_attach(cache_il2, hier_il2_opt, "l2 inst cache",
+	      cache_il2 == cache_dl2);
+
+  /* attach the victim caches */
+  vc_attach(cache_dl1, vc_dl1_opt, "l1 data cache", FALSE);
+  vc_attach(cache_dl2, vc_dl2_opt, "l2 data cache", FALSE);
+  vc_attach(cache_il1, vc_il1_opt, "l1 inst cache",
+	    cache_il1 == cache_dl1 || cache_il1 == cache_dl2);
+  vc_attach(cache_il2, vc_il2_opt, "l2 inst cache", cache_il2 == cache_dl2);
+
+  /* connect the l1 caches to the l2 caches */
+  n = 0;
+  if (cache_dl1 && cache_dl2)
+    cps[n++] = cache_dl1;
+  if (cache_il1 && cache_il2
+      && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cps[n++] = cache_il1;
+  bus_attach(bus_l2_opt, "l2", cps, n);
+
+  /* connect the lowest level caches to main memory */
+  n = 0;
+  if (cache_dl2 || cache_dl1)
+    cps[n++] = cache_dl2 ? cache_dl2 : cache_dl1;
+  if ((cache_il2 || cache_il1)
+      && (cache_il2 ? cache_il2 : cache_il1) != cache_dl1
+      && (cache_il2 ? cache_il2 : cache_il1) != cache_dl2)
+    cps[n++] = cache_il2 ? cache_il2 : cache_il1;
+  bus_attach(bus_mem_opt, "memory", cps, n);
+
+  /* attach the MSHR files */
+  mshr_attach(cache_dl1, mshr_dl1_opt, "l1 data cache", FALSE);
+  mshr_attach(cache_dl2, mshr_dl2_opt, "l2 data cache", FALSE);
+  mshr_attach(cache_il1, mshr_il1_opt, "l1 inst cache",
+	      cache_il1 == cache_dl1 || cache_il1 == cache_dl2);
+  mshr_attach(cache_il2, mshr_il2_opt, "l2 inst cache",
+	      cache_il2 == cache_dl2);
+
   /* use an I-TLB? */
   if (!mystricmp(itlb_opt, "none"))
     itlb = NULL;
@@ -1172,6 +1880,23 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (mem_bus_width < 1 || (mem_bus_width & (mem_bus_width-1)) != 0)
     fatal("memory bus width must be positive non-zero and a power of two");
 
+  /* use a DRAM system? */
+  if (!mystricmp(dram_opt, "none"))
+    dram = NULL;
+  else
+    {
+      int channels, ranks, banks, row_size;
+
+      if (sscanf(dram_opt, "%d:%d:%d:%d:%c",
+		 &channels, &ranks, &banks, &row_size, &c) != 5)
+	fatal("bad DRAM parms: <channels>:<ranks>:<banks>:<rowsize>:<page>");
+      if (dram_nelt != 3)
+	fatal("bad DRAM timing: <tRCD> <tRP> <tCAS>");
+      dram = dram_create(channels, ranks, banks, row_size,
+			 dram_char2policy(c), dram_lat[0], dram_lat[1],
+			 dram_lat[2], mem_bus_width, mem_lat[1], dram_queue);
+    }
+
   if (tlb_miss_lat < 1)
     fatal("TLB miss latency must be greater than zero");
 
@@ -1210,7 +1935,21 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 void
 sim_aux_config(FILE *stream)            /* output stream */
 {
-  /* nada */
+  int i;
+
+  if (cache_dl1 && cache_dl1->pf)
+    prefetch_config(cache_dl1->pf, cache_dl1->name, stream);
+  if (cache_dl2 && cache_dl2->pf)
+    prefetch_config(cache_dl2->pf, cache_dl2->name, stream);
+  if (cache_il1 && cache_il1->pf
+      && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    prefetch_config(cache_il1->pf, cache_il1->name, stream);
+  if (cache_il2 && cache_il2->pf && cache_il2 != cache_dl2)
+    prefetch_config(cache_il2->pf, cache_il2->name, stream);
+  for (i=0; i<nbuses; i++)
+    bus_config(buses[i], stream);
+  if (dram)
+    dram_config(dram, stream);
 }
 
 /* register simulator-specific statistics */
@@ -1321,6 +2060,66 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
                    "the average slip between issue and retirement",
                    "sim_slip / sim_num_insn", NULL);
 
+  stat_reg_counter(sdb, "sim_idle_skipped",
+		   "total idle cycles skipped over in one step",
+		   &sim_idle_skipped, /* initial value */0, /* format */NULL);
+
+  if (decode_cache_size)
+    {
+      stat_reg_counter(sdb, "decode.lookups",
+		       "total pre-decoded instruction cache lookups",
+		       &decode_lookups, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "decode.hits",
+		       "total pre-decoded instruction cache hits",
+		       &decode_hits, /* initial value */0, /* format */NULL);
+      stat_reg_formula(sdb, "decode.hit_rate",
+		       "pre-decoded instruction cache hit rate",
+		       "decode.hits / decode.lookups", /* format */NULL);
+    }
+
+  if (sample_period || sample_nwindows)
+    {
+      stat_reg_counter(sdb, "sample.units",
+		       "total number of sampled units measured",
+		       &sample_units, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "sample.fwd_insn",
+		       "total number of insts executed functionally",
+		       &sample_fwd_insn, /* initial value */0, /* format */NULL);
+      /* parallel units are simulated in detail by copies of this process,
+	 while this process executes every inst functionally */
+      if (sample_jobs)
+	{
+	  stat_reg_counter(sdb, "sample.dropped_units",
+			   "total number of parallel units not simulated",
+			   &sample_dropped, /* initial value */0,
+			   /* format */NULL);
+	  stat_reg_formula(sdb, "sample.total_insn",
+			   "total number of insts executed",
+			   "sample.fwd_insn", /* format */"%12.0f");
+	}
+      else
+	stat_reg_formula(sdb, "sample.total_insn",
+			 "total number of insts executed",
+			 "sim_num_insn + sample.fwd_insn", /* format */"%12.0f");
+      stat_reg_double(sdb, "sample.cpi",
+		      "mean CPI of sampled units",
+		      &sample_cpi, /* initial value */0.0, /* format */NULL);
+      stat_reg_double(sdb, "sample.cpi_stddev",
+		      "standard deviation of sampled unit CPIs",
+		      &sample_cpi_stddev, /* initial value */0.0,
+		      /* format */NULL);
+      stat_reg_double(sdb, "sample.cpi_ci",
+		      "99.7% confidence interval of sample.cpi (+/-)",
+		      &sample_cpi_ci, /* initial value */0.0,
+		      /* format */NULL);
+      stat_reg_formula(sdb, "sample.cpi_err",
+		       "relative error of sample.cpi at 99.7% confidence",
+		       "sample.cpi_ci / sample.cpi", /* format */NULL);
+      stat_reg_formula(sdb, "sample.est_cycles",
+		       "estimated total cycles, from sample.cpi",
+		       "sample.cpi * sample.total_insn", /* format */"%12.0f");
+    }
+
   /* register predictor stats */
   if (pred)
     bpred_reg_stats(pred, sdb);
@@ -1379,29 +2178,20 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   ld_reg_stats(sdb);
   mem_reg_stats(mem, sdb);
 
-  /* register mshr stats */
-  if (mshr)
-  {
-    stat_reg_counter(sdb, "mshr.accesses",
-                    "total number of MSHR accesses",
-                    &mshr->nvalid, mshr->nvalid, NULL);
-    
-    stat_reg_counter(sdb, "mshr.hits",
-                    "total number of MSHR hits",
-                    &mshr->nvalid_entries, mshr->nvalid_entries, NULL);
-    
-    stat_reg_formula(sdb, "mshr.misses",
-                    "total number of MSHR misses",
-                    "mshr.accesses - mshr.hits", NULL);
-    
-    stat_reg_counter(sdb, "mshr.full",
-                    "number of times MSHR was full",
-                    &mshr->nentries, mshr->nentries, NULL);
-    
-    stat_reg_formula(sdb, "mshr.miss_rate",
-                    "MSHR miss rate (misses/ref)",
-                    "mshr.misses / mshr.accesses", NULL);
-  }
+  /* register the interconnect stats */
+  for (i=0; i<nbuses; i++)
+    bus_reg_stats(buses[i], sdb, "sim_cycle");
+
+  /* register the DRAM system stats */
+  if (dram)
+    dram_reg_stats(dram, sdb);
+
+  /* register the cache fill queue stats */
+  miss_queue_reg_stats(miss_queue, sdb);
+
+  /* register the stats of the MSHR files */
+  for (i=0; i<mshr_nfiles; i++)
+    mshr_reg_stats(mshr_files[i], mshr_files[i]->name, sdb);
 }
 
 /* forward declarations */
@@ -1422,7 +2212,10 @@ sim_init(void)
 
   /* allocate and initialize register file */
   regs_init(&regs);
-	miss_queue_init();
+
+  /* allocate the queue of outstanding cache fills */
+  miss_queue_init();
+
   /* allocate and initialize memory space */
   mem = mem_create("mem");
   mem_init(mem);
@@ -1704,31 +2497,153 @@ static int LSQ_num;                     /* num entries currently in LSQ */
 #define STORE_OP_READY(RS)              ((RS)->idep_ready[STORE_OP_INDEX])
 #define STORE_ADDR_READY(RS)            ((RS)->idep_ready[STORE_ADDR_INDEX])
 
-/* allocate and initialize the load/store queue (LSQ) */
+/*
+ * the LSQ store index follows, the store index hashes the address of every
+ * store in the LSQ (store addresses are known at dispatch, since execution
+ * occurs in the dispatch stage), so that lsq_refresh() and load forwarding in
+ * ruu_issue() can find the stores to a load's address without walking the
+ * LSQ; it also tracks, by LSQ slot, the stores whose effective address has
+ * not yet been computed (STA unknown) and the loads that have not yet been
+ * placed on the ready queue
+ */
+
+/* store index hash table, indexed by hashed store address, each bucket is a
+   chain of LSQ slots linked through LSQ_st_next[], -1 terminates a chain */
+static int *LSQ_st_hash;
+static int *LSQ_st_next;
+static int LSQ_st_hsize;
+
+#define LSQ_ST_HASH(ADDR)						\
+  ((((ADDR) >> 2) ^ ((ADDR) >> 12)) & (LSQ_st_hsize - 1))
+
+/* stores with an unknown effective address, by LSQ slot */
+static BITMAP_PTR_TYPE LSQ_sta_unknown;
+
+/* loads not yet placed on the ready queue, by LSQ slot */
+static BITMAP_PTR_TYPE LSQ_ld_waiting;
+
+/* age of LSQ slot SLOT, i.e., its distance from the head of the LSQ */
+#define LSQ_AGE(SLOT)		(((SLOT) - LSQ_head + LSQ_size) % LSQ_size)
+
+/* allocate and initialize the LSQ store index */
 static void
-lsq_init(void)
+lsq_index_init(void)
 {
-  LSQ = calloc(LSQ_size, sizeof(struct RUU_station));
-  if (!LSQ)
+  int i;
+
+  /* keep the hash table at most half full */
+  LSQ_st_hsize = 2 * LSQ_size;
+  LSQ_st_hash = (int *)calloc(LSQ_st_hsize, sizeof(int));
+  LSQ_st_next = (int *)calloc(LSQ_size, sizeof(int));
+  LSQ_sta_unknown = (BITMAP_PTR_TYPE)
+    calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+  LSQ_ld_waiting = (BITMAP_PTR_TYPE)
+    calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+  if (!LSQ_st_hash || !LSQ_st_next || !LSQ_sta_unknown || !LSQ_ld_waiting)
     fatal("out of virtual memory");
 
-  LSQ_num = 0;
-  LSQ_head = LSQ_tail = 0;
-  LSQ_count = 0;
-  LSQ_fcount = 0;
+  for (i=0; i < LSQ_st_hsize; i++)
+    LSQ_st_hash[i] = -1;
 }
 
-/* dump the contents of the RUU */
+/* enter newly dispatched LSQ entry at slot SLOT into the store index */
 static void
-lsq_dump(FILE *stream)				/* output stream */
+lsq_index_insert(int slot)			/* LSQ slot to enter */
 {
-  int num, head;
-  struct RUU_station *rs;
+  struct RUU_station *rs = &LSQ[slot];
+  int bucket;
 
-  if (!stream)
-    stream = stderr;
+  if ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+    {
+      /* index the store by its address */
+      bucket = LSQ_ST_HASH(rs->addr);
+      LSQ_st_next[slot] = LSQ_st_hash[bucket];
+      LSQ_st_hash[bucket] = slot;
+
+      /* blocks all later loads until its address is computed */
+      if (!STORE_ADDR_READY(rs))
+	(void)BITMAP_SET(LSQ_sta_unknown, 0, slot);
+    }
+  else if ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+    {
+      /* load waits for lsq_refresh() to find it ready */
+      (void)BITMAP_SET(LSQ_ld_waiting, 0, slot);
+    }
+}
 
-  fprintf(stream, "** LSQ state **\n");
+/* remove the LSQ entry at slot SLOT from the store index, the entry is
+   being committed or squashed */
+static void
+lsq_index_remove(int slot)			/* LSQ slot to remove */
+{
+  struct RUU_station *rs = &LSQ[slot];
+  int *link;
+
+  if ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+    {
+      for (link = &LSQ_st_hash[LSQ_ST_HASH(rs->addr)];
+	   *link != slot;
+	   link = &LSQ_st_next[*link])
+	{
+	  if (*link < 0)
+	    panic("LSQ store not in store index");
+	}
+      *link = LSQ_st_next[slot];
+    }
+
+  (void)BITMAP_CLEAR(LSQ_sta_unknown, 0, slot);
+  (void)BITMAP_CLEAR(LSQ_ld_waiting, 0, slot);
+}
+
+/* return the LSQ slot of the youngest store to address ADDR that is older
+   than the LSQ entry with age AGE, returns -1 if there is no such store */
+static int
+lsq_index_lookup(md_addr_t addr,		/* address to look up */
+		 int age)			/* age of the accessing entry */
+{
+  int slot, best = -1, best_age = -1;
+
+  for (slot = LSQ_st_hash[LSQ_ST_HASH(addr)];
+       slot >= 0;
+       slot = LSQ_st_next[slot])
+    {
+      if (LSQ[slot].addr == addr
+	  && LSQ_AGE(slot) < age
+	  && LSQ_AGE(slot) > best_age)
+	{
+	  best = slot;
+	  best_age = LSQ_AGE(slot);
+	}
+    }
+  return best;
+}
+
+/* allocate and initialize the load/store queue (LSQ) */
+static void
+lsq_init(void)
+{
+  LSQ = calloc(LSQ_size, sizeof(struct RUU_station));
+  if (!LSQ)
+    fatal("out of virtual memory");
+
+  lsq_index_init();
+
+  LSQ_num = 0;
+  LSQ_head = LSQ_tail = 0;
+  LSQ_count = 0;
+  LSQ_fcount = 0;
+}
+/* dump the contents of the RUU */
+static void
+lsq_dump(FILE *stream)				/* output stream */
+{
+  int num, head;
+  struct RUU_station *rs;
+
+  if (!stream)
+    stream = stderr;
+
+  fprintf(stream, "** LSQ state **\n");
   fprintf(stream, "LSQ_head: %d, LSQ_tail: %d\n", LSQ_head, LSQ_tail);
   fprintf(stream, "LSQ_num: %d\n", LSQ_num);
 
@@ -1850,7 +2765,12 @@ ruu_release_fu(void)
     {
       /* resource is released when BUSY hits zero */
       if (fu_pool->resources[i].busy > 0)
-	fu_pool->resources[i].busy--;
+	{
+	  /* a released unit may be claimed by issue this cycle, or by
+	     commit (store ports) next cycle */
+	  if (!--fu_pool->resources[i].busy)
+	    pipe_active = TRUE;
+	}
     }
 }
 
@@ -1859,24 +2779,74 @@ ruu_release_fu(void)
  * the execution unit event queue implementation follows, the event queue
  * indicates which instruction will complete next, the writeback handler
  * drains this queue
+ *
+ * events are kept in a timing wheel with one bucket per cycle, an event
+ * scheduled less than EVENTQ_WHEEL_SIZE cycles in the future is inserted
+ * directly into the bucket for its completion cycle, later events (e.g.,
+ * long memory latencies) are held in a sorted overflow list and migrated
+ * into the wheel as they come into range; each bucket is kept in the same
+ * order the original sorted list would produce (latest insertion first), so
+ * writeback order is cycle-exact with the sorted list, which is still
+ * available (-eventq:wheel 0) for regression comparison
  */
 
-/* pending event queue, sorted from soonest to latest event (in time), NOTE:
-   RS_LINK nodes are used for the event queue list so that it need not be
-   updated during squash events */
+/* pending overflow event queue, sorted from soonest to latest event (in
+   time), this is the entire event queue if the timing wheel is disabled,
+   NOTE: RS_LINK nodes are used for the event queue list so that it need not
+   be updated during squash events */
 static struct RS_link *event_queue;
 
+/* timing wheel buckets, indexed by event time modulo the wheel size, NULL
+   if the timing wheel is disabled */
+static struct RS_link **eventq_wheel = NULL;
+
+/* timing wheel size mask, the wheel size is a power of two */
+static int eventq_wheel_mask;
+
+/* number of events (valid or squashed) currently held in the wheel */
+static int eventq_wheel_num;
+
 /* initialize the event queue structures */
 static void
 eventq_init(void)
 {
   event_queue = NULL;
+  eventq_wheel_num = 0;
+
+  if (eventq_wheel_size > 0)
+    {
+      eventq_wheel =
+	(struct RS_link **)calloc(eventq_wheel_size, sizeof(struct RS_link *));
+      if (!eventq_wheel)
+	fatal("out of virtual memory");
+      eventq_wheel_mask = eventq_wheel_size - 1;
+    }
+  else
+    eventq_wheel = NULL;
+}
+
+/* dump one event queue entry */
+static void
+eventq_dumpent(struct RS_link *ev,		/* event to dump */
+	       FILE *stream)			/* output stream */
+{
+  /* is event still valid? */
+  if (RSLINK_VALID(ev))
+    {
+      struct RUU_station *rs = RSLINK_RS(ev);
+
+      fprintf(stream, "idx: %2d: @ %.0f\n",
+	      (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
+      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+		  stream, /* !header */FALSE);
+    }
 }
 
 /* dump the contents of the event queue */
 static void
 eventq_dump(FILE *stream)			/* output stream */
 {
+  int i;
   struct RS_link *ev;
 
   if (!stream)
@@ -1884,19 +2854,47 @@ eventq_dump(FILE *stream)			/* output stream */
 
   fprintf(stream, "** event queue state **\n");
 
-  for (ev = event_queue; ev != NULL; ev = ev->next)
+  /* wheel events, in time order starting with the current cycle */
+  if (eventq_wheel)
     {
-      /* is event still valid? */
-      if (RSLINK_VALID(ev))
+      for (i=0; i < eventq_wheel_size; i++)
 	{
-	  struct RUU_station *rs = RSLINK_RS(ev);
-
-	  fprintf(stream, "idx: %2d: @ %.0f\n",
-		  (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* !header */FALSE);
+	  for (ev = eventq_wheel[(sim_cycle + i) & eventq_wheel_mask];
+	       ev != NULL;
+	       ev = ev->next)
+	    eventq_dumpent(ev, stream);
 	}
     }
+
+  /* followed by the far-future events */
+  for (ev = event_queue; ev != NULL; ev = ev->next)
+    eventq_dumpent(ev, stream);
+}
+
+/* move any overflow events that now fall within the timing wheel into their
+   buckets, overflow events were scheduled before any event inserted directly
+   into the same bucket, so they go to the end of the bucket to maintain the
+   sorted list order */
+static void
+eventq_migrate(void)
+{
+  struct RS_link *ev, **tail;
+
+  while (event_queue
+	 && event_queue->x.when < sim_cycle + eventq_wheel_size)
+    {
+      /* unlink the earliest overflow event */
+      ev = event_queue;
+      event_queue = event_queue->next;
+      ev->next = NULL;
+
+      /* append it to its bucket */
+      for (tail = &eventq_wheel[ev->x.when & eventq_wheel_mask];
+	   *tail != NULL;
+	   tail = &(*tail)->next);
+      *tail = ev;
+      eventq_wheel_num++;
+    }
 }
 
 /* insert an event for RS into the event queue, event queue is sorted from
@@ -1917,6 +2915,22 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
   RSLINK_NEW(new_ev, rs);
   new_ev->x.when = when;
 
+  if (eventq_wheel)
+    {
+      /* bring the wheel up to date before inserting into it */
+      eventq_migrate();
+
+      if (when < sim_cycle + eventq_wheel_size)
+	{
+	  /* insert at the head of the bucket for cycle WHEN */
+	  new_ev->next = eventq_wheel[when & eventq_wheel_mask];
+	  eventq_wheel[when & eventq_wheel_mask] = new_ev;
+	  eventq_wheel_num++;
+	  return;
+	}
+      /* else, too far in the future, insert into the overflow list */
+    }
+
   /* locate insertion point */
   for (prev=NULL, ev=event_queue;
        ev && ev->x.when < when;
@@ -1936,18 +2950,71 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
     }
 }
 
+/* get the time of the earliest pending (possibly squashed) event into
+   *WHEN, returns FALSE if the event queue is empty */
+static int
+eventq_next_time(tick_t *when)			/* earliest event time */
+{
+  int i, found = FALSE;
+
+  if (eventq_wheel && eventq_wheel_num)
+    {
+      for (i=0; i < eventq_wheel_size; i++)
+	{
+	  if (eventq_wheel[(sim_cycle + i) & eventq_wheel_mask])
+	    {
+	      *when = eventq_wheel[(sim_cycle + i) & eventq_wheel_mask]->x.when;
+	      found = TRUE;
+	      break;
+	    }
+	}
+    }
+
+  /* not yet migrated overflow events may be earlier than wheel events */
+  if (event_queue && (!found || event_queue->x.when < *when))
+    {
+      *when = event_queue->x.when;
+      found = TRUE;
+    }
+  return found;
+}
+
 /* return the next event that has already occurred, returns NULL when no
    remaining events or all remaining events are in the future */
 static struct RUU_station *
 eventq_next_event(void)
 {
-  struct RS_link *ev;
+  struct RS_link *ev, **bucket;
 
-  if (event_queue && event_queue->x.when <= sim_cycle)
+  for (;;)
     {
+      if (eventq_wheel)
+	{
+	  /* bring the wheel up to date before draining it */
+	  eventq_migrate();
+
+	  /* only the bucket for this cycle can hold events that occurred */
+	  bucket = &eventq_wheel[sim_cycle & eventq_wheel_mask];
+	  if (!*bucket || (*bucket)->x.when > sim_cycle)
+	    {
+	      /* no event is ready */
+	      return NULL;
+	    }
+	  eventq_wheel_num--;
+	}
+      else
+	{
+	  bucket = &event_queue;
+	  if (!event_queue || event_queue->x.when > sim_cycle)
+	    {
+	      /* no event or no event is ready */
+	      return NULL;
+	    }
+	}
+
       /* unlink and return first event on priority list */
-      ev = event_queue;
-      event_queue = event_queue->next;
+      ev = *bucket;
+      *bucket = ev->next;
 
       /* event still valid? */
       if (RSLINK_VALID(ev))
@@ -1960,19 +3027,10 @@ eventq_next_event(void)
 	  /* event is valid, return resv station */
 	  return rs;
 	}
-      else
-	{
-	  /* reclaim event record */
-	  RSLINK_FREE(ev);
 
-	  /* receiving inst was squashed, return next event */
-	  return eventq_next_event();
-	}
-    }
-  else
-    {
-      /* no event or no event is ready */
-      return NULL;
+      /* receiving inst was squashed, reclaim event record and return next
+	 event */
+      RSLINK_FREE(ev);
     }
 }
 
@@ -1987,22 +3045,84 @@ eventq_next_event(void)
  * ensures that instruction issue priorities are properly observed; NOTE:
  * RS_LINK nodes are used for the event queue list so that it need not be
  * updated during squash events
+ *
+ * by default the ready queue is kept as a set of bitmaps indexed by RUU and
+ * LSQ slot, one per priority class; since slots are allocated in program
+ * order from the queue heads, a find-first-set scan starting at the head
+ * visits ready instructions oldest first, and the queue need not be rebuilt
+ * each cycle; the original sorted ready list is still available
+ * (-readyq:bitmap false)
  */
 
-/* the ready instruction queue */
+/* the ready instruction queue, used if the ready bitmaps are disabled */
 static struct RS_link *ready_queue;
 
+/* ready bitmaps: loads/stores (by LSQ slot), long latency and control ops
+   (by RUU slot), and all other ops (by RUU slot) */
+static BITMAP_PTR_TYPE readyq_lsq;
+static BITMAP_PTR_TYPE readyq_prio;
+static BITMAP_PTR_TYPE readyq_norm;
+
 /* initialize the event queue structures */
 static void
 readyq_init(void)
 {
   ready_queue = NULL;
+
+  if (readyq_bitmap)
+    {
+      readyq_lsq = (BITMAP_PTR_TYPE)
+	calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+      readyq_prio = (BITMAP_PTR_TYPE)
+	calloc(BITMAP_SIZE(RUU_size), sizeof(BITMAP_ENT_TYPE));
+      readyq_norm = (BITMAP_PTR_TYPE)
+	calloc(BITMAP_SIZE(RUU_size), sizeof(BITMAP_ENT_TYPE));
+      if (!readyq_lsq || !readyq_prio || !readyq_norm)
+	fatal("out of virtual memory");
+    }
+}
+
+/* return the offset (from queue head HEAD) of the first set bit in ready
+   bitmap MAP, over a circular queue of SIZE slots, at or after offset OFF,
+   returns -1 if no bit is set; SIZE is a power of two */
+static int
+readyq_scan(BITMAP_PTR_TYPE map, int size, int head, int off)
+{
+  int slot, span;
+  BITMAP_ENT_TYPE word;
+
+  while (off < size)
+    {
+      slot = (head + off) & (size - 1);
+
+      /* bits left in this word before the word or queue wraps */
+      span = MIN(32 - (slot % 32), size - slot);
+      span = MIN(span, size - off);
+
+      word = map[slot/32] >> (slot % 32);
+      if (span < 32)
+	word &= (1U << span) - 1;
+
+      if (word)
+	return off + __builtin_ctz(word);
+      off += span;
+    }
+  return -1;
 }
 
+/* get the ready bitmap and slot for RS */
+#define READYQ_MAP(RS)							\
+  ((RS)->in_LSQ								\
+   ? readyq_lsq								\
+   : ((MD_OP_FLAGS((RS)->op) & (F_LONGLAT|F_CTRL))			\
+      ? readyq_prio : readyq_norm))
+#define READYQ_SLOT(RS)		((RS) - ((RS)->in_LSQ ? LSQ : RUU))
+
 /* dump the contents of the ready queue */
 static void
 readyq_dump(FILE *stream)			/* output stream */
 {
+  int off;
   struct RS_link *link;
 
   if (!stream)
@@ -2010,6 +3130,26 @@ readyq_dump(FILE *stream)			/* output stream */
 
   fprintf(stream, "** ready queue state **\n");
 
+  if (readyq_bitmap)
+    {
+      for (off = readyq_scan(readyq_lsq, LSQ_size, LSQ_head, 0);
+	   off >= 0;
+	   off = readyq_scan(readyq_lsq, LSQ_size, LSQ_head, off + 1))
+	ruu_dumpent(&LSQ[(LSQ_head + off) % LSQ_size],
+		    (LSQ_head + off) % LSQ_size, stream, /* header */TRUE);
+      for (off = readyq_scan(readyq_prio, RUU_size, RUU_head, 0);
+	   off >= 0;
+	   off = readyq_scan(readyq_prio, RUU_size, RUU_head, off + 1))
+	ruu_dumpent(&RUU[(RUU_head + off) % RUU_size],
+		    (RUU_head + off) % RUU_size, stream, /* header */TRUE);
+      for (off = readyq_scan(readyq_norm, RUU_size, RUU_head, 0);
+	   off >= 0;
+	   off = readyq_scan(readyq_norm, RUU_size, RUU_head, off + 1))
+	ruu_dumpent(&RUU[(RUU_head + off) % RUU_size],
+		    (RUU_head + off) % RUU_size, stream, /* header */TRUE);
+      return;
+    }
+
   for (link = ready_queue; link != NULL; link = link->next)
     {
       /* is entry still valid? */
@@ -2046,6 +3186,14 @@ readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
     panic("node is already queued");
   rs->queued = TRUE;
 
+  if (readyq_bitmap)
+    {
+      /* mark the RS slot ready in its priority class, ruu_issue() visits
+	 the priority classes in order, oldest instruction first */
+      (void)BITMAP_SET(READYQ_MAP(rs), 0, READYQ_SLOT(rs));
+      return;
+    }
+
   /* get a free ready list node */
   RSLINK_NEW(new_node, rs);
   new_node->x.seq = rs->seq;
@@ -2079,6 +3227,20 @@ readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
     }
 }
 
+/* remove RS from the ready queue, RS has issued or is being squashed, NOTE:
+   squashed ready list nodes are skipped by ruu_issue() so only the ready
+   bitmaps need updating here */
+static void
+readyq_dequeue(struct RUU_station *rs)		/* RS to dequeue */
+{
+  if (!rs->queued)
+    return;
+  rs->queued = FALSE;
+
+  if (readyq_bitmap)
+    (void)BITMAP_CLEAR(READYQ_MAP(rs), 0, READYQ_SLOT(rs));
+}
+
 
 /*
  * the create vector maps a logical register to a creator in the RUU (and
@@ -2237,6 +3399,7 @@ ruu_commit(void)
 		  if (cache_dl1)
 		    {
 		      /* commit store value to D-cache */
+		      cache_dl1->access_pc = LSQ[LSQ_head].PC;
 		      lat =
 			cache_access(cache_dl1, Write, (LSQ[LSQ_head].addr&~3),
 				     NULL, 4, sim_cycle, NULL, NULL);
@@ -2263,6 +3426,7 @@ ruu_commit(void)
 	    }
 
 	  /* invalidate load/store operation instance */
+	  lsq_index_remove(LSQ_head);
 	  LSQ[LSQ_head].tag++;
           sim_slip += (sim_cycle - LSQ[LSQ_head].slip);
    
@@ -2316,6 +3480,7 @@ ruu_commit(void)
 
       /* one more instruction committed to architected state */
       committed++;
+      pipe_active = TRUE;
 
       for (i=0; i<MAX_ODEPS; i++)
 	{
@@ -2373,7 +3538,9 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	    }
       
 	  /* squash this LSQ entry */
+	  lsq_index_remove(LSQ_index);
 	  LSQ[LSQ_index].tag++;
+	  readyq_dequeue(&LSQ[LSQ_index]);
 
 	  /* indicate in pipetrace that this instruction was squashed */
 	  ptrace_endinst(LSQ[LSQ_index].ptrace_seq);
@@ -2394,6 +3561,7 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
       
       /* squash this RUU entry */
       RUU[RUU_index].tag++;
+      readyq_dequeue(&RUU[RUU_index]);
 
       /* indicate in pipetrace that this instruction was squashed */
       ptrace_endinst(RUU[RUU_index].ptrace_seq);
@@ -2444,6 +3612,7 @@ ruu_writeback(void)
 
       /* operation has completed */
       rs->completed = TRUE;
+      pipe_active = TRUE;
 
       /* does this operation reveal a mis-predicted branch? */
       if (rs->recover_inst)
@@ -2454,7 +3623,10 @@ ruu_writeback(void)
 	  /* recover processor state and reinit fetch to correct path */
 	  ruu_recover(rs - RUU);
 	  tracer_recover();
-	  bpred_recover(pred, rs->PC, rs->stack_recover_idx);
+	  bpred_recover(pred, rs->PC, rs->stack_recover_idx,
+			/* taken? */rs->next_PC != (rs->PC +
+						   sizeof(md_inst_t)),
+			/* dir predictor update pointer */&rs->dir_update);
 
 	  /* stall fetch until I-fetch and I-decode recover */
 	  ruu_fetch_issue_delay = ruu_branch_penalty;
@@ -2537,6 +3709,11 @@ ruu_writeback(void)
 		      /* input is now ready */
 		      olink->rs->idep_ready[olink->x.opnum] = TRUE;
 
+		      /* store address now known, no longer blocks loads */
+		      if (olink->rs->in_LSQ
+			  && olink->x.opnum == STORE_ADDR_INDEX)
+			(void)BITMAP_CLEAR(LSQ_sta_unknown, 0, olink->rs - LSQ);
+
 		      /* are all the register operands of target ready? */
 		      if (OPERANDS_READY(olink->rs))
 			{
@@ -2574,83 +3751,275 @@ ruu_writeback(void)
  */
 
 /* this function locates ready instructions whose memory dependencies have
-   been satisfied, this is accomplished by walking the LSQ for loads, looking
-   for blocking memory dependency condition (e.g., earlier store with an
-   unknown address) */
-#define MAX_STD_UNKNOWNS		64
+   been satisfied, this is accomplished by visiting the loads not yet on the
+   ready queue, oldest first, looking for blocking memory dependency
+   conditions (e.g., earlier store with an unknown address) in the LSQ
+   store index */
 static void
 lsq_refresh(void)
 {
-  int i, j, index, n_std_unknowns;
-  md_addr_t std_unknowns[MAX_STD_UNKNOWNS];
-
-  /* scan entire queue for ready loads: scan from oldest instruction
-     (head) until we reach the tail or an unresolved store, after which no
-     other instruction will become ready */
-  for (i=0, index=LSQ_head, n_std_unknowns=0;
-       i < LSQ_num;
-       i++, index=(index + 1) % LSQ_size)
-    {
-      /* terminate search for ready loads after first unresolved store,
-	 as no later load could be resolved in its presence */
-      if (/* store? */
-	  (MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+  int age, limit, index, st;
+
+  /* no load younger than the oldest unresolved store can be resolved in its
+     presence */
+  /* FIXME: a later STD + STD known could hide the STA unknown */
+  limit = readyq_scan(LSQ_sta_unknown, LSQ_size, LSQ_head, 0);
+  if (limit < 0)
+    limit = LSQ_num;
+
+  /* scan waiting loads, from oldest instruction (head) until we reach the
+     first unresolved store */
+  for (age = readyq_scan(LSQ_ld_waiting, LSQ_size, LSQ_head, 0);
+       age >= 0 && age < limit;
+       age = readyq_scan(LSQ_ld_waiting, LSQ_size, LSQ_head, age + 1))
+    {
+      index = (LSQ_head + age) % LSQ_size;
+
+      if (/* queued? */LSQ[index].queued
+	  || /* waiting? */LSQ[index].issued
+	  || /* completed? */LSQ[index].completed)
+	panic("waiting load is queued, issued, or completed");
+
+      if (/* regs ready? */!OPERANDS_READY(&LSQ[index]))
+	continue;
+
+      /* no STA unknown conflict (because we got to this check), check for
+	 a STD unknown conflict, only the latest earlier store to the same
+	 address matters, as a later STD known hides an earlier STD
+	 unknown */
+      st = lsq_index_lookup(LSQ[index].addr, age);
+      if (st < 0 || OPERANDS_READY(&LSQ[st]))
 	{
-	  if (!STORE_ADDR_READY(&LSQ[index]))
-	    {
-	      /* FIXME: a later STD + STD known could hide the STA unknown */
-	      /* sta unknown, blocks all later loads, stop search */
-	      break;
-	    }
-	  else if (!OPERANDS_READY(&LSQ[index]))
-	    {
-	      /* sta known, but std unknown, may block a later store, record
-		 this address for later referral, we use an array here because
-		 for most simulations the number of entries to search will be
-		 very small */
-	      if (n_std_unknowns == MAX_STD_UNKNOWNS)
-		fatal("STD unknown array overflow, increase MAX_STD_UNKNOWNS");
-	      std_unknowns[n_std_unknowns++] = LSQ[index].addr;
-	    }
-	  else /* STORE_ADDR_READY() && OPERANDS_READY() */
-	    {
-	      /* a later STD known hides an earlier STD unknown */
-	      for (j=0; j<n_std_unknowns; j++)
-		{
-		  if (std_unknowns[j] == /* STA/STD known */LSQ[index].addr)
-		    std_unknowns[j] = /* bogus addr */0;
-		}
-	    }
+	  /* no STA or STD unknown conflicts, put load on ready queue */
+	  (void)BITMAP_CLEAR(LSQ_ld_waiting, 0, index);
+	  readyq_enqueue(&LSQ[index]);
+	  pipe_active = TRUE;
+	}
+    }
+}
+
+
+/*
+ *  RUU_ISSUE() - issue instructions to functional units
+ */
+
+/* attempt to issue ready operation RS to a functional unit, RS has all
+   register and memory dependencies satisfied; returns TRUE if RS issued,
+   or FALSE if no functional unit was available this cycle */
+static int
+ruu_issue_inst(struct RUU_station *rs)		/* RS to issue */
+{
+  int load_lat, tlb_lat;
+  struct res_template *fu;
+
+  if (rs->in_LSQ
+      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
+    {
+      /* stores complete in effectively zero time, result is
+	 written into the load/store queue, the actual store into
+	 the memory system occurs when the instruction is retired
+	 (see ruu_commit()) */
+      rs->issued = TRUE;
+      rs->completed = TRUE;
+      if (rs->onames[0] || rs->onames[1])
+	panic("store creates result");
+
+      if (rs->recover_inst)
+	panic("mis-predicted store");
+
+      /* entered execute stage, indicate in pipe trace */
+      ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
+
+      return TRUE;
+    }
+
+  /* does the instruction need a functional unit? */
+  if (MD_OP_FUCLASS(rs->op) == NA)
+    {
+      /* FIXME: need better solution for these */
+      /* the instruction does not need a functional unit */
+      rs->issued = TRUE;
+
+      /* schedule a result event */
+      eventq_queue_event(rs, sim_cycle + 1);
+
+      /* entered execute stage, indicate in pipe trace */
+      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
+		      rs->ea_comp ? PEV_AGEN : 0);
+
+      return TRUE;
+    }
+
+  /* a load that would miss in the data cache waits for a free MSHR,
+     unless it is forwarded a value from the LSQ */
+  if (cache_dl1 && cache_dl1->mshr
+      && rs->in_LSQ
+      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+      && MD_VALID_ADDR(rs->addr)
+      && cache_mshr_blocked(cache_dl1, (rs->addr & ~3))
+      && lsq_index_lookup(rs->addr, LSQ_AGE(rs - LSQ)) < 0)
+    {
+      /* we'll try to issue it again next cycle */
+      cache_dl1->mshr->stalls++;
+      ruu_issue_mshr_blocked++;
+      return FALSE;
+    }
+
+  /* issue the instruction to a functional unit */
+  fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
+  if (!fu)
+    {
+      /* insufficient functional unit resources, we'll try to issue it
+	 again next cycle */
+      return FALSE;
+    }
+
+  /* got one! issue inst to functional unit */
+  rs->issued = TRUE;
+  /* reserve the functional unit */
+  if (fu->master->busy)
+    panic("functional unit already in use");
+
+  /* schedule functional unit release event */
+  fu->master->busy = fu->issuelat;
+
+  /* schedule a result writeback event */
+  if (rs->in_LSQ
+      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD)))
+    {
+      int events = 0;
+
+      /* for loads, determine cache access latency:
+	 first check the LSQ store index to see if a store forward is
+	 possible, if not, access the data cache */
+      load_lat = 0;
+      /* FIXME: not dealing with partials! */
+      if (lsq_index_lookup(rs->addr, LSQ_AGE(rs - LSQ)) >= 0)
+	{
+	  /* hit in the LSQ */
+	  load_lat = 1;
 	}
 
-      if (/* load? */
-	  ((MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
-	  && /* queued? */!LSQ[index].queued
-	  && /* waiting? */!LSQ[index].issued
-	  && /* completed? */!LSQ[index].completed
-	  && /* regs ready? */OPERANDS_READY(&LSQ[index]))
+      /* was the value store forwared from the LSQ? */
+      if (!load_lat)
 	{
-	  /* no STA unknown conflict (because we got to this check), check for
-	     a STD unknown conflict */
-	  for (j=0; j<n_std_unknowns; j++)
+	  int valid_addr = MD_VALID_ADDR(rs->addr);
+
+	  if (!spec_mode && !valid_addr)
+	    sim_invalid_addrs++;
+
+	  /* no! go to the data cache if addr is valid */
+	  if (cache_dl1 && valid_addr)
 	    {
-	      /* found a relevant STD unknown? */
-	      if (std_unknowns[j] == LSQ[index].addr)
-		break;
+	      /* access the cache if non-faulting */
+	      cache_dl1->access_pc = rs->PC;
+	      load_lat =
+		cache_access(cache_dl1, Read,
+			     (rs->addr & ~3), NULL, 4,
+			     sim_cycle, NULL, NULL);
+	      if (load_lat > cache_dl1_lat)
+		events |= PEV_CACHEMISS;
 	    }
-	  if (j == n_std_unknowns)
+	  else
 	    {
-	      /* no STA or STD unknown conflicts, put load on ready queue */
-	      readyq_enqueue(&LSQ[index]);
+	      /* no caches defined, just use op latency */
+	      load_lat = fu->oplat;
 	    }
 	}
+
+      /* all loads and stores must to access D-TLB */
+      if (dtlb && MD_VALID_ADDR(rs->addr))
+	{
+	  /* access the D-DLB, NOTE: this code will
+	     initiate speculative TLB misses */
+	  tlb_lat =
+	    cache_access(dtlb, Read, (rs->addr & ~3),
+			 NULL, 4, sim_cycle, NULL, NULL);
+	  if (tlb_lat > 1)
+	    events |= PEV_TLBMISS;
+
+	  /* D-cache/D-TLB accesses occur in parallel */
+	  load_lat = MAX(tlb_lat, load_lat);
+	}
+
+      /* use computed cache access latency */
+      eventq_queue_event(rs, sim_cycle + load_lat);
+
+      /* entered execute stage, indicate in pipe trace */
+      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
+		      ((rs->ea_comp ? PEV_AGEN : 0)
+		       | events));
+    }
+  else /* !load && !store */
+    {
+      /* use deterministic functional unit latency */
+      eventq_queue_event(rs, sim_cycle + fu->oplat);
+
+      /* entered execute stage, indicate in pipe trace */
+      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE, 
+		      rs->ea_comp ? PEV_AGEN : 0);
     }
+
+  return TRUE;
 }
 
+/* issue ready instructions from the ready bitmaps, loads/stores, long
+   latency and control ops first (oldest first, merging the LSQ and RUU
+   by sequence number), then all other instructions (oldest first);
+   instructions that cannot get a functional unit simply remain ready */
+static void
+ruu_issue_bitmap(void)
+{
+  int n_issued, lsq_off, prio_off, norm_off;
+  struct RUU_station *rs;
 
-/*
- *  RUU_ISSUE() - issue instructions to functional units
- */
+  lsq_off = readyq_scan(readyq_lsq, LSQ_size, LSQ_head, 0);
+  prio_off = readyq_scan(readyq_prio, RUU_size, RUU_head, 0);
+  norm_off = readyq_scan(readyq_norm, RUU_size, RUU_head, 0);
+
+  for (n_issued=0; n_issued < ruu_issue_width; )
+    {
+      /* select the oldest ready instruction of the highest priority class */
+      if (lsq_off >= 0
+	  && (prio_off < 0
+	      || (LSQ[(LSQ_head + lsq_off) % LSQ_size].seq
+		  < RUU[(RUU_head + prio_off) % RUU_size].seq)))
+	{
+	  rs = &LSQ[(LSQ_head + lsq_off) % LSQ_size];
+	  lsq_off = readyq_scan(readyq_lsq, LSQ_size, LSQ_head, lsq_off + 1);
+	}
+      else if (prio_off >= 0)
+	{
+	  rs = &RUU[(RUU_head + prio_off) % RUU_size];
+	  prio_off = readyq_scan(readyq_prio, RUU_size, RUU_head, prio_off + 1);
+	}
+      else if (norm_off >= 0)
+	{
+	  rs = &RUU[(RUU_head + norm_off) % RUU_size];
+	  norm_off = readyq_scan(readyq_norm, RUU_size, RUU_head, norm_off + 1);
+	}
+      else
+	{
+	  /* no more ready instructions */
+	  break;
+	}
+
+      /* issue operation, both reg and mem deps have been satisfied */
+      if (!OPERANDS_READY(rs) || !rs->queued
+	  || rs->issued || rs->completed)
+	panic("issued inst !ready, issued, or completed");
+
+      if (ruu_issue_inst(rs))
+	{
+	  /* node is now un-queued */
+	  readyq_dequeue(rs);
+
+	  /* one more inst issued */
+	  n_issued++;
+	  pipe_active = TRUE;
+	}
+    }
+}
 
 /* attempt to issue all operations in the ready queue; insts in the ready
    instruction queue have all register dependencies satisfied, this function
@@ -2662,11 +4031,16 @@ lsq_refresh(void)
 static void
 ruu_issue(void)
 {
-  int i, load_lat, tlb_lat, n_issued;
+  int n_issued;
   struct RS_link *node, *next_node;
-  struct res_template *fu;
 
-  /* FIXME: could be a little more efficient when scanning the ready queue */
+  ruu_issue_mshr_blocked = 0;
+
+  if (readyq_bitmap)
+    {
+      ruu_issue_bitmap();
+      return;
+    }
 
   /* copy and then blow away the ready list, NOTE: the ready list is
      always totally reclaimed each cycle, and instructions that are not
@@ -2698,168 +4072,20 @@ ruu_issue(void)
 	  /* node is now un-queued */
 	  rs->queued = FALSE;
 
-	  if (rs->in_LSQ
-	      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
+	  if (ruu_issue_inst(rs))
 	    {
-	      /* stores complete in effectively zero time, result is
-		 written into the load/store queue, the actual store into
-		 the memory system occurs when the instruction is retired
-		 (see ruu_commit()) */
-	      rs->issued = TRUE;
-	      rs->completed = TRUE;
-	      if (rs->onames[0] || rs->onames[1])
-		panic("store creates result");
-
-	      if (rs->recover_inst)
-		panic("mis-predicted store");
-
-	      /* entered execute stage, indicate in pipe trace */
-	      ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
-
 	      /* one more inst issued */
 	      n_issued++;
+	      pipe_active = TRUE;
 	    }
 	  else
 	    {
-	      /* issue the instruction to a functional unit */
-	      if (MD_OP_FUCLASS(rs->op) != NA)
-		{
-		  fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
-		  if (fu)
-		    {
-		      /* got one! issue inst to functional unit */
-		      rs->issued = TRUE;
-		      /* reserve the functional unit */
-		      if (fu->master->busy)
-			panic("functional unit already in use");
-
-		      /* schedule functional unit release event */
-		      fu->master->busy = fu->issuelat;
-
-		      /* schedule a result writeback event */
-		      if (rs->in_LSQ
-			  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
-			      == (F_MEM|F_LOAD)))
-			{
-			  int events = 0;
-
-			  /* for loads, determine cache access latency:
-			     first scan LSQ to see if a store forward is
-			     possible, if not, access the data cache */
-			  load_lat = 0;
-			  i = (rs - LSQ);
-			  if (i != LSQ_head)
-			    {
-			      for (;;)
-				{
-				  /* go to next earlier LSQ entry */
-				  i = (i + (LSQ_size-1)) % LSQ_size;
-
-				  /* FIXME: not dealing with partials! */
-				  if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
-				      && (LSQ[i].addr == rs->addr))
-				    {
-				      /* hit in the LSQ */
-				      load_lat = 1;
-				      break;
-				    }
-
-				  /* scan finished? */
-				  if (i == LSQ_head)
-				    break;
-				}
-			    }
-
-			  /* was the value store forwared from the LSQ? */
-			  if (!load_lat)
-			    {
-			      int valid_addr = MD_VALID_ADDR(rs->addr);
-
-			      if (!spec_mode && !valid_addr)
-				sim_invalid_addrs++;
-
-			      /* no! go to the data cache if addr is valid */
-			      if (cache_dl1 && valid_addr)
-				{
-				  /* access the cache if non-faulting */
-				  load_lat =
-				    cache_access(cache_dl1, Read,
-						 (rs->addr & ~3), NULL, 4,
-						 sim_cycle, NULL, NULL);
-				  if (load_lat > cache_dl1_lat)
-				    events |= PEV_CACHEMISS;
-				}
-			      else
-				{
-				  /* no caches defined, just use op latency */
-				  load_lat = fu->oplat;
-				}
-			    }
-
-			  /* all loads and stores must to access D-TLB */
-			  if (dtlb && MD_VALID_ADDR(rs->addr))
-			    {
-			      /* access the D-DLB, NOTE: this code will
-				 initiate speculative TLB misses */
-			      tlb_lat =
-				cache_access(dtlb, Read, (rs->addr & ~3),
-					     NULL, 4, sim_cycle, NULL, NULL);
-			      if (tlb_lat > 1)
-				events |= PEV_TLBMISS;
-
-			      /* D-cache/D-TLB accesses occur in parallel */
-			      load_lat = MAX(tlb_lat, load_lat);
-			    }
-
-			  /* use computed cache access latency */
-			  eventq_queue_event(rs, sim_cycle + load_lat);
-
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-					  ((rs->ea_comp ? PEV_AGEN : 0)
-					   | events));
-			}
-		      else /* !load && !store */
-			{
-			  /* use deterministic functional unit latency */
-			  eventq_queue_event(rs, sim_cycle + fu->oplat);
-
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE, 
-					  rs->ea_comp ? PEV_AGEN : 0);
-			}
-
-		      /* one more inst issued */
-		      n_issued++;
-		    }
-		  else /* no functional unit */
-		    {
-		      /* insufficient functional unit resources, put operation
-			 back onto the ready list, we'll try to issue it
-			 again next cycle */
-		      readyq_enqueue(rs);
-		    }
-		}
-	      else /* does not require a functional unit! */
-		{
-		  /* FIXME: need better solution for these */
-		  /* the instruction does not need a functional unit */
-		  rs->issued = TRUE;
-
-		  /* schedule a result event */
-		  eventq_queue_event(rs, sim_cycle + 1);
-
-		  /* entered execute stage, indicate in pipe trace */
-		  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-				  rs->ea_comp ? PEV_AGEN : 0);
-
-		  /* one more inst issued */
-		  n_issued++;
-		}
-	    } /* !store */
-
-	}
-      /* else, RUU entry was squashed */
+	      /* put operation back onto the ready list, we'll try to issue
+		 it again next cycle */
+	      readyq_enqueue(rs);
+	    }
+	}
+      /* else, RUU entry was squashed */
 
       /* reclaim ready list entry, NOTE: this is done whether or not the
          instruction issued, since the instruction was once again reinserted
@@ -2896,6 +4122,33 @@ ruu_issue(void)
     }
 }
 
+/* rebuild the ready list as ruu_issue() does in a cycle in which nothing
+   issues, for the cycles skipped by ruu_skip_idle(), loads and long latency
+   ops go back at the head of the list, so its order may change each cycle */
+static void
+readyq_requeue(void)
+{
+  struct RS_link *node, *next_node;
+
+  node = ready_queue;
+  ready_queue = NULL;
+
+  for (; node; node = next_node)
+    {
+      next_node = node->next;
+
+      /* still valid? */
+      if (RSLINK_VALID(node))
+	{
+	  struct RUU_station *rs = RSLINK_RS(node);
+
+	  rs->queued = FALSE;
+	  readyq_enqueue(rs);
+	}
+      RSLINK_FREE(node);
+    }
+}
+
 
 /*
  * routines for generating on-the-fly instruction traces with support
@@ -2989,6 +4242,39 @@ static md_addr_t recover_PC;
 static md_addr_t fetch_regs_PC;
 static md_addr_t fetch_pred_PC;
 
+/* sampled simulation phases, functional simulation runs between the drain
+   of one sampled unit and the detailed warm-up of the next */
+enum sample_phase {
+  sample_none,				/* not sampling */
+  sample_warm,				/* detailed warm-up */
+  sample_measure,			/* detailed measured unit */
+  sample_drain				/* draining the pipeline */
+};
+static enum sample_phase sample_phase = sample_none;
+
+/* next non-speculative PC, after the last non-speculative inst dispatched */
+static md_addr_t sample_next_PC;
+
+/* inst count and cycle at the start of the current sampling phase */
+static counter_t sample_insn0;
+static tick_t sample_cycle0;
+
+/* in a forked parallel sampling worker, the pipe to the main process,
+   otherwise -1 */
+static int sample_worker_fd = -1;
+
+/* in a forked parallel sampling worker, the pipe from the main process that
+   carries the effects of the system calls it executes, otherwise -1 */
+static int sample_sys_fd = -1;
+
+/* send the results of a parallel sampled unit to the main process and exit,
+   DROPPED is set if the unit could not be simulated */
+static void sample_worker_done(int dropped);
+
+/* execute the system call INST, parallel sampling workers replay the effects
+   of the call executed by the main process */
+static void sample_syscall(md_inst_t inst);
+
 /* IFETCH -> DISPATCH instruction queue definition */
 struct fetch_rec {
   md_inst_t IR;				/* inst register */
@@ -3440,6 +4726,187 @@ ruu_install_odep(struct RUU_station *rs,	/* creating RUU station */
 #error No ISA target defined...
 #endif
 
+/*
+ * the pre-decoded instruction cache follows, instructions are decoded once,
+ * at their first fetch, into a direct-mapped cache indexed by PC that holds
+ * the instruction bits, opcode, and register dependence names, so that the
+ * fetch and dispatch stages need not re-read and re-decode the instruction
+ * on every execution; entries are invalidated by (non-speculative) stores to
+ * the text segment, and system calls, which may write anywhere in memory,
+ * start a new generation of entries, an entry from an earlier generation is
+ * revalidated against memory at its next fetch
+ */
+
+/* a pre-decoded instruction */
+struct decode_ent {
+  md_addr_t PC;				/* PC of instruction */
+  unsigned int gen;			/* flush generation of entry */
+  md_inst_t inst;			/* instruction bits */
+  enum md_opcode op;			/* decoded opcode */
+  int out1, out2, in1, in2, in3;	/* output/input register names */
+};
+
+/* pre-decoded instruction cache, NULL if disabled */
+static struct decode_ent *decode_cache = NULL;
+
+/* current flush generation, entries from earlier generations are invalid */
+static unsigned int decode_gen;
+
+/* pre-decoded instruction cache index of PC */
+#define DECODE_INDEX(PC)						\
+  (((PC) / sizeof(md_inst_t)) & (decode_cache_size - 1))
+
+/* non-zero if instructions A and B have the same bits */
+#ifdef TARGET_PISA
+#define DECODE_INST_EQ(A, B)	((A).a == (B).a && (A).b == (B).b)
+#else /* !TARGET_PISA */
+#define DECODE_INST_EQ(A, B)	((A) == (B))
+#endif /* TARGET_PISA */
+
+/* initialize the pre-decoded instruction cache */
+static void
+decode_init(void)
+{
+  if (!decode_cache_size)
+    return;
+
+  decode_cache =
+    (struct decode_ent *)calloc(decode_cache_size, sizeof(struct decode_ent));
+  if (!decode_cache)
+    fatal("out of virtual memory");
+
+  /* calloc()'ed entries are all from generation 0 */
+  decode_gen = 1;
+}
+
+/* decode instruction INST into pre-decoded instruction record ENT */
+static void
+decode_inst(struct decode_ent *ent,		/* record to fill */
+	    md_inst_t inst)			/* instruction to decode */
+{
+  enum md_opcode op;
+
+  ent->inst = inst;
+
+  /* decode the inst */
+  MD_SET_OPCODE(op, inst);
+
+  /* compute output/input dependencies */
+  switch (op)
+    {
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,CLASS,O1,O2,I1,I2,I3)		\
+    case OP:								\
+      ent->op = OP;							\
+      ent->out1 = O1; ent->out2 = O2;					\
+      ent->in1 = I1; ent->in2 = I2; ent->in3 = I3;			\
+      break;
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+    case OP:								\
+      /* could speculatively decode a bogus inst, convert to NOP */	\
+      ent->op = MD_NOP_OP;						\
+      ent->out1 = NA; ent->out2 = NA;					\
+      ent->in1 = NA; ent->in2 = NA; ent->in3 = NA;			\
+      break;
+#define CONNECT(OP)	/* nada... */
+#include "machine.def"
+    default:
+      /* can speculatively decode a bogus inst, convert to a NOP */
+      ent->op = MD_NOP_OP;
+      ent->out1 = NA; ent->out2 = NA;
+      ent->in1 = NA; ent->in2 = NA; ent->in3 = NA;
+    }
+}
+
+/* return the pre-decoded instruction at (valid text address) PC, reading
+   and decoding it on a miss */
+static struct decode_ent *
+decode_fetch(md_addr_t PC)			/* PC of instruction */
+{
+  struct decode_ent *ent;
+  md_inst_t inst;
+
+  decode_lookups++;
+  ent = &decode_cache[DECODE_INDEX(PC)];
+  if (ent->PC == PC && ent->gen == decode_gen)
+    {
+      decode_hits++;
+      return ent;
+    }
+
+  /* miss, read instruction from memory */
+  MD_FETCH_INST(inst, mem, PC);
+
+  /* entries from before the last flush are still good if the instruction
+     did not change */
+  if (ent->PC == PC && ent->gen != 0 && DECODE_INST_EQ(ent->inst, inst))
+    {
+      decode_hits++;
+      ent->gen = decode_gen;
+      return ent;
+    }
+
+  /* decode it */
+  decode_inst(ent, inst);
+  ent->PC = PC;
+  ent->gen = decode_gen;
+  return ent;
+}
+
+/* return the pre-decoded record for instruction INST at PC, decoding it into
+   TMP if it is not cached */
+static struct decode_ent *
+decode_lookup(md_addr_t PC,			/* PC of instruction */
+	      md_inst_t inst,			/* instruction bits */
+	      struct decode_ent *tmp)		/* scratch record */
+{
+  struct decode_ent *ent;
+
+  if (decode_cache)
+    {
+      ent = &decode_cache[DECODE_INDEX(PC)];
+      /* decoding depends only on the instruction bits */
+      if (ent->PC == PC && DECODE_INST_EQ(ent->inst, inst))
+	return ent;
+    }
+
+  /* not cached (e.g., replaced since it was fetched, or not in text) */
+  decode_inst(tmp, inst);
+  return tmp;
+}
+
+/* invalidate any pre-decoded instructions overwritten by a store to ADDR */
+static void
+decode_invalidate(md_addr_t addr)		/* address written */
+{
+  md_addr_t PC;
+
+  if (!decode_cache
+      || addr < ld_text_base || addr >= ld_text_base + ld_text_size)
+    return;
+
+  /* a store can overlap (at most) two instructions */
+  PC = addr & ~(sizeof(md_inst_t)-1);
+  decode_cache[DECODE_INDEX(PC)].gen = 0;
+  decode_cache[DECODE_INDEX(PC + sizeof(md_inst_t))].gen = 0;
+}
+
+/* force revalidation of all pre-decoded instructions */
+static void
+decode_flush(void)
+{
+  if (!decode_cache)
+    return;
+
+  /* generation 0 marks invalidated entries */
+  if (!++decode_gen)
+    {
+      /* generation count wrapped, really flush the cache */
+      memset(decode_cache, 0, decode_cache_size * sizeof(struct decode_ent));
+      decode_gen = 1;
+    }
+}
+
+
 
 /*
  * configure the execution engine
@@ -3623,7 +5090,7 @@ ruu_install_odep(struct RUU_station *rs,	/* creating RUU station */
 #define SYSCALL(INST)							\
   (/* only execute system calls in non-speculative mode */		\
    (spec_mode ? panic("speculative syscall") : (void) 0),		\
-   sys_syscall(&regs, mem_access, mem, INST, TRUE))
+   sample_syscall(INST))
 
 /* default register state accessor, used by DLite */
 static char *					/* err str, NULL for no err */
@@ -3756,6 +5223,7 @@ ruu_dispatch(void)
   int n_dispatched;			/* total insts dispatched */
   md_inst_t inst;			/* actual instruction bits */
   enum md_opcode op;			/* decoded opcode enum */
+  struct decode_ent *dec, dec_tmp;	/* pre-decoded instruction */
   int out1, out2, in1, in2, in3;	/* output/input register names */
   md_addr_t target_PC;			/* actual next/target PC address */
   md_addr_t addr;			/* effective address, if load/store */
@@ -3785,7 +5253,9 @@ ruu_dispatch(void)
 	 /* insts still available from fetch unit? */
 	 && fetch_num != 0
 	 /* on an acceptable trace path */
-	 && (ruu_include_spec || !spec_mode))
+	 && (ruu_include_spec || !spec_mode)
+	 /* not draining the pipeline after a sampled unit? */
+	 && sample_phase != sample_drain)
     {
       /* if issuing in-order, block until last op issues if inorder issue */
       if (ruu_inorder_issue
@@ -3804,8 +5274,9 @@ ruu_dispatch(void)
       stack_recover_idx = fetch_data[fetch_head].stack_recover_idx;
       pseq = fetch_data[fetch_head].ptrace_seq;
 
-      /* decode the inst */
-      MD_SET_OPCODE(op, inst);
+      /* decode the inst, or get its pre-decoded record */
+      dec = decode_lookup(regs.regs_PC, inst, &dec_tmp);
+      op = dec->op;
 
       /* compute default next PC */
       regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
@@ -3840,26 +5311,19 @@ ruu_dispatch(void)
       /* set default fault - none */
       fault = md_fault_none;
 
-      /* more decoding and execution */
+      /* output/input dependencies to out1-2 and in1-3 were decoded */
+      out1 = dec->out1; out2 = dec->out2;
+      in1 = dec->in1; in2 = dec->in2; in3 = dec->in3;
+
+      /* execution */
       switch (op)
 	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,CLASS,O1,O2,I1,I2,I3)		\
 	case OP:							\
-	  /* compute output/input dependencies to out1-2 and in1-3 */	\
-	  out1 = O1; out2 = O2;						\
-	  in1 = I1; in2 = I2; in3 = I3;					\
 	  /* execute the instruction */					\
 	  SYMCAT(OP,_IMPL);						\
 	  break;
-#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
-	case OP:							\
-	  /* could speculatively decode a bogus inst, convert to NOP */	\
-	  op = MD_NOP_OP;						\
-	  /* compute output/input dependencies to out1-2 and in1-3 */	\
-	  out1 = NA; out2 = NA;						\
-	  in1 = NA; in2 = NA; in3 = NA;					\
-	  /* no EXPR */							\
-	  break;
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)	/* decoded to NOP */
 #define CONNECT(OP)	/* nada... */
 	  /* the following macro wraps the instruction fault declaration macro
 	     with a test to see if the trace generator is in non-speculative
@@ -3875,12 +5339,9 @@ ruu_dispatch(void)
 	  }
 #include "machine.def"
 	default:
-	  /* can speculatively decode a bogus inst, convert to a NOP */
-	  op = MD_NOP_OP;
-	  /* compute output/input dependencies to out1-2 and in1-3 */	\
-	  out1 = NA; out2 = NA;
-	  in1 = NA; in2 = NA; in3 = NA;
+	  /* a bogus inst, decoded to a NOP */
 	  /* no EXPR */
+	  break;
 	}
       /* operation sets next PC */
 
@@ -3899,6 +5360,11 @@ ruu_dispatch(void)
 	fatal("non-speculative fault (%d) detected @ 0x%08p",
 	      fault, regs.regs_PC);
 
+      /* record where non-speculative execution continues, in case the
+	 pipeline is drained after this inst */
+      if (!spec_mode)
+	sample_next_PC = regs.regs_NPC;
+
       /* update memory access stats */
       if (MD_OP_FLAGS(op) & F_MEM)
 	{
@@ -3907,7 +5373,13 @@ ruu_dispatch(void)
 	    sim_num_refs++;
 
 	  if (MD_OP_FLAGS(op) & F_STORE)
-	    is_write = TRUE;
+	    {
+	      is_write = TRUE;
+
+	      /* drop any pre-decoded insts the store overwrote */
+	      if (!spec_mode)
+		decode_invalidate(addr);
+	    }
 	  else
 	    {
 	      sim_total_loads++;
@@ -3916,6 +5388,10 @@ ruu_dispatch(void)
 	    }
 	}
 
+      /* system calls may write anywhere, including the text segment */
+      if (MD_OP_FLAGS(op) & F_TRAP)
+	decode_flush();
+
       br_taken = (regs.regs_NPC != (regs.regs_PC + sizeof(md_inst_t))); (void)br_taken;
       br_pred_taken = (pred_PC != (regs.regs_PC + sizeof(md_inst_t)));
 
@@ -4040,6 +5516,7 @@ ruu_dispatch(void)
 	      n_dispatched++;
 	      RUU_tail = (RUU_tail + 1) % RUU_size;
 	      RUU_num++;
+	      lsq_index_insert(LSQ_tail);
 	      LSQ_tail = (LSQ_tail + 1) % LSQ_size;
 	      LSQ_num++;
 
@@ -4167,6 +5644,7 @@ ruu_dispatch(void)
       /* consume instruction from IFETCH -> DISPATCH queue */
       fetch_head = (fetch_head+1) & (ruu_ifq_size - 1);
       fetch_num--;
+      pipe_active = TRUE;
 
       /* check for DLite debugger entry condition */
       made_check = TRUE;
@@ -4205,6 +5683,9 @@ fetch_init(void)
   fetch_tail = fetch_head = 0;
   IFQ_count = 0;
   IFQ_fcount = 0;
+
+  /* fetch and dispatch share the pre-decoded instruction cache */
+  decode_init();
 }
 
 /* dump contents of fetch stage registers and fetch queue */
@@ -4254,6 +5735,7 @@ ruu_fetch(void)
 {
   int i, lat, tlb_lat, done = FALSE;
   md_inst_t inst;
+  struct decode_ent *dec;
   int stack_recover_idx;
   int branch_cnt;
 
@@ -4274,14 +5756,33 @@ ruu_fetch(void)
 	  && fetch_regs_PC < (ld_text_base+ld_text_size)
 	  && !(fetch_regs_PC & (sizeof(md_inst_t)-1)))
 	{
-	  /* read instruction from memory */
-	  MD_FETCH_INST(inst, mem, fetch_regs_PC);
+	  /* fetch waits while the I-cache MSHRs cannot track another miss */
+	  if (cache_il1 && cache_il1->mshr
+	      && cache_mshr_blocked(cache_il1, IACOMPRESS(fetch_regs_PC)))
+	    {
+	      cache_il1->mshr->stalls++;
+	      ruu_fetch_mshr_blocked = TRUE;
+	      break;
+	    }
+
+	  /* read instruction from memory, or the pre-decoded inst cache */
+	  if (decode_cache)
+	    {
+	      dec = decode_fetch(fetch_regs_PC);
+	      inst = dec->inst;
+	    }
+	  else
+	    {
+	      dec = NULL;
+	      MD_FETCH_INST(inst, mem, fetch_regs_PC);
+	    }
 
 	  /* address is within program text, read instruction from memory */
 	  lat = cache_il1_lat;
 	  if (cache_il1)
 	    {
 	      /* access the I-cache */
+	      cache_il1->access_pc = fetch_regs_PC;
 	      lat =
 		cache_access(cache_il1, Read, IACOMPRESS(fetch_regs_PC),
 			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
@@ -4310,6 +5811,7 @@ ruu_fetch(void)
 	    {
 	      /* I-cache miss, block fetch until it is resolved */
 	      ruu_fetch_issue_delay += lat - 1;
+	      pipe_active = TRUE;
 	      break;
 	    }
 	  /* else, I-cache/I-TLB hit */
@@ -4318,6 +5820,7 @@ ruu_fetch(void)
 	{
 	  /* fetch PC is bogus, send a NOP down the pipeline */
 	  inst = MD_NOP_INST;
+	  dec = NULL;
 	}
 
       /* have a valid inst, here */
@@ -4328,7 +5831,10 @@ ruu_fetch(void)
 	  enum md_opcode op;
 
 	  /* pre-decode instruction, used for bpred stats recording */
-	  MD_SET_OPCODE(op, inst);
+	  if (dec)
+	    op = dec->op;
+	  else
+	    MD_SET_OPCODE(op, inst);
 	  
 	  /* get the next predicted fetch address; only use branch predictor
 	     result for branches (assumes pre-decode bits); NOTE: returned
@@ -4388,9 +5894,97 @@ ruu_fetch(void)
       /* adjust instruction fetch queue */
       fetch_tail = (fetch_tail + 1) & (ruu_ifq_size - 1);
       fetch_num++;
+      pipe_active = TRUE;
     }
 }
 
+/* skip over idle cycles, called at the start of cycle SIM_CYCLE after a
+   cycle in which no pipeline stage made progress; until the next event
+   completes, the next cache miss is filled, a functional unit is released
+   or the fetch unit unblocks, every cycle would be identical to the last,
+   so advance SIM_CYCLE directly to that point and update the occupancy
+   stats and countdowns in bulk */
+static void
+ruu_skip_idle(void)
+{
+  int i;
+  tick_t when, wake, skip, n;
+
+  /* next writeback event */
+  if (!eventq_next_time(&wake))
+    wake = 0;
+
+#define WAKE_AT(T)	if (!wake || (T) < wake) wake = (T)
+
+  /* next cache miss fill */
+  if (miss_queue && miss_queue->size > 0)
+    WAKE_AT(miss_queue->entries[0].ready_time);
+
+  /* next MSHR freed, loads or fetch may be waiting for it */
+  for (i=0; i<mshr_nfiles; i++)
+    {
+      if (mshr_next_ready(mshr_files[i], &when))
+	WAKE_AT(when);
+    }
+
+  /* next fetch, if the IFQ has room, fetch waiting for a free I-cache MSHR
+     wakes with the MSHRs above */
+  if (fetch_num < ruu_ifq_size && !ruu_fetch_mshr_blocked)
+    WAKE_AT(sim_cycle + ruu_fetch_issue_delay);
+
+  /* next functional unit release */
+  for (i=0; i<fu_pool->num_resources; i++)
+    {
+      if (fu_pool->resources[i].busy > 0)
+	{
+	  when = sim_cycle + fu_pool->resources[i].busy - 1;
+	  WAKE_AT(when);
+	}
+    }
+
+#undef WAKE_AT
+
+  /* nothing pending, or something happens this cycle */
+  if (!wake || wake <= sim_cycle)
+    return;
+
+  skip = wake - sim_cycle;
+
+  /* update buffer occupancy stats for the skipped cycles */
+  IFQ_count += skip * fetch_num;
+  IFQ_fcount += ((fetch_num == ruu_ifq_size) ? skip : 0);
+  RUU_count += skip * RUU_num;
+  RUU_fcount += ((RUU_num == RUU_size) ? skip : 0);
+  LSQ_count += skip * LSQ_num;
+  LSQ_fcount += ((LSQ_num == LSQ_size) ? skip : 0);
+
+  /* loads and fetch blocked on full MSHRs retry in every skipped cycle */
+  if (ruu_issue_mshr_blocked)
+    cache_dl1->mshr->stalls += skip * ruu_issue_mshr_blocked;
+  if (ruu_fetch_mshr_blocked)
+    cache_il1->mshr->stalls += skip;
+
+  /* insts that did not issue are put back onto the ready list in every
+     skipped cycle */
+  if (!readyq_bitmap)
+    {
+      for (n=0; n<skip && ready_queue; n++)
+	readyq_requeue();
+    }
+
+  /* count down fetch blocking and functional unit busy times */
+  ruu_fetch_issue_delay =
+    (ruu_fetch_issue_delay > skip) ? ruu_fetch_issue_delay - skip : 0;
+  for (i=0; i<fu_pool->num_resources; i++)
+    {
+      if (fu_pool->resources[i].busy > 0)
+	fu_pool->resources[i].busy -= skip;
+    }
+
+  sim_idle_skipped += skip;
+  sim_cycle = wake;
+}
+
 /* default machine state accessor, used by DLite */
 static char *					/* err str, NULL for no err */
 simoo_mstate_obj(FILE *stream,			/* output stream */
@@ -4473,110 +6067,700 @@ simoo_mstate_obj(FILE *stream,			/* output stream */
 }
 
 
-/* start simulation, program loaded, processor precise state initialized */
-void
-sim_main(void)
+/* update the caches, TLBs and branch predictor for the inst at the current
+   PC, executed during functional simulation, with bits INST, opcode OP,
+   effective address ADDR and branch target TARGET_PC */
+static void
+sim_warm(md_inst_t inst,		/* instruction bits */
+	 enum md_opcode op,		/* decoded opcode enum */
+	 md_addr_t addr,		/* effective address, if load/store */
+	 int is_write,			/* store? */
+	 md_addr_t target_PC)		/* branch target address */
 {
-  /* ignore any floating point exceptions, they may occur on mis-speculated
-     execution paths */
-  signal(SIGFPE, SIG_IGN);
+  md_addr_t bpred_PC;			/* predicted next PC */
+  struct bpred_update_t update_rec;	/* bpred direction update info */
+  int stack_idx;			/* bpred retstack recovery index */
+  int i;
 
-  /* set up program entry state */
-  regs.regs_PC = ld_prog_entry;
-  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+  /* fetch the inst through the I-cache and I-TLB */
+  if (cache_il1)
+    cache_il1->access_pc = regs.regs_PC;
+  if (cache_dl1)
+    cache_dl1->access_pc = regs.regs_PC;
+  if (cache_il1)
+    cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
+		 NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle, NULL, NULL);
+  if (itlb)
+    cache_access(itlb, Read, IACOMPRESS(regs.regs_PC),
+		 NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle, NULL, NULL);
 
-  /* check for DLite debugger entry condition */
-  if (dlite_check_break(regs.regs_PC, /* no access */0, /* addr */0, 0, 0))
-    dlite_main(regs.regs_PC, regs.regs_PC + sizeof(md_inst_t),
-	       sim_cycle, &regs, mem);
+  /* loads and stores access the D-cache and D-TLB */
+  if ((MD_OP_FLAGS(op) & F_MEM) && MD_VALID_ADDR(addr))
+    {
+      if (cache_dl1)
+	cache_access(cache_dl1, is_write ? Write : Read, (addr & ~3),
+		     NULL, 4, sim_cycle, NULL, NULL);
+      if (dtlb)
+	cache_access(dtlb, Read, (addr & ~3), NULL, 4, sim_cycle, NULL, NULL);
+    }
 
-  /* fast forward simulator loop, performs functional simulation for
-     FASTFWD_COUNT insts, then turns on performance (timing) simulation */
-  if (fastfwd_count > 0)
+  /* train the branch predictor on the resolved branch */
+  if (pred && (MD_OP_FLAGS(op) & F_CTRL))
     {
-      int icount;
-      md_inst_t inst;			/* actual instruction bits */
-      enum md_opcode op;		/* decoded opcode enum */
-      md_addr_t target_PC; (void)target_PC;		/* actual next/target PC address */
-      md_addr_t addr;			/* effective address, if load/store */
-      int is_write;			/* store? */
-      byte_t temp_byte = 0;		/* temp variable for spec mem access */
-      half_t temp_half = 0;		/* " ditto " */
-      word_t temp_word = 0;		/* " ditto " */
+      bpred_PC = bpred_lookup(pred,
+			      /* branch addr */regs.regs_PC,
+			      /* target */target_PC,
+			      /* inst opcode */op,
+			      /* call? */MD_IS_CALL(op),
+			      /* return? */MD_IS_RETURN(op),
+			      /* stash an update ptr */&update_rec,
+			      /* stash return stack ptr */&stack_idx);
+      if (!bpred_PC)
+	bpred_PC = regs.regs_PC + sizeof(md_inst_t);
+
+      bpred_update(pred,
+		   /* branch addr */regs.regs_PC,
+		   /* resolved branch target */regs.regs_NPC,
+		   /* taken? */regs.regs_NPC != (regs.regs_PC +
+						 sizeof(md_inst_t)),
+		   /* pred taken? */bpred_PC != (regs.regs_PC +
+						  sizeof(md_inst_t)),
+		   /* correct pred? */bpred_PC == regs.regs_NPC,
+		   /* opcode */op,
+		   /* predictor update pointer */&update_rec);
+    }
+
+  /* no timing is modeled, so outstanding misses complete immediately */
+  while (miss_queue->size > 0)
+    miss_queue_extract_min(miss_queue, sim_cycle);
+  for (i=0; i<mshr_nfiles; i++)
+    mshr_flush(mshr_files[i]);
+  for (i=0; i<nbuses; i++)
+    bus_flush(buses[i]);
+  if (dram)
+    dram_flush(dram);
+}
+
+/* functionally simulate insts until the count *ICOUNT reaches LIMIT, if WARM
+   is set, the caches, TLBs and branch predictor are updated as each inst
+   executes, but no timing is modeled */
+static void
+sim_fastfwd(counter_t *icount,		/* insts executed, updated */
+	    counter_t limit,		/* stop once *ICOUNT reaches this */
+	    int warm)			/* warm caches and bpred? */
+{
+  md_inst_t inst;			/* actual instruction bits */
+  enum md_opcode op;			/* decoded opcode enum */
+  md_addr_t target_PC;			/* actual next/target PC address */
+  md_addr_t addr;			/* effective address, if load/store */
+  int is_write;				/* store? */
+  byte_t temp_byte = 0;			/* temp variable for spec mem access */
+  half_t temp_half = 0;			/* " ditto " */
+  word_t temp_word = 0;			/* " ditto " */
 #ifdef HOST_HAS_QWORD
-      qword_t temp_qword = 0; (void)temp_qword;		/* " ditto " */
+  qword_t temp_qword = 0; (void)temp_qword;	/* " ditto " */
 #endif /* HOST_HAS_QWORD */
-      enum md_fault_type fault;
+  enum md_fault_type fault;
 
-      fprintf(stderr, "sim: ** fast forwarding %d insts **\n", fastfwd_count);
+  while (*icount < limit)
+    {
+      /* one more inst executed, counted before it may exit the program */
+      (*icount)++;
 
-      for (icount=0; icount < fastfwd_count; icount++)
-	{
-	  /* maintain $r0 semantics */
-	  regs.regs_R[MD_REG_ZERO] = 0;
+      /* maintain $r0 semantics */
+      regs.regs_R[MD_REG_ZERO] = 0;
 #ifdef TARGET_ALPHA
-	  regs.regs_F.d[MD_REG_ZERO] = 0.0;
+      regs.regs_F.d[MD_REG_ZERO] = 0.0;
 #endif /* TARGET_ALPHA */
 
-	  /* get the next instruction to execute */
-	  MD_FETCH_INST(inst, mem, regs.regs_PC);
+      /* get the next instruction to execute */
+      MD_FETCH_INST(inst, mem, regs.regs_PC);
 
-	  /* set default reference address */
-	  addr = 0; is_write = FALSE;
+      /* set default reference address */
+      addr = 0; is_write = FALSE;
 
-	  /* set default fault - none */
-	  fault = md_fault_none;
+      /* set default fault - none */
+      fault = md_fault_none;
 
-	  /* decode the instruction */
-	  MD_SET_OPCODE(op, inst);
+      /* decode the instruction */
+      MD_SET_OPCODE(op, inst);
 
-	  /* execute the instruction */
-	  switch (op)
-	    {
+      /* execute the instruction */
+      switch (op)
+	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
-	    case OP:							\
-	      SYMCAT(OP,_IMPL);						\
-	      break;
+	case OP:							\
+	  SYMCAT(OP,_IMPL);						\
+	  break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
-	    case OP:							\
-	      panic("attempted to execute a linking opcode");
+	case OP:							\
+	  panic("attempted to execute a linking opcode");
 #define CONNECT(OP)
 #undef DECLARE_FAULT
 #define DECLARE_FAULT(FAULT)						\
-	      { fault = (FAULT); break; }
+	  { fault = (FAULT); break; }
 #include "machine.def"
-	    default:
-	      panic("attempted to execute a bogus opcode");
-	    }
+	default:
+	  panic("attempted to execute a bogus opcode");
+	}
 
-	  if (fault != md_fault_none)
-	    fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
+      if (fault != md_fault_none)
+	fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
 
-	  /* update memory access stats */
-	  if (MD_OP_FLAGS(op) & F_MEM)
-	    {
-	      if (MD_OP_FLAGS(op) & F_STORE)
-		is_write = TRUE;
-	    }
+      /* update memory access stats */
+      if (MD_OP_FLAGS(op) & F_MEM)
+	{
+	  if (MD_OP_FLAGS(op) & F_STORE)
+	    is_write = TRUE;
+	}
 
-	  /* check for DLite debugger entry condition */
-	  if (dlite_check_break(regs.regs_NPC,
-				is_write ? ACCESS_WRITE : ACCESS_READ,
-				addr, sim_num_insn, sim_num_insn))
-	    dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+      /* warm the caches and branch predictor, if requested */
+      if (warm)
+	sim_warm(inst, op, addr, is_write, target_PC);
 
-	  /* go to the next instruction */
-	  regs.regs_PC = regs.regs_NPC;
-	  regs.regs_NPC += sizeof(md_inst_t);
-	}
+      /* check for DLite debugger entry condition */
+      if (dlite_check_break(regs.regs_NPC,
+			    is_write ? ACCESS_WRITE : ACCESS_READ,
+			    addr, sim_num_insn, sim_num_insn))
+	dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+
+      /* go to the next instruction */
+      regs.regs_PC = regs.regs_NPC;
+      regs.regs_NPC += sizeof(md_inst_t);
     }
 
-  fprintf(stderr, "sim: ** starting performance simulation **\n");
+  /* stores and system calls above may have rewritten the text, so make the
+     timing simulator revalidate its pre-decoded insts */
+  decode_flush();
+}
+
+/* set up the timing simulation entry state at the current non-speculative
+   PC, with an empty instruction fetch queue */
+static void
+sim_enter_timing(void)
+{
+  /* discard any insts left in the IFETCH -> DISPATCH queue */
+  while (fetch_num != 0)
+    {
+      if (ptrace_active)
+	ptrace_endinst(fetch_data[fetch_head].ptrace_seq);
+      fetch_head = (fetch_head+1) & (ruu_ifq_size - 1);
+      fetch_num--;
+    }
+  fetch_tail = fetch_head = 0;
+
+  /* the text may have changed since the insts were pre-decoded */
+  decode_flush();
 
-  /* set up timing simulation entry state */
   fetch_regs_PC = regs.regs_PC - sizeof(md_inst_t);
   fetch_pred_PC = regs.regs_PC;
   regs.regs_PC = regs.regs_PC - sizeof(md_inst_t);
+}
+
+/* record the CPI of a measured unit of INSNS insts that took CYCLES cycles */
+static void
+sample_record(tick_t cycles,		/* cycles of the measured unit */
+	      counter_t insns)		/* insts of the measured unit */
+{
+  double cpi, n;
+
+  cpi = (double)cycles / (double)insns;
+  sample_units++;
+  sample_cpi_sum += cpi;
+  sample_cpi_sum2 += cpi * cpi;
+
+  /* update the CPI estimate and its 99.7% (3 sigma) confidence */
+  n = (double)sample_units;
+  sample_cpi = sample_cpi_sum / n;
+  if (sample_units > 1)
+    sample_cpi_stddev =
+      sqrt(MAX(0.0, (sample_cpi_sum2 - sample_cpi_sum * sample_cpi)
+	       / (n - 1.0)));
+  sample_cpi_ci = 3.0 * sample_cpi_stddev / sqrt(n);
+}
+
+/* functionally simulate the insts between two sampled units, then start the
+   detailed warm-up of the next unit */
+static void
+sample_functional(void)
+{
+  counter_t count = sample_period - sample_warmup - sample_unit;
+
+  /* do not run past the instruction limit */
+  if (max_insts)
+    count = MIN(count, max_insts - MIN(max_insts,
+				       sim_num_insn + sample_fwd_insn));
+
+  sim_fastfwd(&sample_fwd_insn, sample_fwd_insn + count, sample_fwarm);
+
+  sample_phase = sample_warm;
+  sample_insn0 = sim_num_insn;
+}
+
+/* advance the sampled simulation to its next phase, if the current phase is
+   complete, called at the end of each cycle */
+static void
+sample_advance(void)
+{
+  switch (sample_phase)
+    {
+    case sample_warm:
+      /* detailed warm-up done, start measuring */
+      if (sim_num_insn - sample_insn0 >= sample_warmup)
+	{
+	  sample_phase = sample_measure;
+	  sample_insn0 = sim_num_insn;
+	  sample_cycle0 = sim_cycle;
+	}
+      break;
+
+    case sample_measure:
+      /* unit measured, record its CPI and drain the pipeline */
+      if (sim_num_insn - sample_insn0 >= sample_unit)
+	{
+	  /* a parallel unit is done, hand it to the main process */
+	  if (sample_worker_fd >= 0)
+	    sample_worker_done(/* !dropped */FALSE);
+
+	  sample_record(sim_cycle - sample_cycle0, sim_num_insn - sample_insn0);
+	  sample_phase = sample_drain;
+	}
+      break;
+
+    case sample_drain:
+      /* once all dispatched insts have committed, continue functionally
+	 after the last non-speculative inst */
+      if (RUU_num == 0)
+	{
+	  if (spec_mode)
+	    panic("drained and speculative");
+
+	  regs.regs_PC = sample_next_PC;
+	  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+	  sample_functional();
+	  sim_enter_timing();
+	}
+      break;
+
+    default:
+      panic("bogus sampling phase");
+    }
+}
+
+/* parallel sampling workers in flight, oldest first, in a circular queue of
+   SAMPLE_JOBS entries */
+static struct sample_job_t {
+  pid_t pid;				/* worker process */
+  int fd;				/* read end of its result pipe */
+  int sys_fd;				/* write end of its system call pipe,
+					   -1 once closed */
+  counter_t end;			/* inst count after which its unit
+					   executes no more system calls */
+} *sample_job_tab;
+static int sample_job_head = 0;
+static int sample_job_num = 0;
+
+/* result of a parallel sampled unit, sent by the worker followed by the
+   stat snapshots taken at the start and the end of the unit */
+struct sample_result_t {
+  tick_t cycles;			/* cycles of the measured unit */
+  counter_t insns;			/* measured insts, 0 if none */
+  int dropped;				/* unit could not be simulated? */
+};
+
+/* memory written by a system call, sent to the workers followed by the
+   bytes written */
+struct sample_sys_write_t {
+  md_addr_t addr;			/* target address written */
+  int nbytes;				/* bytes written, 0 ends the call */
+};
+
+/* stat snapshot buffers, before and after a unit */
+static int sample_snap_size;
+static char *sample_snap;
+
+/* write LEN bytes from BUF to FD, returns FALSE on error */
+static int
+sample_write(int fd, void *buf, int len)
+{
+  int n;
+
+  while (len > 0)
+    {
+      if ((n = write(fd, buf, len)) <= 0)
+	return FALSE;
+      buf = (char *)buf + n; len -= n;
+    }
+  return TRUE;
+}
+
+/* read LEN bytes into BUF from FD, returns FALSE on EOF or error */
+static int
+sample_read(int fd, void *buf, int len)
+{
+  int n;
+
+  while (len > 0)
+    {
+      if ((n = read(fd, buf, len)) <= 0)
+	return FALSE;
+      buf = (char *)buf + n; len -= n;
+    }
+  return TRUE;
+}
+
+/* send the results of a parallel sampled unit to the main process and exit,
+   DROPPED is set if the unit could not be simulated */
+static void
+sample_worker_done(int dropped)
+{
+  struct sample_result_t res;
+
+  /* no more system calls, so the main process never blocks on this worker
+     while it waits for the results */
+  close(sample_sys_fd);
+  sample_sys_fd = -1;
+
+  res.cycles = sim_cycle - sample_cycle0;
+  res.insns = (sample_phase == sample_measure
+	       && sim_num_insn - sample_insn0 >= sample_unit)
+    ? sim_num_insn - sample_insn0 : 0;
+  res.dropped = dropped;
+  stat_snapshot(sim_sdb, sample_snap + sample_snap_size);
+
+  if (!sample_write(sample_worker_fd, &res, sizeof(res))
+      || !sample_write(sample_worker_fd, sample_snap, 2*sample_snap_size))
+    _exit(1);
+
+  /* do not flush stdio buffers shared with the main process */
+  _exit(0);
+}
+
+/* send LEN bytes from BUF to the workers still taking system calls, the
+   pipes of workers that have finished are closed */
+static void
+sample_sys_send(void *buf, int len)
+{
+  int i;
+  struct sample_job_t *job;
+
+  for (i=0; i < sample_job_num; i++)
+    {
+      job = &sample_job_tab[(sample_job_head + i) % sample_jobs];
+      if (job->sys_fd >= 0 && !sample_write(job->sys_fd, buf, len))
+	{
+	  close(job->sys_fd);
+	  job->sys_fd = -1;
+	}
+    }
+}
+
+/* memory accessor of the system calls executed by the main process, sends
+   the memory written to the workers */
+static enum md_fault_type
+sample_sys_access(struct mem_t *mem,	/* memory space to access */
+		  enum mem_cmd cmd,	/* Read or Write */
+		  md_addr_t addr,	/* target memory address to access */
+		  void *p,		/* where to copy to/from */
+		  int nbytes)		/* transfer length in bytes */
+{
+  struct sample_sys_write_t w;
+
+  if (cmd == Write && nbytes > 0)
+    {
+      w.addr = addr;
+      w.nbytes = nbytes;
+      sample_sys_send(&w, sizeof(w));
+      sample_sys_send(p, nbytes);
+    }
+  return mem_access(mem, cmd, addr, p, nbytes);
+}
+
+/* replay in a worker the system call that is inst ICOUNT of the program,
+   with the effects sent by the main process, which executed the call */
+static void
+sample_sys_replay(counter_t icount)
+{
+  counter_t n;
+  struct sample_sys_write_t w;
+  byte_t buf[1024];
+  int len;
+
+  /* the main process stopped sending calls before this one */
+  if (!sample_read(sample_sys_fd, &n, sizeof(n)) || n != icount)
+    sample_worker_done(/* dropped */TRUE);
+
+  /* the effects of a call end early if the program exited in it, as it
+     does in the main process, and so does the unit */
+  for (;;)
+    {
+      if (!sample_read(sample_sys_fd, &w, sizeof(w)))
+	sample_worker_done(/* !dropped */FALSE);
+      if (w.nbytes == 0)
+	break;
+
+      for (; w.nbytes > 0; w.addr += len, w.nbytes -= len)
+	{
+	  len = MIN(w.nbytes, sizeof(buf));
+	  if (!sample_read(sample_sys_fd, buf, len))
+	    sample_worker_done(/* !dropped */FALSE);
+	  mem_access(mem, Write, w.addr, buf, len);
+	}
+    }
+  if (!sample_read(sample_sys_fd, &regs, sizeof(regs)))
+    sample_worker_done(/* !dropped */FALSE);
+}
+
+/* execute the system call INST, parallel sampling workers replay the effects
+   of the call executed by the main process */
+static void
+sample_syscall(md_inst_t inst)
+{
+  int i;
+  counter_t n;
+  struct sample_job_t *job;
+  struct sample_sys_write_t w;
+
+  /* both processes count the call before executing it, workers in detailed
+     simulation once all earlier insts have committed */
+  if (sample_sys_fd >= 0)
+    {
+      sample_sys_replay(sim_num_insn + sample_fwd_insn);
+      return;
+    }
+
+  if (sample_job_num == 0)
+    {
+      sys_syscall(&regs, mem_access, mem, inst, TRUE);
+      return;
+    }
+
+  /* the main process executes the call functionally, and sends its effects
+     to the workers whose units may reach it */
+  n = sim_num_insn + sample_fwd_insn;
+  for (i=0; i < sample_job_num; i++)
+    {
+      job = &sample_job_tab[(sample_job_head + i) % sample_jobs];
+      if (job->sys_fd >= 0 && n > job->end)
+	{
+	  close(job->sys_fd);
+	  job->sys_fd = -1;
+	}
+    }
+
+  sample_sys_send(&n, sizeof(n));
+  sys_syscall(&regs, sample_sys_access, mem, inst, TRUE);
+  w.addr = 0;
+  w.nbytes = 0;
+  sample_sys_send(&w, sizeof(w));
+  sample_sys_send(&regs, sizeof(regs));
+}
+
+/* wait for the oldest parallel sampling worker and merge its results */
+static void
+sample_reap(void)
+{
+  struct sample_job_t *job = &sample_job_tab[sample_job_head];
+  struct sample_result_t res;
+  int status;
+
+  /* a worker waiting for a system call this process will not send drops
+     its unit */
+  if (job->sys_fd >= 0)
+    close(job->sys_fd);
+
+  if (!sample_read(job->fd, &res, sizeof(res))
+      || !sample_read(job->fd, sample_snap, 2*sample_snap_size))
+    fatal("sampling worker %d did not complete", (int)job->pid);
+  close(job->fd);
+  if (waitpid(job->pid, &status, 0) < 0)
+    fatal("cannot wait for sampling worker %d", (int)job->pid);
+
+  sample_job_head = (sample_job_head + 1) % sample_jobs;
+  sample_job_num--;
+
+  if (res.dropped)
+    sample_dropped++;
+  if (res.insns > 0)
+    sample_record(res.cycles, res.insns);
+  stat_add_delta(sim_sdb, sample_snap, sample_snap + sample_snap_size);
+}
+
+/* merge the results of all outstanding workers before the final stats are
+   printed, called at simulator exit */
+static void
+sample_exit(void)
+{
+  if (sample_worker_fd >= 0)
+    sample_worker_done(/* !dropped */FALSE);
+
+  while (sample_job_num > 0)
+    sample_reap();
+
+  if (sample_dropped > 0 && sample_units == 0)
+    fatal("all %d parallel sampled units were dropped, "
+	  "rerun without -sample:jobs", (int)sample_dropped);
+}
+
+/* run the program functionally, forking a worker process at the start of
+   each sampled unit that simulates the unit in detail from its copy of the
+   simulator state, returns TRUE in the workers, which should proceed with
+   detailed simulation, and FALSE in the main process once all units have
+   been started */
+static int
+sample_parallel(void)
+{
+  int i, pfd[2], sfd[2];
+  pid_t pid;
+  counter_t start, end;
+  struct sample_job_t *job;
+
+  sample_job_tab = calloc(sample_jobs, sizeof(struct sample_job_t));
+  sample_snap_size = stat_snapshot_size(sim_sdb);
+  sample_snap = calloc(2, MAX(sample_snap_size, 1));
+  if (!sample_job_tab || !sample_snap)
+    fatal("out of virtual memory");
+  sim_exit_hook = sample_exit;
+
+  /* workers close their system call pipes when their units are done */
+  signal(SIGPIPE, SIG_IGN);
+
+  for (i=0; !sample_nwindows || i < sample_nwindows; i++)
+    {
+      if (sample_nwindows)
+	start = sample_windows[i];
+      else
+	start = (counter_t)i * sample_period
+	  + (sample_period - sample_warmup - sample_unit);
+
+      /* do not run past the instruction limit */
+      if (max_insts && start >= max_insts)
+	{
+	  sim_fastfwd(&sample_fwd_insn, max_insts, sample_fwarm);
+	  break;
+	}
+      sim_fastfwd(&sample_fwd_insn, start, sample_fwarm);
+
+      /* wait for a free worker slot */
+      if (sample_job_num == sample_jobs)
+	sample_reap();
+
+      if (pipe(pfd) < 0 || pipe(sfd) < 0)
+	fatal("cannot create sampling worker pipe");
+      fflush(stdout);
+      fflush(stderr);
+      if ((pid = fork()) < 0)
+	fatal("cannot fork sampling worker");
+
+      if (pid == 0)
+	{
+	  /* worker: simulate this unit in detail, then report back */
+	  close(pfd[0]);
+	  close(sfd[1]);
+
+	  /* the pipes of the other workers belong to the main process, and
+	     would keep them from seeing it close them */
+	  for (; sample_job_num > 0; sample_job_num--)
+	    {
+	      job = &sample_job_tab[sample_job_head];
+	      close(job->fd);
+	      if (job->sys_fd >= 0)
+		close(job->sys_fd);
+	      sample_job_head = (sample_job_head + 1) % sample_jobs;
+	    }
+
+	  sample_worker_fd = pfd[1];
+	  sample_sys_fd = sfd[0];
+	  max_insts = 0;
+	  stat_snapshot(sim_sdb, sample_snap);
+	  sample_phase = sample_warm;
+	  sample_insn0 = sim_num_insn;
+	  return TRUE;
+	}
+
+      close(pfd[1]);
+      close(sfd[0]);
+      job = &sample_job_tab[(sample_job_head + sample_job_num) % sample_jobs];
+      job->pid = pid;
+      job->fd = pfd[0];
+      job->sys_fd = sfd[1];
+      /* each phase of the unit may overrun by up to a commit group */
+      job->end = sim_num_insn + sample_fwd_insn + sample_warmup + sample_unit
+	+ 2 * ruu_commit_width;
+      sample_job_num++;
+    }
+
+  /* keep executing the program for the units still in flight, until they
+     are past any system calls they need */
+  for (i=0, end=0; i < sample_job_num; i++)
+    end = MAX(end,
+	      sample_job_tab[(sample_job_head + i) % sample_jobs].end);
+  if (max_insts)
+    end = MIN(end, max_insts);
+  if (end > sim_num_insn + sample_fwd_insn)
+    sim_fastfwd(&sample_fwd_insn, end - sim_num_insn, sample_fwarm);
+
+  /* outstanding workers are merged by sample_exit() */
+  return FALSE;
+}
+
+/* start simulation, program loaded, processor precise state initialized */
+void
+sim_main(void)
+{
+  int i;
+
+  /* ignore any floating point exceptions, they may occur on mis-speculated
+     execution paths */
+  signal(SIGFPE, SIG_IGN);
+
+  /* set up program entry state */
+  regs.regs_PC = ld_prog_entry;
+  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+
+  /* check for DLite debugger entry condition */
+  if (dlite_check_break(regs.regs_PC, /* no access */0, /* addr */0, 0, 0))
+    dlite_main(regs.regs_PC, regs.regs_PC + sizeof(md_inst_t),
+	       sim_cycle, &regs, mem);
+
+  /* fast forward simulator loop, performs functional simulation for
+     FASTFWD_COUNT insts, then turns on performance (timing) simulation */
+  if (fastfwd_count > 0)
+    {
+      counter_t icount = 0;
+
+      fprintf(stderr, "sim: ** fast forwarding %d insts **\n", fastfwd_count);
+      sim_fastfwd(&icount, fastfwd_count, /* !warm */FALSE);
+    }
+
+  /* sampled simulation starts with functional simulation */
+  if (sample_jobs && (sample_period || sample_nwindows))
+    {
+      if (sample_nwindows)
+	fprintf(stderr, "sim: ** sampling %u insts in %d windows, "
+		"%d units in parallel **\n",
+		sample_unit, sample_nwindows, sample_jobs);
+      else
+	fprintf(stderr, "sim: ** sampling %u of every %u insts, "
+		"%d units in parallel **\n",
+		sample_unit, sample_period, sample_jobs);
+
+      /* only the workers perform detailed simulation */
+      if (!sample_parallel())
+	return;
+    }
+  else if (sample_period)
+    {
+      fprintf(stderr, "sim: ** sampling %u of every %u insts **\n",
+	      sample_unit, sample_period);
+      sample_functional();
+    }
+
+  if (sample_worker_fd < 0)
+    fprintf(stderr, "sim: ** starting performance simulation **\n");
+
+  /* set up timing simulation entry state */
+  sim_enter_timing();
 
   /* main simulator loop, NOTE: the pipe stages are traverse in reverse order
      to eliminate this/next state synchronization and relaxation problems */
@@ -4596,6 +6780,9 @@ sim_main(void)
       /* indicate new cycle in pipetrace */
       ptrace_newcycle(sim_cycle);
 
+      /* no progress made yet this cycle */
+      pipe_active = FALSE;
+
       /* commit entries from RUU/LSQ to architected register file */
       ruu_commit();
 
@@ -4634,8 +6821,12 @@ sim_main(void)
 	  ruu_issue();
 	}
 
-      /* call instruction fetch unit if it is not blocked */
-      if (!ruu_fetch_issue_delay)
+      /* call instruction fetch unit if it is not blocked, fetch stops while
+	 draining the pipeline after a sampled unit */
+      ruu_fetch_mshr_blocked = FALSE;
+      if (sample_phase == sample_drain)
+	/* nada */;
+      else if (!ruu_fetch_issue_delay)
 	ruu_fetch();
       else
 	ruu_fetch_issue_delay--;
@@ -4650,15 +6841,28 @@ sim_main(void)
 
       /* go to next cycle */
       sim_cycle++;
-      //mshr_update(mshr, sim_cycle); 
+
+      /* if no stage made progress (nothing completed, became ready, issued,
+	 committed, dispatched or fetched), skip ahead to the next cycle in
+	 which something can happen */
+      if (skip_idle && !pipe_active && !ptrace_outfd)
+	ruu_skip_idle();
+
+      /* free the MSHRs of completed misses */
+      for (i=0; i<mshr_nfiles; i++)
+	mshr_update(mshr_files[i], sim_cycle);
       
       /* 완료된 캐시 미스 처리 */
       while (miss_queue->size > 0 && miss_queue->entries[0].ready_time <= sim_cycle) {
         miss_queue_extract_min(miss_queue, sim_cycle);
       }
 
+      /* advance to the next sampling phase, if it is time */
+      if (sample_phase != sample_none)
+	sample_advance();
+
       /* finish early? */
-      if (max_insts && sim_num_insn >= max_insts)
+      if (max_insts && sim_num_insn + sample_fwd_insn >= max_insts)
 	return;
     }
 }
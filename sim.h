@@ -70,6 +70,10 @@ extern int sim_exit_now;
 /* longjmp here when simulation is completed */
 extern jmp_buf sim_exit_buf;
 
+/* if non-NULL, called when the simulation completes, before the final
+   stats are printed */
+extern void (*sim_exit_hook)(void);
+
 /* byte/word swapping required to execute target executable on this host */
 extern int sim_swap_bytes;
 extern int sim_swap_words;
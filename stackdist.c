@@ -0,0 +1,222 @@
+/* stackdist.c - LRU stack distance cache sweep routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "stackdist.h"
+
+/* create a stack distance sweep of all LRU caches with BSIZE byte blocks,
+   MIN_SETS to MAX_SETS sets and up to MAX_ASSOC ways */
+struct stackdist_t *			/* pointer to sweep created */
+stackdist_create(char *name,		/* name of the sweep */
+		 int bsize,		/* block (line) size of caches */
+		 int min_sets,		/* smallest number of sets */
+		 int max_sets,		/* largest number of sets */
+		 int max_assoc)		/* largest associativity */
+{
+  struct stackdist_t *sd;
+  int i, l, nsets;
+
+  /* check all sweep parameters */
+  if (bsize < 8 || (bsize & (bsize-1)) != 0)
+    fatal("sweep block size `%d' must be a power of two, 8 or greater", bsize);
+  if (min_sets <= 0 || (min_sets & (min_sets-1)) != 0)
+    fatal("sweep min sets `%d' must be a positive power of two", min_sets);
+  if (max_sets < min_sets || (max_sets & (max_sets-1)) != 0)
+    fatal("sweep max sets `%d' must be a power of two >= min sets", max_sets);
+  if (max_assoc <= 0 || (max_assoc & (max_assoc-1)) != 0)
+    fatal("sweep max associativity `%d' must be a positive power of two",
+	  max_assoc);
+
+  sd = (struct stackdist_t *)calloc(1, sizeof(struct stackdist_t));
+  if (!sd)
+    fatal("out of virtual memory");
+
+  /* initialize user parameters */
+  sd->name = mystrdup(name);
+  sd->bsize = bsize;
+  sd->min_sets = min_sets;
+  sd->max_sets = max_sets;
+  sd->max_assoc = max_assoc;
+
+  /* compute derived parameters */
+  sd->nlevels = log_base2(max_sets) - log_base2(min_sets) + 1;
+  sd->nassocs = log_base2(max_assoc) + 1;
+  sd->blk_shift = log_base2(bsize);
+
+  /* allocate the stacks, all entries unused */
+  sd->stacks = (md_addr_t **)calloc(sd->nlevels, sizeof(md_addr_t *));
+  if (!sd->stacks)
+    fatal("out of virtual memory");
+  for (l=0; l<sd->nlevels; l++)
+    {
+      nsets = min_sets << l;
+      sd->stacks[l] = (md_addr_t *)malloc(nsets * max_assoc * sizeof(md_addr_t));
+      if (!sd->stacks[l])
+	fatal("out of virtual memory");
+      for (i=0; i < nsets * max_assoc; i++)
+	sd->stacks[l][i] = STACKDIST_INVALID;
+    }
+
+  /* initialize sweep stats */
+  sd->accesses = 0;
+  sd->misses = (counter_t *)calloc(sd->nlevels * sd->nassocs,
+				   sizeof(counter_t));
+  if (!sd->misses)
+    fatal("out of virtual memory");
+
+  return sd;
+}
+
+/* print stack distance sweep configuration */
+void
+stackdist_config(struct stackdist_t *sd,/* sweep instance */
+		 FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "sweep: %s: %d to %d sets, %d byte blocks, 1- to %d-way, LRU\n",
+	  sd->name, sd->min_sets, sd->max_sets, sd->bsize, sd->max_assoc);
+}
+
+/* register stack distance sweep stats */
+void
+stackdist_reg_stats(struct stackdist_t *sd,/* sweep instance */
+		    struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512], buf2[512], *name;
+  int l, a, nsets, assoc, size;
+
+  /* get a name for this sweep */
+  if (!sd->name || !sd->name[0])
+    name = "<unknown>";
+  else
+    name = sd->name;
+
+  sprintf(buf, "%s.accesses", name);
+  stat_reg_counter(sdb, buf, "total number of accesses",
+		   &sd->accesses, 0, NULL);
+
+  /* misses and miss rate of every cache in the sweep */
+  for (l=0; l<sd->nlevels; l++)
+    {
+      nsets = sd->min_sets << l;
+      for (a=0; a<sd->nassocs; a++)
+	{
+	  assoc = 1 << a;
+	  size = nsets * assoc * sd->bsize;
+
+	  sprintf(buf, "%s.%dx%d.misses", name, nsets, assoc);
+	  sprintf(buf1, "misses, %d sets x %d ways (%d%s)", nsets, assoc,
+		  size >= 1024 ? size/1024 : size, size >= 1024 ? "KB" : "B");
+	  stat_reg_counter(sdb, buf, buf1, &sd->misses[l*sd->nassocs + a],
+			   0, NULL);
+	  sprintf(buf, "%s.%dx%d.miss_rate", name, nsets, assoc);
+	  sprintf(buf1, "miss rate, %d sets x %d ways", nsets, assoc);
+	  sprintf(buf2, "%s.%dx%d.misses / %s.accesses",
+		  name, nsets, assoc, name);
+	  stat_reg_formula(sdb, buf, buf1, buf2, NULL);
+	}
+    }
+}
+
+/* access address ADDR in all the caches of sweep SD */
+void
+stackdist_access(struct stackdist_t *sd,/* sweep instance */
+		 md_addr_t addr)	/* address of access */
+{
+  md_addr_t baddr = addr >> sd->blk_shift;
+  md_addr_t *stack;
+  counter_t *misses = sd->misses;
+  int l, a, depth;
+
+  sd->accesses++;
+
+  for (l=0; l<sd->nlevels; l++, misses += sd->nassocs)
+    {
+      /* find the stack distance of the block in its set */
+      stack = sd->stacks[l]
+	+ (baddr & ((sd->min_sets << l) - 1)) * sd->max_assoc;
+      for (depth=0; depth < sd->max_assoc && stack[depth] != baddr; depth++)
+	/* nada */;
+
+      /* the block is the MRU block of its set in this and, as each set is a
+	 subset of the set with half as many sets, in all larger set counts,
+	 so no stack changes and there are no misses from here on */
+      if (depth == 0)
+	break;
+
+      /* misses in every cache with at most DEPTH ways */
+      for (a=0; a < sd->nassocs && (1 << a) <= depth; a++)
+	misses[a]++;
+
+      /* move the block to the MRU position, dropping the LRU block if the
+	 block was not in the stack */
+      memmove(stack + 1, stack,
+	      MIN(depth, sd->max_assoc - 1) * sizeof(md_addr_t));
+      stack[0] = baddr;
+    }
+}
+
+/* flush all the caches of sweep SD */
+void
+stackdist_flush(struct stackdist_t *sd)/* sweep instance */
+{
+  int i, l;
+
+  for (l=0; l<sd->nlevels; l++)
+    for (i=0; i < (sd->min_sets << l) * sd->max_assoc; i++)
+      sd->stacks[l][i] = STACKDIST_INVALID;
+}
@@ -0,0 +1,133 @@
+/* stackdist.h - LRU stack distance cache sweep interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+/*
+ * This module computes the miss counts of a whole grid of LRU caches that
+ * share a block size in a single pass over a reference stream, using the
+ * stack algorithm of Mattson et al.  For every number of sets from MIN_SETS
+ * to MAX_SETS (powers of two), each set keeps its blocks in LRU order, and
+ * the depth at which a reference finds its block in the stack of its set is
+ * its stack distance.  A reference hits in each cache with that number of
+ * sets whose associativity is larger than its stack distance.  Stacks are
+ * cut off at MAX_ASSOC blocks, as deeper blocks miss in every cache of the
+ * grid.
+ *
+ * The caches swept are write-allocate and model no timing, they should
+ * produce the same miss counts as LRU caches created with cache_create().
+ */
+
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/* stack entry value of an unused entry, never a block address because
+   block addresses are shifted right by the block offset */
+#define STACKDIST_INVALID	((md_addr_t)-1)
+
+/* stack distance cache sweep definition */
+struct stackdist_t
+{
+  /* parameters */
+  char *name;			/* sweep name */
+  int bsize;			/* block size in bytes */
+  int min_sets;			/* smallest number of sets */
+  int max_sets;			/* largest number of sets */
+  int max_assoc;		/* largest associativity */
+
+  /* derived data */
+  int nlevels;			/* number of set counts swept */
+  int nassocs;			/* number of associativities swept */
+  int blk_shift;		/* log2 of the block size */
+
+  /* LRU stacks, with MIN_SETS << L sets, the MAX_ASSOC most recently used
+     block addresses of set S are at STACKS[L][S*MAX_ASSOC], MRU first */
+  md_addr_t **stacks;
+
+  /* per-sweep stats */
+  counter_t accesses;		/* total number of accesses */
+  counter_t *misses;		/* misses of the cache with MIN_SETS << L sets
+				   and 1 << A ways are at MISSES[L*NASSOCS+A] */
+};
+
+/* create a stack distance sweep of all LRU caches with BSIZE byte blocks,
+   MIN_SETS to MAX_SETS sets and up to MAX_ASSOC ways */
+struct stackdist_t *			/* pointer to sweep created */
+stackdist_create(char *name,		/* name of the sweep */
+		 int bsize,		/* block (line) size of caches */
+		 int min_sets,		/* smallest number of sets */
+		 int max_sets,		/* largest number of sets */
+		 int max_assoc);	/* largest associativity */
+
+/* print stack distance sweep configuration */
+void
+stackdist_config(struct stackdist_t *sd,/* sweep instance */
+		 FILE *stream);		/* output stream */
+
+/* register stack distance sweep stats */
+void
+stackdist_reg_stats(struct stackdist_t *sd,/* sweep instance */
+		    struct stat_sdb_t *sdb);/* stats database */
+
+/* access address ADDR in all the caches of sweep SD */
+void
+stackdist_access(struct stackdist_t *sd,/* sweep instance */
+		 md_addr_t addr);	/* address of access */
+
+/* flush all the caches of sweep SD */
+void
+stackdist_flush(struct stackdist_t *sd);/* sweep instance */
+
+#endif /* STACKDIST_H */
@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <math.h>
 
@@ -60,6 +61,17 @@
 #include "eval.h"
 #include "stats.h"
 
+/* hash stat name NAME into the stat database name index */
+static unsigned int
+stat_hash(char *name)			/* stat name */
+{
+  unsigned int hash = 0;
+
+  while (*name)
+    hash = (hash << 5) + hash + (unsigned char)*name++;
+  return hash & (STAT_HTAB_SZ - 1);
+}
+
 /* evaluate a stat as an expression */
 struct eval_value_t
 stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
@@ -69,14 +81,14 @@ stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
   static struct eval_value_t err_value = { et_int, { 0 } };
   struct eval_value_t val;
 
-  /* locate the stat variable */
-  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+  /* locate the stat variable, parsed formulas remember where it is */
+  if (es->ident_bind && *es->ident_bind)
+    stat = *es->ident_bind;
+  else
     {
-      if (!strcmp(stat->name, es->tok_buf))
-	{
-	  /* found it! */
-	  break;
-	}
+      stat = stat_find_stat(sdb, es->tok_buf);
+      if (es->ident_bind)
+	*es->ident_bind = stat;
     }
   if (!stat)
     {
@@ -126,20 +138,31 @@ stat_eval_ident(struct eval_state_t *es)/* an expression evaluator */
       fatal("stat distributions not allowed in formula expressions");
       break;
     case sc_formula:
-      {
-	/* instantiate a new evaluator to avoid recursion problems */
-	struct eval_state_t *es = eval_new(stat_eval_ident, sdb);
-	char *endp;
+      if (stat->variant.for_formula.tree)
+	{
+	  /* parsed formulas keep no state in the evaluator, reuse it */
+	  val = eval_tree(es, stat->variant.for_formula.tree);
+	  if (eval_error != ERR_NOERR)
+	    {
+	      /* pass through eval_error */
+	      val = err_value;
+	    }
+	}
+      else
+	{
+	  /* instantiate a new evaluator to avoid recursion problems */
+	  struct eval_state_t *es = eval_new(stat_eval_ident, sdb);
+	  char *endp;
 
-	val = eval_expr(es, stat->variant.for_formula.formula, &endp);
-	if (eval_error != ERR_NOERR || *endp != '\0')
-	  {
-	    /* pass through eval_error */
-	    val = err_value;
-	  }
-	/* else, use value returned */
-	eval_delete(es);
-      }
+	  val = eval_expr(es, stat->variant.for_formula.formula, &endp);
+	  if (eval_error != ERR_NOERR || *endp != '\0')
+	    {
+	      /* pass through eval_error */
+	      val = err_value;
+	    }
+	  /* else, use value returned */
+	  eval_delete(es);
+	}
       break;
     default:
       panic("bogus stat class");
@@ -189,9 +212,13 @@ stat_delete(struct stat_sdb_t *sdb)	/* stats database */
 #endif /* HOST_HAS_QWORD */
 	case sc_float:
 	case sc_double:
-	case sc_formula:
 	  /* no other storage to deallocate */
 	  break;
+	case sc_formula:
+	  /* free parsed formula */
+	  eval_tree_delete(stat->variant.for_formula.tree);
+	  stat->variant.for_formula.tree = NULL;
+	  break;
 	case sc_dist:
 	  /* free distribution array */
 	  free(stat->variant.for_dist.arr);
@@ -222,6 +249,7 @@ stat_delete(struct stat_sdb_t *sdb)	/* stats database */
       free(stat);
     }
   sdb->stats = NULL;
+  sdb->stats_tail = NULL;
   eval_delete(sdb->evaluator);
   sdb->evaluator = NULL;
   free(sdb);
@@ -232,18 +260,23 @@ static void
 add_stat(struct stat_sdb_t *sdb,	/* stat database */
 	 struct stat_stat_t *stat)	/* stat variable */
 {
-  struct stat_stat_t *elt, *prev;
-
-  /* append at end of stat database list */
-  for (prev=NULL, elt=sdb->stats; elt != NULL; prev=elt, elt=elt->next)
-    /* nada */;
+  unsigned int hash;
 
   /* append stat to stats chain */
-  if (prev != NULL)
-    prev->next = stat;
-  else /* prev == NULL */
+  if (sdb->stats_tail != NULL)
+    sdb->stats_tail->next = stat;
+  else /* sdb->stats_tail == NULL */
     sdb->stats = stat;
+  sdb->stats_tail = stat;
   stat->next = NULL;
+
+  /* index stat by name, the first stat registered under a name is found */
+  if (!stat_find_stat(sdb, stat->name))
+    {
+      hash = stat_hash(stat->name);
+      stat->hnext = sdb->htab[hash];
+      sdb->htab[hash] = stat;
+    }
 }
 
 /* register an integer statistical variable */
@@ -328,6 +361,7 @@ stat_reg_qword(struct stat_sdb_t *sdb,	/* stat database */
   stat->desc = mystrdup(desc);
   stat->format = format ? format : "%12lu";
   stat->sc = sc_qword;
+  stat->merge = sm_add;
   stat->variant.for_qword.var = var;
   stat->variant.for_qword.init_val = init_val;
 
@@ -359,6 +393,7 @@ stat_reg_sqword(struct stat_sdb_t *sdb,	/* stat database */
   stat->desc = mystrdup(desc);
   stat->format = format ? format : "%12ld";
   stat->sc = sc_sqword;
+  stat->merge = sm_add;
   stat->variant.for_sqword.var = var;
   stat->variant.for_sqword.init_val = init_val;
 
@@ -464,6 +499,7 @@ stat_reg_dist(struct stat_sdb_t *sdb,	/* stat database */
   stat->desc = mystrdup(desc);
   stat->format = format ? format : NULL;
   stat->sc = sc_dist;
+  stat->merge = sm_add;
   stat->variant.for_dist.init_val = init_val;
   stat->variant.for_dist.arr_sz = arr_sz;
   stat->variant.for_dist.bucket_sz = bucket_sz;
@@ -610,6 +646,7 @@ stat_reg_formula(struct stat_sdb_t *sdb,/* stat database */
 		 char *format)		/* optional variable output format */
 {
   struct stat_stat_t *stat;
+  char *endp;
 
   stat = (struct stat_stat_t *)calloc(1, sizeof(struct stat_stat_t));
   if (!stat)
@@ -621,6 +658,17 @@ stat_reg_formula(struct stat_sdb_t *sdb,/* stat database */
   stat->sc = sc_formula;
   stat->variant.for_formula.formula = mystrdup(formula);
 
+  /* parse the formula once, stats it references are bound when it is first
+     evaluated, formulas that do not parse are evaluated from the string */
+  stat->variant.for_formula.tree =
+    eval_parse(sdb->evaluator, stat->variant.for_formula.formula, &endp);
+  if (stat->variant.for_formula.tree
+      && (eval_error != ERR_NOERR || *endp != '\0'))
+    {
+      eval_tree_delete(stat->variant.for_formula.tree);
+      stat->variant.for_formula.tree = NULL;
+    }
+
   /* link onto SDB chain */
   add_stat(sdb, stat);
 
@@ -971,22 +1019,33 @@ stat_print_stat(struct stat_sdb_t *sdb,	/* stat database */
       print_sdist(stat, fd);
       break;
     case sc_formula:
-      {
-	/* instantiate a new evaluator to avoid recursion problems */
-	struct eval_state_t *es = eval_new(stat_eval_ident, sdb);
-	char *endp;
-
-	fprintf(fd, "%-22s ", stat->name);
-	val = eval_expr(es, stat->variant.for_formula.formula, &endp);
-	if (eval_error != ERR_NOERR || *endp != '\0')
-	  fprintf(fd, "<error: %s>", eval_err_str[eval_error]);
-	else
-	  myfprintf(fd, stat->format, eval_as_double(val));
-	fprintf(fd, " # %s", stat->desc);
+      if (stat->variant.for_formula.tree)
+	{
+	  fprintf(fd, "%-22s ", stat->name);
+	  val = eval_tree(sdb->evaluator, stat->variant.for_formula.tree);
+	  if (eval_error != ERR_NOERR)
+	    fprintf(fd, "<error: %s>", eval_err_str[eval_error]);
+	  else
+	    myfprintf(fd, stat->format, eval_as_double(val));
+	  fprintf(fd, " # %s", stat->desc);
+	}
+      else
+	{
+	  /* instantiate a new evaluator to avoid recursion problems */
+	  struct eval_state_t *es = eval_new(stat_eval_ident, sdb);
+	  char *endp;
+
+	  fprintf(fd, "%-22s ", stat->name);
+	  val = eval_expr(es, stat->variant.for_formula.formula, &endp);
+	  if (eval_error != ERR_NOERR || *endp != '\0')
+	    fprintf(fd, "<error: %s>", eval_err_str[eval_error]);
+	  else
+	    myfprintf(fd, stat->format, eval_as_double(val));
+	  fprintf(fd, " # %s", stat->desc);
 
-	/* done with the evaluator */
-	eval_delete(es);
-      }
+	  /* done with the evaluator */
+	  eval_delete(es);
+	}
       break;
     default:
       panic("bogus stat class");
@@ -1018,7 +1077,7 @@ stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
 {
   struct stat_stat_t *stat;
 
-  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+  for (stat = sdb->htab[stat_hash(stat_name)]; stat; stat = stat->hnext)
     {
       if (!strcmp(stat->name, stat_name))
 	break;
@@ -1026,6 +1085,179 @@ stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
   return stat;
 }
 
+/* size of the snapshot of stat STAT, sparse distributions and formulas are
+   not included in snapshots */
+static int
+stat_snapshot_len(struct stat_stat_t *stat)	/* stat variable */
+{
+  switch (stat->sc)
+    {
+    case sc_int:
+      return sizeof(int);
+    case sc_uint:
+      return sizeof(unsigned int);
+#ifdef HOST_HAS_QWORD
+    case sc_qword:
+      return sizeof(qword_t);
+    case sc_sqword:
+      return sizeof(sqword_t);
+#endif /* HOST_HAS_QWORD */
+    case sc_float:
+      return sizeof(float);
+    case sc_double:
+      return sizeof(double);
+    case sc_dist:
+      return (stat->variant.for_dist.arr_sz + 1) * sizeof(unsigned int);
+    case sc_sdist:
+    case sc_formula:
+      return 0;
+    default:
+      panic("bogus stat class");
+    }
+  return 0;
+}
+
+/* return the size of a snapshot of the values of the stats in SDB */
+int
+stat_snapshot_size(struct stat_sdb_t *sdb)	/* stat database */
+{
+  int size = 0;
+  struct stat_stat_t *stat;
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    size += stat_snapshot_len(stat);
+  return size;
+}
+
+/* save a snapshot of the values of the stats in SDB into BUF, which must
+   hold at least stat_snapshot_size() bytes */
+void
+stat_snapshot(struct stat_sdb_t *sdb,	/* stat database */
+	      void *buf)		/* snapshot buffer */
+{
+  char *p = buf;
+  struct stat_stat_t *stat;
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    {
+      switch (stat->sc)
+	{
+	case sc_int:
+	  memcpy(p, stat->variant.for_int.var, sizeof(int));
+	  break;
+	case sc_uint:
+	  memcpy(p, stat->variant.for_uint.var, sizeof(unsigned int));
+	  break;
+#ifdef HOST_HAS_QWORD
+	case sc_qword:
+	  memcpy(p, stat->variant.for_qword.var, sizeof(qword_t));
+	  break;
+	case sc_sqword:
+	  memcpy(p, stat->variant.for_sqword.var, sizeof(sqword_t));
+	  break;
+#endif /* HOST_HAS_QWORD */
+	case sc_float:
+	  memcpy(p, stat->variant.for_float.var, sizeof(float));
+	  break;
+	case sc_double:
+	  memcpy(p, stat->variant.for_double.var, sizeof(double));
+	  break;
+	case sc_dist:
+	  memcpy(p, stat->variant.for_dist.arr,
+		 stat->variant.for_dist.arr_sz * sizeof(unsigned int));
+	  memcpy(p + stat->variant.for_dist.arr_sz * sizeof(unsigned int),
+		 &stat->variant.for_dist.overflows, sizeof(unsigned int));
+	  break;
+	default:
+	  /* not saved */;
+	}
+      p += stat_snapshot_len(stat);
+    }
+}
+
+/* set how stat_add_delta() merges stat STAT, qword and distribution stats
+   (i.e., counters) are added by default, all others are not merged */
+struct stat_stat_t *
+stat_set_merge(struct stat_stat_t *stat,	/* stat variable */
+	       enum stat_merge_t merge)		/* merging of stat values */
+{
+  stat->merge = merge;
+  return stat;
+}
+
+/* merge the change in stat values from snapshot BEFORE to snapshot AFTER,
+   both taken from a database with the same stats as SDB (e.g., in a forked
+   copy of the simulator), into the stats in SDB, see stat_set_merge() */
+void
+stat_add_delta(struct stat_sdb_t *sdb,	/* stat database */
+	       void *before,		/* earlier snapshot */
+	       void *after)		/* later snapshot */
+{
+  unsigned int i;
+  char *b = before, *a = after;
+  struct stat_stat_t *stat;
+
+  /* merge AFTER - BEFORE, or AFTER for sm_max, into variable VAR of type
+     TYPE, per the merging of STAT */
+#define ADD_DELTA(TYPE, VAR, OFF)					\
+  {									\
+    TYPE x_b, x_a;							\
+    memcpy(&x_b, b + (OFF), sizeof(TYPE));				\
+    memcpy(&x_a, a + (OFF), sizeof(TYPE));				\
+    if (stat->merge == sm_add)						\
+      *(VAR) += x_a - x_b;						\
+    else if (x_a > *(VAR))						\
+      *(VAR) = x_a;							\
+  }
+
+  for (stat = sdb->stats; stat != NULL; stat = stat->next)
+    {
+      if (stat->merge == sm_none)
+	{
+	  b += stat_snapshot_len(stat);
+	  a += stat_snapshot_len(stat);
+	  continue;
+	}
+
+      switch (stat->sc)
+	{
+	case sc_int:
+	  ADD_DELTA(int, stat->variant.for_int.var, 0);
+	  break;
+	case sc_uint:
+	  ADD_DELTA(unsigned int, stat->variant.for_uint.var, 0);
+	  break;
+#ifdef HOST_HAS_QWORD
+	case sc_qword:
+	  ADD_DELTA(qword_t, stat->variant.for_qword.var, 0);
+	  break;
+	case sc_sqword:
+	  ADD_DELTA(sqword_t, stat->variant.for_sqword.var, 0);
+	  break;
+#endif /* HOST_HAS_QWORD */
+	case sc_float:
+	  ADD_DELTA(float, stat->variant.for_float.var, 0);
+	  break;
+	case sc_double:
+	  ADD_DELTA(double, stat->variant.for_double.var, 0);
+	  break;
+	case sc_dist:
+	  for (i=0; i < stat->variant.for_dist.arr_sz; i++)
+	    ADD_DELTA(unsigned int, &stat->variant.for_dist.arr[i],
+		      i * sizeof(unsigned int));
+	  ADD_DELTA(unsigned int, &stat->variant.for_dist.overflows,
+		    i * sizeof(unsigned int));
+	  break;
+	default:
+	  /* not saved */;
+	}
+      b += stat_snapshot_len(stat);
+      a += stat_snapshot_len(stat);
+    }
+
+#undef ADD_DELTA
+}
+
 #ifdef TESTIT
 
 void
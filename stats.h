@@ -85,10 +85,20 @@ enum stat_class_t {
   sc_NUM
 };
 
+/* how stat_add_delta() merges a stat changed in a copy of the simulator */
+enum stat_merge_t {
+  sm_none = 0,			/* not merged, e.g., config or state values */
+  sm_add,			/* the change is added, e.g., counters */
+  sm_max			/* the larger value is kept, e.g., peaks */
+};
+
 /* sparse array distributions are implemented with a hash table */
 #define HTAB_SZ			1024
 #define HTAB_HASH(I)		((((I) >> 8) ^ (I)) & (HTAB_SZ - 1))
 
+/* stat databases index their stats by name with a hash table */
+#define STAT_HTAB_SZ		1024
+
 /* hash table bucket definition */
 struct bucket_t {
   struct bucket_t *next;	/* pointer to the next bucket */
@@ -118,10 +128,12 @@ typedef void
 /* statistical variable definition */
 struct stat_stat_t {
   struct stat_stat_t *next;	/* pointer to next stat in database list */
+  struct stat_stat_t *hnext;	/* pointer to next stat in name hash chain */
   char *name;			/* stat name */
   char *desc;			/* stat description */
   char *format;			/* stat output print format */
   enum stat_class_t sc;		/* stat class */
+  enum stat_merge_t merge;	/* merging of values from forked copies */
   union stat_variant_t {
     /* sc == sc_int */
     struct stat_for_int_t {
@@ -176,6 +188,7 @@ struct stat_stat_t {
     /* sc == sc_formula */
     struct stat_for_formula_t {
       char *formula;		/* stat formula, see eval.h for format */
+      struct eval_node_t *tree;	/* parsed formula, NULL if unparsable */
     } for_formula;
   } variant;
 };
@@ -183,6 +196,8 @@ struct stat_stat_t {
 /* statistical database */
 struct stat_sdb_t {
   struct stat_stat_t *stats;		/* list of stats in database */
+  struct stat_stat_t *stats_tail;	/* last stat in database list */
+  struct stat_stat_t *htab[STAT_HTAB_SZ]; /* stats hashed by name */
   struct eval_state_t *evaluator;	/* an expression evaluator */
 };
 
@@ -328,5 +343,29 @@ stat_print_stats(struct stat_sdb_t *sdb,/* stat database */
 struct stat_stat_t *
 stat_find_stat(struct stat_sdb_t *sdb,	/* stat database */
 	       char *stat_name);	/* stat name */
+
+/* return the size of a snapshot of the values of the stats in SDB */
+int
+stat_snapshot_size(struct stat_sdb_t *sdb);	/* stat database */
+
+/* save a snapshot of the values of the stats in SDB into BUF, which must
+   hold at least stat_snapshot_size() bytes */
+void
+stat_snapshot(struct stat_sdb_t *sdb,	/* stat database */
+	      void *buf);		/* snapshot buffer */
+
+/* set how stat_add_delta() merges stat STAT, qword and distribution stats
+   (i.e., counters) are added by default, all others are not merged */
+struct stat_stat_t *
+stat_set_merge(struct stat_stat_t *stat,	/* stat variable */
+	       enum stat_merge_t merge);	/* merging of stat values */
+
+/* merge the change in stat values from snapshot BEFORE to snapshot AFTER,
+   both taken from a database with the same stats as SDB (e.g., in a forked
+   copy of the simulator), into the stats in SDB, see stat_set_merge() */
+void
+stat_add_delta(struct stat_sdb_t *sdb,	/* stat database */
+	       void *before,		/* earlier snapshot */
+	       void *after);		/* later snapshot */
 	       
 #endif /* STAT_H */